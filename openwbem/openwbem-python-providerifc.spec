@@ -70,6 +70,7 @@ install doc/*.txt $RPM_BUILD_ROOT/usr/share/doc/packages/%{name}
 %{py_sitedir}/*
 %dir /usr/lib/pycim
 /usr/%_lib/openwbem/provifcs/*
+%{_libexecdir}/owpyworker
 /usr/share/mof/openwbem/*.mof
 %dir /usr/share/doc/packages/%{name}
 /usr/share/doc/packages/%{name}/*
@@ -15,11 +15,23 @@
 * License along with this program; if not, write to the Free Software
 * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
 #include "OW_PyProvIFCCommon.hpp"
 #include <openwbem/OW_CIMException.hpp>
 #include <openwbem/OW_Format.hpp>
 #include <openwbem/OW_CIMValue.hpp>
 
+extern "C"
+{
+#include <stdio.h>
+#include <unistd.h>
+#ifdef HAVE_MALLINFO
+#include <malloc.h>
+#endif
+}
+
 using namespace OW_NAMESPACE;
 
 namespace PythonProvIFC
@@ -69,106 +81,138 @@ LogPyException(
 }
 
 //////////////////////////////////////////////////////////////////////////////
-PyProviderReg::PyProviderReg(const CIMInstance& ci)
-	: m_ci(ci)
-{
-}
-
-//////////////////////////////////////////////////////////////////////////////
-PyProviderReg::PyProviderReg()
-	: m_ci(CIMNULL)
-{
-}
-
-//////////////////////////////////////////////////////////////////////////////
-PyProviderReg::PyProviderReg(const PyProviderReg& arg)
-	: m_ci(arg.m_ci)
+Int64
+getHeapInUse()
 {
+#ifdef HAVE_MALLINFO
+	// mallinfo's fields are ints. They wrap past 4GB, which is more than
+	// an interpreter budget is going to be set to.
+	struct mallinfo mi = ::mallinfo();
+	return Int64(UInt32(mi.uordblks)) + Int64(UInt32(mi.hblkhd));
+#else
+	FILE* fp = ::fopen("/proc/self/statm", "r");
+	if (!fp)
+	{
+		return -1;
+	}
+	long size = 0;
+	long resident = 0;
+	int rc = ::fscanf(fp, "%ld %ld", &size, &resident);
+	::fclose(fp);
+	if (rc != 2)
+	{
+		return -1;
+	}
+	return Int64(resident) * Int64(::sysconf(_SC_PAGESIZE));
+#endif
 }
 
-//////////////////////////////////////////////////////////////////////////////
-PyProviderReg&
-PyProviderReg::operator=(const PyProviderReg& arg)
+namespace
 {
-	m_ci = arg.m_ci;
-	return *this;
-}
 
 //////////////////////////////////////////////////////////////////////////////
-String
-PyProviderReg::getInstanceId() const
+template <typename T>
+void
+getRegProperty(
+	const CIMInstance& ci,
+	const char* propName,
+	T& rv)
 {
-	String rv;
-	CIMValue cv = m_ci.getPropertyValue("InstanceID");
+	CIMValue cv = ci.getPropertyValue(propName);
 	if (cv)
 		cv.get(rv);
-	return rv;
 }
 
-//////////////////////////////////////////////////////////////////////////////
-String
-PyProviderReg::getModPath() const
-{
-	String rv;
-	CIMValue cv = m_ci.getPropertyValue("ModulePath");
-	if (cv)
-		cv.get(rv);
-	return rv;
-}
-
-//////////////////////////////////////////////////////////////////////////////
-StringArray
-PyProviderReg::getNameSpaceNames() const
-{
-	StringArray rv;
-	CIMValue cv = m_ci.getPropertyValue("NamespaceNames");
-	if (cv)
-		cv.get(rv);
-	return rv;
-}
+}	// End of unnamed namespace
 
 //////////////////////////////////////////////////////////////////////////////
-String
-PyProviderReg::getClassName() const
+PyProviderReg::PyProviderReg(const CIMInstance& ci)
+	: m_isNull(!ci)
+	, m_instanceId()
+	, m_modPath()
+	, m_namespaces()
+	, m_className()
+	, m_providerTypes()
+	, m_methodNames()
+	, m_handlerClassNames()
+	, m_lazyInstances(false)
+	, m_outOfProcess(false)
+	, m_schedulingWeight(1)
+	, m_preload(false)
 {
-	String rv;
-	CIMValue cv = m_ci.getPropertyValue("ClassName");
-	if (cv)
-		cv.get(rv);
-	return rv;
+	if (m_isNull)
+	{
+		return;
+	}
+	getRegProperty(ci, "InstanceID", m_instanceId);
+	getRegProperty(ci, "ModulePath", m_modPath);
+	getRegProperty(ci, "NamespaceNames", m_namespaces);
+	getRegProperty(ci, "ClassName", m_className);
+	getRegProperty(ci, "ProviderTypes", m_providerTypes);
+	getRegProperty(ci, "MethodNames", m_methodNames);
+	getRegProperty(ci, "IndicationExportHandlerClassNames",
+		m_handlerClassNames);
+	getRegProperty(ci, "LazyInstances", m_lazyInstances);
+	getRegProperty(ci, "OutOfProcess", m_outOfProcess);
+	getRegProperty(ci, "SchedulingWeight", m_schedulingWeight);
+	getRegProperty(ci, "Preload", m_preload);
+	if (!m_schedulingWeight)
+	{
+		m_schedulingWeight = 1;
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////////
-UInt16Array
-PyProviderReg::getProviderTypes() const
+PyProviderReg::PyProviderReg()
+	: m_isNull(true)
+	, m_instanceId()
+	, m_modPath()
+	, m_namespaces()
+	, m_className()
+	, m_providerTypes()
+	, m_methodNames()
+	, m_handlerClassNames()
+	, m_lazyInstances(false)
+	, m_outOfProcess(false)
+	, m_schedulingWeight(1)
+	, m_preload(false)
 {
-	UInt16Array rv;
-	CIMValue cv = m_ci.getPropertyValue("ProviderTypes");
-	if (cv)
-		cv.get(rv);
-	return rv;
 }
 
 //////////////////////////////////////////////////////////////////////////////
-StringArray
-PyProviderReg::getMethodNames() const
+PyProviderReg::PyProviderReg(const PyProviderReg& arg)
+	: m_isNull(arg.m_isNull)
+	, m_instanceId(arg.m_instanceId)
+	, m_modPath(arg.m_modPath)
+	, m_namespaces(arg.m_namespaces)
+	, m_className(arg.m_className)
+	, m_providerTypes(arg.m_providerTypes)
+	, m_methodNames(arg.m_methodNames)
+	, m_handlerClassNames(arg.m_handlerClassNames)
+	, m_lazyInstances(arg.m_lazyInstances)
+	, m_outOfProcess(arg.m_outOfProcess)
+	, m_schedulingWeight(arg.m_schedulingWeight)
+	, m_preload(arg.m_preload)
 {
-	StringArray rv;
-	CIMValue cv = m_ci.getPropertyValue("MethodNames");
-	if (cv)
-		cv.get(rv);
-	return rv;
 }
 
 //////////////////////////////////////////////////////////////////////////////
-StringArray
-PyProviderReg::getExportHandlerClassNames() const
+PyProviderReg&
+PyProviderReg::operator=(const PyProviderReg& arg)
 {
-	StringArray rv;
-	CIMValue cv = m_ci.getPropertyValue("IndicationExportHandlerClassNames");
-	if (cv)
-		cv.get(rv);
-	return rv;
+	m_isNull = arg.m_isNull;
+	m_instanceId = arg.m_instanceId;
+	m_modPath = arg.m_modPath;
+	m_namespaces = arg.m_namespaces;
+	m_className = arg.m_className;
+	m_providerTypes = arg.m_providerTypes;
+	m_methodNames = arg.m_methodNames;
+	m_handlerClassNames = arg.m_handlerClassNames;
+	m_lazyInstances = arg.m_lazyInstances;
+	m_outOfProcess = arg.m_outOfProcess;
+	m_schedulingWeight = arg.m_schedulingWeight;
+	m_preload = arg.m_preload;
+	return *this;
 }
 
 }	// End of namespace PythonProvIFC
@@ -23,6 +23,8 @@
 #include <openwbem/OW_Exception.hpp>
 #include <openwbem/OW_ProviderEnvironmentIFC.hpp>
 #include <openwbem/OW_CIMInstance.hpp>
+#include <openwbem/OW_String.hpp>
+#include <openwbem/OW_Array.hpp>
 
 using namespace OW_NAMESPACE;
 
@@ -63,22 +65,42 @@ public:
 		E_POLLED = 8,
 	};
 
+	// The properties are read once here, the getters don't look at the
+	// instance
 	PyProviderReg(const CIMInstance& ci);
 	PyProviderReg();
 	PyProviderReg(const PyProviderReg& arg);
 	PyProviderReg& operator=(const PyProviderReg& arg);
 
-	String getModPath() const;
-	String getInstanceId() const;
-	StringArray getNameSpaceNames() const;
-	String getClassName() const;
-	UInt16Array getProviderTypes() const;
-	StringArray getMethodNames() const;
-	StringArray getExportHandlerClassNames() const;
-	bool isNull() const { return (!m_ci) ? true : false; }
+	const String& getModPath() const { return m_modPath; }
+	const String& getInstanceId() const { return m_instanceId; }
+	const StringArray& getNameSpaceNames() const { return m_namespaces; }
+	const String& getClassName() const { return m_className; }
+	const UInt16Array& getProviderTypes() const { return m_providerTypes; }
+	const StringArray& getMethodNames() const { return m_methodNames; }
+	const StringArray& getExportHandlerClassNames() const
+	{
+		return m_handlerClassNames;
+	}
+	bool getLazyInstances() const { return m_lazyInstances; }
+	bool getOutOfProcess() const { return m_outOfProcess; }
+	UInt32 getSchedulingWeight() const { return m_schedulingWeight; }
+	bool getPreload() const { return m_preload; }
+	bool isNull() const { return m_isNull; }
 	
 private:
-	CIMInstance m_ci;
+	bool m_isNull;
+	String m_instanceId;
+	String m_modPath;
+	StringArray m_namespaces;
+	String m_className;
+	UInt16Array m_providerTypes;
+	StringArray m_methodNames;
+	StringArray m_handlerClassNames;
+	bool m_lazyInstances;
+	bool m_outOfProcess;
+	UInt32 m_schedulingWeight;
+	bool m_preload;
 };
 
 String
@@ -98,6 +120,13 @@ LogPyException(
 	int lineno,
 	LoggerRef& lgr);
 
+// Returns the number of bytes of the process heap in use. Python's
+// allocators take their memory from it, so this is what the interpreters
+// use plus what the CIMOM uses. Falls back to the resident set size where
+// the heap can't be looked at. Returns -1 if neither can be read.
+Int64
+getHeapInUse();
+
 }	// End of namespace PythonProvIFC
 
 #endif	// OW_PYPROVIFCCOMMON_HPP_GUARD_
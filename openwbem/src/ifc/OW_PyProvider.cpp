@@ -20,6 +20,8 @@
 #include "OW_PyProvIFCCommon.hpp"
 #include "OW_PyProviderEnvironment.hpp"
 #include "OW_PyConverter.hpp"
+#include "OW_PyLazyInstance.hpp"
+#include "OW_PyInstanceIterator.hpp"
 #include <openwbem/OW_CIMValue.hpp>
 #include <openwbem/OW_CIMClass.hpp>
 #include <openwbem/OW_CIMInstance.hpp>
@@ -29,6 +31,8 @@
 #include <openwbem/OW_CIMException.hpp>
 #include <openwbem/OW_NoSuchProviderException.hpp>
 #include <openwbem/OW_Format.hpp>
+#include <openwbem/OW_Thread.hpp>
+#include <openwbem/OW_NonRecursiveMutexLock.hpp>
 
 #include <iostream>
 using std::cout;
@@ -38,6 +42,7 @@ extern "C"
 {
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 }
 
@@ -52,9 +57,6 @@ OW_DEFINE_EXCEPTION(NoSuchMethod);
 namespace
 {
 
-Py::Module g_pywbem;
-Py::Object g_cimexObj;
-
 //////////////////////////////////////////////////////////////////////////////
 String
 getPyFile(const String& fname)
@@ -214,25 +216,274 @@ getFunction(
 	return Py::Callable();	// Shouldn't hit this
 }
 
+UInt32 g_resultBatchSize = 100;
+UInt32 g_prefetchDepth = 0;				// 0 if prefetching is off
+volatile int g_moduleLoads = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+// ProviderProxy imports a provider module under its path. Python 2 runs a
+// module that is already in sys.modules again in the same module object,
+// so a new version of a changed provider would replace the code of the
+// version still serving. The path is cleared before a load, and the module
+// is moved to a name of its own after it. Must be called with the GIL
+// held.
+void
+clearProviderModule(
+	const String& path)
+{
+	Py::Dict modules(PyImport_GetModuleDict());
+	if (modules.hasKey(path))
+	{
+		// Left behind by a load that failed
+		modules.delItem(path);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+String
+keepProviderModule(
+	const String& path)
+{
+	Py::Dict modules(PyImport_GetModuleDict());
+	if (!modules.hasKey(path))
+	{
+		return String();
+	}
+	String name = Format("%1#%2", path,
+		__sync_add_and_fetch(&g_moduleLoads, 1));
+	modules.setItem(name, modules.getItem(path));
+	modules.delItem(path);
+	return name;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+inline UInt64
+getUsecs()
+{
+	struct timeval tv;
+	::gettimeofday(&tv, 0);
+	return UInt64(tv.tv_sec) * 1000000 + UInt64(tv.tv_usec);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Collects the results converted while the GIL is held and hands them to
+// the CIMOM result handler in batches of g_resultBatchSize with the GIL
+// released, so filtering, encoding and chunk delivery done by the CIMOM
+// don't stall other python providers. The batches are accounted in the
+// stats of the provider producing them. Must be used with the GIL held.
+// flush() must be called once the provider is done producing results.
+template <typename T, typename RH>
+class ResultBatcher
+{
+public:
+	ResultBatcher(RH& result, PyResultBatchStats& stats)
+		: m_result(result)
+		, m_stats(stats)
+		, m_batch()
+		, m_holdStart(getUsecs())
+	{
+		m_batch.reserve(g_resultBatchSize);
+	}
+
+	void add(const T& item)
+	{
+		m_batch.append(item);
+		if (m_batch.size() >= g_resultBatchSize)
+		{
+			flush();
+		}
+	}
+
+	void flush()
+	{
+		if (m_batch.empty())
+		{
+			return;
+		}
+
+		UInt64 holdUsecs = getUsecs() - m_holdStart;
+		m_stats.batches++;
+		m_stats.items += m_batch.size();
+		m_stats.holdUsecs += holdUsecs;
+		if (holdUsecs > m_stats.maxHoldUsecs)
+		{
+			m_stats.maxHoldUsecs = holdUsecs;
+		}
+
+		PYCXX_ALLOW_THREADS
+		for (typename Array<T>::size_type i = 0; i < m_batch.size(); i++)
+		{
+			m_result.handle(m_batch[i]);
+		}
+		PYCXX_END_ALLOW_THREADS
+
+		m_batch.clear();
+		m_holdStart = getUsecs();
+	}
+
+private:
+	RH& m_result;
+	PyResultBatchStats& m_stats;
+	Array<T> m_batch;
+	UInt64 m_holdStart;
+};
+
+typedef ResultBatcher<CIMInstance, CIMInstanceResultHandlerIFC>
+	InstanceBatcher;
+typedef ResultBatcher<CIMObjectPath, CIMObjectPathResultHandlerIFC>
+	ObjectPathBatcher;
+
+//////////////////////////////////////////////////////////////////////////////
+// Converts a columnar instance batch returned by enumInstances.
+// Must be called with the GIL held.
+CIMInstanceArray
+convertInstanceBatch(
+	const ProviderEnvironmentIFCRef& env,
+	const String& ns,
+	const Py::Object& pybatch,
+	const CIMClass& requestedClass,
+	const CIMClass& cimClass)
+{
+	String className = OWPyConv::getPyInstBatchClassName(pybatch);
+	CIMClass cls(CIMNULL);
+	if (className.equalsIgnoreCase(cimClass.getName()))
+	{
+		cls = cimClass;
+	}
+	else if (className.equalsIgnoreCase(requestedClass.getName()))
+	{
+		cls = requestedClass;
+	}
+	else
+	{
+		// Batch for a sub class
+		PYCXX_ALLOW_THREADS
+		cls = env->getCIMOMHandle()->getClass(ns, className);
+		PYCXX_END_ALLOW_THREADS
+	}
+
+	return OWPyConv::PyInstBatch2OW(pybatch, cls, ns);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Deliver a columnar instance batch returned by enumInstances.
+// Must be called with the GIL held.
+void
+handleInstanceBatch(
+	const ProviderEnvironmentIFCRef& env,
+	const String& ns,
+	const Py::Object& pybatch,
+	InstanceBatcher& batcher,
+	const CIMClass& requestedClass,
+	const CIMClass& cimClass)
+{
+	CIMInstanceArray insts = convertInstanceBatch(env, ns, pybatch,
+		requestedClass, cimClass);
+	for (CIMInstanceArray::size_type i = 0; i < insts.size(); i++)
+	{
+		batcher.add(insts[i]);
+	}
+}
+
 }	// End of unnamed namespace
 
 //////////////////////////////////////////////////////////////////////////////
 // STATIC
 void
-PyProvider::setPyWbemMod(
-	const Py::Module& pywbemMod)
+PyProvider::setResultBatchSize(
+	UInt32 batchSize)
 {
-	g_pywbem = pywbemMod;
-	g_cimexObj = pywbemMod.getAttr("CIMError");
+	g_resultBatchSize = (batchSize) ? batchSize : 1;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+UInt32
+PyProvider::getResultBatchSize()
+{
+	return g_resultBatchSize;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyResultBatchStats
+PyProvider::getResultBatchStats() const
+{
+	Py::GILGuard gg;	// The counters are protected by the GIL
+	return m_resultBatchStats;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+PyProvider::setPrefetchDepth(
+	UInt32 depth)
+{
+	g_prefetchDepth = depth;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+UInt32
+PyProvider::getPrefetchDepth()
+{
+	return g_prefetchDepth;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Logs how long the provider's first request took, and ends the
+// iterators the provider started during the request. Must be constructed
+// after the GIL is acquired, so it is destroyed before the GIL is given
+// up.
+class PyProvider::RequestScope
+{
+public:
+	RequestScope(PyProvider* pprov, const ProviderEnvironmentIFCRef& env,
+		const char* operation)
+		: m_pprov(pprov)
+		, m_env(env)
+		, m_operation(operation)
+		, m_first(pprov->m_servedRequest == 0)
+		, m_start((m_first) ? getUsecs() : 0)
+		, m_iterators()
+	{
+	}
+
+	~RequestScope()
+	{
+		if (m_first
+			&& __sync_bool_compare_and_swap(&m_pprov->m_servedRequest, 0, 1))
+		{
+			// A provider that wasn't preloaded had its load time added
+			// to this request
+			LoggerRef logger = myLogger(m_env);
+			OW_LOG_DEBUG(logger, Format("Python provider %1 first request "
+				"(%2) took %3 usecs. Load took %4 usecs. Preloaded: %5",
+				m_pprov->m_path, m_operation, getUsecs() - m_start,
+				m_pprov->m_loadUsecs, (m_pprov->m_preloaded) ? "yes" : "no"));
+		}
+	}
+
+private:
+	RequestScope(const RequestScope&);
+	RequestScope& operator=(const RequestScope&);
+
+	PyProvider* m_pprov;
+	const ProviderEnvironmentIFCRef& m_env;
+	const char* m_operation;
+	bool m_first;
+	UInt64 m_start;
+	PyIteratorScope m_iterators;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 PyProvider::PyProvider(
 	const String& path, 
 	const ProviderEnvironmentIFCRef& env,
-	bool unloadableType)
+	bool unloadableType,
+	PyInterpreterState* interp)
 	: IntrusiveCountableBase()
 	, m_path(path)
+	, m_interp(interp)
 	, m_pyprov()
 	, m_dt(0)
 	, m_fileModTime(0)
@@ -241,22 +492,56 @@ PyProvider::PyProvider(
 #endif
 	, m_unloadableType(unloadableType)
 	, m_handlerClassNames()
+	, m_lazyInstances(false)
+	, m_workerPool()
+	, m_scheduler()
+	, m_asyncLoop()
+	, m_fileWatcher()
+	, m_fileWatch()
+	, m_moduleName()
+	, m_residentBytes(0)
+	, m_loadUsecs(0)
+	, m_resultBatchStats()
+	, m_preloaded(false)
+	, m_servedRequest(0)
+	, m_version(0)
+	, m_uses(0)
+	, m_hasUseListener(0)
+	, m_useGuard()
+	, m_useListener()
 {
+	UInt64 loadStart = getUsecs();
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "load");
 	Py::GILGuard gg;	// Acquire python's GIL
+	PyIteratorScope its;	// Ends the iterators started from here
 
 	LoggerRef logger = myLogger(env);
 
 	try
 	{
 		// Get the Python proxy provider
-		Py::Object cim_provider = g_pywbem.getAttr("cim_provider"); 
+		Py::Object cim_provider = OWPyConv::getPyWbemMod().getAttr(
+			"cim_provider");
 		Py::Callable ctor = cim_provider.getAttr("ProviderProxy");
 		Py::Tuple args(2);
 		args[0] = PyProviderEnvironment::newObject(env); 	// Provider Environment
 		args[1] = Py::String(m_path);
-		// Construct a CIMProvider python object
+		// Construct a CIMProvider python object. What the module takes
+		// while the GIL is held is attributed to the provider.
+		Int64 heapBefore = getHeapInUse();
+		clearProviderModule(m_path);
 		m_pyprov = ctor.apply(args);
+		m_moduleName = keepProviderModule(m_path);
+		Int64 heapAfter = getHeapInUse();
+		if (heapBefore >= 0 && heapAfter >= 0)
+		{
+			m_residentBytes = heapAfter - heapBefore;
+		}
 		m_fileModTime = getModTime(m_path);
+		// Loading the provider may have reloaded pywbem
+		OWPyConv::checkPyWbemMod();
+		m_loadUsecs = getUsecs() - loadStart;
 	}
 	catch(Py::Exception& e)
 	{
@@ -268,11 +553,259 @@ PyProvider::PyProvider(
 	}
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Results a provider returns as a coroutine or future are awaited on the
+// event loop. Must be called with the GIL held.
+Py::Object
+PyProvider::awaitResult(
+	const Py::Object& obj)
+{
+	if (m_asyncLoop && m_asyncLoop->isAwaitable(obj))
+	{
+		return m_asyncLoop->await(obj);
+	}
+	return obj;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Runs the python iterator of an instance enumeration on a thread of its
+// own. Results are converted in chunks of the result batch size with the
+// GIL held and put on a bounded queue with it released. An error is kept
+// and raised again on the request thread by rethrow, so it is reported as
+// if the request thread had run the iterator.
+class PyProvider::PrefetchProducer : public Thread
+{
+public:
+	PrefetchProducer(
+		PyProvider* provider,
+		const PyInstanceQueueRef& queue,
+		const Py::Object& iterable,
+		const ProviderEnvironmentIFCRef& env,
+		const char* operation,
+		const String& ns,
+		bool allowBatches,
+		const CIMClass& requestedClass,
+		const CIMClass& cimClass)
+		: Thread()
+		, m_provider(provider)
+		, m_queue(queue)
+		, m_iterable(iterable)
+		, m_env(env)
+		, m_operation(operation)
+		, m_ns(ns)
+		, m_allowBatches(allowBatches)
+		, m_requestedClass(requestedClass)
+		, m_cimClass(cimClass)
+		, m_error(E_NO_ERROR)
+		, m_errNo(CIMException::FAILED)
+		, m_errMsg()
+		, m_excType()
+		, m_excValue()
+		, m_excTraceback()
+	{
+	}
+
+	// Raises the error the iterator ended with, if any. Must be called
+	// with the GIL held, after the thread was joined.
+	void rethrow()
+	{
+		switch (m_error)
+		{
+			case E_PYTHON_ERROR:
+				PyErr_Restore(Py::new_reference_to(m_excType),
+					Py::new_reference_to(m_excValue),
+					(m_excTraceback.isNone()) ? 0
+						: Py::new_reference_to(m_excTraceback));
+				m_excType = Py::Object();
+				m_excValue = Py::Object();
+				m_excTraceback = Py::Object();
+				throw Py::Exception();
+			case E_CONVERSION_ERROR:
+				OW_THROW(PyConversionException, m_errMsg.c_str());
+			case E_CIM_ERROR:
+				OW_THROWCIMMSG(m_errNo, m_errMsg.c_str());
+			default:
+				break;
+		}
+	}
+
+protected:
+	virtual Int32 run()
+	{
+		// The request this runs for is admitted already. Upcalls made from
+		// here must not wait for the scheduler again.
+		PyScheduleTicket st(PyProviderSchedulerRef(), m_provider->m_path,
+			PyProviderScheduler::E_BULK_OP);
+		Py::InterpreterScope is(m_provider->m_interp);
+		Py::GILStatsScope gs(m_provider->m_path, m_operation);
+		Py::GILGuard gg;	// Acquire python's GIL
+		PyIteratorScope its;	// Ends the iterators started from here
+		try
+		{
+			CIMInstanceArray chunk;
+			chunk.reserve(g_resultBatchSize);
+			bool open = true;
+			PyObject* item;
+			while (open && (item = PyIter_Next(m_iterable.ptr())))
+			{
+				Py::Object wko = m_provider->awaitResult(
+					Py::Object(item, true));
+				if (m_allowBatches && OWPyConv::isPyInstBatch(wko))
+				{
+					CIMInstanceArray insts = convertInstanceBatch(m_env,
+						m_ns, wko, m_requestedClass, m_cimClass);
+					for (size_t i = 0; i < insts.size(); i++)
+					{
+						chunk.append(insts[i]);
+					}
+				}
+				else
+				{
+					chunk.append(OWPyConv::PyInst2OW(wko, m_ns));
+				}
+				if (chunk.size() >= g_resultBatchSize)
+				{
+					open = pushChunk(chunk);
+				}
+			}
+			if (PyErr_Occurred())
+			{
+				throw Py::Exception();
+			}
+			if (open)
+			{
+				pushChunk(chunk);
+			}
+		}
+		catch (Py::Exception& e)
+		{
+			PyObject* etype;
+			PyObject* evalue;
+			PyObject* etb;
+			PyErr_Fetch(&etype, &evalue, &etb);
+			PyErr_NormalizeException(&etype, &evalue, &etb);
+			m_excType = Py::Object(etype, true);
+			m_excValue = (evalue) ? Py::Object(evalue, true) : Py::None();
+			m_excTraceback = (etb) ? Py::Object(etb, true) : Py::None();
+			m_error = E_PYTHON_ERROR;
+		}
+		catch (const PyConversionException& e)
+		{
+			m_errMsg = e.getMessage();
+			m_error = E_CONVERSION_ERROR;
+		}
+		catch (const CIMException& e)
+		{
+			m_errNo = e.getErrNo();
+			m_errMsg = e.getMessage();
+			m_error = E_CIM_ERROR;
+		}
+		catch (const Exception& e)
+		{
+			m_errMsg = Format("%1 failed on provider %2: %3",
+				m_operation, m_provider->m_path, e.getMessage());
+			m_error = E_CIM_ERROR;
+		}
+		// Drops the iterator with the GIL held. A generator the request
+		// thread stopped reading gets closed here.
+		m_iterable = Py::Object();
+		m_queue->finish();
+		return 0;
+	}
+
+private:
+	// Hands a chunk to the request thread. Returns false if it stopped
+	// reading.
+	bool pushChunk(CIMInstanceArray& chunk)
+	{
+		bool open = true;
+		PYCXX_ALLOW_THREADS
+		for (size_t i = 0; i < chunk.size() && open; i++)
+		{
+			open = m_queue->push(chunk[i]);
+		}
+		PYCXX_END_ALLOW_THREADS
+		chunk.clear();
+		return open;
+	}
+
+	enum EError
+	{
+		E_NO_ERROR,
+		E_PYTHON_ERROR,
+		E_CONVERSION_ERROR,
+		E_CIM_ERROR
+	};
+
+	PyProvider* m_provider;
+	PyInstanceQueueRef m_queue;
+	Py::Object m_iterable;
+	ProviderEnvironmentIFCRef m_env;
+	const char* m_operation;
+	String m_ns;
+	bool m_allowBatches;
+	CIMClass m_requestedClass;
+	CIMClass m_cimClass;
+	EError m_error;
+	CIMException::ErrNoType m_errNo;
+	String m_errMsg;
+	Py::Object m_excType;
+	Py::Object m_excValue;
+	Py::Object m_excTraceback;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Delivers the results of an instance enumeration through a
+// PrefetchProducer, so python produces the next results while the CIMOM
+// handles the previous ones. Must be called with the GIL held.
+void
+PyProvider::prefetchInstances(
+	const ProviderEnvironmentIFCRef& env,
+	const char* operation,
+	const Py::Object& iterable,
+	const String& ns,
+	bool allowBatches,
+	const CIMClass& requestedClass,
+	const CIMClass& cimClass,
+	CIMInstanceResultHandlerIFC& result)
+{
+	PyInstanceQueueRef queue(new PyInstanceQueue(g_prefetchDepth));
+	IntrusiveReference<PrefetchProducer> producer(new PrefetchProducer(this,
+		queue, iterable, env, operation, ns, allowBatches, requestedClass,
+		cimClass));
+	PYCXX_ALLOW_THREADS
+	producer->start();
+	try
+	{
+		CIMInstance ci(CIMNULL);
+		while (queue->pop(ci))
+		{
+			result.handle(ci);
+		}
+	}
+	catch (...)
+	{
+		// Stops the producer at its next result
+		queue->close();
+		producer->join();
+		throw;
+	}
+	producer->join();
+	PYCXX_END_ALLOW_THREADS
+	producer->rethrow();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 PyProvider::~PyProvider()
 {
+	if (m_fileWatcher)
+	{
+		m_fileWatcher->unwatch(m_fileWatch);
+	}
 	try
 	{
+		Py::InterpreterScope is(m_interp);
+		Py::GILStatsScope gs(m_path, "unload");
 		Py::GILGuard gg;	// Acquire python's GIL
 		m_pyprov.release();
 	}
@@ -287,16 +820,121 @@ PyProvider::~PyProvider()
 	}
 }
 
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProvider::setFileWatcher(
+	const PyProviderFileWatcherRef& watcher)
+{
+	m_fileWatcher = watcher;
+	m_fileWatch = watcher->watch(getPyFile(m_path));
+	// The file may have changed after it was loaded and before the watch
+	// was set up
+	if (!m_fileWatch->isPolled()
+		&& getModTime(m_fileWatch->getFileName()) > m_fileModTime)
+	{
+		m_fileWatch->markDirty();
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////////
 bool
 PyProvider::providerChanged() const
 {
+	if (m_fileWatch && !m_fileWatch->isPolled())
+	{
+		if (!m_fileWatch->isDirty())
+		{
+			return false;
+		}
+		// Cleared first, so a change made while the file is looked at
+		// marks it again
+		m_fileWatch->clearDirty();
+		if (getModTime(m_fileWatch->getFileName()) > m_fileModTime)
+		{
+			// Stays dirty until the provider is replaced
+			m_fileWatch->markDirty();
+			return true;
+		}
+		return false;
+	}
 	String pyfname = m_path;
 	pyfname = getPyFile(m_path);
 	time_t modTime = getModTime(pyfname);
 	return (modTime > m_fileModTime);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProvider::dropModule()
+{
+	if (m_moduleName.empty())
+	{
+		return;
+	}
+	Py::InterpreterScope is(m_interp);
+	Py::GILGuard gg;	// Acquire python's GIL
+	try
+	{
+		Py::Dict modules(PyImport_GetModuleDict());
+		if (modules.hasKey(m_moduleName))
+		{
+			modules.delItem(m_moduleName);
+		}
+	}
+	catch(Py::Exception& e)
+	{
+		e.clear();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProvider::keepVersion()
+{
+	m_fileModTime = getModTime(getPyFile(m_path));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProvider::releaseUse()
+{
+	if (__sync_sub_and_fetch(&m_uses, 1) != 0
+		|| !__atomic_load_n(&m_hasUseListener, __ATOMIC_SEQ_CST))
+	{
+		return;
+	}
+	PyProviderUseListenerRef listener;
+	{
+		NonRecursiveMutexLock l(m_useGuard);
+		listener = m_useListener;
+	}
+	if (listener)
+	{
+		listener->usesReleased();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// A use released before the listener is set isn't reported. The caller
+// looks at getUses after setting it.
+void
+PyProvider::setUseListener(
+	const PyProviderUseListenerRef& listener)
+{
+	{
+		NonRecursiveMutexLock l(m_useGuard);
+		m_useListener = listener;
+	}
+	__atomic_store_n(&m_hasUseListener, 1, __ATOMIC_SEQ_CST);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Int64
+PyProvider::getResidentBytes() const
+{
+	return (m_residentBytes > 0) ? m_residentBytes : 0;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 void 
 PyProvider::updateAccessTime()
@@ -318,6 +956,21 @@ PyProvider::getFileName() const
 	return m_path;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyProvider::inst2Py(
+	const CIMInstance& ci,
+	const String& ns) const
+{
+	// Providers registered with LazyInstances=true get a proxy that
+	// converts properties as they are accessed
+	if (m_lazyInstances)
+	{
+		return PyLazyInstance::newObject(ci, ns);
+	}
+	return OWPyConv::OWInst2Py(ci, ns);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 String
 PyProvider::processPyException(
@@ -328,7 +981,8 @@ PyProvider::processPyException(
 {
 	Py::Object etype, evalue;
 
-	bool isCIMExc = PyErr_ExceptionMatches(g_cimexObj.ptr());
+	Py::Object cimexObj = OWPyConv::getPyWbemMod().getAttr("CIMError");
+	bool isCIMExc = PyErr_ExceptionMatches(cimexObj.ptr());
 	String tb = LogPyException(thrownEx, __FILE__, lineno, lgr, etype,
 		evalue, !isCIMExc);
 	thrownEx.clear();
@@ -397,7 +1051,10 @@ bool
 PyProvider::canShutDown(
 	const ProviderEnvironmentIFCRef& env) const
 {
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "canShutDown");
 	Py::GILGuard gg;	// Acquire python's GIL
+	PyIteratorScope its;	// Ends the iterators started from here
 
 	LoggerRef logger = myLogger(env);
 
@@ -443,7 +1100,10 @@ void
 PyProvider::shutDown(
 	const ProviderEnvironmentIFCRef& env)
 {
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "shutDown");
 	Py::GILGuard gg;	// Acquire python's GIL
+	PyIteratorScope its;	// Ends the iterators started from here
 
 	LoggerRef logger = myLogger(env);
 
@@ -482,6 +1142,53 @@ PyProvider::shutDown(
 	}
 }
 
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProvider::warmUp(
+	const ProviderEnvironmentIFCRef& env)
+{
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "warmUp");
+	Py::GILGuard gg;	// Acquire python's GIL
+	PyIteratorScope its;	// Ends the iterators started from here
+
+	LoggerRef logger = myLogger(env);
+
+	try
+	{
+		Py::Callable pyfunc;
+		try
+		{
+			String fname = getFunctionName("warmup");
+			pyfunc = m_pyprov.getAttr(fname);
+		}
+		catch(Py::Exception& e)
+		{
+			e.clear();
+			return;
+		}
+		Py::Tuple args(1);
+		args[0] = PyProviderEnvironment::newObject(env); 	// Provider Environment
+		awaitResult(pyfunc.apply(args));
+	}
+	catch(Py::Exception& e)
+	{
+		OW_LOG_ERROR(logger, Format("Caught python exception invoking "
+			"warmup on provider %1", m_path));
+
+		// Rethrow as an exception OW understands
+		processPyException(e, __LINE__, logger);
+	}
+	catch(const PyConversionException& e)
+	{
+		String msg = Format("Caught python conversion exception calling "
+			"warmup on provider %1. Exception Message: %2", m_path,
+			e.getMessage());
+		OW_LOG_ERROR(logger, msg);
+		OW_THROWCIMMSG(CIMException::FAILED, msg.c_str());
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////////
 void
 PyProvider::enumInstanceNames(
@@ -491,7 +1198,19 @@ PyProvider::enumInstanceNames(
 	CIMObjectPathResultHandlerIFC& result,
 	const CIMClass& cimClass)
 {
+	if (m_workerPool)
+	{
+		m_workerPool->enumInstanceNames(m_path, m_fileModTime,
+			env->getUserName(), ns, cimClass, result);
+		return;
+	}
+
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_BULK_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "enumInstanceNames");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "enumInstanceNames");
 
 	LoggerRef logger = myLogger(env);
 
@@ -501,8 +1220,8 @@ PyProvider::enumInstanceNames(
 		Py::Tuple args(3);
 		args[0] = PyProviderEnvironment::newObject(env); 	// Provider Environment
 		args[1] = Py::String(ns);							// Namespace
-		args[2] = OWPyConv::OWClass2Py(cimClass);			// CIM Class
-		Py::Object wko = pyfunc.apply(args);
+		args[2] = OWPyConv::OWCachedClass2Py(cimClass, ns);	// CIM Class
+		Py::Object wko = awaitResult(pyfunc.apply(args));
 		PyObject* ito = PyObject_GetIter(wko.ptr());
 		if (!ito)
 		{
@@ -513,16 +1232,28 @@ PyProvider::enumInstanceNames(
 			OW_THROWCIMMSG(CIMException::FAILED, msg.c_str());
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		// Providers may yield plain tuples of key values in the order
+		// of the key properties of the class instead of CIMInstanceNames
+		OWPyKeyTupleConv keyConv(cimClass, ns);
+		ObjectPathBatcher batcher(result, m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
-			wko = Py::Object(item, true); 
-			result.handle(OWPyConv::PyRef2OW(wko, ns));
+			wko = awaitResult(Py::Object(item, true));
+			if (OWPyKeyTupleConv::isPyKeyTuple(wko))
+			{
+				batcher.add(keyConv.PyKeyTuple2OW(wko));
+			}
+			else
+			{
+				batcher.add(OWPyConv::PyRef2OW(wko, ns));
+			}
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 	}
 	catch(Py::Exception& e)
 	{
@@ -558,7 +1289,20 @@ PyProvider::enumInstances(
 	const CIMClass& requestedClass,
 	const CIMClass& cimClass)
 {
+	if (m_workerPool)
+	{
+		m_workerPool->enumInstances(m_path, m_fileModTime,
+			env->getUserName(), ns, propertyList, requestedClass, cimClass,
+			result);
+		return;
+	}
+
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_BULK_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "enumInstances");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "enumInstances");
 
 	LoggerRef logger = myLogger(env);
 
@@ -569,9 +1313,17 @@ PyProvider::enumInstances(
 		args[0] = PyProviderEnvironment::newObject(env); 	// Provider Environment
 		args[1] = Py::String(ns);							// Namespace
 		args[2] = getPropertyList(propertyList);
-		args[3] = OWPyConv::OWClass2Py(requestedClass);
-		args[4] = OWPyConv::OWClass2Py(cimClass);
-		Py::Object wko = pyfunc.apply(args);
+		args[3] = OWPyConv::OWCachedClass2Py(requestedClass, ns);
+		// Don't convert the same class twice
+		if (requestedClass.getName().equalsIgnoreCase(cimClass.getName()))
+		{
+			args[4] = args[3];
+		}
+		else
+		{
+			args[4] = OWPyConv::OWCachedClass2Py(cimClass, ns);
+		}
+		Py::Object wko = awaitResult(pyfunc.apply(args));
 		PyObject* ito = PyObject_GetIter(wko.ptr());
 		if (!ito)
 		{
@@ -582,16 +1334,32 @@ PyProvider::enumInstances(
 			OW_THROWCIMMSG(CIMException::FAILED, msg.c_str());
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		if (g_prefetchDepth)
+		{
+			prefetchInstances(env, "enumInstances", iterable, ns, true,
+				requestedClass, cimClass, result);
+			return;
+		}
+		InstanceBatcher batcher(result, m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
-			wko = Py::Object(item, true); 
-			result.handle(OWPyConv::PyInst2OW(wko, ns));
+			wko = awaitResult(Py::Object(item, true));
+			if (OWPyConv::isPyInstBatch(wko))
+			{
+				handleInstanceBatch(env, ns, wko, batcher, requestedClass,
+					cimClass);
+			}
+			else
+			{
+				batcher.add(OWPyConv::PyInst2OW(wko, ns));
+			}
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 	}
 	catch(Py::Exception& e)
 	{
@@ -624,7 +1392,18 @@ PyProvider::getInstance(
 	const StringArray* propertyList, 
 	const CIMClass& cimClass)
 {
+	if (m_workerPool)
+	{
+		return m_workerPool->getInstance(m_path, m_fileModTime,
+			env->getUserName(), ns, instanceName, propertyList, cimClass);
+	}
+
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_SHORT_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "getInstance");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "getInstance");
 	LoggerRef logger = myLogger(env);
 
 	try
@@ -640,8 +1419,8 @@ PyProvider::getInstance(
 		args[0] = PyProviderEnvironment::newObject(env); 	// Provider Environment
 		args[1] = OWPyConv::OWRef2Py(lcop);
 		args[2] = getPropertyList(propertyList);
-		args[3] = OWPyConv::OWClass2Py(cimClass);
-		Py::Object pyci = pyfunc.apply(args);
+		args[3] = OWPyConv::OWCachedClass2Py(cimClass, ns);
+		Py::Object pyci = awaitResult(pyfunc.apply(args));
 		if (pyci.isNone())
 		{
 			OW_THROWCIMMSG(CIMException::FAILED,
@@ -680,7 +1459,12 @@ PyProvider::createInstance(
 	const String& ns,
 	const CIMInstance& cimInstance)
 {
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_SHORT_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "createInstance");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "createInstance");
 
 	LoggerRef logger = myLogger(env);
 
@@ -689,8 +1473,8 @@ PyProvider::createInstance(
 		Py::Callable pyfunc = getFunction(m_pyprov, "createInstance");
 		Py::Tuple args(2);
 		args[0] = PyProviderEnvironment::newObject(env); 	// Provider Environment
-		args[1] = OWPyConv::OWInst2Py(cimInstance, ns);		// New instance
-		Py::Object pycop = pyfunc.apply(args);
+		args[1] = inst2Py(cimInstance, ns);		// New instance
+		Py::Object pycop = awaitResult(pyfunc.apply(args));
 		if (pycop.isNone())
 		{
 			OW_THROWCIMMSG(CIMException::FAILED,
@@ -733,7 +1517,12 @@ PyProvider::modifyInstance(
 	const StringArray* propertyList,
 	const CIMClass& theClass)
 {
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_SHORT_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "modifyInstance");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "modifyInstance");
 	LoggerRef logger = myLogger(env);
 
 	try
@@ -741,11 +1530,11 @@ PyProvider::modifyInstance(
 		Py::Callable pyfunc = getFunction(m_pyprov, "modifyInstance");
 		Py::Tuple args(5);
 		args[0] = PyProviderEnvironment::newObject(env); 	// Provider Environment
-		args[1] = OWPyConv::OWInst2Py(modifiedInstance, ns);
-		args[2] = OWPyConv::OWInst2Py(previousInstance, ns);
+		args[1] = inst2Py(modifiedInstance, ns);
+		args[2] = inst2Py(previousInstance, ns);
 		args[3] = getPropertyList(propertyList);
-		args[4] = OWPyConv::OWClass2Py(theClass);
-		pyfunc.apply(args);
+		args[4] = OWPyConv::OWCachedClass2Py(theClass, ns);
+		awaitResult(pyfunc.apply(args));
 	}
 	catch(Py::Exception& e)
 	{
@@ -773,7 +1562,12 @@ PyProvider::deleteInstance(
 	const String& ns,
 	const CIMObjectPath& cop)
 {
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_SHORT_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "deleteInstance");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "deleteInstance");
 	LoggerRef logger = myLogger(env);
 
 	try
@@ -787,7 +1581,7 @@ PyProvider::deleteInstance(
 		Py::Tuple args(2);
 		args[0] = PyProviderEnvironment::newObject(env); 	// Provider Environment
 		args[1] = OWPyConv::OWRef2Py(lcop);
-		pyfunc.apply(args);
+		awaitResult(pyfunc.apply(args));
 	}
 	catch(Py::Exception& e)
 	{
@@ -823,7 +1617,12 @@ PyProvider::associators(
 	EIncludeClassOriginFlag includeClassOrigin,
 	const StringArray* propertyList)
 {
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_BULK_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "associators");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "associators");
 
 	LoggerRef logger = myLogger(env);
 
@@ -843,7 +1642,7 @@ PyProvider::associators(
 		args[4] = Py::String(role);
 		args[5] = Py::String(resultRole);
 		args[6] = getPropertyList(propertyList);
-		Py::Object wko = pyfunc.apply(args);
+		Py::Object wko = awaitResult(pyfunc.apply(args));
 		PyObject* ito = PyObject_GetIter(wko.ptr());
 		if (!ito)
 		{
@@ -854,16 +1653,24 @@ PyProvider::associators(
 			OW_THROWCIMMSG(CIMException::FAILED, msg.c_str());
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		if (g_prefetchDepth)
+		{
+			prefetchInstances(env, "associators", iterable, ns, false,
+				CIMClass(CIMNULL), CIMClass(CIMNULL), result);
+			return;
+		}
+		InstanceBatcher batcher(result, m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
-			wko = Py::Object(item, true); 
-			result.handle(OWPyConv::PyInst2OW(wko, ns));
+			wko = awaitResult(Py::Object(item, true));
+			batcher.add(OWPyConv::PyInst2OW(wko, ns));
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 	}
 	catch(Py::Exception& e)
 	{
@@ -896,7 +1703,12 @@ PyProvider::associatorNames(
 	const String& role,
 	const String& resultRole)
 {
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_BULK_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "associatorNames");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "associatorNames");
 
 	LoggerRef logger = myLogger(env);
 
@@ -915,7 +1727,7 @@ PyProvider::associatorNames(
 		args[3] = Py::String(resultClass);
 		args[4] = Py::String(role);
 		args[5] = Py::String(resultRole);
-		Py::Object wko = pyfunc.apply(args);
+		Py::Object wko = awaitResult(pyfunc.apply(args));
 		PyObject* ito = PyObject_GetIter(wko.ptr());
 		if (!ito)
 		{
@@ -926,16 +1738,18 @@ PyProvider::associatorNames(
 			OW_THROWCIMMSG(CIMException::FAILED, msg.c_str());
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		ObjectPathBatcher batcher(result, m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
-			wko = Py::Object(item, true); 
-			result.handle(OWPyConv::PyRef2OW(wko, ns));
+			wko = awaitResult(Py::Object(item, true));
+			batcher.add(OWPyConv::PyRef2OW(wko, ns));
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 	}
 	catch(Py::Exception& e)
 	{
@@ -969,7 +1783,12 @@ PyProvider::references(
 	EIncludeClassOriginFlag includeClassOrigin,
 	const StringArray* propertyList)
 {
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_BULK_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "references");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "references");
 
 	LoggerRef logger = myLogger(env);
 
@@ -987,7 +1806,7 @@ PyProvider::references(
 		args[2] = Py::String(resultClass);
 		args[3] = Py::String(role);
 		args[4] = getPropertyList(propertyList);
-		Py::Object wko = pyfunc.apply(args);
+		Py::Object wko = awaitResult(pyfunc.apply(args));
 		PyObject* ito = PyObject_GetIter(wko.ptr());
 		if (!ito)
 		{
@@ -998,16 +1817,24 @@ PyProvider::references(
 			OW_THROWCIMMSG(CIMException::FAILED, msg.c_str());
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		if (g_prefetchDepth)
+		{
+			prefetchInstances(env, "references", iterable, ns, false,
+				CIMClass(CIMNULL), CIMClass(CIMNULL), result);
+			return;
+		}
+		InstanceBatcher batcher(result, m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
-			wko = Py::Object(item, true); 
-			result.handle(OWPyConv::PyInst2OW(wko, ns));
+			wko = awaitResult(Py::Object(item, true));
+			batcher.add(OWPyConv::PyInst2OW(wko, ns));
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 	}
 	catch(Py::Exception& e)
 	{
@@ -1038,7 +1865,12 @@ PyProvider::referenceNames(
 	const String& resultClass,
 	const String& role)
 {
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_BULK_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "referenceNames");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "referenceNames");
 
 	LoggerRef logger = myLogger(env);
 
@@ -1055,7 +1887,7 @@ PyProvider::referenceNames(
 		args[1] = OWPyConv::OWRef2Py(lcop);
 		args[2] = Py::String(resultClass);
 		args[3] = Py::String(role);
-		Py::Object wko = pyfunc.apply(args);
+		Py::Object wko = awaitResult(pyfunc.apply(args));
 		PyObject* ito = PyObject_GetIter(wko.ptr());
 		if (!ito)
 		{
@@ -1066,16 +1898,18 @@ PyProvider::referenceNames(
 			OW_THROWCIMMSG(CIMException::FAILED, msg.c_str());
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		ObjectPathBatcher batcher(result, m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
-			wko = Py::Object(item, true); 
-			result.handle(OWPyConv::PyRef2OW(wko, ns));
+			wko = awaitResult(Py::Object(item, true));
+			batcher.add(OWPyConv::PyRef2OW(wko, ns));
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 	}
 	catch(Py::Exception& e)
 	{
@@ -1106,7 +1940,12 @@ PyProvider::invokeMethod(
 	const CIMParamValueArray& in,
 	CIMParamValueArray& out)
 {
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_SHORT_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "invokeMethod");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "invokeMethod");
 	LoggerRef logger = myLogger(env);
 
 	CIMObjectPath lpath(path);
@@ -1147,7 +1986,7 @@ PyProvider::invokeMethod(
 		//-----------------------------------------------------
 		// Invoke the method in the Python provider
 		//-----------------------------------------------------
-		Py::Object pyv = pyfunc.apply(args);
+		Py::Object pyv = awaitResult(pyfunc.apply(args));
 		//-----------------------------------------------------
 		// Process output from Python provider's invokeMethod
 		//-----------------------------------------------------
@@ -1239,7 +2078,10 @@ PyProvider::activateFilter(
 #endif
 	)
 {
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "activateFilter");
 	Py::GILGuard gg;	// Acquire python's GIL
+	PyIteratorScope its;	// Ends the iterators started from here
 
 	LoggerRef logger = myLogger(env);
 
@@ -1308,7 +2150,10 @@ PyProvider::deActivateFilter(
 #endif
 	)
 {
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "deActivateFilter");
 	Py::GILGuard gg;	// Acquire python's GIL
+	PyIteratorScope its;	// Ends the iterators started from here
 
 	LoggerRef logger = myLogger(env);
 
@@ -1366,7 +2211,12 @@ PyProvider::exportIndication(
 	const CIMInstance& indHandlerInst,
 	const CIMInstance& indicationInst)
 {
+	PyScheduleTicket st(m_scheduler, m_path,
+		PyProviderScheduler::E_SHORT_OP);
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "exportIndication");
 	Py::GILGuard gg;	// Acquire python's GIL
+	RequestScope rs(this, env, "exportIndication");
 
 	LoggerRef logger = myLogger(env);
 
@@ -1376,9 +2226,9 @@ PyProvider::exportIndication(
 		Py::Tuple args(4);
 		args[0] = PyProviderEnvironment::newObject(env);
 		args[1] = Py::String(ns);
-		args[2] = OWPyConv::OWInst2Py(indHandlerInst, ns);
-		args[3] = OWPyConv::OWInst2Py(indicationInst, ns);
-		pyfunc.apply(args);
+		args[2] = inst2Py(indHandlerInst, ns);
+		args[3] = inst2Py(indicationInst, ns);
+		awaitResult(pyfunc.apply(args));
 	}
 	catch(Py::Exception& e)
 	{
@@ -1403,7 +2253,10 @@ Int32
 PyProvider::poll(
 	const ProviderEnvironmentIFCRef& env)
 {
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "poll");
 	Py::GILGuard gg;	// Acquire python's GIL
+	PyIteratorScope its;	// Ends the iterators started from here
 
 	LoggerRef logger = myLogger(env);
 	Int32 rv = 0;
@@ -1442,7 +2295,10 @@ Int32
 PyProvider::getInitialPollingInterval(
 	const ProviderEnvironmentIFCRef& env)
 {
+	Py::InterpreterScope is(m_interp);
+	Py::GILStatsScope gs(m_path, "getInitialPollingInterval");
 	Py::GILGuard gg;	// Acquire python's GIL
+	PyIteratorScope its;	// Ends the iterators started from here
 
 	LoggerRef logger = myLogger(env);
 	Int32 rv = 0;
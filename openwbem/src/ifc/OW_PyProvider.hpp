@@ -19,12 +19,17 @@
 #define OW_PYPROVIDER_HPP_GUARD_
 
 #include "PyCxxObjects.hpp"
+#include "OW_PyWorkerPool.hpp"
+#include "OW_PyAsyncLoop.hpp"
+#include "OW_PyProviderScheduler.hpp"
+#include "OW_PyProviderFileWatcher.hpp"
 
 #include <openwbem/OW_config.h>
 #include <openwbem/OW_ProviderEnvironmentIFC.hpp>
 #include <openwbem/OW_DateTime.hpp>
 #include <openwbem/OW_IntrusiveCountableBase.hpp>
 #include <openwbem/OW_IntrusiveReference.hpp>
+#include <openwbem/OW_NonRecursiveMutex.hpp>
 #include <openwbem/OW_WQLSelectStatement.hpp>
 
 extern "C"
@@ -37,11 +42,42 @@ using namespace OW_NAMESPACE;
 namespace PythonProvIFC
 {
 
+// GIL hold time of the batched delivery of provider results. Every batch
+// accounts for the time from taking (or re-taking) the GIL until it is
+// released to hand the batch to the CIMOM.
+struct PyResultBatchStats
+{
+	PyResultBatchStats()
+		: batches(0)
+		, items(0)
+		, holdUsecs(0)
+		, maxHoldUsecs(0)
+	{
+	}
+
+	UInt64 batches;
+	UInt64 items;
+	UInt64 holdUsecs;
+	UInt64 maxHoldUsecs;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Told when a provider it was set on loses its last use
+class PyProviderUseListener : public IntrusiveCountableBase
+{
+public:
+	virtual ~PyProviderUseListener() {}
+	virtual void usesReleased() = 0;
+};
+typedef IntrusiveReference<PyProviderUseListener> PyProviderUseListenerRef;
+
 class PyProvider : public IntrusiveCountableBase
 {
 public:
+	// interp is the python interpreter the provider is loaded into and
+	// called in. 0 means the main interpreter.
 	PyProvider(const String& name, const ProviderEnvironmentIFCRef& env,
-		bool unloadableType=true);
+		bool unloadableType=true, PyInterpreterState* interp=0);
 
 	virtual ~PyProvider();
 
@@ -209,6 +245,12 @@ public:
 	bool canShutDown(
 		const ProviderEnvironmentIFCRef& env) const;
 
+	// Calls the provider's optional warmup function, so a preloaded
+	// provider can open connections or fill caches before its first
+	// request.
+	void warmUp(
+		const ProviderEnvironmentIFCRef& env);
+
 	String getName() const { return m_path; }
 
 	String getFileName() const;
@@ -227,12 +269,97 @@ public:
 		m_handlerClassNames = cnames;
 	}
 
+	bool getLazyInstances() const { return m_lazyInstances; }
+	void setLazyInstances(bool arg)
+	{
+		m_lazyInstances = arg;
+	}
+
+	// Providers registered with OutOfProcess=true serve enumInstanceNames,
+	// enumInstances and getInstance from the given worker pool
+	void setWorkerPool(const PyWorkerPoolRef& pool)
+	{
+		m_workerPool = pool;
+	}
+
+	// Requests wait for the scheduler before they run, unless it is null
+	void setScheduler(const PyProviderSchedulerRef& scheduler)
+	{
+		m_scheduler = scheduler;
+	}
+
+	// Provider methods may return coroutines or futures, which are run on
+	// the given event loop. Only for providers in the main interpreter.
+	void setAsyncLoop(const PyAsyncLoopRef& loop)
+	{
+		m_asyncLoop = loop;
+	}
+
+	// Lets providerChanged check a flag set by the watcher instead of
+	// calling stat on every request
+	void setFileWatcher(const PyProviderFileWatcherRef& watcher);
+
 	time_t getFileModTime() const { return m_fileModTime; }
 	bool providerChanged() const;
+	// Stops reporting the current change of the provider file, so a
+	// reload that failed isn't tried again until the file changes again
+	void keepVersion();
+
+	// Removes the module of this version from sys.modules. Its name is
+	// unique to the version, so versions loaded later keep their own.
+	void dropModule();
+
+	// Which load of the module this provider is. 1 for the first load,
+	// one more for every reload.
+	UInt32 getVersion() const { return m_version; }
+	void setVersion(UInt32 version)
+	{
+		m_version = version;
+	}
+
+	// Users of the provider. The provider interface takes a use for every
+	// proxy it hands out, which releases it when it is destroyed. A
+	// version replaced by a reload is shut down once it has no users.
+	void addUse() { __sync_add_and_fetch(&m_uses, 1); }
+	void releaseUse();
+	int getUses() const { return m_uses; }
+	// Has the listener told whenever the last use is released from now on
+	void setUseListener(const PyProviderUseListenerRef& listener);
+
+	// Time it took to import the module and construct the provider
+	UInt64 getLoadUsecs() const { return m_loadUsecs; }
+	// Set for providers loaded at startup instead of by a request, and
+	// for their new versions. Exempts them from the provider TTL.
+	bool isPreloaded() const { return m_preloaded; }
+	void setPreloaded(bool arg)
+	{
+		m_preloaded = arg;
+	}
 
-	static void setPyWbemMod(const Py::Module& pywbemMod);
+	// Number of results collected with the GIL held before they are
+	// handed to the CIMOM with the GIL released
+	static void setResultBatchSize(UInt32 batchSize);
+	static UInt32 getResultBatchSize();
+	// Batches of results this provider produced since it was loaded
+	PyResultBatchStats getResultBatchStats() const;
+
+	// Depth of the queue between the thread running an enumeration's
+	// python iterator and the request thread delivering its results.
+	// 0 runs the iterator on the request thread.
+	static void setPrefetchDepth(UInt32 depth);
+	static UInt32 getPrefetchDepth();
+
+	// Approximate heap the provider holds: what loading its module took.
+	// What its requests allocate later isn't counted, and allocations of
+	// CIMOM threads running during the load are.
+	Int64 getResidentBytes() const;
 
 private:
+	class PrefetchProducer;
+	friend class PrefetchProducer;
+	class RequestScope;
+	friend class RequestScope;
+
 	PyProvider() {}
 	PyProvider(const PyProvider& arg) {}
 	PyProvider& operator= (const PyProvider& arg);
@@ -243,7 +370,15 @@ private:
 		LoggerRef& lgr,
 		bool doThrow=true) const;
 
+	Py::Object inst2Py(const CIMInstance& ci, const String& ns) const;
+	Py::Object awaitResult(const Py::Object& obj);
+	void prefetchInstances(const ProviderEnvironmentIFCRef& env,
+		const char* operation, const Py::Object& iterable, const String& ns,
+		bool allowBatches, const CIMClass& requestedClass,
+		const CIMClass& cimClass, CIMInstanceResultHandlerIFC& result);
+
 	String m_path;
+	PyInterpreterState* m_interp;
 	Py::Object m_pyprov;
 	DateTime m_dt;
 	time_t m_fileModTime;
@@ -252,6 +387,23 @@ private:
 #endif
 	bool m_unloadableType;
 	StringArray m_handlerClassNames;
+	bool m_lazyInstances;
+	PyWorkerPoolRef m_workerPool;
+	PyProviderSchedulerRef m_scheduler;
+	PyAsyncLoopRef m_asyncLoop;
+	PyProviderFileWatcherRef m_fileWatcher;
+	PyFileWatchRef m_fileWatch;			// Null unless the file is watched
+	String m_moduleName;				// Key of the module in sys.modules
+	Int64 m_residentBytes;				// See getResidentBytes
+	UInt64 m_loadUsecs;
+	PyResultBatchStats m_resultBatchStats;	// Protected by the GIL
+	bool m_preloaded;
+	volatile int m_servedRequest;		// Set once a request has run
+	UInt32 m_version;
+	volatile int m_uses;
+	volatile int m_hasUseListener;		// Spares releaseUse the lock
+	NonRecursiveMutex m_useGuard;
+	PyProviderUseListenerRef m_useListener;	// m_useGuard
 };
 
 typedef IntrusiveReference<PyProvider> PyProviderRef;
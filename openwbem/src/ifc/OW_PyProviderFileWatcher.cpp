@@ -0,0 +1,456 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "OW_PyProviderFileWatcher.hpp"
+#include <openwbem/OW_NonRecursiveMutexLock.hpp>
+#include <openwbem/OW_Thread.hpp>
+
+extern "C"
+{
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+}
+
+namespace PythonProvIFC
+{
+
+namespace
+{
+
+#ifdef HAVE_SYS_INOTIFY_H
+// Events that may leave a file in the directory with a new modification
+// time. Partial writes are left out, the file is looked at when it is
+// closed.
+const UInt32 WATCH_MASK = IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE
+	| IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF
+	| IN_MOVE_SELF;
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+void
+splitPath(
+	const String& fileName,
+	String& dirName,
+	String& baseName)
+{
+	size_t idx = fileName.lastIndexOf('/');
+	if (idx == String::npos)
+	{
+		dirName = ".";
+		baseName = fileName;
+	}
+	else
+	{
+		dirName = (idx == 0) ? String("/") : fileName.substring(0, idx);
+		baseName = fileName.substring(idx + 1);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+setNonBlocking(
+	int fd)
+{
+	::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+	::fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+class PyFileWatcherThread : public Thread
+{
+public:
+	PyFileWatcherThread(PyProviderFileWatcher* watcher)
+		: Thread()
+		, m_watcher(watcher)
+	{
+	}
+
+protected:
+	virtual Int32 run()
+	{
+		for (;;)
+		{
+			struct pollfd pfds[2];
+			pfds[0].fd = m_watcher->m_fd;
+			pfds[0].events = POLLIN;
+			pfds[0].revents = 0;
+			pfds[1].fd = m_watcher->m_wakeFds[0];
+			pfds[1].events = POLLIN;
+			pfds[1].revents = 0;
+			int rc = ::poll(pfds, 2, -1);
+			if (rc < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				// Changes can't be seen any more
+				m_watcher->markAllDirty();
+				return 1;
+			}
+			if (pfds[1].revents)
+			{
+				break;
+			}
+			if (pfds[0].revents)
+			{
+				m_watcher->handleEvents();
+			}
+		}
+		return 0;
+	}
+
+private:
+	PyProviderFileWatcher* m_watcher;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+PyFileWatch::PyFileWatch(
+	const String& fileName,
+	bool polled)
+	: IntrusiveCountableBase()
+	, m_fileName(fileName)
+	, m_polled(polled ? 1 : 0)
+	, m_dirty(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatch::setPolled()
+{
+	__sync_lock_test_and_set(&m_polled, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatch::markDirty()
+{
+	__sync_lock_test_and_set(&m_dirty, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatch::clearDirty()
+{
+	__sync_lock_release(&m_dirty);
+	__sync_synchronize();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderFileWatcher::DirWatch::DirWatch()
+	: dirName()
+	, files()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderFileWatcher::PyProviderFileWatcher()
+	: IntrusiveCountableBase()
+	, m_fd(-1)
+	, m_dirs()
+	, m_dirWds()
+	, m_guard()
+	, m_thread()
+{
+	m_wakeFds[0] = -1;
+	m_wakeFds[1] = -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderFileWatcher::~PyProviderFileWatcher()
+{
+	shutdown();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyProviderFileWatcher::start()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	m_fd = ::inotify_init();
+	if (m_fd < 0)
+	{
+		return false;
+	}
+	if (::pipe(m_wakeFds) < 0)
+	{
+		::close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+	setNonBlocking(m_fd);
+	setNonBlocking(m_wakeFds[0]);
+	setNonBlocking(m_wakeFds[1]);
+	m_thread = new PyFileWatcherThread(this);
+	m_thread->start();
+	return true;
+#else
+	return false;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderFileWatcher::shutdown()
+{
+	if (m_thread)
+	{
+		char c = 0;
+		while (::write(m_wakeFds[1], &c, 1) < 0 && errno == EINTR)
+		{
+		}
+		m_thread->join();
+		m_thread = 0;
+	}
+
+	NonRecursiveMutexLock l(m_guard);
+	if (m_fd >= 0)
+	{
+		::close(m_fd);
+		::close(m_wakeFds[0]);
+		::close(m_wakeFds[1]);
+		m_fd = -1;
+		m_wakeFds[0] = -1;
+		m_wakeFds[1] = -1;
+	}
+	// Watches still held fall back to polling
+	for (DirWatchMap::iterator dit = m_dirs.begin(); dit != m_dirs.end();
+		++dit)
+	{
+		for (Map<String, WatchList>::iterator fit =
+			dit->second.files.begin(); fit != dit->second.files.end(); ++fit)
+		{
+			for (size_t i = 0; i < fit->second.size(); i++)
+			{
+				fit->second[i]->setPolled();
+			}
+		}
+	}
+	m_dirs.clear();
+	m_dirWds.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyFileWatchRef
+PyProviderFileWatcher::watch(
+	const String& fileName)
+{
+	NonRecursiveMutexLock l(m_guard);
+	if (m_fd < 0 || fileName.empty())
+	{
+		return PyFileWatchRef(new PyFileWatch(fileName, true));
+	}
+
+#ifdef HAVE_SYS_INOTIFY_H
+	String dirName, baseName;
+	splitPath(fileName, dirName, baseName);
+	int wd;
+	Map<String, int>::iterator dit = m_dirWds.find(dirName);
+	if (dit != m_dirWds.end())
+	{
+		wd = dit->second;
+	}
+	else
+	{
+		wd = ::inotify_add_watch(m_fd, dirName.c_str(), WATCH_MASK);
+		if (wd < 0)
+		{
+			// Out of watches, or no such directory
+			return PyFileWatchRef(new PyFileWatch(fileName, true));
+		}
+		m_dirWds[dirName] = wd;
+		m_dirs[wd].dirName = dirName;
+	}
+
+	PyFileWatchRef fileWatch(new PyFileWatch(fileName, false));
+	m_dirs[wd].files[baseName].push_back(fileWatch);
+	return fileWatch;
+#else
+	return PyFileWatchRef(new PyFileWatch(fileName, true));
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderFileWatcher::unwatch(
+	const PyFileWatchRef& fileWatch)
+{
+	if (!fileWatch || fileWatch->isPolled())
+	{
+		return;
+	}
+
+	String dirName, baseName;
+	splitPath(fileWatch->getFileName(), dirName, baseName);
+	NonRecursiveMutexLock l(m_guard);
+	Map<String, int>::iterator dit = m_dirWds.find(dirName);
+	if (dit == m_dirWds.end())
+	{
+		return;
+	}
+	int wd = dit->second;
+	DirWatch& dirWatch = m_dirs[wd];
+	Map<String, WatchList>::iterator fit = dirWatch.files.find(baseName);
+	if (fit != dirWatch.files.end())
+	{
+		WatchList& watches = fit->second;
+		for (WatchList::iterator it = watches.begin(); it != watches.end();
+			++it)
+		{
+			if (*it == fileWatch)
+			{
+				watches.erase(it);
+				break;
+			}
+		}
+		if (watches.empty())
+		{
+			dirWatch.files.erase(fit);
+		}
+	}
+	if (dirWatch.files.empty())
+	{
+#ifdef HAVE_SYS_INOTIFY_H
+		::inotify_rm_watch(m_fd, wd);
+#endif
+		m_dirs.erase(wd);
+		m_dirWds.erase(dit);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderFileWatcher::handleEvents()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	for (;;)
+	{
+		ssize_t len = ::read(m_fd, buf, sizeof(buf));
+		if (len < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (len <= 0)
+		{
+			// EAGAIN once all events are read
+			break;
+		}
+
+		bool overflow = false;
+		{
+			NonRecursiveMutexLock l(m_guard);
+			for (char* p = buf; p < buf + len; )
+			{
+				const struct inotify_event* ev =
+					reinterpret_cast<const struct inotify_event*>(p);
+				p += sizeof(struct inotify_event) + ev->len;
+
+				if (ev->mask & IN_Q_OVERFLOW)
+				{
+					overflow = true;
+					continue;
+				}
+				DirWatchMap::iterator dit = m_dirs.find(ev->wd);
+				if (dit == m_dirs.end())
+				{
+					continue;
+				}
+				if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+				{
+					dropDirWatch(dit);
+					continue;
+				}
+				if (ev->len == 0)
+				{
+					continue;
+				}
+				Map<String, WatchList>::iterator fit =
+					dit->second.files.find(String(ev->name));
+				if (fit != dit->second.files.end())
+				{
+					for (size_t i = 0; i < fit->second.size(); i++)
+					{
+						fit->second[i]->markDirty();
+					}
+				}
+			}
+		}
+		if (overflow)
+		{
+			// Changes may have been lost
+			markAllDirty();
+		}
+	}
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderFileWatcher::markAllDirty()
+{
+	NonRecursiveMutexLock l(m_guard);
+	for (DirWatchMap::iterator dit = m_dirs.begin(); dit != m_dirs.end();
+		++dit)
+	{
+		for (Map<String, WatchList>::iterator fit =
+			dit->second.files.begin(); fit != dit->second.files.end(); ++fit)
+		{
+			for (size_t i = 0; i < fit->second.size(); i++)
+			{
+				fit->second[i]->markDirty();
+			}
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// The directory is gone, or the watch doesn't follow its path any more.
+// Its files fall back to polling. Must be called with m_guard locked.
+void
+PyProviderFileWatcher::dropDirWatch(
+	DirWatchMap::iterator dit)
+{
+	Map<String, WatchList>& files = dit->second.files;
+	for (Map<String, WatchList>::iterator fit = files.begin();
+		fit != files.end(); ++fit)
+	{
+		for (size_t i = 0; i < fit->second.size(); i++)
+		{
+			fit->second[i]->setPolled();
+			fit->second[i]->markDirty();
+		}
+	}
+#ifdef HAVE_SYS_INOTIFY_H
+	::inotify_rm_watch(m_fd, dit->first);
+#endif
+	m_dirWds.erase(dit->second.dirName);
+	m_dirs.erase(dit);
+}
+
+}	// End of namespace PythonProvIFC
@@ -0,0 +1,116 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifndef OW_PYPROVIDERFILEWATCHER_HPP_GUARD
+#define OW_PYPROVIDERFILEWATCHER_HPP_GUARD
+
+#include <openwbem/OW_config.h>
+#include <openwbem/OW_String.hpp>
+#include <openwbem/OW_Map.hpp>
+#include <openwbem/OW_NonRecursiveMutex.hpp>
+#include <openwbem/OW_IntrusiveCountableBase.hpp>
+#include <openwbem/OW_IntrusiveReference.hpp>
+
+#include <vector>
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+class PyFileWatcherThread;
+
+//////////////////////////////////////////////////////////////////////////////
+// The change flag of a watched provider file. It is set by the watcher
+// thread and read by request threads without locking. A polled watch has
+// no watcher behind it; its owner has to stat the file itself.
+class PyFileWatch : public IntrusiveCountableBase
+{
+public:
+	PyFileWatch(const String& fileName, bool polled);
+
+	const String& getFileName() const { return m_fileName; }
+	bool isPolled() const { return m_polled != 0; }
+	void setPolled();
+
+	// True if the file may have changed since clearDirty
+	bool isDirty() const { return m_dirty != 0; }
+	void markDirty();
+	void clearDirty();
+
+private:
+	String m_fileName;
+	volatile int m_polled;
+	volatile int m_dirty;
+};
+typedef IntrusiveReference<PyFileWatch> PyFileWatchRef;
+
+//////////////////////////////////////////////////////////////////////////////
+// Watches provider files with inotify on the directories they are in, so
+// requests don't have to stat them. Renames and writes into a directory
+// mark the watches of the files they touch dirty. If the events
+// overflow, all watches are marked dirty.
+// Where inotify isn't available, or a directory can't be watched, watch
+// returns a polled watch. Watches of a directory that is removed or moved
+// become polled.
+class PyProviderFileWatcher : public IntrusiveCountableBase
+{
+public:
+	PyProviderFileWatcher();
+	~PyProviderFileWatcher();
+
+	// Returns false if inotify isn't available. Watches are polled then.
+	bool start();
+	void shutdown();
+
+	PyFileWatchRef watch(const String& fileName);
+	void unwatch(const PyFileWatchRef& fileWatch);
+
+private:
+	PyProviderFileWatcher(const PyProviderFileWatcher&);
+	PyProviderFileWatcher& operator=(const PyProviderFileWatcher&);
+
+	// Called by the watcher thread
+	void handleEvents();
+	void markAllDirty();
+
+	typedef std::vector<PyFileWatchRef> WatchList;
+	struct DirWatch
+	{
+		DirWatch();
+
+		String dirName;
+		Map<String, WatchList> files;	// Watches by base name
+	};
+	typedef Map<int, DirWatch> DirWatchMap;
+
+	void dropDirWatch(DirWatchMap::iterator dit);
+
+	int m_fd;							// inotify descriptor, -1 if none
+	int m_wakeFds[2];					// Wakes the thread up to stop it
+	DirWatchMap m_dirs;					// By watch descriptor
+	Map<String, int> m_dirWds;			// Watch descriptors by directory
+	NonRecursiveMutex m_guard;
+	IntrusiveReference<PyFileWatcherThread> m_thread;
+
+	friend class PyFileWatcherThread;
+};
+typedef IntrusiveReference<PyProviderFileWatcher> PyProviderFileWatcherRef;
+
+}	// End of namespace PythonProvIFC
+
+#endif	// OW_PYPROVIDERFILEWATCHER_HPP_GUARD
@@ -34,16 +34,59 @@
 #include <openwbem/OW_ResultHandlers.hpp>
 #include <openwbem/OW_ConfigOpts.hpp>
 #include <openwbem/OW_CIMException.hpp>
+#include <openwbem/OW_CIMObjectPath.hpp>
+#include <openwbem/OW_CIMProperty.hpp>
+#include <openwbem/OW_CIMValue.hpp>
+#include <openwbem/OW_SecondaryInstanceProviderIFC.hpp>
+#include <openwbem/OW_Thread.hpp>
 
+#include <algorithm>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
+#include <set>
+#include <time.h>
+#include <unistd.h>
 using std::cout;
 using std::endl;
 
 #define OW_DEFAULT_PYPROVIFC_PROV_LOCATION OW_DEFAULT_OWLIBDIR"/pythonproviders"
 #define OW_DEFAULT_PYPROVIFC_PROV_TTL "5"
+#define OW_DEFAULT_PYPROVIFC_RESULT_BATCH_SIZE "100"
+#define OW_DEFAULT_PYPROVIFC_PREFETCH_DEPTH "0"
+#define OW_DEFAULT_PYPROVIFC_SUBINTERPRETERS "off"
+#define OW_DEFAULT_PYPROVIFC_WORKER_PROCESSES "0"
+#define OW_DEFAULT_PYPROVIFC_WORKER_RING_SIZE "1048576"
+#ifndef OW_PYPROVIFC_LIBEXECDIR
+#define OW_PYPROVIFC_LIBEXECDIR "/usr/lib"
+#endif
+#define OW_DEFAULT_PYPROVIFC_WORKER_PROGRAM OW_PYPROVIFC_LIBEXECDIR"/owpyworker"
+#define OW_DEFAULT_PYPROVIFC_GIL_STATS "false"
+#define OW_DEFAULT_PYPROVIFC_MAX_IN_FLIGHT "0"
+#define OW_DEFAULT_PYPROVIFC_MAX_ACTIVE "0"
+#define OW_DEFAULT_PYPROVIFC_ASYNC_MODULE ""
+#define OW_DEFAULT_PYPROVIFC_WATCH_FILES "true"
+#define OW_DEFAULT_PYPROVIFC_MEMORY_BUDGET "0"
+#define OW_DEFAULT_PYPROVIFC_PRELOAD_THREADS "4"
+#define OW_DEFAULT_PYPROVIFC_GIL_STATS_FILE ""
+#define OW_DEFAULT_PYPROVIFC_CLASS_CACHE_TTL "300"
 static const char* const PYPROVIFC_PROV_LOCATION_opt = "pyprovifc.prov_location";
 static const char* const PYPROVIFC_PROV_TTL_opt = "pyprovifc.prov_TTL";
+static const char* const PYPROVIFC_RESULT_BATCH_SIZE_opt = "pyprovifc.result_batch_size";
+static const char* const PYPROVIFC_PREFETCH_DEPTH_opt = "pyprovifc.prefetch_depth";
+static const char* const PYPROVIFC_SUBINTERPRETERS_opt = "pyprovifc.subinterpreters";
+static const char* const PYPROVIFC_WORKER_PROCESSES_opt = "pyprovifc.worker_processes";
+static const char* const PYPROVIFC_WORKER_RING_SIZE_opt = "pyprovifc.worker_ring_size";
+static const char* const PYPROVIFC_WORKER_PROGRAM_opt = "pyprovifc.worker_program";
+static const char* const PYPROVIFC_GIL_STATS_opt = "pyprovifc.gil_stats";
+static const char* const PYPROVIFC_GIL_STATS_FILE_opt = "pyprovifc.gil_stats_file";
+static const char* const PYPROVIFC_MAX_IN_FLIGHT_opt = "pyprovifc.max_in_flight";
+static const char* const PYPROVIFC_MAX_ACTIVE_opt = "pyprovifc.max_active";
+static const char* const PYPROVIFC_ASYNC_MODULE_opt = "pyprovifc.async_module";
+static const char* const PYPROVIFC_WATCH_FILES_opt = "pyprovifc.watch_files";
+static const char* const PYPROVIFC_MEMORY_BUDGET_opt = "pyprovifc.memory_budget";
+static const char* const PYPROVIFC_PRELOAD_THREADS_opt = "pyprovifc.preload_threads";
+static const char* const PYPROVIFC_CLASS_CACHE_TTL_opt = "pyprovifc.class_cache_ttl";
 
 using namespace OW_NAMESPACE;
 using namespace WBEMFlags;
@@ -56,49 +99,500 @@ OW_DEFINE_EXCEPTION(PyProviderIFC);
 namespace
 {
 
-PyProviderReg
-getProviderReg(
-	const ProviderEnvironmentIFCRef& env,
-	const String& provid)
+// The class of the provider registrations, and the provider id the
+// registration watcher is registered with for it
+const char* const PYREG_CLASS_NAME = "OpenWBEM_PyProviderRegistration";
+const char* const PYREG_WATCHER_ID = "PyProviderIFC_RegistrationWatcher";
+
+//////////////////////////////////////////////////////////////////////////////
+String
+getInteropNs(
+	const ProviderEnvironmentIFCRef& env)
 {
-	// Get instance of provider registration
-    String interopNs = env->getConfigItem(ConfigOpts::INTEROP_SCHEMA_NAMESPACE_opt,
+	return env->getConfigItem(ConfigOpts::INTEROP_SCHEMA_NAMESPACE_opt,
 		OW_DEFAULT_INTEROP_SCHEMA_NAMESPACE);
-	CIMInstance ci(CIMNULL);
-	try
+}
+
+typedef std::pair<DateTime, String> ProviderAccess;
+
+//////////////////////////////////////////////////////////////////////////////
+// Orders providers by the time they were last used, oldest first
+bool
+usedEarlier(
+	const ProviderAccess& lhs,
+	const ProviderAccess& rhs)
+{
+	return lhs.first < rhs.first;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+UInt64
+nowUsecs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return UInt64(ts.tv_sec) * 1000000 + UInt64(ts.tv_nsec) / 1000;
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// Loads providers registered with Preload=true. Each thread takes the
+// next registration nobody has taken until none is left.
+class PyPreloadThread : public Thread
+{
+public:
+	PyPreloadThread(
+		PyProviderIFC* ifc,
+		const ProviderEnvironmentIFCRef& env,
+		const std::vector<PyProviderReg>& regs,
+		volatile int* next)
+		: Thread()
+		, m_ifc(ifc)
+		, m_env(env)
+		, m_regs(regs)
+		, m_next(next)
 	{
-		CIMObjectPath cop("OpenWBEM_PyProviderRegistration", interopNs);
-		cop.setKeyValue("InstanceID", CIMValue(provid));
-		ci = env->getCIMOMHandle()->getInstance(interopNs, cop);
-		return PyProviderReg(ci);
 	}
-	catch (const CIMException& e)
+
+protected:
+	virtual Int32 run()
 	{
-		// Ignore
+		for (;;)
+		{
+			int i = __sync_fetch_and_add(m_next, 1);
+			if (i >= int(m_regs.size()))
+			{
+				break;
+			}
+			m_ifc->preloadProvider(m_env, m_regs[i]);
+		}
+		return 0;
 	}
-	return PyProviderReg();
-}
 
-}	// End of unnamed namespace
+private:
+	PyProviderIFC* m_ifc;
+	ProviderEnvironmentIFCRef m_env;
+	const std::vector<PyProviderReg>& m_regs;
+	volatile int* m_next;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// The secondary instance provider of the provider registration class.
+// Registrations created, modified or deleted are applied to the
+// registration index, so it doesn't have to be read again.
+class PyRegistrationWatcher : public SecondaryInstanceProviderIFC
+{
+public:
+	PyRegistrationWatcher(PyProviderIFC* ifc)
+		: SecondaryInstanceProviderIFC()
+		, m_ifc(ifc)
+	{
+	}
+
+	virtual void filterInstances(
+		const ProviderEnvironmentIFCRef& env,
+		const String& ns,
+		const String& className,
+		CIMInstanceArray& instances,
+		ELocalOnlyFlag localOnly,
+		EDeepFlag deep,
+		EIncludeQualifiersFlag includeQualifiers,
+		EIncludeClassOriginFlag includeClassOrigin,
+		const StringArray* propertyList,
+		const CIMClass& requestedClass,
+		const CIMClass& cimClass)
+	{
+	}
+
+	virtual void createInstance(
+		const ProviderEnvironmentIFCRef& env,
+		const String& ns,
+		const CIMInstance& cimInstance)
+	{
+		PyProviderReg reg(cimInstance);
+		m_ifc->changeRegistration(env, reg.getInstanceId(), reg);
+	}
+
+	virtual void modifyInstance(
+		const ProviderEnvironmentIFCRef& env,
+		const String& ns,
+		const CIMInstance& modifiedInstance,
+		const CIMInstance& previousInstance,
+		EIncludeQualifiersFlag includeQualifiers,
+		const StringArray* propertyList,
+		const CIMClass& theClass)
+	{
+		CIMInstance ci(modifiedInstance);
+		if (propertyList)
+		{
+			// Only the listed properties were changed
+			ci = previousInstance;
+			for (size_t i = 0; i < propertyList->size(); i++)
+			{
+				CIMProperty prop = modifiedInstance.getProperty(
+					(*propertyList)[i]);
+				if (prop)
+				{
+					ci.setProperty(prop);
+				}
+			}
+		}
+		PyProviderReg reg(ci);
+		m_ifc->changeRegistration(env, reg.getInstanceId(), reg);
+	}
+
+	virtual void deleteInstance(
+		const ProviderEnvironmentIFCRef& env,
+		const String& ns,
+		const CIMObjectPath& cop)
+	{
+		String providerId;
+		CIMValue cv = cop.getKeyValue("InstanceID");
+		if (cv)
+		{
+			cv.get(providerId);
+		}
+		m_ifc->changeRegistration(env, providerId, PyProviderReg());
+	}
+
+private:
+	PyProviderIFC* m_ifc;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Loads new versions of changed provider modules while the loaded
+// versions keep serving. Shuts the versions they replace, and providers
+// unloaded by TTL or eviction, down once nothing uses them any more. The
+// thread sleeps until a retired provider loses its last use or a
+// snapshot is reclaimed.
+class PyProviderReloader : public Thread
+{
+public:
+	PyProviderReloader(
+		PyProviderIFC* ifc,
+		const ProviderEnvironmentIFCRef& env)
+		: Thread()
+		, m_ifc(ifc)
+		, m_env(env)
+		, m_guard()
+		, m_cond()
+		, m_jobs()
+		, m_pending()
+		, m_retired()
+		, m_stopping(false)
+		, m_recheck(false)
+		, m_waker(new Waker(this))
+	{
+	}
+
+	// Queues a reload of the module unless one is queued or running
+	void reload(
+		const String& providerId,
+		const String& pypath,
+		const PyProviderRef& current)
+	{
+		NonRecursiveMutexLock l(m_guard);
+		if (m_stopping || !m_pending.insert(pypath).second)
+		{
+			return;
+		}
+		ReloadJob job;
+		job.providerId = providerId;
+		job.pypath = pypath;
+		job.current = current;
+		m_jobs.push_back(job);
+		m_cond.notifyAll();
+	}
+
+	// Shuts a provider that was taken out of the published snapshot down
+	// once no lookup can find it and nothing uses it. Returns false if the
+	// reloader is stopping, the caller has to shut it down then.
+	bool retire(const PyProviderRef& pref)
+	{
+		// Set first, a use released before is seen by the next look
+		pref->setUseListener(m_waker);
+		NonRecursiveMutexLock l(m_guard);
+		if (m_stopping)
+		{
+			return false;
+		}
+		m_retired.push_back(RetiredProvider(m_ifc->getLookupEpoch(), pref));
+		m_recheck = true;
+		m_cond.notifyAll();
+		return true;
+	}
+
+	// Has the thread look at the retired providers again
+	void wake()
+	{
+		NonRecursiveMutexLock l(m_guard);
+		m_recheck = true;
+		m_cond.notifyAll();
+	}
+
+	// Drops the queued reloads and shuts down the replaced versions still
+	// waiting for their users
+	void stop()
+	{
+		{
+			NonRecursiveMutexLock l(m_guard);
+			m_stopping = true;
+			m_cond.notifyAll();
+		}
+		join();
+		m_waker->detach();
+	}
+
+protected:
+	virtual Int32 run()
+	{
+		for (;;)
+		{
+			ReloadJob job;
+			bool haveJob = false;
+			{
+				NonRecursiveMutexLock l(m_guard);
+				while (!m_stopping && m_jobs.empty() && !m_recheck)
+				{
+					m_cond.wait(l);
+				}
+				if (m_stopping)
+				{
+					break;
+				}
+				// Cleared before the look, so what happens during it
+				// is looked at again
+				m_recheck = false;
+				if (!m_jobs.empty())
+				{
+					job = m_jobs.front();
+					m_jobs.pop_front();
+					haveJob = true;
+				}
+			}
+			if (haveJob)
+			{
+				PyProviderRef replaced = m_ifc->replaceProvider(m_env,
+					job.providerId, job.pypath, job.current);
+				job.current = 0;
+				if (replaced)
+				{
+					replaced->setUseListener(m_waker);
+				}
+				NonRecursiveMutexLock l(m_guard);
+				m_pending.erase(job.pypath);
+				if (replaced)
+				{
+					m_retired.push_back(RetiredProvider(
+						m_ifc->getLookupEpoch(), replaced));
+				}
+			}
+			retireProviders(false);
+		}
+		retireProviders(true);
+		return 0;
+	}
+
+private:
+	struct ReloadJob
+	{
+		String providerId;
+		String pypath;
+		PyProviderRef current;
+	};
+	// A provider taken out of the published snapshot, with the lookup
+	// epoch it was handed over in
+	typedef std::pair<UInt32, PyProviderRef> RetiredProvider;
+
+	// Wakes the thread when a retired provider loses its last use. The
+	// providers keep it after the reloader is gone, so it is detached
+	// then.
+	class Waker : public PyProviderUseListener
+	{
+	public:
+		Waker(PyProviderReloader* reloader)
+			: PyProviderUseListener()
+			, m_guard()
+			, m_reloader(reloader)
+		{
+		}
+
+		virtual void usesReleased()
+		{
+			NonRecursiveMutexLock l(m_guard);
+			if (m_reloader)
+			{
+				m_reloader->wake();
+			}
+		}
+
+		void detach()
+		{
+			NonRecursiveMutexLock l(m_guard);
+			m_reloader = 0;
+		}
+
+	private:
+		NonRecursiveMutex m_guard;
+		PyProviderReloader* m_reloader;
+	};
+
+	// Shuts the retired versions nothing uses any more down, or all of
+	// them if all is set
+	void retireProviders(bool all)
+	{
+		std::vector<PyProviderRef> done;
+		{
+			NonRecursiveMutexLock l(m_guard);
+			std::vector<RetiredProvider>::iterator it = m_retired.begin();
+			while (it != m_retired.end())
+			{
+				// A lookup still running may have found the version
+				// without having taken its use yet
+				if (all || (it->second->getUses() == 0
+					&& m_ifc->lookupsDrained(it->first)))
+				{
+					done.push_back(it->second);
+					it = m_retired.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+		for (size_t i = 0; i < done.size(); i++)
+		{
+			m_ifc->retireProvider(m_env, done[i]);
+		}
+	}
+
+	PyProviderIFC* m_ifc;
+	ProviderEnvironmentIFCRef m_env;
+	NonRecursiveMutex m_guard;
+	Condition m_cond;
+	std::deque<ReloadJob> m_jobs;
+	std::set<String> m_pending;			// Paths queued or being reloaded
+	std::vector<RetiredProvider> m_retired;	// Waiting for users
+	bool m_stopping;
+	bool m_recheck;						// Retired providers may be done
+	IntrusiveReference<Waker> m_waker;
+};
 
+//////////////////////////////////////////////////////////////////////////////
+// A provider module being loaded. Requests for the module that come in
+// meanwhile wait for this load instead of starting one of their own.
+class PyProviderIFC::ProviderLoad : public IntrusiveCountableBase
+{
+public:
+	ProviderLoad()
+		: m_guard()
+		, m_cond()
+		, m_done(false)
+		, m_pref()
+		, m_noSuchProvider(false)
+		, m_errMsg()
+	{
+	}
+
+	void finish(const PyProviderRef& pref)
+	{
+		NonRecursiveMutexLock l(m_guard);
+		m_pref = pref;
+		m_done = true;
+		m_cond.notifyAll();
+	}
+
+	void fail(bool noSuchProvider, const String& msg)
+	{
+		NonRecursiveMutexLock l(m_guard);
+		m_noSuchProvider = noSuchProvider;
+		m_errMsg = msg;
+		m_done = true;
+		m_cond.notifyAll();
+	}
+
+	// Returns the loaded provider or throws what the load failed with
+	PyProviderRef wait()
+	{
+		NonRecursiveMutexLock l(m_guard);
+		while (!m_done)
+		{
+			m_cond.wait(l);
+		}
+		if (!m_pref)
+		{
+			if (m_noSuchProvider)
+			{
+				OW_THROW(NoSuchProviderException, m_errMsg.c_str());
+			}
+			OW_THROW(PyProviderIFCException, m_errMsg.c_str());
+		}
+		return m_pref;
+	}
+
+private:
+	NonRecursiveMutex m_guard;
+	Condition m_cond;
+	bool m_done;
+	PyProviderRef m_pref;
+	bool m_noSuchProvider;
+	String m_errMsg;
+};
 
 //////////////////////////////////////////////////////////////////////////////
 PyProviderIFC::PyProviderIFC()
 	: ProviderIFCBaseIFC()
 	, m_pywbemMod()
 	, m_disabled(false)
-	, m_loadedProvsByPath()
-	, m_idmap()
+	, m_snapshot(new ProviderSnapshot)
+	, m_retiredSnapshots()
+	, m_retiredCount(0)
+	, m_lookupEpoch(0)
+	, m_loads()
 	, m_mainPyThreadState(0)
 	, m_provTTL(String(OW_DEFAULT_PYPROVIFC_PROV_TTL).toInt32())
+	, m_memoryBudget(0)
+	, m_loadCounts()
+	, m_preloadThreads(String(OW_DEFAULT_PYPROVIFC_PRELOAD_THREADS).toUInt32())
 	, m_guard()
+	, m_interpGuard()
 	, m_pythonInitialized(false)
+	, m_pycimmbMod()
+	, m_interpGroups(0)
+	, m_interps()
+	, m_workerPool()
+	, m_gilStatsFile()
+	, m_scheduler()
+	, m_asyncLoop()
+	, m_fileWatcher()
+	, m_reloader()
 {
+	m_lookups[0] = 0;
+	m_lookups[1] = 0;
 }
 
 //////////////////////////////////////////////////////////////////////////////
 PyProviderIFC::~PyProviderIFC()
 {
+	if (m_reloader)
+	{
+		m_reloader->stop();
+		m_reloader = 0;
+	}
+
+	// Providers still referenced are released while python is up
+	SnapshotList freed;
+	for (size_t i = 0; i < m_retiredSnapshots.size(); i++)
+	{
+		freed.push_back(m_retiredSnapshots[i].second);
+	}
+	freed.push_back(m_snapshot);
+	m_retiredSnapshots.clear();
+	m_snapshot = 0;
+	deleteSnapshots(freed);
+
 	// We have to shutdown python here, because openwbem shuts down the
 	// polling manager after it shuts down the provider interfaces.
 	// If python is shutdown in the doShuttingDown method, there will
@@ -106,7 +600,13 @@ PyProviderIFC::~PyProviderIFC()
 	// called.
 	if (m_pythonInitialized)
 	{
+		if (m_asyncLoop)
+		{
+			m_asyncLoop->shutdown();
+		}
+		Py::ThreadStateCache::shutdown();
 		PyEval_AcquireLock();
+		endInterpreters();
 		PyThreadState_Swap(m_mainPyThreadState);
 		Py_Finalize();
 	}
@@ -128,8 +628,17 @@ PyProviderIFC::doInit(
 {
 	LoggerRef logger = myLogger(env);
 	OW_LOG_DEBUG(logger, "PyProviderIFC::doInit called..");
+	UInt64 initStart = nowUsecs();
 
 	getTTLOption(env);
+	getResultBatchOption(env);
+	getInterpreterOption(env);
+	getGILStatsOption(env);
+	getSchedulerOptions(env);
+	getPrefetchOption(env);
+	getMemoryBudgetOption(env);
+	getPreloadOption(env);
+	getClassCacheOption(env);
 	initPython(env);
 	if (m_disabled)
 	{
@@ -137,45 +646,54 @@ PyProviderIFC::doInit(
 		// any providers
 		return;
 	}
-
-	// Now enumerate instances of OpenWBEM_PyProvider in the interop namespace
-	// to get provider registration information
-    String interopNs = env->getConfigItem(ConfigOpts::INTEROP_SCHEMA_NAMESPACE_opt,
-		OW_DEFAULT_INTEROP_SCHEMA_NAMESPACE);
-	CIMInstanceArray regs;
-	try
-	{
-		regs = env->getCIMOMHandle()->enumInstancesA(interopNs, "OpenWBEM_PyProviderRegistration");
-
-	}
-	catch (const CIMException& e)
+	startWorkerPool(env);
+	startAsyncLoop(env);
+	startFileWatcher(env);
+	m_reloader = new PyProviderReloader(this, env);
+	m_reloader->start();
+
+	// Now read the instances of OpenWBEM_PyProviderRegistration in the
+	// interop namespace to get provider registration information
+	PyProviderRegIndexRef index = loadRegistrations(env);
+	if (!index)
 	{
-		OW_LOG_INFO(logger, Format("PyProviderIFC::doInit() caught exception "
-			"(%1) while enumerating instances of OpenWBEM_PyProvider in "
-			"in namespace %2", e, interopNs));
 		return;
 	}
 
-	if (!regs.size())
+	// Changes to the registrations are applied to the index as they are
+	// made
+	SecondaryInstanceProviderInfo sipi;
+	sipi.setProviderName(PYREG_WATCHER_ID);
+	SecondaryInstanceProviderInfo::ClassInfo watchInfo(PYREG_CLASS_NAME,
+		StringArray(1, getInteropNs(env)));
+	sipi.addInstrumentedClass(watchInfo);
+	si.append(sipi);
+
+	const PyProviderRegIndex::RegList& regs = index->getRegs();
+	if (regs.empty())
 	{
 		OW_LOG_INFO(logger, Format("PyProviderIFC::doInit() did not find any "
-			"provider registrations in namespace %1", interopNs));
+			"provider registrations in namespace %1", getInteropNs(env)));
 		return;
 	}
-	int instsize = int(regs.size());
-	for (int i = 0; i < instsize; i++)
+	std::vector<PyProviderReg> preloads;
+	for (size_t i = 0; i < regs.size(); i++)
 	{
-		PyProviderReg reg(regs[i]);
-		String provid = reg.getInstanceId();
-		UInt16Array providerTypes = reg.getProviderTypes();
+		const PyProviderReg& reg = regs[i];
+		const String& provid = reg.getInstanceId();
+		const UInt16Array& providerTypes = reg.getProviderTypes();
 		if (providerTypes.empty())
 		{
 			OW_LOG_ERROR(logger, Format("PyProviderIFC no provider types in "
 				"registration for provider %1", provid));
 			continue;
 		}
-		StringArray namespaces = reg.getNameSpaceNames();
-		String className = reg.getClassName();
+		if (reg.getPreload())
+		{
+			preloads.push_back(reg);
+		}
+		const StringArray& namespaces = reg.getNameSpaceNames();
+		const String& className = reg.getClassName();
 		for (size_t pti = 0; pti < providerTypes.size(); pti++)
 		{
 			switch(providerTypes[pti])
@@ -259,6 +777,10 @@ PyProviderIFC::doInit(
 			}
 		}
 	}
+
+	preloadProviders(env, preloads);
+	OW_LOG_DEBUG(logger, Format("PyProviderIFC::doInit finished in %1 "
+		"usecs", nowUsecs() - initStart));
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -304,91 +826,838 @@ PyProviderIFC::getTTLOption(
 
 //////////////////////////////////////////////////////////////////////////////
 void
-PyProviderIFC::initPython(
+PyProviderIFC::getResultBatchOption(
 	const ProviderEnvironmentIFCRef& env)
 {
 	LoggerRef logger = myLogger(env);
-	String confpath = env->getConfigItem(PYPROVIFC_PROV_LOCATION_opt,
-		OW_DEFAULT_PYPROVIFC_PROV_LOCATION);
-
-	OW_LOG_DEBUG(logger, "Python provider ifc initializing python...");
-
-	// Initialize embedded python interpreter
-	Py_Initialize();
-	PyEval_InitThreads();
-	// Save thread state for shutdown
-	m_mainPyThreadState = PyThreadState_Get();
-	// Release the lock acquired by PyEval_InitThreads
-	PyEval_ReleaseLock();
-	m_pythonInitialized = true;
-
-	Py::GILGuard gg;	// Acquire python's GIL
-
+	String batchOpt = env->getConfigItem(PYPROVIFC_RESULT_BATCH_SIZE_opt,
+		OW_DEFAULT_PYPROVIFC_RESULT_BATCH_SIZE);
 	try
 	{
-		// Explicitly importing 'threading' right here seems to get rid of the
-		// atexit error we get when exiting after a provider has imported
-		// threading. Might have something to do with importing threading
-		// from the main thread...
-		Py::Module tmod = Py::Module("threading", true);	// Explicity import threading
-
-		// Load the pywbem module for use in interacting
-		// with python providers
-		OW_LOG_DEBUG(logger, "Python provider ifc loading pywbem module...");
-		m_pywbemMod = Py::Module("pywbem", true);	// load pywbem module
-		OWPyConv::setPyWbemMod(m_pywbemMod);
-		PyProvider::setPyWbemMod(m_pywbemMod);
+		UInt32 batchSize = batchOpt.toUInt32();
+		if (batchSize < 1)
+		{
+			batchSize = 1;
+		}
+		PyProvider::setResultBatchSize(batchSize);
+		OW_LOG_DEBUG(logger, Format("Python provider result batch size "
+			"set to %1", batchSize));
 	}
-	catch (Py::Exception& e)
+	catch(const StringConversionException&)
 	{
-		m_disabled = true;
-		String msg = "Python provider ifc caught exception "
-			"loading pywbem module:";
-		OW_LOG_ERROR(logger, msg);
-		String tb = LogPyException(e, __FILE__, __LINE__, logger);
-		e.clear();
-		msg += tb;
-		OW_THROW(PyProviderIFCException, msg.c_str());
+		OW_LOG_ERROR(logger, Format("Invalid Python provider result batch "
+			"size in options file: %1 Defaulting to %2", batchOpt,
+			OW_DEFAULT_PYPROVIFC_RESULT_BATCH_SIZE));
+		PyProvider::setResultBatchSize(
+			String(OW_DEFAULT_PYPROVIFC_RESULT_BATCH_SIZE).toUInt32());
 	}
+}
 
-	try
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderIFC::logResultBatchStats(
+	const ProviderEnvironmentIFCRef& env)
+{
+	LoggerRef logger = myLogger(env);
+	std::vector<PyProviderRef> provs;
 	{
-		// Initialize the pycimmb module
-		// (python provider support module)
-		OW_LOG_DEBUG(logger, "Python provider ifc initializing the "
-			"pycimmb module...");
-		PyProviderModule::doInit(m_pywbemMod);
+		// Not held while the stats take the GIL
+		MutexLock ml(m_guard);
+		for (ProviderMap::const_iterator it =
+			m_snapshot->provsByPath.begin();
+			it != m_snapshot->provsByPath.end(); ++it)
+		{
+			provs.push_back(it->second);
+		}
 	}
-	catch (Py::Exception& e)
+
+	PyResultBatchStats total;
+	for (size_t i = 0; i < provs.size(); i++)
 	{
-		m_disabled = true;
-		String msg = "Python provider ifc caught exception "
-			"initializing pycim module:";
-		OW_LOG_ERROR(logger, msg);
-		String tb = LogPyException(e, __FILE__, __LINE__, logger);
-		e.clear();
-		msg += tb;
-		OW_THROW(PyProviderIFCException, msg.c_str());
+		PyResultBatchStats stats = provs[i]->getResultBatchStats();
+		if (!stats.batches)
+		{
+			continue;
+		}
+		UInt64 avgHold = stats.holdUsecs / stats.batches;
+		OW_LOG_DEBUG(logger, Format("Python provider %1 result batches: %2 "
+			"items: %3 GIL hold usecs total: %4 avg: %5 max: %6",
+			provs[i]->getName(), stats.batches, stats.items,
+			stats.holdUsecs, avgHold, stats.maxHoldUsecs));
+		total.batches += stats.batches;
+		total.items += stats.items;
+		total.holdUsecs += stats.holdUsecs;
+		if (stats.maxHoldUsecs > total.maxHoldUsecs)
+		{
+			total.maxHoldUsecs = stats.maxHoldUsecs;
+		}
 	}
+	UInt64 avgHold = (total.batches) ? total.holdUsecs / total.batches : 0;
+	OW_LOG_DEBUG(logger, Format("Python provider result batches: %1 "
+		"items: %2 GIL hold usecs total: %3 avg: %4 max: %5 "
+		"(loaded providers, batch size %6)", total.batches, total.items,
+		total.holdUsecs, avgHold, total.maxHoldUsecs,
+		PyProvider::getResultBatchSize()));
 }
 
 //////////////////////////////////////////////////////////////////////////////
-InstanceProviderIFCRef
-PyProviderIFC::doGetInstanceProvider(
-	const ProviderEnvironmentIFCRef& env,
-	const char* provIdString)
+void
+PyProviderIFC::getGILStatsOption(
+	const ProviderEnvironmentIFCRef& env)
 {
-	if (m_disabled)
+	LoggerRef logger = myLogger(env);
+	String statsOpt = env->getConfigItem(PYPROVIFC_GIL_STATS_opt,
+		OW_DEFAULT_PYPROVIFC_GIL_STATS);
+	bool enabled = false;
+	try
 	{
-		OW_THROW(NoSuchProviderException, provIdString);
+		enabled = statsOpt.toBool();
+	}
+	catch(const StringConversionException&)
+	{
+		OW_LOG_ERROR(logger, Format("Invalid Python provider GIL stats "
+			"option in options file: %1 Defaulting to %2", statsOpt,
+			OW_DEFAULT_PYPROVIFC_GIL_STATS));
+	}
+	Py::GILStats::setEnabled(enabled);
+	m_gilStatsFile = env->getConfigItem(PYPROVIFC_GIL_STATS_FILE_opt,
+		OW_DEFAULT_PYPROVIFC_GIL_STATS_FILE);
+	if (enabled)
+	{
+		OW_LOG_DEBUG(logger, "Python provider GIL wait and hold times "
+			"are recorded");
 	}
-
-	OW_LOG_DEBUG(myLogger(env),
-		Format("PyProviderIFC::doGetInstanceProvider called with "
-			"provIdString: %1", provIdString));
-
-	PyProviderRef pref = getProvider(env, provIdString);
-	return InstanceProviderIFCRef(new PyProxyInstanceProvider(pref));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderIFC::logGILStats(
+	const ProviderEnvironmentIFCRef& env)
+{
+	if (!Py::GILStats::isEnabled())
+	{
+		return;
+	}
+	LoggerRef logger = myLogger(env);
+	std::vector<Py::GILStatsEntry> stats = Py::GILStats::getStats();
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		const Py::GILStatsEntry& entry = stats[i];
+		if (!entry.wait.count && !entry.hold.count)
+		{
+			continue;
+		}
+		UInt64 avgWait = (entry.wait.count)
+			? entry.wait.totalUsecs / entry.wait.count : 0;
+		UInt64 avgHold = (entry.hold.count)
+			? entry.hold.totalUsecs / entry.hold.count : 0;
+		OW_LOG_DEBUG(logger, Format("Python provider GIL %1 %2: "
+			"waits: %3 avg: %4 max: %5 holds: %6 avg: %7 max: %8",
+			entry.provider.empty() ? String("-") : entry.provider,
+			entry.operation.empty() ? String("-") : entry.operation,
+			entry.wait.count, avgWait, entry.wait.maxUsecs,
+			entry.hold.count, avgHold, entry.hold.maxUsecs));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Returns the value of an unsigned option, or its default if it isn't a
+// number.
+static UInt32
+getUInt32Option(
+	const ProviderEnvironmentIFCRef& env,
+	const char* opt,
+	const char* defaultValue)
+{
+	String val = env->getConfigItem(opt, defaultValue);
+	try
+	{
+		return val.toUInt32();
+	}
+	catch(const StringConversionException&)
+	{
+		LoggerRef logger = myLogger(env);
+		OW_LOG_ERROR(logger, Format("Invalid value for %1 in "
+			"options file: %2 Defaulting to %3", opt, val, defaultValue));
+	}
+	return String(defaultValue).toUInt32();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderIFC::getSchedulerOptions(
+	const ProviderEnvironmentIFCRef& env)
+{
+	UInt32 maxInFlight = getUInt32Option(env, PYPROVIFC_MAX_IN_FLIGHT_opt,
+		OW_DEFAULT_PYPROVIFC_MAX_IN_FLIGHT);
+	UInt32 maxActive = getUInt32Option(env, PYPROVIFC_MAX_ACTIVE_opt,
+		OW_DEFAULT_PYPROVIFC_MAX_ACTIVE);
+	if (maxInFlight == 0 && maxActive == 0)
+	{
+		return;
+	}
+	m_scheduler = new PyProviderScheduler(maxInFlight, maxActive);
+	LoggerRef logger = myLogger(env);
+	OW_LOG_DEBUG(logger, Format("Python provider requests limited "
+		"to %1 per provider and %2 in all (0 is no limit)", maxInFlight,
+		maxActive));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderIFC::getPrefetchOption(
+	const ProviderEnvironmentIFCRef& env)
+{
+	UInt32 depth = getUInt32Option(env, PYPROVIFC_PREFETCH_DEPTH_opt,
+		OW_DEFAULT_PYPROVIFC_PREFETCH_DEPTH);
+	PyProvider::setPrefetchDepth(depth);
+	if (depth)
+	{
+		LoggerRef logger = myLogger(env);
+		OW_LOG_DEBUG(logger, Format("Python provider enumerations are "
+			"prefetched up to %1 instances ahead", depth));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Classes changed by clients are only seen by providers once their cached
+// conversion expires
+void
+PyProviderIFC::getClassCacheOption(
+	const ProviderEnvironmentIFCRef& env)
+{
+	UInt32 ttl = getUInt32Option(env, PYPROVIFC_CLASS_CACHE_TTL_opt,
+		OW_DEFAULT_PYPROVIFC_CLASS_CACHE_TTL);
+	OWPyConv::setClassCacheTTL(ttl);
+	LoggerRef logger = myLogger(env);
+	OW_LOG_DEBUG(logger, Format("Python provider class conversions are "
+		"cached for %1 seconds (0 is no caching)", ttl));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderIFC::getPreloadOption(
+	const ProviderEnvironmentIFCRef& env)
+{
+	m_preloadThreads = getUInt32Option(env, PYPROVIFC_PRELOAD_THREADS_opt,
+		OW_DEFAULT_PYPROVIFC_PRELOAD_THREADS);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Loads the providers registered with Preload=true, so their first
+// requests don't pay for the module import. Modules load concurrently on
+// up to m_preloadThreads threads. The GIL is given up while a module's
+// files are read, so this mainly overlaps the I/O of the imports.
+void
+PyProviderIFC::preloadProviders(
+	const ProviderEnvironmentIFCRef& env,
+	const std::vector<PyProviderReg>& regs)
+{
+	if (regs.empty())
+	{
+		return;
+	}
+	LoggerRef logger = myLogger(env);
+	if (m_preloadThreads == 0)
+	{
+		OW_LOG_DEBUG(logger, Format("PyProviderIFC not preloading %1 "
+			"providers because %2 is 0", regs.size(),
+			PYPROVIFC_PRELOAD_THREADS_opt));
+		return;
+	}
+
+	UInt64 start = nowUsecs();
+	size_t threads = std::min(size_t(m_preloadThreads), regs.size());
+	if (threads == 1)
+	{
+		for (size_t i = 0; i < regs.size(); i++)
+		{
+			preloadProvider(env, regs[i]);
+		}
+	}
+	else
+	{
+		volatile int next = 0;
+		std::vector<IntrusiveReference<PyPreloadThread> > loaders;
+		for (size_t i = 0; i < threads; i++)
+		{
+			loaders.push_back(new PyPreloadThread(this, env, regs, &next));
+			loaders.back()->start();
+		}
+		for (size_t i = 0; i < loaders.size(); i++)
+		{
+			loaders[i]->join();
+		}
+	}
+	OW_LOG_DEBUG(logger, Format("PyProviderIFC preloaded %1 providers on "
+		"%2 threads in %3 usecs", regs.size(), threads, nowUsecs() - start));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// A provider that fails to preload is loaded by its first request again.
+// Preloaded providers aren't unloaded for inactivity, that would only
+// move their load back to a request. They are still reloaded when they
+// change, and evicted when over the memory budget.
+void
+PyProviderIFC::preloadProvider(
+	const ProviderEnvironmentIFCRef& env,
+	const PyProviderReg& reg)
+{
+	LoggerRef logger = myLogger(env);
+	String provid = reg.getInstanceId();
+	try
+	{
+		PyProviderRef pref = getProvider(env, provid, true, reg);
+		pref->setPreloaded(true);
+		try
+		{
+			pref->warmUp(env);
+		}
+		catch (...)
+		{
+			pref->releaseUse();
+			throw;
+		}
+		pref->releaseUse();
+		OW_LOG_DEBUG(logger, Format("PyProviderIFC preloaded provider %1 "
+			"from %2. Load took %3 usecs", provid, pref->getFileName(),
+			pref->getLoadUsecs()));
+	}
+	catch (const Exception& e)
+	{
+		OW_LOG_ERROR(logger, Format("PyProviderIFC unable to preload "
+			"provider %1: %2", provid, e));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderIFC::getMemoryBudgetOption(
+	const ProviderEnvironmentIFCRef& env)
+{
+	UInt32 budgetMB = getUInt32Option(env, PYPROVIFC_MEMORY_BUDGET_opt,
+		OW_DEFAULT_PYPROVIFC_MEMORY_BUDGET);
+	if (budgetMB == 0)
+	{
+		return;
+	}
+	LoggerRef logger = myLogger(env);
+	if (getHeapInUse() < 0)
+	{
+		OW_LOG_ERROR(logger, Format("Unable to measure the heap in use. "
+			"Ignoring %1. Python providers are unloaded after %2 minutes "
+			"of inactivity", PYPROVIFC_MEMORY_BUDGET_opt, m_provTTL));
+		return;
+	}
+	m_memoryBudget = UInt64(budgetMB) * 1024 * 1024;
+	OW_LOG_DEBUG(logger, Format("Python providers are unloaded least "
+		"recently used first while the heap in use exceeds %1 MB. %2 is "
+		"ignored", budgetMB, PYPROVIFC_PROV_TTL_opt));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Unloads providers, least recently used first, until the heap is
+// estimated to be within the memory budget again. The estimate subtracts
+// what loading the providers unloaded so far took, which is approximate
+// (see PyProvider::getResidentBytes). Only providers
+// that would be unloaded by TTL are evicted.
+void
+PyProviderIFC::evictProviders(
+	const ProviderEnvironmentIFCRef& env)
+{
+	Int64 inUse = getHeapInUse();
+	if (inUse < 0 || UInt64(inUse) <= m_memoryBudget)
+	{
+		return;
+	}
+
+	LoggerRef logger = myLogger(env);
+	OW_LOG_DEBUG(logger, Format("PyProviderIFC heap in use is %1 bytes. "
+		"Evicting providers to get within the budget of %2 bytes", inUse,
+		m_memoryBudget));
+
+	SnapshotList freed;
+	std::vector<PyProviderRef> unloaded;
+	{
+		MutexLock ml(m_guard);
+		std::vector<ProviderAccess> lru;
+		for (ProviderMap::const_iterator it = m_snapshot->provsByPath.begin();
+			it != m_snapshot->provsByPath.end(); ++it)
+		{
+			if (it->second->isUnloadableType())
+			{
+				lru.push_back(ProviderAccess(
+					it->second->getLastAccessTime(), it->first));
+			}
+		}
+		std::stable_sort(lru.begin(), lru.end(), usedEarlier);
+
+		ProviderSnapshot* snapshot = 0;
+		for (size_t i = 0; i < lru.size() && UInt64(inUse) > m_memoryBudget;
+			i++)
+		{
+			PyProviderRef pref =
+				m_snapshot->provsByPath.find(lru[i].second)->second;
+			try
+			{
+				if (pref->getUses() == 0 && pref->canShutDown(env))
+				{
+					Int64 resident = pref->getResidentBytes();
+					OW_LOG_DEBUG(logger, Format("PyProviderIFC evicting "
+						"provider %1. Last used: %2 resident bytes: %3",
+						pref->getName(), lru[i].first.toString(), resident));
+					unloaded.push_back(pref);
+					if (!snapshot)
+					{
+						snapshot = new ProviderSnapshot(*m_snapshot);
+					}
+					snapshot->idmap.erase(pref->getFileName());
+					snapshot->provsByPath.erase(lru[i].second);
+					inUse -= resident;
+				}
+			}
+			catch(...)
+			{
+				// Ignore?
+			}
+		}
+		if (snapshot)
+		{
+			publishSnapshot(snapshot, freed);
+		}
+		else
+		{
+			reclaimSnapshots(freed);
+		}
+	}
+	deleteSnapshots(freed);
+	// Lookups may still find the evicted providers in an older snapshot
+	retireUnloaded(env, unloaded);
+
+	OW_LOG_DEBUG(logger, Format("PyProviderIFC heap in use after "
+		"eviction: %1 bytes", getHeapInUse()));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Logs what every provider module loaded so far holds and how often it
+// was loaded. Many reloads mean the memory budget is too small for the
+// providers in use.
+void
+PyProviderIFC::logProviderMemory(
+	const ProviderEnvironmentIFCRef& env)
+{
+	LoggerRef logger = myLogger(env);
+	OW_LOG_DEBUG(logger, Format("Python provider heap in use: %1 bytes "
+		"budget: %2 bytes (0 is none)", getHeapInUse(), m_memoryBudget));
+
+	MutexLock ml(m_guard);
+	for (Map<String, UInt32>::const_iterator it = m_loadCounts.begin();
+		it != m_loadCounts.end(); ++it)
+	{
+		ProviderMap::const_iterator pit =
+			m_snapshot->provsByPath.find(it->first);
+		bool loaded = pit != m_snapshot->provsByPath.end();
+		OW_LOG_DEBUG(logger, Format("Python provider %1: loaded: %2 "
+			"loads: %3 reloads: %4 resident bytes: %5 last used: %6",
+			it->first, (loaded) ? "yes" : "no", it->second, it->second - 1,
+			(loaded) ? pit->second->getResidentBytes() : Int64(0),
+			(loaded) ? pit->second->getLastAccessTime().toString()
+				: String("-")));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderIFC::logSchedulerStats(
+	const ProviderEnvironmentIFCRef& env)
+{
+	if (!m_scheduler)
+	{
+		return;
+	}
+	LoggerRef logger = myLogger(env);
+	PyProviderQueueStatsArray stats = m_scheduler->getStats();
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		const PyProviderQueueStats& ps = stats[i];
+		UInt64 avgWait = (ps.queued) ? ps.totalWaitUsecs / ps.queued : 0;
+		OW_LOG_DEBUG(logger, Format("Python provider queue %1: in flight: %2 "
+			"queued now: %3 max: %4 admitted: %5 waited: %6 "
+			"wait usecs avg: %7 max: %8", ps.provider, ps.inFlight,
+			ps.queueDepth, ps.maxQueueDepth, ps.admitted, ps.queued, avgWait,
+			ps.maxWaitUsecs));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Subinterpreters isolate the modules of providers from each other. They
+// all share the one GIL of python 2, so they don't add parallelism, which
+// is why they are off unless asked for.
+void
+PyProviderIFC::getInterpreterOption(
+	const ProviderEnvironmentIFCRef& env)
+{
+	LoggerRef logger = myLogger(env);
+	String interpOpt = env->getConfigItem(PYPROVIFC_SUBINTERPRETERS_opt,
+		OW_DEFAULT_PYPROVIFC_SUBINTERPRETERS);
+	interpOpt.trim();
+	if (interpOpt.empty() || interpOpt.equalsIgnoreCase("off"))
+	{
+		m_interpGroups = 0;
+	}
+	else if (interpOpt.equalsIgnoreCase("per_module"))
+	{
+		m_interpGroups = -1;
+	}
+	else
+	{
+		try
+		{
+			m_interpGroups = interpOpt.toInt32();
+			if (m_interpGroups < 0)
+			{
+				m_interpGroups = 0;
+			}
+		}
+		catch(const StringConversionException&)
+		{
+			OW_LOG_ERROR(logger, Format("Invalid Python provider "
+				"subinterpreters option in options file: %1 Defaulting to %2",
+				interpOpt, OW_DEFAULT_PYPROVIFC_SUBINTERPRETERS));
+			m_interpGroups = 0;
+		}
+	}
+	if (m_interpGroups < 0)
+	{
+		OW_LOG_DEBUG(logger, "Python providers run in a subinterpreter "
+			"per provider module. They still share one GIL");
+	}
+	else if (m_interpGroups > 0)
+	{
+		OW_LOG_DEBUG(logger, Format("Python providers run in %1 "
+			"subinterpreter groups. They still share one GIL",
+			m_interpGroups));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Starts the worker processes for providers registered with
+// OutOfProcess=true. They are forked by a template process running the
+// worker program, which sets up python on its own, so this doesn't depend
+// on what other threads of the CIMOM are doing.
+void
+PyProviderIFC::startWorkerPool(
+	const ProviderEnvironmentIFCRef& env)
+{
+	LoggerRef logger = myLogger(env);
+	String countOpt = env->getConfigItem(PYPROVIFC_WORKER_PROCESSES_opt,
+		OW_DEFAULT_PYPROVIFC_WORKER_PROCESSES);
+	String ringOpt = env->getConfigItem(PYPROVIFC_WORKER_RING_SIZE_opt,
+		OW_DEFAULT_PYPROVIFC_WORKER_RING_SIZE);
+	UInt32 count = 0;
+	UInt32 ringSize = 0;
+	try
+	{
+		count = countOpt.toUInt32();
+	}
+	catch(const StringConversionException&)
+	{
+		OW_LOG_ERROR(logger, Format("Invalid Python provider worker "
+			"processes option in options file: %1 Defaulting to %2",
+			countOpt, OW_DEFAULT_PYPROVIFC_WORKER_PROCESSES));
+		count = String(OW_DEFAULT_PYPROVIFC_WORKER_PROCESSES).toUInt32();
+	}
+	try
+	{
+		ringSize = ringOpt.toUInt32();
+		if (ringSize < 4096)
+		{
+			ringSize = 4096;
+		}
+	}
+	catch(const StringConversionException&)
+	{
+		OW_LOG_ERROR(logger, Format("Invalid Python provider worker ring "
+			"size in options file: %1 Defaulting to %2",
+			ringOpt, OW_DEFAULT_PYPROVIFC_WORKER_RING_SIZE));
+		ringSize = String(OW_DEFAULT_PYPROVIFC_WORKER_RING_SIZE).toUInt32();
+	}
+	if (count == 0)
+	{
+		return;
+	}
+
+	String program = env->getConfigItem(PYPROVIFC_WORKER_PROGRAM_opt,
+		OW_DEFAULT_PYPROVIFC_WORKER_PROGRAM);
+	PyWorkerPoolRef pool(new PyWorkerPool(count, ringSize, program));
+	try
+	{
+		pool->start();
+	}
+	catch(const Exception& e)
+	{
+		// Providers registered with OutOfProcess=true run in the CIMOM
+		OW_LOG_ERROR(logger, Format("Python provider ifc failed to start "
+			"worker processes: %1", e));
+		pool->shutdown();
+		return;
+	}
+	m_workerPool = pool;
+	OW_LOG_DEBUG(logger, Format("Python provider ifc started %1 worker "
+		"processes with %2 byte ring buffers", count, ringSize));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Starts the event loop thread that runs the coroutines and futures
+// providers return. Must be called after python is initialized and
+// without the GIL held.
+void
+PyProviderIFC::startAsyncLoop(
+	const ProviderEnvironmentIFCRef& env)
+{
+	LoggerRef logger = myLogger(env);
+	String modName = env->getConfigItem(PYPROVIFC_ASYNC_MODULE_opt,
+		OW_DEFAULT_PYPROVIFC_ASYNC_MODULE);
+	modName.trim();
+	if (modName.empty())
+	{
+		return;
+	}
+
+	PyAsyncLoopRef loop(new PyAsyncLoop(modName));
+	try
+	{
+		loop->start();
+	}
+	catch(const Exception& e)
+	{
+		// Coroutines returned by providers will fail to convert
+		OW_LOG_ERROR(logger, Format("Python provider ifc failed to start "
+			"the event loop: %1", e));
+		return;
+	}
+	m_asyncLoop = loop;
+	OW_LOG_DEBUG(logger, Format("Python provider ifc started the %1 "
+		"event loop", modName));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Starts watching provider files for changes, unless the option turns it
+// off. Providers stat their files on every request if there is no
+// watcher or it can't watch them.
+void
+PyProviderIFC::startFileWatcher(
+	const ProviderEnvironmentIFCRef& env)
+{
+	LoggerRef logger = myLogger(env);
+	String watchOpt = env->getConfigItem(PYPROVIFC_WATCH_FILES_opt,
+		OW_DEFAULT_PYPROVIFC_WATCH_FILES);
+	bool enabled = true;
+	try
+	{
+		enabled = watchOpt.toBool();
+	}
+	catch(const StringConversionException&)
+	{
+		OW_LOG_ERROR(logger, Format("Invalid Python provider watch files "
+			"option in options file: %1 Defaulting to %2", watchOpt,
+			OW_DEFAULT_PYPROVIFC_WATCH_FILES));
+	}
+	if (!enabled)
+	{
+		return;
+	}
+
+	PyProviderFileWatcherRef watcher(new PyProviderFileWatcher);
+	if (!watcher->start())
+	{
+		OW_LOG_INFO(logger, "Python provider ifc can't watch provider "
+			"files. Checking them on every request");
+		return;
+	}
+	m_fileWatcher = watcher;
+	OW_LOG_DEBUG(logger, "Python provider ifc watching provider files "
+		"for changes");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Returns the interpreter the given provider module is to be loaded into,
+// creating it if needed.
+PyInterpreterState*
+PyProviderIFC::getInterpreter(
+	const ProviderEnvironmentIFCRef& env,
+	const String& pypath)
+{
+	if (m_interpGroups == 0)
+	{
+		return 0;
+	}
+
+	MutexLock ml(m_interpGuard);
+
+	String key = pypath;
+	if (m_interpGroups > 0)
+	{
+		// Spread the provider modules over the groups by their path
+		UInt32 hash = 0;
+		for (size_t i = 0; i < pypath.length(); i++)
+		{
+			hash = hash * 31 + UInt32(UInt8(pypath[i]));
+		}
+		key = String(hash % UInt32(m_interpGroups));
+	}
+
+	InterpMap::iterator it = m_interps.find(key);
+	if (it != m_interps.end())
+	{
+		return it->second->interp;
+	}
+
+	LoggerRef logger = myLogger(env);
+	OW_LOG_DEBUG(logger, Format("Python provider ifc creating "
+		"subinterpreter %1", key));
+
+	// We may be called from an upcall of a provider that runs in
+	// a subinterpreter. New interpreters are created from the main one.
+	Py::InterpreterScope is(0);
+	Py::GILGuard gg;	// Acquire python's GIL
+	PyThreadState* mainTState = PyThreadState_Get();
+	PyThreadState* tstate = Py_NewInterpreter();
+	if (!tstate)
+	{
+		PyThreadState_Swap(mainTState);
+		OW_THROW(PyProviderIFCException,
+			"Python provider ifc failed to create a subinterpreter");
+	}
+
+	try
+	{
+		// The support module can't be initialized a second time, but the
+		// module object can be shared with the new interpreter. pywbem
+		// is imported again so the new interpreter gets its own copy.
+		Py::Dict modules(PyImport_GetModuleDict());
+		modules.setItem("pycimmb", m_pycimmbMod);
+		Py::Module pywbemMod("pywbem", true);
+		OWPyConv::setPyWbemMod(pywbemMod);
+	}
+	catch (Py::Exception& e)
+	{
+		String tb = LogPyException(e, __FILE__, __LINE__, logger);
+		e.clear();
+		OWPyConv::dropInterpreterState();
+		Py_EndInterpreter(tstate);
+		PyThreadState_Swap(mainTState);
+		OW_THROW(PyProviderIFCException, Format("Python provider ifc "
+			"failed to initialize subinterpreter: %1", tb).c_str());
+	}
+	PyThreadState_Swap(mainTState);
+	m_interps[key] = tstate;
+	return tstate->interp;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Ends all subinterpreters. Must be called with the GIL held, after all
+// providers have been released.
+void
+PyProviderIFC::endInterpreters()
+{
+	for (InterpMap::iterator it = m_interps.begin(); it != m_interps.end();
+		++it)
+	{
+		PyThreadState_Swap(it->second);
+		OWPyConv::dropInterpreterState();
+		Py_EndInterpreter(it->second);
+	}
+	m_interps.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderIFC::initPython(
+	const ProviderEnvironmentIFCRef& env)
+{
+	LoggerRef logger = myLogger(env);
+	String confpath = env->getConfigItem(PYPROVIFC_PROV_LOCATION_opt,
+		OW_DEFAULT_PYPROVIFC_PROV_LOCATION);
+
+	OW_LOG_DEBUG(logger, "Python provider ifc initializing python...");
+
+	// Initialize embedded python interpreter
+	Py_Initialize();
+	PyEval_InitThreads();
+	// Save thread state for shutdown
+	m_mainPyThreadState = PyThreadState_Get();
+	// Release the lock acquired by PyEval_InitThreads
+	PyEval_ReleaseLock();
+	m_pythonInitialized = true;
+
+	Py::GILGuard gg;	// Acquire python's GIL
+
+	try
+	{
+		// Explicitly importing 'threading' right here seems to get rid of the
+		// atexit error we get when exiting after a provider has imported
+		// threading. Might have something to do with importing threading
+		// from the main thread...
+		Py::Module tmod = Py::Module("threading", true);	// Explicity import threading
+
+		// Load the pywbem module for use in interacting
+		// with python providers
+		OW_LOG_DEBUG(logger, "Python provider ifc loading pywbem module...");
+		m_pywbemMod = Py::Module("pywbem", true);	// load pywbem module
+		OWPyConv::setPyWbemMod(m_pywbemMod);
+	}
+	catch (Py::Exception& e)
+	{
+		m_disabled = true;
+		String msg = "Python provider ifc caught exception "
+			"loading pywbem module:";
+		OW_LOG_ERROR(logger, msg);
+		String tb = LogPyException(e, __FILE__, __LINE__, logger);
+		e.clear();
+		msg += tb;
+		OW_THROW(PyProviderIFCException, msg.c_str());
+	}
+
+	try
+	{
+		// Initialize the pycimmb module
+		// (python provider support module)
+		OW_LOG_DEBUG(logger, "Python provider ifc initializing the "
+			"pycimmb module...");
+		PyProviderModule::doInit(m_pywbemMod);
+		m_pycimmbMod = PyProviderModule::getModulePtr()->module();
+	}
+	catch (Py::Exception& e)
+	{
+		m_disabled = true;
+		String msg = "Python provider ifc caught exception "
+			"initializing pycim module:";
+		OW_LOG_ERROR(logger, msg);
+		String tb = LogPyException(e, __FILE__, __LINE__, logger);
+		e.clear();
+		msg += tb;
+		OW_THROW(PyProviderIFCException, msg.c_str());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+InstanceProviderIFCRef
+PyProviderIFC::doGetInstanceProvider(
+	const ProviderEnvironmentIFCRef& env,
+	const char* provIdString)
+{
+	if (m_disabled)
+	{
+		OW_THROW(NoSuchProviderException, provIdString);
+	}
+
+	OW_LOG_DEBUG(myLogger(env),
+		Format("PyProviderIFC::doGetInstanceProvider called with "
+			"provIdString: %1", provIdString));
+
+	PyProviderRef pref = getProvider(env, provIdString);
+	return InstanceProviderIFCRef(new PyProxyInstanceProvider(pref));
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -401,6 +1670,10 @@ PyProviderIFC::doGetSecondaryInstanceProvider(
 	{
 		OW_THROW(NoSuchProviderException, provIdString);
 	}
+	if (String(provIdString) == PYREG_WATCHER_ID)
+	{
+		return SecondaryInstanceProviderIFCRef(new PyRegistrationWatcher(this));
+	}
 	OW_LOG_DEBUG(myLogger(env),
 		Format("PyProviderIFC::doGetSecondaryInstanceProvider called with "
 			"provIdString: %1 -- Not Currently Supported", provIdString));
@@ -464,69 +1737,41 @@ PyProviderIFC::doGetIndicationExportProviders(
 	}
 
 	IndicationExportProviderIFCRefArray provra;
-    String interopNs = env->getConfigItem(ConfigOpts::INTEROP_SCHEMA_NAMESPACE_opt,
-		OW_DEFAULT_INTEROP_SCHEMA_NAMESPACE);
-	CIMInstanceArray regs;
-	try
-	{
-		regs = env->getCIMOMHandle()->enumInstancesA(interopNs, "OpenWBEM_PyProviderRegistration");
-	}
-	catch (const CIMException& e)
-	{
-		OW_LOG_INFO(logger,
-			Format("PyProviderIFC::doGetIndicationExportProviders() caught "
-			"exception (%1) while enumerating instances of "
-			"OpenWBEM_PyProvider in in namespace %2", e, interopNs));
-		return provra;
-	}
-
-	if (!regs.size())
+	PyProviderRegIndexRef index = getRegIndex();
+	const PyProviderRegIndex::RegList& regs =
+		index->getRegsOfType(PyProviderReg::E_INDICATION_HANDLER);
+	if (regs.empty())
 	{
 		OW_LOG_INFO(logger,
 			Format("PyProviderIFC::doGetIndicationExportProviders() "
-			"did not find any provider registrations in namespace %1",
-				interopNs));
+			"did not find any indication handler provider registrations "
+			"in namespace %1", getInteropNs(env)));
 		return provra;
 	}
-	int instsize = int(regs.size());
-	for (int i = 0; i < instsize; i++)
+	for (size_t i = 0; i < regs.size(); i++)
 	{
-		PyProviderReg reg(regs[i]);
-		String provid = reg.getInstanceId();
-		UInt16Array providerTypes = reg.getProviderTypes();
-		if (providerTypes.empty())
+		const PyProviderReg& reg = regs[i];
+		const String& provid = reg.getInstanceId();
+		const StringArray& handlerClassNames =
+			reg.getExportHandlerClassNames();
+		if (handlerClassNames.empty())
 		{
-			OW_LOG_ERROR(logger, Format("PyProviderIFC no provider types in "
-				"registration for provider %1", provid));
-			continue;
+			OW_LOG_ERROR(logger, Format("PyProviderIFC no handler class "
+				"names in registration for IndicationHandlerProvider %1 "
+				"not registering", provid));
 		}
 
-		for (size_t pti = 0; pti < providerTypes.size(); pti++)
+		try
 		{
-			if (providerTypes[pti] == PyProviderReg::E_INDICATION_HANDLER)
-			{
-				StringArray handlerClassNames = reg.getExportHandlerClassNames();
-				if (handlerClassNames.empty())
-				{
-					OW_LOG_ERROR(logger, Format("PyProviderIFC no handler class "
-						"names in registration for IndicationHandlerProvider %1 "
-						"not registering", provid));
-				}
-
-				try
-				{
-					PyProviderRef pref = getProvider(env, provid, false);
-					pref->setHandlerClassNames(handlerClassNames);
-					provra.append(IndicationExportProviderIFCRef(new PyProxyIndicationExportProvider(pref)));
-				}
-				catch(const Exception& e)
-				{
-					OW_LOG_INFO(logger,
-						Format("PyProviderIFC::doGetIndicationExportProviders() caught "
-						"exception (%1) while loading provider %2", e, provid));
-				}
-				break;
-			}
+			PyProviderRef pref = getProvider(env, provid, false, reg);
+			pref->setHandlerClassNames(handlerClassNames);
+			provra.append(IndicationExportProviderIFCRef(new PyProxyIndicationExportProvider(pref)));
+		}
+		catch(const Exception& e)
+		{
+			OW_LOG_INFO(logger,
+				Format("PyProviderIFC::doGetIndicationExportProviders() caught "
+				"exception (%1) while loading provider %2", e, provid));
 		}
 	}
 	OW_LOG_DEBUG(logger,
@@ -552,108 +1797,365 @@ PyProviderIFC::doGetPolledProviders(
 	}
 
 	PolledProviderIFCRefArray provra;
-    String interopNs = env->getConfigItem(ConfigOpts::INTEROP_SCHEMA_NAMESPACE_opt,
-		OW_DEFAULT_INTEROP_SCHEMA_NAMESPACE);
+	PyProviderRegIndexRef index = getRegIndex();
+	const PyProviderRegIndex::RegList& regs =
+		index->getRegsOfType(PyProviderReg::E_POLLED);
+	if (regs.empty())
+	{
+		OW_LOG_INFO(logger,
+			Format("PyProviderIFC::doGetPolledProviders() "
+			"did not find any polled provider registrations in namespace %1",
+				getInteropNs(env)));
+		return provra;
+	}
+	for (size_t i = 0; i < regs.size(); i++)
+	{
+		const PyProviderReg& reg = regs[i];
+		const String& provid = reg.getInstanceId();
+		try
+		{
+			PyProviderRef pref = getProvider(env, provid, false, reg);
+			provra.append(PolledProviderIFCRef(new PyProxyPolledProvider(pref)));
+		}
+		catch(const Exception& e)
+		{
+			OW_LOG_INFO(logger,
+				Format("PyProviderIFC::doGetPolledProviders() caught "
+				"exception (%1) while loading provider %2", e, provid));
+		}
+	}
+
+	OW_LOG_DEBUG(logger, Format("PyProviderIFC::doGetPolledProviders "
+		"returning %1 providers", provra.size()));
+	return provra;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+IndicationProviderIFCRef
+PyProviderIFC::doGetIndicationProvider(
+	const ProviderEnvironmentIFCRef& env,
+	const char* provIdString)
+{
+	if (m_disabled)
+	{
+		OW_THROW(NoSuchProviderException, provIdString);
+	}
+
+	OW_LOG_DEBUG(myLogger(env),
+		Format("PyProviderIFC::doGetIndicationProvider called with "
+			"provIdString: %1", provIdString));
+
+	PyProviderRef pref = getProvider(env, provIdString, false);
+	return IndicationProviderIFCRef(new PyProxyIndicationProvider(pref));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Reads the provider registrations into the index. This is the only time
+// they are enumerated, later changes come in through the
+// PyRegistrationWatcher. Returns a null reference if they can't be read.
+PyProviderRegIndexRef
+PyProviderIFC::loadRegistrations(
+	const ProviderEnvironmentIFCRef& env)
+{
+	String interopNs = getInteropNs(env);
 	CIMInstanceArray regs;
 	try
 	{
-		regs = env->getCIMOMHandle()->enumInstancesA(interopNs, "OpenWBEM_PyProviderRegistration");
+		regs = env->getCIMOMHandle()->enumInstancesA(interopNs,
+			PYREG_CLASS_NAME);
 	}
 	catch (const CIMException& e)
 	{
-		OW_LOG_INFO(logger,
-			Format("PyProviderIFC::doGetPolledProviders() caught "
-			"exception (%1) while enumerating instances of "
-			"OpenWBEM_PyProvider in in namespace %2", e, interopNs));
-		return provra;
+		OW_LOG_INFO(myLogger(env), Format("PyProviderIFC caught exception "
+			"(%1) while enumerating instances of %2 in namespace %3", e,
+			PYREG_CLASS_NAME, interopNs));
+		return PyProviderRegIndexRef();
+	}
+
+	PyProviderRegIndexRef index(new PyProviderRegIndex(regs));
+	SnapshotList freed;
+	{
+		MutexLock ml(m_guard);
+		ProviderSnapshot* snapshot = new ProviderSnapshot(*m_snapshot);
+		snapshot->regs = index;
+		publishSnapshot(snapshot, freed);
+	}
+	deleteSnapshots(freed);
+	return index;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Returns the current registration index without locking
+PyProviderRegIndexRef
+PyProviderIFC::getRegIndex()
+{
+	UInt32 epoch = beginLookup();
+	PyProviderRegIndexRef index =
+		__atomic_load_n(&m_snapshot, __ATOMIC_ACQUIRE)->regs;
+	endLookup(epoch);
+	return index;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Publishes an index with the registration of providerId replaced by reg,
+// or removed if reg is null. The provider id is mapped to its module
+// again by the next request for it. A provider that is loaded keeps the
+// options it was loaded with until it is loaded again.
+void
+PyProviderIFC::changeRegistration(
+	const ProviderEnvironmentIFCRef& env,
+	const String& providerId,
+	const PyProviderReg& reg)
+{
+	if (providerId.empty())
+	{
+		return;
+	}
+	SnapshotList freed;
+	{
+		MutexLock ml(m_guard);
+		ProviderSnapshot* snapshot = new ProviderSnapshot(*m_snapshot);
+		snapshot->regs = (reg.isNull())
+			? snapshot->regs->withoutReg(providerId)
+			: snapshot->regs->withReg(reg);
+		ProvIdMap::iterator idit = snapshot->idmap.find(providerId);
+		if (idit != snapshot->idmap.end()
+			&& (reg.isNull() || idit->second != reg.getModPath()))
+		{
+			snapshot->idmap.erase(idit);
+		}
+		publishSnapshot(snapshot, freed);
+	}
+	deleteSnapshots(freed);
+
+	OW_LOG_INFO(myLogger(env), Format("PyProviderIFC %1 the registration "
+		"of provider %2. Changes to the classes and provider types it is "
+		"registered for take effect when the CIMOM is restarted",
+		(reg.isNull()) ? "removed" : "updated", providerId));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Looks the provider up in the current snapshot without locking. Returns
+// a null reference if it isn't loaded. pypath is set if the provider id
+// is known.
+PyProviderRef
+PyProviderIFC::findProvider(
+	const String& providerId,
+	String& pypath)
+{
+	PyProviderRef pref;
+	// Keeps reclaimSnapshots from freeing the snapshot while it is read
+	UInt32 epoch = beginLookup();
+	const ProviderSnapshot* snapshot =
+		__atomic_load_n(&m_snapshot, __ATOMIC_ACQUIRE);
+	ProvIdMap::const_iterator idit = snapshot->idmap.find(providerId);
+	if (idit != snapshot->idmap.end())
+	{
+		pypath = idit->second;
+		ProviderMap::const_iterator it = snapshot->provsByPath.find(pypath);
+		if (it != snapshot->provsByPath.end())
+		{
+			pref = it->second;
+			// Taken before the lookup ends, see retireProviders
+			pref->addUse();
+		}
 	}
+	endLookup(epoch);
+	return pref;
+}
 
-	if (!regs.size())
+//////////////////////////////////////////////////////////////////////////////
+// Counts a lookup in the current epoch. Returns the epoch to pass to
+// endLookup.
+UInt32
+PyProviderIFC::beginLookup()
+{
+	for (;;)
 	{
-		OW_LOG_INFO(logger,
-			Format("PyProviderIFC::doGetPolledProviders() "
-			"did not find any provider registrations in namespace %1",
-				interopNs));
-		return provra;
+		UInt32 epoch = __atomic_load_n(&m_lookupEpoch, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&m_lookups[epoch & 1], 1, __ATOMIC_SEQ_CST);
+		// reclaimSnapshots may have found the slot empty and advanced the
+		// epoch before the count was raised. The lookup can't be told
+		// apart from the ones of two epochs later then, so it starts over.
+		if (__atomic_load_n(&m_lookupEpoch, __ATOMIC_SEQ_CST) == epoch)
+		{
+			return epoch;
+		}
+		endLookup(epoch);
 	}
-	int instsize = int(regs.size());
-	for (int i = 0; i < instsize; i++)
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Uncounts a lookup. The last lookup of an epoch reclaims the snapshots
+// retired meanwhile, so they don't wait for the next change.
+void
+PyProviderIFC::endLookup(
+	UInt32 epoch)
+{
+	if (__atomic_sub_fetch(&m_lookups[epoch & 1], 1, __ATOMIC_SEQ_CST) == 0
+		&& __atomic_load_n(&m_retiredCount, __ATOMIC_SEQ_CST) != 0)
 	{
-		PyProviderReg reg(regs[i]);
-		String provid = reg.getInstanceId();
-		UInt16Array providerTypes = reg.getProviderTypes();
-		if (providerTypes.empty())
+		SnapshotList freed;
 		{
-			OW_LOG_ERROR(logger, Format("PyProviderIFC no provider types in "
-				"registration for provider %1", provid));
-			continue;
+			MutexLock ml(m_guard);
+			reclaimSnapshots(freed);
 		}
+		deleteSnapshots(freed);
+	}
+}
 
-		for (size_t pti = 0; pti < providerTypes.size(); pti++)
+//////////////////////////////////////////////////////////////////////////////
+// Makes snapshot the current one. Snapshots no lookup can use any more
+// are added to freed, to be deleted once m_guard is unlocked. Must be
+// called with m_guard locked.
+void
+PyProviderIFC::publishSnapshot(
+	ProviderSnapshot* snapshot,
+	SnapshotList& freed)
+{
+	ProviderSnapshot* old = m_snapshot;
+	__atomic_store_n(&m_snapshot, snapshot, __ATOMIC_SEQ_CST);
+	// Only m_guard holders advance the epoch
+	m_retiredSnapshots.push_back(std::make_pair(
+		__atomic_load_n(&m_lookupEpoch, __ATOMIC_SEQ_CST), old));
+	reclaimSnapshots(freed);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Moves the retired snapshots no lookup can use any more to freed, and
+// advances the epoch as far as the running lookups allow. Lookups only
+// run in the current epoch and the one before it: the epoch advances
+// when the slot the next epoch shares with the one before is empty. A
+// lookup that can see a snapshot retired in epoch E began in E at the
+// latest, so it has ended once the epoch is E + 2. Must be called with
+// m_guard locked.
+void
+PyProviderIFC::reclaimSnapshots(
+	SnapshotList& freed)
+{
+	while (!m_retiredSnapshots.empty())
+	{
+		UInt32 epoch = __atomic_load_n(&m_lookupEpoch, __ATOMIC_SEQ_CST);
+		RetiredList::iterator it = m_retiredSnapshots.begin();
+		while (it != m_retiredSnapshots.end())
 		{
-			if (providerTypes[pti] == PyProviderReg::E_POLLED)
+			if (epoch - it->first >= 2)
 			{
-				try
-				{
-					PyProviderRef pref = getProvider(env, provid, false);
-					provra.append(PolledProviderIFCRef(new PyProxyPolledProvider(pref)));
-				}
-				catch(const Exception& e)
-				{
-					OW_LOG_INFO(logger,
-						Format("PyProviderIFC::doGetPolledProviders() caught "
-						"exception (%1) while loading provider %2", e, provid));
-				}
-				break;
+				freed.push_back(it->second);
+				it = m_retiredSnapshots.erase(it);
 			}
+			else
+			{
+				++it;
+			}
+		}
+		// Stored before the slot is read, so the lookup that empties the
+		// slot after that sees it
+		__atomic_store_n(&m_retiredCount, UInt32(m_retiredSnapshots.size()),
+			__ATOMIC_SEQ_CST);
+		if (m_retiredSnapshots.empty()
+			|| __atomic_load_n(&m_lookups[(epoch + 1) & 1],
+				__ATOMIC_SEQ_CST) != 0)
+		{
+			// The last of those lookups calls this again
+			return;
 		}
+		__atomic_store_n(&m_lookupEpoch, epoch + 1, __ATOMIC_SEQ_CST);
 	}
-
-	OW_LOG_DEBUG(logger, Format("PyProviderIFC::doGetPolledProviders "
-		"returning %1 providers", provra.size()));
-	return provra;
+	__atomic_store_n(&m_retiredCount, 0, __ATOMIC_SEQ_CST);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-IndicationProviderIFCRef
-PyProviderIFC::doGetIndicationProvider(
-	const ProviderEnvironmentIFCRef& env,
-	const char* provIdString)
+// Deleting a snapshot may release providers, which takes the GIL. The
+// reloader may be waiting for the snapshots to go, see lookupsDrained.
+// Must be called without m_guard locked.
+void
+PyProviderIFC::deleteSnapshots(
+	SnapshotList& snapshots)
 {
-	if (m_disabled)
+	if (snapshots.empty())
 	{
-		OW_THROW(NoSuchProviderException, provIdString);
+		return;
 	}
+	for (size_t i = 0; i < snapshots.size(); i++)
+	{
+		delete snapshots[i];
+	}
+	snapshots.clear();
+	PyProviderReloaderRef reloader = m_reloader;
+	if (reloader)
+	{
+		reloader->wake();
+	}
+}
 
-	OW_LOG_DEBUG(myLogger(env),
-		Format("PyProviderIFC::doGetIndicationProvider called with "
-			"provIdString: %1", provIdString));
-
-	PyProviderRef pref = getProvider(env, provIdString, false);
-	return IndicationProviderIFCRef(new PyProxyIndicationProvider(pref));
+//////////////////////////////////////////////////////////////////////////////
+// Associates a loaded provider with a provider id and marks it as not
+// unloadable if needed.
+void
+PyProviderIFC::associateProvider(
+	const String& providerId,
+	const String& pypath,
+	const PyProviderRef& pref,
+	bool unloadableType)
+{
+	if (pref->isUnloadableType() && !unloadableType)
+	{
+		pref->setUnloadableType(false);
+	}
+	SnapshotList freed;
+	{
+		MutexLock ml(m_guard);
+		ProvIdMap::const_iterator idit = m_snapshot->idmap.find(providerId);
+		if (idit == m_snapshot->idmap.end() || idit->second != pypath)
+		{
+			ProviderSnapshot* snapshot = new ProviderSnapshot(*m_snapshot);
+			snapshot->idmap[providerId] = pypath;
+			publishSnapshot(snapshot, freed);
+		}
+	}
+	deleteSnapshots(freed);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-String
-PyProviderIFC::getPath4Id(
-	const String& provid)
+// Ends the load of a provider module and publishes the provider if the
+// load succeeded. The caller wakes up the requests waiting for the load.
+void
+PyProviderIFC::finishLoad(
+	const String& pypath,
+	const ProviderLoadRef& load,
+	const PyProviderRef& pref)
 {
-	// Assumes m_guard is acquired
-	String pypath;
-	ProvIdMap::iterator idit = m_idmap.find(provid);
-	if (idit != m_idmap.end())
+	SnapshotList freed;
 	{
-		pypath = idit->second;
+		MutexLock ml(m_guard);
+		LoadMap::iterator lit = m_loads.find(pypath);
+		if (lit != m_loads.end() && lit->second == load)
+		{
+			m_loads.erase(lit);
+		}
+		if (pref)
+		{
+			pref->setVersion(++m_loadCounts[pypath]);
+			ProviderSnapshot* snapshot = new ProviderSnapshot(*m_snapshot);
+			snapshot->provsByPath[pypath] = pref;
+			publishSnapshot(snapshot, freed);
+		}
 	}
-	return pypath;
+	deleteSnapshots(freed);
 }
 
 //////////////////////////////////////////////////////////////////////////////
+// Loaded providers are looked up without locking. A provider module that
+// isn't loaded is loaded by the first request for it without m_guard
+// locked, so different modules load concurrently. Other requests for the
+// same module wait for that load.
 PyProviderRef
 PyProviderIFC::getProvider(
 	const ProviderEnvironmentIFCRef& env,
 	const String& providerId,
-	bool unloadableType)
+	bool unloadableType,
+	const PyProviderReg& knownReg)
 {
 	LoggerRef logger = myLogger(env);
 
@@ -661,14 +2163,35 @@ PyProviderIFC::getProvider(
 		Format("PyProviderIFC getProvider called with provider ID %1",
 			providerId));
 
-	MutexLock ml(m_guard);
-	PyProviderReg reg;
 	// See if we already know about this provider id
-	String pypath = getPath4Id(providerId);
+	String pypath;
+	PyProviderRef pref = findProvider(providerId, pypath);
+	if (pref)
+	{
+		OW_LOG_DEBUG(logger,
+			Format("PyProviderIFC getProvider. provider ID %1 already "
+				"loaded. returning", providerId));
+		if (pref->isUnloadableType() && pref->providerChanged())
+		{
+			// Keeps serving until the new version is loaded
+			scheduleReload(providerId, pypath, pref);
+		}
+		if (pref->isUnloadableType() && !unloadableType)
+		{
+			pref->setUnloadableType(false);
+		}
+		return pref;
+	}
+
+	PyProviderReg reg(knownReg);
 	if (pypath.empty())
 	{
-		// No. lets get the instance so we can determine the python module
-		reg = getProviderReg(env, providerId);
+		// No. lets get the registration so we can determine the python
+		// module
+		if (reg.isNull())
+		{
+			reg = getRegIndex()->getReg(providerId);
+		}
 		if (reg.isNull())
 		{
 			OW_THROW(NoSuchProviderException, providerId.c_str());
@@ -682,35 +2205,57 @@ PyProviderIFC::getProvider(
 		}
 	}
 
-	// See if we have the python module loaded
-	ProviderMap::iterator it = m_loadedProvsByPath.find(pypath);
-	if (it != m_loadedProvsByPath.end())
+	PyProviderRef loadedPref;
+	ProviderLoadRef load;
+	bool loading = false;
 	{
-		// Provider is loaded
-		PyProviderRef pref = it->second;
-		if (pref->providerChanged() == false
-			|| pref->isUnloadableType() == false)
+		MutexLock ml(m_guard);
+		// See if we have the python module loaded
+		ProviderMap::const_iterator it = m_snapshot->provsByPath.find(pypath);
+		if (it != m_snapshot->provsByPath.end())
 		{
-			// Provider has changed. force reload
-			OW_LOG_DEBUG(logger,
-				Format("PyProviderIFC getProvider. provider ID %1 already "
-					"loaded. returning", providerId));
-			if (pref->isUnloadableType() && !unloadableType)
+			// Loaded under another provider id
+			loadedPref = it->second;
+			loadedPref->addUse();
+		}
+		else
+		{
+			LoadMap::iterator lit = m_loads.find(pypath);
+			if (lit != m_loads.end())
+			{
+				load = lit->second;
+			}
+			else
 			{
-				pref->setUnloadableType(false);
+				load = new ProviderLoad;
+				m_loads[pypath] = load;
+				loading = true;
 			}
-			// Associate this module to this provider id
-			m_idmap[providerId] = pypath;
-			return pref;
 		}
+	}
 
-		String fname = pref->getFileName();
-		OW_LOG_DEBUG(logger, Format("PyProviderIFC detected change in "
-			"provider %1  File: %2. Reloading...", 
-				pref->getName(), fname));
-		pref->shutDown(env);
-		m_loadedProvsByPath.erase(it);
-		m_idmap.erase(fname);
+	if (loadedPref)
+	{
+		OW_LOG_DEBUG(logger,
+			Format("PyProviderIFC getProvider. provider ID %1 already "
+				"loaded. returning", providerId));
+		if (loadedPref->isUnloadableType() && loadedPref->providerChanged())
+		{
+			scheduleReload(providerId, pypath, loadedPref);
+		}
+		associateProvider(providerId, pypath, loadedPref, unloadableType);
+		return loadedPref;
+	}
+
+	if (!loading)
+	{
+		OW_LOG_DEBUG(logger,
+			Format("PyProviderIFC waiting for provider %1 to be loaded "
+				"from %2", providerId, pypath));
+		pref = load->wait();
+		pref->addUse();
+		associateProvider(providerId, pypath, pref, unloadableType);
+		return pref;
 	}
 
 	// OK. At this point we have the python module path and
@@ -720,9 +2265,33 @@ PyProviderIFC::getProvider(
 		Format("PyProviderIFC loading provider %1 from %2",
 			providerId, pypath));
 
-	PyProviderRef pref = new PyProvider(pypath, env, unloadableType);
-	m_loadedProvsByPath[pypath] = pref;
-	m_idmap[providerId] = pypath;
+	try
+	{
+		pref = loadProvider(env, providerId, pypath, reg, unloadableType);
+	}
+	catch (const NoSuchProviderException& e)
+	{
+		finishLoad(pypath, load, PyProviderRef());
+		load->fail(true, e.getMessage());
+		throw;
+	}
+	catch (const Exception& e)
+	{
+		finishLoad(pypath, load, PyProviderRef());
+		load->fail(false, e.getMessage());
+		throw;
+	}
+	catch (...)
+	{
+		finishLoad(pypath, load, PyProviderRef());
+		load->fail(false, Format("Python provider ifc failed to load "
+			"provider %1 from %2", providerId, pypath));
+		throw;
+	}
+	pref->addUse();
+	finishLoad(pypath, load, pref);
+	load->finish(pref);
+	associateProvider(providerId, pypath, pref, unloadableType);
 
 	OW_LOG_DEBUG(logger,
 		Format("PyProviderIFC loaded provider %1 from file %2",
@@ -731,58 +2300,307 @@ PyProviderIFC::getProvider(
 	return pref;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Has a new version of a changed provider module loaded in the background
+void
+PyProviderIFC::scheduleReload(
+	const String& providerId,
+	const String& pypath,
+	const PyProviderRef& current)
+{
+	PyProviderReloaderRef reloader = m_reloader;
+	if (reloader)
+	{
+		reloader->reload(providerId, pypath, current);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Called by the reloader. Loads a new version of a changed provider
+// module and makes it the version lookups find. Returns the version to
+// shut down once nothing uses it: the replaced one, or the new one if the
+// module was unloaded while it was loaded. That version is shut down
+// without having served a request. Returns null if the module was
+// unloaded before, which retired the loaded version, or if the load
+// failed, the loaded version keeps serving then.
+PyProviderRef
+PyProviderIFC::replaceProvider(
+	const ProviderEnvironmentIFCRef& env,
+	const String& providerId,
+	const String& pypath,
+	const PyProviderRef& current)
+{
+	LoggerRef logger = myLogger(env);
+	OW_LOG_DEBUG(logger, Format("PyProviderIFC detected change in "
+		"provider %1  File: %2. Loading a new version while version %3 "
+		"keeps serving", current->getName(), current->getFileName(),
+		current->getVersion()));
+
+	{
+		MutexLock ml(m_guard);
+		ProviderMap::const_iterator it = m_snapshot->provsByPath.find(pypath);
+		if (it == m_snapshot->provsByPath.end() || it->second != current)
+		{
+			OW_LOG_DEBUG(logger, Format("PyProviderIFC provider %1 was "
+				"unloaded before it was reloaded. Not loading a new "
+				"version", pypath));
+			return PyProviderRef();
+		}
+	}
+
+	UInt64 start = nowUsecs();
+	PyProviderRef pref;
+	try
+	{
+		pref = loadProvider(env, providerId, pypath, PyProviderReg(),
+			current->isUnloadableType());
+		// A new version of a preloaded provider stays exempt from TTL
+		pref->setPreloaded(current->isPreloaded());
+	}
+	catch (const Exception& e)
+	{
+		OW_LOG_ERROR(logger, Format("PyProviderIFC failed to reload "
+			"provider %1 from %2: %3. Version %4 keeps serving", providerId,
+			pypath, e, current->getVersion()));
+		current->keepVersion();
+		return PyProviderRef();
+	}
+	catch (...)
+	{
+		OW_LOG_ERROR(logger, Format("PyProviderIFC failed to reload "
+			"provider %1 from %2. Version %3 keeps serving", providerId,
+			pypath, current->getVersion()));
+		current->keepVersion();
+		return PyProviderRef();
+	}
+
+	bool replaced = false;
+	SnapshotList freed;
+	{
+		MutexLock ml(m_guard);
+		ProviderMap::const_iterator it = m_snapshot->provsByPath.find(pypath);
+		if (it != m_snapshot->provsByPath.end() && it->second == current)
+		{
+			pref->setVersion(++m_loadCounts[pypath]);
+			ProviderSnapshot* snapshot = new ProviderSnapshot(*m_snapshot);
+			snapshot->provsByPath[pypath] = pref;
+			publishSnapshot(snapshot, freed);
+			replaced = true;
+		}
+	}
+	deleteSnapshots(freed);
+
+	if (!replaced)
+	{
+		OW_LOG_DEBUG(logger, Format("PyProviderIFC provider %1 was "
+			"unloaded while it was reloaded. Dropping the new version",
+			pypath));
+		return pref;
+	}
+	OW_LOG_DEBUG(logger, Format("PyProviderIFC switched provider %1 from "
+		"version %2 to version %3 in %4 usecs. The old version has %5 "
+		"users left", pypath, current->getVersion(), pref->getVersion(),
+		nowUsecs() - start, current->getUses()));
+	return current;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Called by the reloader to shut down a version nothing uses any more,
+// and drop its module
+void
+PyProviderIFC::retireProvider(
+	const ProviderEnvironmentIFCRef& env,
+	const PyProviderRef& pref)
+{
+	LoggerRef logger = myLogger(env);
+	try
+	{
+		pref->shutDown(env);
+		OW_LOG_DEBUG(logger, Format("PyProviderIFC shut down version %1 of "
+			"provider %2", pref->getVersion(), pref->getName()));
+	}
+	catch (const Exception& e)
+	{
+		OW_LOG_ERROR(logger, Format("Python provider ifc caught exception "
+			"shutting down version %1 of provider %2: %3",
+			pref->getVersion(), pref->getName(), e));
+	}
+	catch (...)
+	{
+		OW_LOG_ERROR(logger, Format("Python provider ifc caught UNKNOWN "
+			"exception shutting down version %1 of provider %2",
+			pref->getVersion(), pref->getName()));
+	}
+	pref->dropModule();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Hands providers that were taken out of the published snapshot to the
+// reloader, which shuts them down once no lookup can find them and nothing
+// uses them any more.
+void
+PyProviderIFC::retireUnloaded(
+	const ProviderEnvironmentIFCRef& env,
+	const std::vector<PyProviderRef>& unloaded)
+{
+	PyProviderReloaderRef reloader = m_reloader;
+	for (size_t i = 0; i < unloaded.size(); i++)
+	{
+		if (!reloader || !reloader->retire(unloaded[i]))
+		{
+			retireProvider(env, unloaded[i]);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+UInt32
+PyProviderIFC::getLookupEpoch() const
+{
+	return __atomic_load_n(&m_lookupEpoch, __ATOMIC_SEQ_CST);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// True once the snapshots retired up to epoch are freed. A provider that
+// was taken out of the published snapshot by then can't be found by a
+// lookup any more.
+bool
+PyProviderIFC::lookupsDrained(
+	UInt32 epoch)
+{
+	MutexLock ml(m_guard);
+	for (size_t i = 0; i < m_retiredSnapshots.size(); i++)
+	{
+		if (Int32(epoch - m_retiredSnapshots[i].first) >= 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Constructs a provider for the module at pypath with the options of its
+// registration. The provider isn't published.
+PyProviderRef
+PyProviderIFC::loadProvider(
+	const ProviderEnvironmentIFCRef& env,
+	const String& providerId,
+	const String& pypath,
+	PyProviderReg reg,
+	bool unloadableType)
+{
+	if (reg.isNull())
+	{
+		reg = getRegIndex()->getReg(providerId);
+	}
+
+	PyInterpreterState* interp = getInterpreter(env, pypath);
+	PyProviderRef pref(new PyProvider(pypath, env, unloadableType, interp));
+	pref->setLazyInstances(!reg.isNull() && reg.getLazyInstances());
+	if (m_workerPool && !reg.isNull() && reg.getOutOfProcess())
+	{
+		pref->setWorkerPool(m_workerPool);
+	}
+	if (m_asyncLoop && !interp)
+	{
+		pref->setAsyncLoop(m_asyncLoop);
+	}
+	if (m_scheduler)
+	{
+		m_scheduler->setWeight(pypath,
+			(reg.isNull()) ? 1 : reg.getSchedulingWeight());
+		pref->setScheduler(m_scheduler);
+	}
+	if (m_fileWatcher)
+	{
+		pref->setFileWatcher(m_fileWatcher);
+	}
+	return pref;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 void
 PyProviderIFC::doUnloadProviders(
 	const ProviderEnvironmentIFCRef& env)
 {
-	if (m_disabled || m_provTTL < 1)
+	if (m_disabled || (m_provTTL < 1 && !m_memoryBudget))
 	{
 		return;
 	}
 
 	LoggerRef logger = myLogger(env);
+	logResultBatchStats(env);
+	logGILStats(env);
+	logSchedulerStats(env);
+	logProviderMemory(env);
 
-	MutexLock ml(m_guard);
-	DateTime dt;
-	dt.setToCurrent();
-	ProviderMap::iterator it = m_loadedProvsByPath.begin();
-	while (it != m_loadedProvsByPath.end())
-	{
-		PyProviderRef pref = it->second;
-		// Only do an unload here if it is not an 
-		// indication/indicationexport/polled provider	
-		if (pref->isUnloadableType())
-		{
-			String pname = pref->getName();
-			DateTime provDt = pref->getLastAccessTime();
-			provDt.addMinutes(m_provTTL);
-			if (provDt < dt)
+	if (m_memoryBudget)
+	{
+		// Idle providers stay loaded while there is room for them
+		evictProviders(env);
+		return;
+	}
+
+	SnapshotList freed;
+	std::vector<PyProviderRef> unloaded;
+	{
+		MutexLock ml(m_guard);
+		DateTime dt;
+		dt.setToCurrent();
+		ProviderSnapshot* snapshot = 0;
+		ProviderMap::const_iterator it = m_snapshot->provsByPath.begin();
+		while (it != m_snapshot->provsByPath.end())
+		{
+			PyProviderRef pref = it->second;
+			// Only do an unload here if it is not an 
+			// indication/indicationexport/polled provider	
+			// or a preloaded one
+			if (pref->isUnloadableType() && !pref->isPreloaded())
 			{
-				try
+				String pname = pref->getName();
+				DateTime provDt = pref->getLastAccessTime();
+				provDt.addMinutes(m_provTTL);
+				if (provDt < dt)
 				{
-					if (pref->canShutDown(env))
+					try
 					{
-						OW_LOG_DEBUG(logger, Format("PyProviderIFC unloading "
-							"provider %1 because it has been inactive for "
-							"more than %2 minutes", pname, m_provTTL));
-						pref->shutDown(env);
-						String fname = it->second->getFileName();
-						m_idmap.erase(fname);
-						m_loadedProvsByPath.erase(it++);
-						OW_LOG_DEBUG(logger, Format("PyProviderIFC. provider "
-							"%1 unloaded", pname));
-						continue;
+						if (pref->getUses() == 0 && pref->canShutDown(env))
+						{
+							OW_LOG_DEBUG(logger, Format("PyProviderIFC "
+								"unloading provider %1 because it has been "
+								"inactive for more than %2 minutes", pname,
+								m_provTTL));
+							unloaded.push_back(pref);
+							if (!snapshot)
+							{
+								snapshot = new ProviderSnapshot(*m_snapshot);
+							}
+							String fname = pref->getFileName();
+							snapshot->idmap.erase(fname);
+							snapshot->provsByPath.erase(it->first);
+						}
+					}
+					catch(...)
+					{
+						// Ignore?
 					}
-				}
-				catch(...)
-				{
-					// Ignore?
 				}
 			}
+			++it;
+		}
+		if (snapshot)
+		{
+			publishSnapshot(snapshot, freed);
+		}
+		else
+		{
+			reclaimSnapshots(freed);
 		}
-		++it;
 	}
+	deleteSnapshots(freed);
+	// Lookups may still find the unloaded providers in an older snapshot
+	retireUnloaded(env, unloaded);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -794,34 +2612,73 @@ PyProviderIFC::doShuttingDown(
 	OW_LOG_DEBUG(logger,
 		"PyProviderIFC::doShuttingDown called. Shutting down providers...");
 
-	MutexLock ml(m_guard);
-
-	ProviderMap::iterator it = m_loadedProvsByPath.begin();
-	while (it != m_loadedProvsByPath.end())
+	if (m_pythonInitialized)
 	{
-		PyProviderRef pref = it->second;
-		try
+		logResultBatchStats(env);
+		logGILStats(env);
+		logSchedulerStats(env);
+		logProviderMemory(env);
+		if (Py::GILStats::isEnabled() && !m_gilStatsFile.empty()
+			&& !Py::GILStats::dump(m_gilStatsFile))
 		{
-			pref->shutDown(env);
+			OW_LOG_ERROR(logger, Format("Unable to write Python provider "
+				"GIL stats to %1", m_gilStatsFile));
 		}
-		catch(Py::Exception& e)
-		{
-			OW_LOG_ERROR(logger, Format("Python provider ifc caught "
-				"exception shutting down provider %1", pref->getName()));
-			String tb = LogPyException(e, __FILE__, __LINE__, logger);
-			e.clear();
-		}
-		catch(...)
+	}
+
+	if (m_workerPool)
+	{
+		m_workerPool->shutdown();
+	}
+
+	if (m_asyncLoop)
+	{
+		m_asyncLoop->shutdown();
+	}
+
+	if (m_fileWatcher)
+	{
+		m_fileWatcher->shutdown();
+	}
+
+	if (m_reloader)
+	{
+		// Also breaks the reference cycle through the environment
+		m_reloader->stop();
+		m_reloader = 0;
+	}
+
+	SnapshotList freed;
+	{
+		MutexLock ml(m_guard);
+
+		ProviderMap::const_iterator it = m_snapshot->provsByPath.begin();
+		while (it != m_snapshot->provsByPath.end())
 		{
-			OW_LOG_ERROR(logger, Format("Python provider ifc caught "
-				"UNKNOWN exception shutting down provider %1",
-				pref->getName()));
-			// Ignore?
+			PyProviderRef pref = it->second;
+			try
+			{
+				pref->shutDown(env);
+			}
+			catch(Py::Exception& e)
+			{
+				OW_LOG_ERROR(logger, Format("Python provider ifc caught "
+					"exception shutting down provider %1", pref->getName()));
+				String tb = LogPyException(e, __FILE__, __LINE__, logger);
+				e.clear();
+			}
+			catch(...)
+			{
+				OW_LOG_ERROR(logger, Format("Python provider ifc caught "
+					"UNKNOWN exception shutting down provider %1",
+					pref->getName()));
+				// Ignore?
+			}
+			it++;
 		}
-		it++;
+		publishSnapshot(new ProviderSnapshot, freed);
 	}
-	m_loadedProvsByPath.clear();
-	m_idmap.clear();
+	deleteSnapshots(freed);
 
 	// Note: Python gets shutdown in the PyProviderIFC destructor
 }
@@ -22,6 +22,7 @@
 #include "OW_PyProviderModule.hpp"
 #include "OW_PyProvider.hpp"
 #include "OW_PyProvIFCCommon.hpp"
+#include "OW_PyProviderRegIndex.hpp"
 #include <openwbem/OW_config.h>
 #include <openwbem/OW_ProviderIFCBaseIFC.hpp>
 #include <openwbem/OW_Map.hpp>
@@ -29,11 +30,19 @@
 //#include <openwbem/OW_CppProviderBaseIFC.hpp>
 #include <openwbem/OW_MutexLock.hpp>
 
+#include <utility>
+#include <vector>
+
 using namespace OW_NAMESPACE;
 
 namespace PythonProvIFC
 {
 
+class PyPreloadThread;
+class PyRegistrationWatcher;
+class PyProviderReloader;
+typedef IntrusiveReference<PyProviderReloader> PyProviderReloaderRef;
+
 class PyProviderIFC : public ProviderIFCBaseIFC
 {
 public:
@@ -103,26 +112,133 @@ private:
 
 	typedef Map<String, PyProviderRef> ProviderMap;
 	typedef Map<String, String> ProvIdMap;
+	// Subinterpreters by provider module path or group number, holding
+	// the thread state each was created with
+	typedef Map<String, PyThreadState*> InterpMap;
+
+	// The loaded providers and the provider registrations. A published
+	// snapshot is never changed, so getProvider reads it without locking.
+	// Changes publish a new one with m_guard locked.
+	struct ProviderSnapshot
+	{
+		ProviderSnapshot()
+			: provsByPath()
+			, idmap()
+			, regs(new PyProviderRegIndex)
+		{
+		}
+
+		ProviderMap provsByPath;
+		ProvIdMap idmap;
+		PyProviderRegIndexRef regs;		// Never null
+	};
+	typedef std::vector<ProviderSnapshot*> SnapshotList;
+	// Unpublished snapshots with the lookup epoch they were unpublished in
+	typedef std::vector<std::pair<UInt32, ProviderSnapshot*> > RetiredList;
+
+	class ProviderLoad;
+	typedef IntrusiveReference<ProviderLoad> ProviderLoadRef;
+	// Provider modules being loaded, by module path
+	typedef Map<String, ProviderLoadRef> LoadMap;
 
 	void initPython(const ProviderEnvironmentIFCRef& env);
 	void getTTLOption(const ProviderEnvironmentIFCRef& env);
-
-	String getPath4Id(const String& provid);
-
+	void getResultBatchOption(const ProviderEnvironmentIFCRef& env);
+	void logResultBatchStats(const ProviderEnvironmentIFCRef& env);
+	void getInterpreterOption(const ProviderEnvironmentIFCRef& env);
+	void getGILStatsOption(const ProviderEnvironmentIFCRef& env);
+	void logGILStats(const ProviderEnvironmentIFCRef& env);
+	void getSchedulerOptions(const ProviderEnvironmentIFCRef& env);
+	void logSchedulerStats(const ProviderEnvironmentIFCRef& env);
+	void getPrefetchOption(const ProviderEnvironmentIFCRef& env);
+	PyInterpreterState* getInterpreter(const ProviderEnvironmentIFCRef& env,
+		const String& pypath);
+	void endInterpreters();
+	void startWorkerPool(const ProviderEnvironmentIFCRef& env);
+	void startAsyncLoop(const ProviderEnvironmentIFCRef& env);
+	void startFileWatcher(const ProviderEnvironmentIFCRef& env);
+	void getMemoryBudgetOption(const ProviderEnvironmentIFCRef& env);
+	void evictProviders(const ProviderEnvironmentIFCRef& env);
+	void logProviderMemory(const ProviderEnvironmentIFCRef& env);
+	void getPreloadOption(const ProviderEnvironmentIFCRef& env);
+	void getClassCacheOption(const ProviderEnvironmentIFCRef& env);
+	void preloadProviders(const ProviderEnvironmentIFCRef& env,
+		const std::vector<PyProviderReg>& regs);
+	void preloadProvider(const ProviderEnvironmentIFCRef& env,
+		const PyProviderReg& reg);
+
+	PyProviderRegIndexRef loadRegistrations(
+		const ProviderEnvironmentIFCRef& env);
+	PyProviderRegIndexRef getRegIndex();
+	void changeRegistration(const ProviderEnvironmentIFCRef& env,
+		const String& providerId, const PyProviderReg& reg);
+
+	PyProviderRef findProvider(const String& providerId, String& pypath);
+	UInt32 beginLookup();
+	void endLookup(UInt32 epoch);
+	void publishSnapshot(ProviderSnapshot* snapshot, SnapshotList& freed);
+	void reclaimSnapshots(SnapshotList& freed);
+	void deleteSnapshots(SnapshotList& snapshots);
+	void associateProvider(const String& providerId, const String& pypath,
+		const PyProviderRef& pref, bool unloadableType);
+	void finishLoad(const String& pypath, const ProviderLoadRef& load,
+		const PyProviderRef& pref);
+	PyProviderRef loadProvider(const ProviderEnvironmentIFCRef& env,
+		const String& providerId, const String& pypath, PyProviderReg reg,
+		bool unloadableType);
+	void scheduleReload(const String& providerId, const String& pypath,
+		const PyProviderRef& current);
+	PyProviderRef replaceProvider(const ProviderEnvironmentIFCRef& env,
+		const String& providerId, const String& pypath,
+		const PyProviderRef& current);
+	void retireProvider(const ProviderEnvironmentIFCRef& env,
+		const PyProviderRef& pref);
+	void retireUnloaded(const ProviderEnvironmentIFCRef& env,
+		const std::vector<PyProviderRef>& unloaded);
+	UInt32 getLookupEpoch() const;
+	bool lookupsDrained(UInt32 epoch);
+
+	// The caller gets a use of the provider, see PyProvider::addUse. The
+	// proxy it is handed to releases it.
 	PyProviderRef getProvider(
 		const ProviderEnvironmentIFCRef& env,
 		const String& providerId,
-		bool unloadableType=true);
+		bool unloadableType=true,
+		const PyProviderReg& knownReg=PyProviderReg());
 
 	PyProviderModule* m_pyprovMod;
 	Py::Module m_pywbemMod;
 	bool m_disabled;
-	ProviderMap m_loadedProvsByPath;
-	ProvIdMap m_idmap;
+	// Lookups count themselves in m_lookups by the parity of the epoch
+	// they began in, see reclaimSnapshots. The members marked atomic are
+	// only accessed through the __atomic builtins outside of m_guard.
+	ProviderSnapshot* m_snapshot;		// Atomic. Changed with m_guard locked
+	RetiredList m_retiredSnapshots;		// Freed when no lookup can use them
+	UInt32 m_retiredCount;				// Atomic. Size of m_retiredSnapshots
+	UInt32 m_lookupEpoch;				// Atomic. Advanced with m_guard locked
+	UInt32 m_lookups[2];				// Atomic. Running lookups by epoch
+	LoadMap m_loads;
 	PyThreadState* m_mainPyThreadState;
 	Int32 m_provTTL;					// Provider TTL in minutes
-	Mutex m_guard;
+	UInt64 m_memoryBudget;				// Bytes. 0 unloads by TTL instead
+	Map<String, UInt32> m_loadCounts;	// Loads by module path. m_guard
+	UInt32 m_preloadThreads;			// 0 loads on first request only
+	Mutex m_guard;						// Serializes snapshot changes
+	Mutex m_interpGuard;
 	bool m_pythonInitialized;
+	Py::Module m_pycimmbMod;
+	Int32 m_interpGroups;				// 0 off, -1 per module, else groups
+	InterpMap m_interps;
+	PyWorkerPoolRef m_workerPool;		// Null unless worker processes are on
+	String m_gilStatsFile;				// Written at shutdown if not empty
+	PyProviderSchedulerRef m_scheduler;	// Null unless requests are limited
+	PyAsyncLoopRef m_asyncLoop;			// Null unless async_module is set
+	PyProviderFileWatcherRef m_fileWatcher;	// Null if files are polled
+	PyProviderReloaderRef m_reloader;	// Null once shut down
+
+	friend class PyPreloadThread;
+	friend class PyProviderReloader;
+	friend class PyRegistrationWatcher;
 };
 
 } // end namespace PythonProvIFC
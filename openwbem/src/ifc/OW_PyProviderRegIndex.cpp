@@ -0,0 +1,162 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#include "OW_PyProviderRegIndex.hpp"
+
+namespace PythonProvIFC
+{
+
+namespace
+{
+
+// Returned for lookups that find nothing
+const PyProviderRegIndex::RegList g_noRegs;
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderRegIndex::PyProviderRegIndex()
+	: IntrusiveCountableBase()
+	, m_byId()
+	, m_regs()
+	, m_byClass()
+	, m_byType()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderRegIndex::PyProviderRegIndex(
+	const CIMInstanceArray& regs)
+	: IntrusiveCountableBase()
+	, m_byId()
+	, m_regs()
+	, m_byClass()
+	, m_byType()
+{
+	for (size_t i = 0; i < regs.size(); i++)
+	{
+		PyProviderReg reg(regs[i]);
+		m_byId[reg.getInstanceId()] = reg;
+	}
+	build();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderRegIndex::PyProviderRegIndex(
+	const RegMap& byId)
+	: IntrusiveCountableBase()
+	, m_byId(byId)
+	, m_regs()
+	, m_byClass()
+	, m_byType()
+{
+	build();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Fills the lookups from m_byId
+void
+PyProviderRegIndex::build()
+{
+	m_regs.reserve(m_byId.size());
+	for (RegMap::const_iterator it = m_byId.begin(); it != m_byId.end();
+		++it)
+	{
+		const PyProviderReg& reg = it->second;
+		m_regs.push_back(reg);
+
+		const StringArray& namespaces = reg.getNameSpaceNames();
+		for (size_t i = 0; i < namespaces.size(); i++)
+		{
+			m_byClass[classKey(namespaces[i], reg.getClassName())].push_back(
+				reg);
+		}
+
+		const UInt16Array& providerTypes = reg.getProviderTypes();
+		for (size_t i = 0; i < providerTypes.size(); i++)
+		{
+			// A type listed twice is indexed once
+			RegList& regs = m_byType[providerTypes[i]];
+			if (regs.empty() || regs.back().getInstanceId() != it->first)
+			{
+				regs.push_back(reg);
+			}
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+String
+PyProviderRegIndex::classKey(
+	const String& ns,
+	const String& className)
+{
+	String key = ns + ":" + className;
+	key.toLowerCase();
+	return key;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderReg
+PyProviderRegIndex::getReg(
+	const String& providerId) const
+{
+	RegMap::const_iterator it = m_byId.find(providerId);
+	return (it != m_byId.end()) ? it->second : PyProviderReg();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+const PyProviderRegIndex::RegList&
+PyProviderRegIndex::getRegsForClass(
+	const String& ns,
+	const String& className) const
+{
+	ClassRegMap::const_iterator it = m_byClass.find(classKey(ns, className));
+	return (it != m_byClass.end()) ? it->second : g_noRegs;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+const PyProviderRegIndex::RegList&
+PyProviderRegIndex::getRegsOfType(
+	UInt16 provType) const
+{
+	TypeRegMap::const_iterator it = m_byType.find(provType);
+	return (it != m_byType.end()) ? it->second : g_noRegs;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderRegIndexRef
+PyProviderRegIndex::withReg(
+	const PyProviderReg& reg) const
+{
+	RegMap byId(m_byId);
+	byId[reg.getInstanceId()] = reg;
+	return PyProviderRegIndexRef(new PyProviderRegIndex(byId));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderRegIndexRef
+PyProviderRegIndex::withoutReg(
+	const String& providerId) const
+{
+	RegMap byId(m_byId);
+	byId.erase(providerId);
+	return PyProviderRegIndexRef(new PyProviderRegIndex(byId));
+}
+
+}	// End of namespace PythonProvIFC
@@ -0,0 +1,85 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifndef OW_PYPROVIDERREGINDEX_HPP_GUARD
+#define OW_PYPROVIDERREGINDEX_HPP_GUARD
+
+#include "OW_PyProvIFCCommon.hpp"
+#include <openwbem/OW_config.h>
+#include <openwbem/OW_String.hpp>
+#include <openwbem/OW_Map.hpp>
+#include <openwbem/OW_IntrusiveCountableBase.hpp>
+#include <openwbem/OW_IntrusiveReference.hpp>
+
+#include <vector>
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+class PyProviderRegIndex;
+typedef IntrusiveReference<PyProviderRegIndex> PyProviderRegIndexRef;
+
+//////////////////////////////////////////////////////////////////////////////
+// The instances of OpenWBEM_PyProviderRegistration, parsed and looked up
+// by provider id, by instrumented class and namespace, and by provider
+// type. An index isn't changed once it is built, so it is read without
+// locking. A changed registration makes a new index.
+class PyProviderRegIndex : public IntrusiveCountableBase
+{
+public:
+	typedef std::vector<PyProviderReg> RegList;
+
+	PyProviderRegIndex();
+	PyProviderRegIndex(const CIMInstanceArray& regs);
+
+	// Returns a null registration if the provider id isn't registered
+	PyProviderReg getReg(const String& providerId) const;
+	// All registrations, ordered by provider id
+	const RegList& getRegs() const { return m_regs; }
+	// Class and namespace names are compared ignoring case
+	const RegList& getRegsForClass(const String& ns,
+		const String& className) const;
+	const RegList& getRegsOfType(UInt16 provType) const;
+
+	// Return a new index with reg added or replacing the registration with
+	// its provider id, and without the registration of providerId
+	PyProviderRegIndexRef withReg(const PyProviderReg& reg) const;
+	PyProviderRegIndexRef withoutReg(const String& providerId) const;
+
+private:
+	PyProviderRegIndex(const PyProviderRegIndex&);
+	PyProviderRegIndex& operator=(const PyProviderRegIndex&);
+
+	typedef Map<String, PyProviderReg> RegMap;
+	typedef Map<String, RegList> ClassRegMap;
+	typedef Map<UInt16, RegList> TypeRegMap;
+
+	explicit PyProviderRegIndex(const RegMap& byId);
+	void build();
+	static String classKey(const String& ns, const String& className);
+
+	RegMap m_byId;
+	RegList m_regs;
+	ClassRegMap m_byClass;				// By lower case namespace:class
+	TypeRegMap m_byType;
+};
+
+}	// End of namespace PythonProvIFC
+
+#endif	// OW_PYPROVIDERREGINDEX_HPP_GUARD
@@ -0,0 +1,270 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#include "OW_PyProviderScheduler.hpp"
+#include <openwbem/OW_NonRecursiveMutexLock.hpp>
+
+extern "C"
+{
+#include <time.h>
+}
+
+namespace PythonProvIFC
+{
+
+namespace
+{
+
+// Virtual cost of a request. An enumeration counts as several short
+// requests.
+const double SHORT_OP_COST = 1.0;
+const double BULK_OP_COST = 4.0;
+
+// Requests the current thread has been admitted to
+__thread int t_admitted = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+UInt64
+nowUsecs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return UInt64(ts.tv_sec) * 1000000 + UInt64(ts.tv_nsec) / 1000;
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderScheduler::ProviderQueue::ProviderQueue()
+	: lastFinish(0)
+	, shortOps()
+	, bulkOps()
+	, stats()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderScheduler::PyProviderScheduler(
+	UInt32 maxInFlight,
+	UInt32 maxActive)
+	: IntrusiveCountableBase()
+	, m_maxInFlight(maxInFlight)
+	, m_maxActive(maxActive)
+	, m_active(0)
+	, m_virtualTime(0)
+	, m_queues()
+	, m_guard()
+	, m_grantCond()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderScheduler::~PyProviderScheduler()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderScheduler::setWeight(
+	const String& provider,
+	UInt32 weight)
+{
+	NonRecursiveMutexLock l(m_guard);
+	m_queues[provider].stats.weight = (weight) ? weight : 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderScheduler::admit(
+	const String& provider,
+	EOpClass opClass)
+{
+	NonRecursiveMutexLock l(m_guard);
+	ProviderQueue& queue = m_queues[provider];
+	PyProviderQueueStats& stats = queue.stats;
+	double cost = (opClass == E_SHORT_OP) ? SHORT_OP_COST : BULK_OP_COST;
+
+	Waiter waiter;
+	waiter.startTag = (queue.lastFinish > m_virtualTime)
+		? queue.lastFinish : m_virtualTime;
+	waiter.finishTag = waiter.startTag + cost / stats.weight;
+	waiter.queuedAt = 0;
+	waiter.granted = false;
+	queue.lastFinish = waiter.finishTag;
+	stats.admitted++;
+
+	bool idle = queue.shortOps.empty() && queue.bulkOps.empty()
+		&& (m_maxInFlight == 0 || stats.inFlight < m_maxInFlight)
+		&& (m_maxActive == 0 || m_active < m_maxActive);
+	if (idle)
+	{
+		// Nothing to be fair to
+		stats.inFlight++;
+		m_active++;
+		if (waiter.startTag > m_virtualTime)
+		{
+			m_virtualTime = waiter.startTag;
+		}
+		return;
+	}
+
+	waiter.queuedAt = nowUsecs();
+	if (opClass == E_SHORT_OP)
+	{
+		queue.shortOps.push_back(&waiter);
+	}
+	else
+	{
+		queue.bulkOps.push_back(&waiter);
+	}
+	UInt32 depth = queue.shortOps.size() + queue.bulkOps.size();
+	stats.queued++;
+	if (depth > stats.maxQueueDepth)
+	{
+		stats.maxQueueDepth = depth;
+	}
+
+	dispatch();
+	while (!waiter.granted)
+	{
+		m_grantCond.wait(l);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyProviderScheduler::done(
+	const String& provider)
+{
+	NonRecursiveMutexLock l(m_guard);
+	ProviderQueue& queue = m_queues[provider];
+	if (queue.stats.inFlight)
+	{
+		queue.stats.inFlight--;
+	}
+	if (m_active)
+	{
+		m_active--;
+	}
+	dispatch();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Lets waiting requests in while there are free slots. Must be called
+// with m_guard locked.
+void
+PyProviderScheduler::dispatch()
+{
+	bool granted = false;
+	while (m_maxActive == 0 || m_active < m_maxActive)
+	{
+		ProviderQueue* best = 0;
+		std::deque<Waiter*>* bestOps = 0;
+		for (QueueMap::iterator it = m_queues.begin(); it != m_queues.end();
+			++it)
+		{
+			ProviderQueue& queue = it->second;
+			if (m_maxInFlight && queue.stats.inFlight >= m_maxInFlight)
+			{
+				continue;
+			}
+			std::deque<Waiter*>* ops = (!queue.shortOps.empty())
+				? &queue.shortOps : &queue.bulkOps;
+			if (ops->empty())
+			{
+				continue;
+			}
+			if (!best || ops->front()->finishTag
+				< bestOps->front()->finishTag)
+			{
+				best = &queue;
+				bestOps = ops;
+			}
+		}
+		if (!best)
+		{
+			break;
+		}
+
+		Waiter* waiter = bestOps->front();
+		bestOps->pop_front();
+		waiter->granted = true;
+		best->stats.inFlight++;
+		m_active++;
+		if (waiter->startTag > m_virtualTime)
+		{
+			m_virtualTime = waiter->startTag;
+		}
+		UInt64 wait = nowUsecs() - waiter->queuedAt;
+		best->stats.totalWaitUsecs += wait;
+		if (wait > best->stats.maxWaitUsecs)
+		{
+			best->stats.maxWaitUsecs = wait;
+		}
+		granted = true;
+	}
+	if (granted)
+	{
+		m_grantCond.notifyAll();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyProviderQueueStatsArray
+PyProviderScheduler::getStats() const
+{
+	NonRecursiveMutexLock l(m_guard);
+	PyProviderQueueStatsArray rv;
+	for (QueueMap::const_iterator it = m_queues.begin();
+		it != m_queues.end(); ++it)
+	{
+		PyProviderQueueStats stats = it->second.stats;
+		stats.provider = it->first;
+		stats.queueDepth = it->second.shortOps.size()
+			+ it->second.bulkOps.size();
+		rv.append(stats);
+	}
+	return rv;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyScheduleTicket::PyScheduleTicket(
+	const PyProviderSchedulerRef& scheduler,
+	const String& provider,
+	PyProviderScheduler::EOpClass opClass)
+	: m_scheduler()
+	, m_provider(provider)
+{
+	if (scheduler && t_admitted == 0)
+	{
+		scheduler->admit(provider, opClass);
+		m_scheduler = scheduler;
+	}
+	t_admitted++;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyScheduleTicket::~PyScheduleTicket()
+{
+	t_admitted--;
+	if (m_scheduler)
+	{
+		m_scheduler->done(m_provider);
+	}
+}
+
+}	// End of namespace PythonProvIFC
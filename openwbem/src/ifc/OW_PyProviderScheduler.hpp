@@ -0,0 +1,154 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifndef OW_PYPROVIDERSCHEDULER_HPP_GUARD
+#define OW_PYPROVIDERSCHEDULER_HPP_GUARD
+
+#include <openwbem/OW_config.h>
+#include <openwbem/OW_String.hpp>
+#include <openwbem/OW_Array.hpp>
+#include <openwbem/OW_NonRecursiveMutex.hpp>
+#include <openwbem/OW_Condition.hpp>
+#include <openwbem/OW_IntrusiveCountableBase.hpp>
+#include <openwbem/OW_IntrusiveReference.hpp>
+
+#include <deque>
+#include <map>
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+//////////////////////////////////////////////////////////////////////////////
+struct PyProviderQueueStats
+{
+	PyProviderQueueStats()
+		: provider()
+		, weight(1)
+		, inFlight(0)
+		, queueDepth(0)
+		, maxQueueDepth(0)
+		, admitted(0)
+		, queued(0)
+		, totalWaitUsecs(0)
+		, maxWaitUsecs(0)
+	{
+	}
+
+	String provider;
+	UInt32 weight;
+	UInt32 inFlight;			// Requests running in the provider now
+	UInt32 queueDepth;			// Requests waiting now
+	UInt32 maxQueueDepth;
+	UInt64 admitted;			// Requests let in so far
+	UInt64 queued;				// Of those, requests that had to wait
+	UInt64 totalWaitUsecs;
+	UInt64 maxWaitUsecs;
+};
+typedef Array<PyProviderQueueStats> PyProviderQueueStatsArray;
+
+//////////////////////////////////////////////////////////////////////////////
+// Admission control for python provider requests. A provider runs at most
+// maxInFlight requests at a time and all providers together at most
+// maxActive, 0 meaning no limit. Requests over a limit wait. When a slot
+// frees up, waiting requests are let in by weighted fair queueing across
+// providers: every request gets a virtual finish time of its provider's
+// previous one plus its cost divided by the provider's weight, and the
+// earliest goes first. Short requests (getInstance, invokeMethod and the
+// like) cost less than enumerations and go ahead of the enumerations
+// waiting for the same provider.
+// A request made by a thread that is already running one (an upcall
+// that ends up in a python provider) is let in right away, so upcalls
+// can't deadlock on the limits.
+class PyProviderScheduler : public IntrusiveCountableBase
+{
+public:
+	enum EOpClass
+	{
+		E_SHORT_OP,
+		E_BULK_OP
+	};
+
+	PyProviderScheduler(UInt32 maxInFlight, UInt32 maxActive);
+	~PyProviderScheduler();
+
+	void setWeight(const String& provider, UInt32 weight);
+
+	// admit blocks until the request may run. Every admit must be
+	// followed by a call to done.
+	void admit(const String& provider, EOpClass opClass);
+	void done(const String& provider);
+
+	PyProviderQueueStatsArray getStats() const;
+
+private:
+	PyProviderScheduler(const PyProviderScheduler&);
+	PyProviderScheduler& operator=(const PyProviderScheduler&);
+
+	struct Waiter
+	{
+		double startTag;
+		double finishTag;
+		UInt64 queuedAt;
+		bool granted;
+	};
+
+	struct ProviderQueue
+	{
+		ProviderQueue();
+
+		double lastFinish;
+		std::deque<Waiter*> shortOps;
+		std::deque<Waiter*> bulkOps;
+		PyProviderQueueStats stats;
+	};
+	typedef std::map<String, ProviderQueue> QueueMap;
+
+	void dispatch();
+
+	UInt32 m_maxInFlight;
+	UInt32 m_maxActive;
+	UInt32 m_active;
+	double m_virtualTime;
+	QueueMap m_queues;
+	mutable NonRecursiveMutex m_guard;
+	Condition m_grantCond;
+};
+typedef IntrusiveReference<PyProviderScheduler> PyProviderSchedulerRef;
+
+//////////////////////////////////////////////////////////////////////////////
+// Admits a request to a provider for as long as it is in scope. Does
+// nothing if the scheduler is null or the thread already runs a request.
+class PyScheduleTicket
+{
+public:
+	PyScheduleTicket(const PyProviderSchedulerRef& scheduler,
+		const String& provider, PyProviderScheduler::EOpClass opClass);
+	~PyScheduleTicket();
+
+private:
+	PyScheduleTicket(const PyScheduleTicket&);
+	PyScheduleTicket& operator=(const PyScheduleTicket&);
+
+	PyProviderSchedulerRef m_scheduler;
+	String m_provider;
+};
+
+}	// End of namespace PythonProvIFC
+
+#endif	// OW_PYPROVIDERSCHEDULER_HPP_GUARD
@@ -34,6 +34,12 @@ PyProxyInstanceProvider::PyProxyInstanceProvider(PyProviderRef pProv)
 {
 }
 
+//////////////////////////////////////////////////////////////////////////////
+PyProxyInstanceProvider::~PyProxyInstanceProvider()
+{
+	m_pProv->releaseUse();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 void
 PyProxyInstanceProvider::enumInstanceNames(
@@ -141,6 +147,12 @@ PyProxyAssociatorProvider::PyProxyAssociatorProvider(PyProviderRef pProv)
 {
 }
 
+//////////////////////////////////////////////////////////////////////////////
+PyProxyAssociatorProvider::~PyProxyAssociatorProvider()
+{
+	m_pProv->releaseUse();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 void
 PyProxyAssociatorProvider::associators(
@@ -228,6 +240,12 @@ PyProxyMethodProvider::PyProxyMethodProvider(PyProviderRef pProv)
 {
 }
 
+//////////////////////////////////////////////////////////////////////////////
+PyProxyMethodProvider::~PyProxyMethodProvider()
+{
+	m_pProv->releaseUse();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 CIMValue
 PyProxyMethodProvider::invokeMethod(
@@ -260,6 +278,12 @@ PyProxyIndicationProvider::PyProxyIndicationProvider(
 {
 }
 
+//////////////////////////////////////////////////////////////////////////////
+PyProxyIndicationProvider::~PyProxyIndicationProvider()
+{
+	m_pProv->releaseUse();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 void
 PyProxyIndicationProvider::activateFilter(
@@ -344,6 +368,12 @@ PyProxyIndicationExportProvider::PyProxyIndicationExportProvider(
 {
 }
 
+//////////////////////////////////////////////////////////////////////////////
+PyProxyIndicationExportProvider::~PyProxyIndicationExportProvider()
+{
+	m_pProv->releaseUse();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 StringArray
 PyProxyIndicationExportProvider::getHandlerClassNames()
@@ -400,6 +430,12 @@ PyProxyPolledProvider::PyProxyPolledProvider(PyProviderRef pProv)
 {
 }
 
+//////////////////////////////////////////////////////////////////////////////
+PyProxyPolledProvider::~PyProxyPolledProvider()
+{
+	m_pProv->releaseUse();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 Int32
 PyProxyPolledProvider::poll(const ProviderEnvironmentIFCRef& env)
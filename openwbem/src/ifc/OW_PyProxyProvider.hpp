@@ -31,10 +31,14 @@ using namespace OW_NAMESPACE;
 namespace PythonProvIFC
 {
 
+// The proxies take over the use of the provider getProvider took for them
+// and release it when they are destroyed.
+
 class PyProxyInstanceProvider : public InstanceProviderIFC
 {
 public:
 	PyProxyInstanceProvider(PyProviderRef pProv);
+	virtual ~PyProxyInstanceProvider();
 	virtual void enumInstanceNames(
 		const ProviderEnvironmentIFCRef& env,
 		const String& ns,
@@ -90,6 +94,7 @@ class PyProxyAssociatorProvider : public AssociatorProviderIFC
 {
 public:
 	PyProxyAssociatorProvider(PyProviderRef pProv);
+	virtual ~PyProxyAssociatorProvider();
 
 	virtual void associators(
 		const ProviderEnvironmentIFCRef& env,
@@ -142,6 +147,7 @@ class PyProxyMethodProvider : public MethodProviderIFC
 {
 public:
 	PyProxyMethodProvider(PyProviderRef pProv);
+	virtual ~PyProxyMethodProvider();
 	virtual CIMValue invokeMethod(
 		const ProviderEnvironmentIFCRef& env,
 		const String& ns,
@@ -162,6 +168,7 @@ class PyProxyIndicationProvider : public IndicationProviderIFC
 {
 public:
 	PyProxyIndicationProvider(PyProviderRef pProv);
+	virtual ~PyProxyIndicationProvider();
 	virtual void activateFilter(
 		const ProviderEnvironmentIFCRef& env,
 		const WQLSelectStatement& filter,
@@ -207,6 +214,7 @@ class PyProxyIndicationExportProvider : public IndicationExportProviderIFC
 {
 public:
 	PyProxyIndicationExportProvider(PyProviderRef pProv);
+	virtual ~PyProxyIndicationExportProvider();
 	virtual StringArray getHandlerClassNames();
 	virtual void exportIndication(const ProviderEnvironmentIFCRef& env, 
 		const String& ns, const CIMInstance& indHandlerInst,
@@ -226,6 +234,7 @@ class PyProxyPolledProvider : public PolledProviderIFC
 {
 public:
 	PyProxyPolledProvider(PyProviderRef pProv);
+	virtual ~PyProxyPolledProvider();
 	virtual Int32 poll(const ProviderEnvironmentIFCRef& env);
 	virtual Int32 getInitialPollingInterval(
 		const ProviderEnvironmentIFCRef& env);
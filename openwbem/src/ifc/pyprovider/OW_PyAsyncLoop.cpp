@@ -0,0 +1,464 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#include "OW_PyAsyncLoop.hpp"
+#include "OW_PyProviderModule.hpp"
+#include "PyCxxExtensions.hpp"
+#include <openwbem/OW_CIMException.hpp>
+#include <openwbem/OW_NonRecursiveMutexLock.hpp>
+#include <openwbem/OW_Condition.hpp>
+#include <openwbem/OW_Thread.hpp>
+#include <openwbem/OW_Format.hpp>
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+namespace
+{
+
+// Run in a namespace holding the module as 'mod' and the loop as 'loop'.
+// submit runs an awaitable on the loop and calls done(result, None) or
+// done(None, sys.exc_info()) on the loop thread when it finishes.
+// coroutine is the pycimmb.coroutine decorator. It keeps the code of the
+// generator functions it marks in _codes.
+const char* const ASYNC_HELPER_SRC =
+	"import sys\n"
+	"import inspect\n"
+	"_codes = set()\n"
+	"def coroutine(func):\n"
+	"    if not inspect.isgeneratorfunction(func):\n"
+	"        raise TypeError('pycimmb.coroutine needs a generator function. '\n"
+	"            'Return a future for any other awaitable')\n"
+	"    _codes.add(func.__code__)\n"
+	"    return func\n"
+	"_ensure = getattr(mod, 'ensure_future', None) or getattr(mod, 'async')\n"
+	"def _finish(fut, done):\n"
+	"    try:\n"
+	"        r = fut.result()\n"
+	"    except BaseException:\n"
+	"        done(None, sys.exc_info())\n"
+	"    else:\n"
+	"        done(r, None)\n"
+	"def submit(aw, done):\n"
+	"    def start():\n"
+	"        try:\n"
+	"            fut = _ensure(aw, loop=loop)\n"
+	"        except BaseException:\n"
+	"            done(None, sys.exc_info())\n"
+	"            return\n"
+	"        fut.add_done_callback(lambda f: _finish(f, done))\n"
+	"    loop.call_soon_threadsafe(start)\n";
+
+//////////////////////////////////////////////////////////////////////////////
+// Returns the traceback of the current python error and clears it
+String
+takePyError(
+	Py::Exception& e)
+{
+	Py::Object etype, evalue;
+	String tb = Py::getCurrentErrorInfo(etype, evalue);
+	e.clear();
+	return tb;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Raises a pywbem.CIMError(CIM_ERR_FAILED) for the provider
+void
+throwLoopError(
+	const char* msg)
+{
+	Py::Callable excctor = PyProviderModule::getWBEMMod().getAttr(
+		"CIMError");
+	Py::Tuple args(2);
+	args[0] = Py::Int(int(CIMException::FAILED));
+	args[1] = Py::String(msg);
+	throw Py::Exception(excctor, args);
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// A request thread waiting for an awaitable to finish on the loop
+class PyAsyncWaiter : public IntrusiveCountableBase
+{
+public:
+	PyAsyncWaiter()
+		: m_guard()
+		, m_cond()
+		, m_done(false)
+		, m_aborted(false)
+	{
+	}
+
+	void wait()
+	{
+		NonRecursiveMutexLock l(m_guard);
+		while (!m_done)
+		{
+			m_cond.wait(l);
+		}
+	}
+
+	void notify()
+	{
+		NonRecursiveMutexLock l(m_guard);
+		m_done = true;
+		m_cond.notifyAll();
+	}
+
+	void abort()
+	{
+		NonRecursiveMutexLock l(m_guard);
+		m_aborted = true;
+		m_done = true;
+		m_cond.notifyAll();
+	}
+
+	bool aborted()
+	{
+		NonRecursiveMutexLock l(m_guard);
+		return m_aborted;
+	}
+
+private:
+	NonRecursiveMutex m_guard;
+	Condition m_cond;
+	bool m_done;
+	bool m_aborted;
+};
+typedef IntrusiveReference<PyAsyncWaiter> PyAsyncWaiterRef;
+
+//////////////////////////////////////////////////////////////////////////////
+// The done callback given to the helper's submit. Keeps the outcome for
+// the waiting request thread.
+class PyAsyncCompletion
+	: public Py::PythonExtension<PyAsyncCompletion>
+{
+public:
+	PyAsyncCompletion(const PyAsyncWaiterRef& waiter)
+		: Py::PythonExtension<PyAsyncCompletion>()
+		, m_waiter(waiter)
+		, m_result()
+		, m_excInfo()
+	{
+	}
+
+	virtual Py::Object call(const Py::Object& args, const Py::Object& kws)
+	{
+		Py::Tuple targs(args);
+		if (targs.length() == 2)
+		{
+			m_result = targs[0];
+			m_excInfo = targs[1];
+		}
+		m_waiter->notify();
+		return Py::None();
+	}
+
+	// Returns the result or throws with the awaitable's exception set
+	Py::Object takeResult()
+	{
+		Py::Object result = m_result;
+		Py::Object excInfo = m_excInfo;
+		m_result = Py::None();
+		m_excInfo = Py::None();
+		if (!excInfo.isNone())
+		{
+			Py::Tuple ei(excInfo);
+			PyObject* etype = Py::new_reference_to(ei[0]);
+			PyObject* evalue = Py::new_reference_to(ei[1]);
+			PyObject* etb = Py::new_reference_to(ei[2]);
+			if (etb == Py_None)
+			{
+				Py_DECREF(etb);
+				etb = 0;
+			}
+			PyErr_Restore(etype, evalue, etb);
+			throw Py::Exception();
+		}
+		return result;
+	}
+
+	static void doInit()
+	{
+		behaviors().name("AsyncCompletion");
+		behaviors().doc("Completion callback of a provider coroutine or "
+			"future run on the python provider interface event loop");
+		behaviors().supportCall();
+	}
+
+private:
+	PyAsyncWaiterRef m_waiter;
+	Py::Object m_result;
+	Py::Object m_excInfo;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+class PyAsyncLoopThread : public Thread
+{
+public:
+	PyAsyncLoopThread(const Py::Object& mod, const Py::Object& loop)
+		: Thread()
+		, m_mod(mod)
+		, m_loop(loop)
+	{
+	}
+
+protected:
+	virtual Int32 run()
+	{
+		Py::InterpreterScope is(0);
+		Py::GILGuard gg;	// Acquire python's GIL
+		Int32 rc = 0;
+		try
+		{
+			Py::Tuple args(1);
+			args[0] = m_loop;
+			Py::Callable(m_mod.getAttr("set_event_loop")).apply(args);
+			// Gives the GIL up while waiting for events
+			Py::Callable(m_loop.getAttr("run_forever")).apply(Py::Tuple());
+			Py::Callable(m_loop.getAttr("close")).apply(Py::Tuple());
+		}
+		catch (Py::Exception& e)
+		{
+			PyErr_Print();
+			e.clear();
+			rc = 1;
+		}
+		m_mod = Py::Object();
+		m_loop = Py::Object();
+		return rc;
+	}
+
+private:
+	Py::Object m_mod;
+	Py::Object m_loop;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+PyAsyncLoop::PyAsyncLoop(
+	const String& moduleName)
+	: IntrusiveCountableBase()
+	, m_moduleName(moduleName)
+	, m_loop()
+	, m_futureType()
+	, m_submit()
+	, m_coroCodes()
+	, m_thread()
+	, m_guard()
+	, m_waiters()
+	, m_running(false)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyAsyncLoop::~PyAsyncLoop()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+PyAsyncLoop::doInit()
+{
+	PyAsyncCompletion::doInit();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyAsyncLoop::start()
+{
+	{
+		Py::InterpreterScope is(0);
+		Py::GILGuard gg;	// Acquire python's GIL
+		try
+		{
+			Py::Module mod(m_moduleName, true);
+			m_loop = Py::Callable(mod.getAttr("new_event_loop")).apply(
+				Py::Tuple());
+			m_futureType = mod.getAttr("Future");
+
+			Py::Dict globals;
+			globals.setItem("__builtins__", Py::Object(PyEval_GetBuiltins()));
+			globals.setItem("mod", mod);
+			globals.setItem("loop", m_loop);
+			PyObject* rv = PyRun_String(ASYNC_HELPER_SRC, Py_file_input,
+				globals.ptr(), globals.ptr());
+			if (!rv)
+			{
+				throw Py::Exception();
+			}
+			Py_DECREF(rv);
+			m_submit = globals.getItem("submit");
+			m_coroCodes = globals.getItem("_codes");
+
+			Py::Module pycimmb = PyProviderModule::getModulePtr()->module();
+			pycimmb.setAttr("event_loop", m_loop);
+			pycimmb.setAttr("coroutine", globals.getItem("coroutine"));
+			m_thread = new PyAsyncLoopThread(mod, m_loop);
+		}
+		catch (Py::Exception& e)
+		{
+			String tb = takePyError(e);
+			m_loop = Py::Object();
+			m_futureType = Py::Object();
+			m_submit = Py::Object();
+			m_coroCodes = Py::Object();
+			OW_THROWCIMMSG(CIMException::FAILED, Format("Unable to start "
+				"the %1 event loop: %2", m_moduleName, tb).c_str());
+		}
+	}
+	m_thread->start();
+	NonRecursiveMutexLock l(m_guard);
+	m_running = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyAsyncLoop::shutdown()
+{
+	{
+		NonRecursiveMutexLock l(m_guard);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+
+	{
+		Py::InterpreterScope is(0);
+		Py::GILGuard gg;	// Acquire python's GIL
+		try
+		{
+			Py::Tuple args(1);
+			args[0] = m_loop.getAttr("stop");
+			Py::Callable(m_loop.getAttr("call_soon_threadsafe")).apply(args);
+		}
+		catch (Py::Exception& e)
+		{
+			takePyError(e);
+		}
+	}
+	m_thread->join();
+
+	{
+		// Whatever is still pending won't finish any more
+		NonRecursiveMutexLock l(m_guard);
+		for (std::set<PyAsyncWaiter*>::iterator it = m_waiters.begin();
+			it != m_waiters.end(); ++it)
+		{
+			(*it)->abort();
+		}
+	}
+
+	Py::InterpreterScope is(0);
+	Py::GILGuard gg;	// Acquire python's GIL
+	m_loop = Py::Object();
+	m_futureType = Py::Object();
+	m_submit = Py::Object();
+	m_coroCodes = Py::Object();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyAsyncLoop::isAwaitable(
+	const Py::Object& obj) const
+{
+	if (m_futureType.isNone())
+	{
+		return false;
+	}
+	if (PyGen_Check(obj.ptr()))
+	{
+		PyObject* code = PyObject_GetAttrString(obj.ptr(), "gi_code");
+		if (!code)
+		{
+			PyErr_Clear();
+			return false;
+		}
+		int rc = PySet_Contains(m_coroCodes.ptr(), code);
+		Py_DECREF(code);
+		if (rc < 0)
+		{
+			PyErr_Clear();
+		}
+		return rc > 0;
+	}
+	int rc = PyObject_IsInstance(obj.ptr(), m_futureType.ptr());
+	if (rc < 0)
+	{
+		PyErr_Clear();
+	}
+	return rc > 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyAsyncLoop::await(
+	const Py::Object& obj)
+{
+	PyAsyncWaiterRef waiter(new PyAsyncWaiter);
+	bool running = false;
+	{
+		NonRecursiveMutexLock l(m_guard);
+		running = m_running;
+		if (running)
+		{
+			m_waiters.insert(waiter.getPtr());
+		}
+	}
+	if (!running)
+	{
+		throwLoopError("The python provider event loop is not running");
+	}
+
+	PyAsyncCompletion* completion = new PyAsyncCompletion(waiter);
+	Py::Object done = Py::asObject(completion);
+	try
+	{
+		Py::Tuple args(2);
+		args[0] = obj;
+		args[1] = done;
+		Py::Callable(m_submit).apply(args);
+	}
+	catch (...)
+	{
+		NonRecursiveMutexLock l(m_guard);
+		m_waiters.erase(waiter.getPtr());
+		throw;
+	}
+
+	PYCXX_ALLOW_THREADS
+	waiter->wait();
+	PYCXX_END_ALLOW_THREADS
+
+	{
+		NonRecursiveMutexLock l(m_guard);
+		m_waiters.erase(waiter.getPtr());
+	}
+	if (waiter->aborted())
+	{
+		throwLoopError("The python provider event loop was shut down "
+			"before the request finished");
+	}
+	return completion->takeResult();
+}
+
+}	// End of namespace PythonProvIFC
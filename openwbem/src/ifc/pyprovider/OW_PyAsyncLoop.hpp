@@ -0,0 +1,89 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifndef OW_PYASYNCLOOP_HPP_GUARD
+#define OW_PYASYNCLOOP_HPP_GUARD
+
+#include "PyCxxObjects.hpp"
+#include <openwbem/OW_String.hpp>
+#include <openwbem/OW_NonRecursiveMutex.hpp>
+#include <openwbem/OW_IntrusiveCountableBase.hpp>
+#include <openwbem/OW_IntrusiveReference.hpp>
+
+#include <set>
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+class PyAsyncLoopThread;
+class PyAsyncWaiter;
+
+//////////////////////////////////////////////////////////////////////////////
+// An event loop of an asyncio style module (trollius on python 2) running
+// on a thread of its own in the main interpreter. Provider methods may
+// return coroutines or futures instead of results. The request thread
+// hands them to the loop and waits for them without the GIL, so a single
+// interpreter can have many I/O bound requests outstanding.
+// The loop is available to providers as pycimmb.event_loop. Futures a
+// provider creates itself must belong to it. Coroutines are generators on
+// python 2, so only the ones of functions marked with pycimmb.coroutine
+// are awaited; any other generator is taken as a generator of results.
+class PyAsyncLoop : public IntrusiveCountableBase
+{
+public:
+	PyAsyncLoop(const String& moduleName);
+	~PyAsyncLoop();
+
+	// Imports the module and starts the loop thread. Must be called
+	// without the GIL. Throws a CIMException if the module can't be used.
+	void start();
+	// Stops the loop and waits for its thread. Requests still waiting
+	// fail with CIM_ERR_FAILED. Must be called without the GIL.
+	void shutdown();
+
+	// True if obj is a future, or a generator of a function marked with
+	// pycimmb.coroutine. Must be called with the GIL held.
+	bool isAwaitable(const Py::Object& obj) const;
+	// Runs obj on the loop and returns its result, or throws a
+	// Py::Exception with its exception set. Must be called with the GIL
+	// held. Gives the GIL up while waiting.
+	Py::Object await(const Py::Object& obj);
+
+	// Sets up the python type of the completion callbacks
+	static void doInit();
+
+private:
+	PyAsyncLoop(const PyAsyncLoop&);
+	PyAsyncLoop& operator=(const PyAsyncLoop&);
+
+	String m_moduleName;
+	Py::Object m_loop;
+	Py::Object m_futureType;
+	Py::Object m_submit;				// Helper running awaitables on the loop
+	Py::Object m_coroCodes;				// Code of the marked coroutines
+	IntrusiveReference<PyAsyncLoopThread> m_thread;
+	NonRecursiveMutex m_guard;
+	std::set<PyAsyncWaiter*> m_waiters;
+	bool m_running;
+};
+typedef IntrusiveReference<PyAsyncLoop> PyAsyncLoopRef;
+
+}	// End of namespace PythonProvIFC
+
+#endif	// OW_PYASYNCLOOP_HPP_GUARD
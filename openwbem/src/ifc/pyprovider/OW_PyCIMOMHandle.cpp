@@ -17,6 +17,7 @@
 *****************************************************************************/
 #include "OW_PyProviderModule.hpp"
 #include "OW_PyConverter.hpp"
+#include "OW_PyInstanceIterator.hpp"
 #include <openwbem/OW_CIMQualifier.hpp>
 #include <openwbem/OW_CIMQualifierType.hpp>
 #include <openwbem/OW_CIMException.hpp>
@@ -26,6 +27,11 @@
 #include <openwbem/OW_Format.hpp>
 #include <openwbem/OW_CIMParamValue.hpp>
 
+extern "C"
+{
+#include <sys/time.h>
+}
+
 #include <iostream>
 using std::cout;
 using std::cerr;
@@ -40,6 +46,9 @@ namespace PythonProvIFC
 namespace
 {
 
+// Results held between the CIMOM and a provider using Iterator=True
+const UInt32 DEFAULT_ITERATOR_QUEUE_SIZE = 100;
+
 //////////////////////////////////////////////////////////////////////////////
 String
 getPythonTraceBack(
@@ -143,29 +152,102 @@ getStringParam(
 }
 
 //////////////////////////////////////////////////////////////////////////////
-class PyClassResultHandler : public CIMClassResultHandlerIFC
+UInt64
+getMsecs()
+{
+	struct timeval tv;
+	::gettimeofday(&tv, 0);
+	return UInt64(tv.tv_sec) * 1000 + UInt64(tv.tv_usec) / 1000;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+getBatchParams(
+	const Py::Dict& kws,
+	UInt32& batchSize,
+	UInt32& batchMsecs)
+{
+	batchSize = 0;
+	batchMsecs = 0;
+	Py::Object wko = getParam(kws, "HandlerBatchSize");
+	if (!wko.isNone())
+	{
+		long v = long(Py::Int(wko));
+		if (v < 0)
+		{
+			OW_THROWCIMMSG(CIMException::INVALID_PARAMETER,
+				"'HandlerBatchSize' parameter must not be negative");
+		}
+		batchSize = UInt32(v);
+	}
+	wko = getParam(kws, "HandlerBatchTime");
+	if (!wko.isNone())
+	{
+		long v = long(Py::Int(wko));
+		if (v < 0)
+		{
+			OW_THROWCIMMSG(CIMException::INVALID_PARAMETER,
+				"'HandlerBatchTime' parameter must not be negative");
+		}
+		batchMsecs = UInt32(v);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Result handler given to the CIMOM handle. Results are either collected
+// in a python list or given to a python callable. If a batch size is
+// specified along with the callable, results are held in their native
+// form without the GIL and the callable is invoked with a list of them
+// once the batch is full, or the first held result is older than the batch
+// time when the next one arrives. The batch time is only checked on
+// arrival: the results are pushed by the CIMOM on the thread of the call,
+// and a timer thread calling the python handler would run it concurrently
+// with the provider with no way to return its exceptions to the call.
+// Whatever is left is delivered by getResult().
+template <typename T>
+class PyResultHandler : public ResultHandlerIFC<T>
 {
 public:
-	PyClassResultHandler(Py::Object& pycb)
-		: CIMClassResultHandlerIFC()
+	PyResultHandler(Py::Object& pycb, UInt32 batchSize, UInt32 batchMsecs)
+		: ResultHandlerIFC<T>()
 		, m_res()
 		, m_pycb()
+		, m_batch()
+		, m_batchSize(0)
+		, m_batchMsecs(batchMsecs)
+		, m_batchStart(0)
 	{
 		if (pycb.isCallable())
 		{
 			m_pycb = pycb;
+			m_batchSize = batchSize;
 		}
 	}
 
-	virtual void doHandle(const CIMClass& cc)
+	virtual void doHandle(const T& item)
 	{
+		if (m_batchSize)
+		{
+			if (m_batch.empty())
+			{
+				m_batchStart = getMsecs();
+			}
+			m_batch.append(item);
+			if (m_batch.size() >= m_batchSize
+				|| (m_batchMsecs && getMsecs() - m_batchStart >= m_batchMsecs))
+			{
+				flush();
+			}
+			return;
+		}
+
 		Py::GILGuard gg;	// Acquire python's GIL
 		if (!m_pycb.isNone())
 		{
 			try
 			{
 				Py::Tuple args(1);
-				args[0] = OWPyConv::OWClass2Py(cc);
+				args[0] = toPy(item);
 				m_pycb.apply(args);
 			}
 			catch(Py::Exception& e)
@@ -178,224 +260,313 @@ public:
 		}
 		else
 		{
-			m_res.append(OWPyConv::OWClass2Py(cc));
+			m_res.append(toPy(item));
 		}
 	}
 
-	Py::Object getResult() const 
+	Py::Object getResult()
 	{ 
+		flush();
 		return (!m_pycb.isNone()) ? Py::Nothing() : Py::Object(m_res);
 	}
 
-private:
-	Py::List m_res;
-	Py::Callable m_pycb;
-};
+protected:
+	virtual Py::Object toPy(const T& item) = 0;
 
-class PyQualResultHandler : public CIMQualifierTypeResultHandlerIFC
-{
-public:
-	PyQualResultHandler(Py::Object& pycb)
-		: CIMQualifierTypeResultHandlerIFC()
-		, m_res()
-		, m_pycb()
+private:
+	void flush()
 	{
-		if (pycb.isCallable())
+		if (m_batch.empty())
 		{
-			m_pycb = pycb;
+			return;
 		}
-	}
-
-	virtual void doHandle(const CIMQualifierType& cqt)
-	{
 		Py::GILGuard gg;	// Acquire python's GIL
-		if (!m_pycb.isNone())
+		try
 		{
-			try
-			{
-				Py::Tuple args(1);
-				args[0] = OWPyConv::OWQualType2Py(cqt);
-				m_pycb.apply(args);
-			}
-			catch(Py::Exception& e)
+			Py::List pylist;
+			for (typename Array<T>::size_type i = 0; i < m_batch.size(); i++)
 			{
-				String msg = Format("Python exception caught: %1",
-					getPythonTraceBack(e));
-				e.clear();
-				throwPyCIMException(CIMException::FAILED, msg.c_str());
+				pylist.append(toPy(m_batch[i]));
 			}
+			m_batch.clear();
+			Py::Tuple args(1);
+			args[0] = pylist;
+			m_pycb.apply(args);
 		}
-		else
+		catch(Py::Exception& e)
 		{
-			m_res.append(OWPyConv::OWQualType2Py(cqt));
+			m_batch.clear();
+			String msg = Format("Python exception caught: %1",
+				getPythonTraceBack(e));
+			e.clear();
+			throwPyCIMException(CIMException::FAILED, msg.c_str());
 		}
 	}
 
-	Py::Object getResult() const 
-	{ 
-		return (!m_pycb.isNone()) ? Py::Nothing() : Py::Object(m_res);
-	}
-
-private:
 	Py::List m_res;
 	Py::Callable m_pycb;
+	Array<T> m_batch;
+	UInt32 m_batchSize;
+	UInt32 m_batchMsecs;
+	UInt64 m_batchStart;
 };
 
-class PyOpResultHandler : public CIMObjectPathResultHandlerIFC
+//////////////////////////////////////////////////////////////////////////////
+class PyClassResultHandler : public PyResultHandler<CIMClass>
 {
 public:
-	PyOpResultHandler(const String& ns, Py::Object& pycb)
-		: CIMObjectPathResultHandlerIFC()
-		, m_res()
+	PyClassResultHandler(Py::Object& pycb, UInt32 batchSize=0,
+		UInt32 batchMsecs=0)
+		: PyResultHandler<CIMClass>(pycb, batchSize, batchMsecs)
+	{
+	}
+
+protected:
+	virtual Py::Object toPy(const CIMClass& cc)
+	{
+		return OWPyConv::OWClass2Py(cc);
+	}
+};
+
+class PyQualResultHandler : public PyResultHandler<CIMQualifierType>
+{
+public:
+	PyQualResultHandler(Py::Object& pycb, UInt32 batchSize=0,
+		UInt32 batchMsecs=0)
+		: PyResultHandler<CIMQualifierType>(pycb, batchSize, batchMsecs)
+	{
+	}
+
+protected:
+	virtual Py::Object toPy(const CIMQualifierType& cqt)
+	{
+		return OWPyConv::OWQualType2Py(cqt);
+	}
+};
+
+class PyOpResultHandler : public PyResultHandler<CIMObjectPath>
+{
+public:
+	PyOpResultHandler(const String& ns, Py::Object& pycb,
+		UInt32 batchSize=0, UInt32 batchMsecs=0)
+		: PyResultHandler<CIMObjectPath>(pycb, batchSize, batchMsecs)
 		, m_ns(ns)
-		, m_pycb()
 	{
-		if (pycb.isCallable())
-		{
-			m_pycb = pycb;
-		}
 	}
 
-	virtual void doHandle(const CIMObjectPath& cop)
+protected:
+	virtual Py::Object toPy(const CIMObjectPath& cop)
 	{
-		Py::GILGuard gg;	// Acquire python's GIL
 		CIMObjectPath lcop(cop);
 		if (lcop.getNameSpace().empty())
 		{
 			lcop.setNameSpace(m_ns);
 		}
+		return OWPyConv::OWRef2Py(lcop);
+	}
 
-		if (!m_pycb.isNone())
-		{
-			try
-			{
-				Py::Tuple args(1);
-				args[0] = OWPyConv::OWRef2Py(lcop);
-				m_pycb.apply(args);
-			}
-			catch(Py::Exception& e)
-			{
-				String msg = Format("Python exception caught: %1",
-					getPythonTraceBack(e));
-				e.clear();
-				throwPyCIMException(CIMException::FAILED, msg.c_str());
-			}
-		}
-		else
-		{
-			m_res.append(OWPyConv::OWRef2Py(lcop));
-		}
+private:
+	String m_ns;
+};
+
+class PyInstResultHandler : public PyResultHandler<CIMInstance>
+{
+public:
+	PyInstResultHandler(const String& ns, Py::Object& pycb,
+		UInt32 batchSize=0, UInt32 batchMsecs=0)
+		: PyResultHandler<CIMInstance>(pycb, batchSize, batchMsecs)
+		, m_ns(ns)
+	{
 	}
 
-	Py::Object getResult() const 
-	{ 
-		return (!m_pycb.isNone()) ? Py::Nothing() : Py::Object(m_res);
+protected:
+	virtual Py::Object toPy(const CIMInstance& ci)
+	{
+		return OWPyConv::OWInst2Py(ci, m_ns);
 	}
 
 private:
-	Py::List m_res;
 	String m_ns;
-	Py::Callable m_pycb;
 };
 
-class PyInstResultHandler : public CIMInstanceResultHandlerIFC
+class PyStringResultHandler : public PyResultHandler<String>
 {
 public:
-	PyInstResultHandler(const String& ns, Py::Object& pycb)
-		: CIMInstanceResultHandlerIFC()
-		, m_res()
-		, m_ns(ns)
-		, m_pycb()
+	PyStringResultHandler(Py::Object& pycb, UInt32 batchSize=0,
+		UInt32 batchMsecs=0)
+		: PyResultHandler<String>(pycb, batchSize, batchMsecs)
 	{
-		if (pycb.isCallable())
-		{
-			m_pycb = pycb;
-		}
 	}
 
-	virtual void doHandle(const CIMInstance& ci)
+protected:
+	virtual Py::Object toPy(const String& arg)
 	{
-		Py::GILGuard gg;	// Acquire python's GIL
-		if (!m_pycb.isNone())
-		{
-			try
-			{
-				Py::Tuple args(1);
-				args[0] = OWPyConv::OWInst2Py(ci, m_ns);
-				m_pycb.apply(args);
-			}
-			catch(Py::Exception& e)
-			{
-				String msg = Format("Python exception caught: %1",
-					getPythonTraceBack(e));
-				e.clear();
-				throwPyCIMException(CIMException::FAILED, msg.c_str());
-			}
-		}
-		else
+		return Py::String(arg);
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Returns the queue size for an upcall made with Iterator=True, or 0 if
+// the results are to be returned as a list or given to a Handler
+UInt32
+getIteratorQueueSize(
+	const Py::Dict& kws,
+	const Py::Object& cb)
+{
+	Py::Object wko = getParam(kws, "Iterator");
+	if (wko.isNone() || !wko.isTrue())
+	{
+		return 0;
+	}
+	if (!cb.isNone())
+	{
+		OW_THROWCIMMSG(CIMException::INVALID_PARAMETER,
+			"The 'Handler' and 'Iterator' parameters are mutually exclusive");
+	}
+	UInt32 queueSize = DEFAULT_ITERATOR_QUEUE_SIZE;
+	wko = getParam(kws, "IteratorQueueSize");
+	if (!wko.isNone())
+	{
+		long v = long(Py::Int(wko));
+		if (v <= 0)
 		{
-			m_res.append(OWPyConv::OWInst2Py(ci, m_ns));
+			OW_THROWCIMMSG(CIMException::INVALID_PARAMETER,
+				"'IteratorQueueSize' parameter must be greater than 0");
 		}
+		queueSize = UInt32(v);
 	}
+	return queueSize;
+}
 
-	Py::Object getResult() const 
-	{ 
-		return (!m_pycb.isNone()) ? Py::Nothing() : Py::Object(m_res);
+//////////////////////////////////////////////////////////////////////////////
+class EnumInstancesProducer : public PyInstanceProducer
+{
+public:
+	EnumInstancesProducer(const PyInstanceQueueRef& queue,
+		const CIMOMHandleIFCRef& chdl, const String& ns,
+		const String& className, EDeepFlag deepFlg,
+		ELocalOnlyFlag localOnlyFlag, EIncludeQualifiersFlag incQualsFlag,
+		EIncludeClassOriginFlag classOriginFlag, const StringArray* pPropList)
+		: PyInstanceProducer(queue)
+		, m_chdl(chdl)
+		, m_ns(ns)
+		, m_className(className)
+		, m_deepFlg(deepFlg)
+		, m_localOnlyFlag(localOnlyFlag)
+		, m_incQualsFlag(incQualsFlag)
+		, m_classOriginFlag(classOriginFlag)
+		, m_propList(pPropList ? *pPropList : StringArray())
+		, m_hasPropList(pPropList != 0)
+	{
+	}
+
+protected:
+	virtual void produce(CIMInstanceResultHandlerIFC& result)
+	{
+		m_chdl->enumInstances(m_ns, m_className, result, m_deepFlg,
+			m_localOnlyFlag, m_incQualsFlag, m_classOriginFlag,
+			m_hasPropList ? &m_propList : 0);
 	}
 
 private:
-	Py::List m_res;
+	CIMOMHandleIFCRef m_chdl;
 	String m_ns;
-	Py::Callable m_pycb;
+	String m_className;
+	EDeepFlag m_deepFlg;
+	ELocalOnlyFlag m_localOnlyFlag;
+	EIncludeQualifiersFlag m_incQualsFlag;
+	EIncludeClassOriginFlag m_classOriginFlag;
+	StringArray m_propList;
+	bool m_hasPropList;
 };
 
-class PyStringResultHandler : public StringResultHandlerIFC
+//////////////////////////////////////////////////////////////////////////////
+class AssociatorsProducer : public PyInstanceProducer
 {
 public:
-	PyStringResultHandler(Py::Object& pycb)
-		: StringResultHandlerIFC()
-		, m_res()
-		, m_pycb()
+	AssociatorsProducer(const PyInstanceQueueRef& queue,
+		const CIMOMHandleIFCRef& chdl, const String& ns,
+		const CIMObjectPath& objectName, const String& assocClass,
+		const String& resultClass, const String& role,
+		const String& resultRole, EIncludeQualifiersFlag incQualsFlag,
+		EIncludeClassOriginFlag classOriginFlag, const StringArray* pPropList)
+		: PyInstanceProducer(queue)
+		, m_chdl(chdl)
+		, m_ns(ns)
+		, m_objectName(objectName)
+		, m_assocClass(assocClass)
+		, m_resultClass(resultClass)
+		, m_role(role)
+		, m_resultRole(resultRole)
+		, m_incQualsFlag(incQualsFlag)
+		, m_classOriginFlag(classOriginFlag)
+		, m_propList(pPropList ? *pPropList : StringArray())
+		, m_hasPropList(pPropList != 0)
 	{
-		if (pycb.isCallable())
-		{
-			m_pycb = pycb;
-		}
 	}
 
-	virtual void doHandle(const String& arg)
+protected:
+	virtual void produce(CIMInstanceResultHandlerIFC& result)
 	{
-		Py::GILGuard gg;	// Acquire python's GIL
-		if (!m_pycb.isNone())
-		{
-			try
-			{
-				Py::Tuple args(1);
-				args[0] = Py::String(arg);
-				m_pycb.apply(args);
-			}
-			catch(Py::Exception& e)
-			{
-				String msg = Format("Python exception caught: %1",
-					getPythonTraceBack(e));
-				e.clear();
-				throwPyCIMException(CIMException::FAILED, msg.c_str());
-			}
-		}
-		else
-		{
-			m_res.append(Py::String(arg));
-		}
+		m_chdl->associators(m_ns, m_objectName, result, m_assocClass,
+			m_resultClass, m_role, m_resultRole, m_incQualsFlag,
+			m_classOriginFlag, m_hasPropList ? &m_propList : 0);
 	}
 
-	Py::Object getResult() const 
-	{ 
-		return (!m_pycb.isNone()) ? Py::Nothing() : Py::Object(m_res);
+private:
+	CIMOMHandleIFCRef m_chdl;
+	String m_ns;
+	CIMObjectPath m_objectName;
+	String m_assocClass;
+	String m_resultClass;
+	String m_role;
+	String m_resultRole;
+	EIncludeQualifiersFlag m_incQualsFlag;
+	EIncludeClassOriginFlag m_classOriginFlag;
+	StringArray m_propList;
+	bool m_hasPropList;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+class ReferencesProducer : public PyInstanceProducer
+{
+public:
+	ReferencesProducer(const PyInstanceQueueRef& queue,
+		const CIMOMHandleIFCRef& chdl, const String& ns,
+		const CIMObjectPath& objectName, const String& resultClass,
+		const String& role, EIncludeQualifiersFlag incQualsFlag,
+		EIncludeClassOriginFlag classOriginFlag, const StringArray* pPropList)
+		: PyInstanceProducer(queue)
+		, m_chdl(chdl)
+		, m_ns(ns)
+		, m_objectName(objectName)
+		, m_resultClass(resultClass)
+		, m_role(role)
+		, m_incQualsFlag(incQualsFlag)
+		, m_classOriginFlag(classOriginFlag)
+		, m_propList(pPropList ? *pPropList : StringArray())
+		, m_hasPropList(pPropList != 0)
+	{
+	}
+
+protected:
+	virtual void produce(CIMInstanceResultHandlerIFC& result)
+	{
+		m_chdl->references(m_ns, m_objectName, result, m_resultClass,
+			m_role, m_incQualsFlag, m_classOriginFlag,
+			m_hasPropList ? &m_propList : 0);
 	}
 
 private:
-	Py::List m_res;
-	Py::Callable m_pycb;
+	CIMOMHandleIFCRef m_chdl;
+	String m_ns;
+	CIMObjectPath m_objectName;
+	String m_resultClass;
+	String m_role;
+	EIncludeQualifiersFlag m_incQualsFlag;
+	EIncludeClassOriginFlag m_classOriginFlag;
+	StringArray m_propList;
+	bool m_hasPropList;
 };
 
 }	// End of unnamed namespace
@@ -656,7 +827,9 @@ PyCIMOMHandle::enumClassNames(
 			}
 		}
 
-		PyStringResultHandler rhandler(cb);
+		UInt32 batchSize, batchMsecs;
+		getBatchParams(kws, batchSize, batchMsecs);
+		PyStringResultHandler rhandler(cb, batchSize, batchMsecs);
 		PYCXX_ALLOW_THREADS
 		m_chdl->enumClassNames(ns, className, rhandler, flg);
 		PYCXX_END_ALLOW_THREADS
@@ -758,7 +931,9 @@ PyCIMOMHandle::enumClass(
 			}
 		}
 
-		PyClassResultHandler rhandler(cb);
+		UInt32 batchSize, batchMsecs;
+		getBatchParams(kws, batchSize, batchMsecs);
+		PyClassResultHandler rhandler(cb, batchSize, batchMsecs);
 		PYCXX_ALLOW_THREADS
 		m_chdl->enumClass(ns, className, rhandler, deepFlg, localOnlyFlag,
 			incQualsFlag, classOriginFlag);
@@ -919,6 +1094,7 @@ PyCIMOMHandle::createClass(
 		PYCXX_ALLOW_THREADS
 		m_chdl->createClass(ns, cc);
 		PYCXX_END_ALLOW_THREADS
+		OWPyConv::invalidateClassCache(ns);
 	}
 	catch(const CIMException& e)
 	{
@@ -974,6 +1150,7 @@ PyCIMOMHandle::deleteClass(
 		PYCXX_ALLOW_THREADS
 		m_chdl->deleteClass(ns, className);
 		PYCXX_END_ALLOW_THREADS
+		OWPyConv::invalidateClassCache(ns);
 	}
 	catch(const CIMException& e)
 	{
@@ -1029,6 +1206,7 @@ PyCIMOMHandle::modifyClass(
 		PYCXX_ALLOW_THREADS
 		m_chdl->modifyClass(ns, cc);
 		PYCXX_END_ALLOW_THREADS
+		OWPyConv::invalidateClassCache(ns);
 	}
 	catch(const CIMException& e)
 	{
@@ -1079,7 +1257,9 @@ PyCIMOMHandle::enumQualifiers(
 			}
 		}
 
-		PyQualResultHandler rhandler(cb);
+		UInt32 batchSize, batchMsecs;
+		getBatchParams(kws, batchSize, batchMsecs);
+		PyQualResultHandler rhandler(cb, batchSize, batchMsecs);
 		PYCXX_ALLOW_THREADS
 		m_chdl->enumQualifierTypes(ns, rhandler);
 		PYCXX_END_ALLOW_THREADS
@@ -1309,7 +1489,10 @@ PyCIMOMHandle::enumInstanceNames(
 					"'Handler' parameter must be a callable object");
 			}
 		}
-		PyOpResultHandler rhandler(ns, cb);
+
+		UInt32 batchSize, batchMsecs;
+		getBatchParams(kws, batchSize, batchMsecs);
+		PyOpResultHandler rhandler(ns, cb, batchSize, batchMsecs);
 		PYCXX_ALLOW_THREADS
 		m_chdl->enumInstanceNames(ns, className, rhandler);
 		PYCXX_END_ALLOW_THREADS
@@ -1414,7 +1597,20 @@ PyCIMOMHandle::enumInstances(
 					"'Handler' parameter must be a callable object");
 			}
 		}
-		PyInstResultHandler rhandler(ns, cb);
+
+		UInt32 queueSize = getIteratorQueueSize(kws, cb);
+		if (queueSize)
+		{
+			PyInstanceQueueRef queue(new PyInstanceQueue(queueSize));
+			PyInstanceProducerRef producer(new EnumInstancesProducer(queue,
+				m_chdl, ns, className, deepFlg, localOnlyFlag, incQualsFlag,
+				classOriginFlag, pPropList));
+			return PyInstanceIterator::newObject(queue, producer, ns);
+		}
+
+		UInt32 batchSize, batchMsecs;
+		getBatchParams(kws, batchSize, batchMsecs);
+		PyInstResultHandler rhandler(ns, cb, batchSize, batchMsecs);
 		PYCXX_ALLOW_THREADS
 		m_chdl->enumInstances(ns, className, rhandler, deepFlg, localOnlyFlag,
 			incQualsFlag, classOriginFlag, pPropList);
@@ -1785,7 +1981,19 @@ PyCIMOMHandle::associators(
 			}
 		}
 
-		PyInstResultHandler rhandler(ns, cb);
+		UInt32 queueSize = getIteratorQueueSize(kws, cb);
+		if (queueSize)
+		{
+			PyInstanceQueueRef queue(new PyInstanceQueue(queueSize));
+			PyInstanceProducerRef producer(new AssociatorsProducer(queue,
+				m_chdl, ns, objectName, assocClass, resultClass, role,
+				resultRole, incQualsFlag, classOriginFlag, pPropList));
+			return PyInstanceIterator::newObject(queue, producer, ns);
+		}
+
+		UInt32 batchSize, batchMsecs;
+		getBatchParams(kws, batchSize, batchMsecs);
+		PyInstResultHandler rhandler(ns, cb, batchSize, batchMsecs);
 		PYCXX_ALLOW_THREADS
 		m_chdl->associators(ns, objectName, rhandler, assocClass, resultClass,
 			role, resultRole, incQualsFlag, classOriginFlag, pPropList);
@@ -1872,7 +2080,10 @@ PyCIMOMHandle::associatorNames(
 					"'Handler' parameter must be a callable object");
 			}
 		}
-		PyOpResultHandler rhandler(ns, cb);
+
+		UInt32 batchSize, batchMsecs;
+		getBatchParams(kws, batchSize, batchMsecs);
+		PyOpResultHandler rhandler(ns, cb, batchSize, batchMsecs);
 		PYCXX_ALLOW_THREADS
 		m_chdl->associatorNames(ns, objectName, rhandler, assocClass,
 				resultClass, role, resultRole);
@@ -1973,7 +2184,19 @@ PyCIMOMHandle::references(
 			}
 		}
 
-		PyInstResultHandler rhandler(ns, cb);
+		UInt32 queueSize = getIteratorQueueSize(kws, cb);
+		if (queueSize)
+		{
+			PyInstanceQueueRef queue(new PyInstanceQueue(queueSize));
+			PyInstanceProducerRef producer(new ReferencesProducer(queue,
+				m_chdl, ns, objectName, resultClass, role, incQualsFlag,
+				classOriginFlag, pPropList));
+			return PyInstanceIterator::newObject(queue, producer, ns);
+		}
+
+		UInt32 batchSize, batchMsecs;
+		getBatchParams(kws, batchSize, batchMsecs);
+		PyInstResultHandler rhandler(ns, cb, batchSize, batchMsecs);
 		PYCXX_ALLOW_THREADS
 		m_chdl->references(ns, objectName, rhandler, resultClass, role, 
 			incQualsFlag, classOriginFlag, pPropList);
@@ -2047,7 +2270,10 @@ PyCIMOMHandle::referenceNames(
 					"'Handler' parameter must be a callable object");
 			}
 		}
-		PyOpResultHandler rhandler(ns, cb);
+
+		UInt32 batchSize, batchMsecs;
+		getBatchParams(kws, batchSize, batchMsecs);
+		PyOpResultHandler rhandler(ns, cb, batchSize, batchMsecs);
 		PYCXX_ALLOW_THREADS
 		m_chdl->referenceNames(ns, objectName, rhandler, resultClass, role);
 		PYCXX_END_ALLOW_THREADS
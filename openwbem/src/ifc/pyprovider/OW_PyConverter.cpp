@@ -16,6 +16,7 @@
 * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *****************************************************************************/
 #include "OW_PyConverter.hpp"
+#include "OW_PyLazyInstance.hpp"
 #include <openwbem/OW_CIMProperty.hpp>
 #include <openwbem/OW_CIMDateTime.hpp>
 #include <openwbem/OW_CIMQualifierType.hpp>
@@ -25,8 +26,13 @@
 #include <openwbem/OW_CIMFlavor.hpp>
 #include <openwbem/OW_CIMScope.hpp>
 #include <openwbem/OW_Format.hpp>
+#include <openwbem/OW_Map.hpp>
 
+#include <ctime>
 #include <iostream>
+#include <limits>
+#include <vector>
+#include <map>
 using std::cout;
 using std::endl;
 
@@ -37,11 +43,109 @@ namespace PythonProvIFC
 
 OW_DEFINE_EXCEPTION(PyConversion);
 
-Py::Module g_modpywbem;
-
 namespace
 {
 
+// pywbem types and callables used by the converters. These are resolved
+// once by OWPyConv::setPyWbemMod so the conversion routines don't have to
+// look them up in the module on every call.
+struct PyWbemTypes
+{
+	Py::Object cimInstance;
+	Py::Object cimInstanceName;
+	Py::Object cimClassName;
+	Py::Object cimClass;
+	Py::Object cimProperty;
+	Py::Object cimQualifier;
+	Py::Object cimQualifierDecl;
+	Py::Object cimParameter;
+	Py::Object cimMethod;
+	Py::Object cimDateTime;
+	Py::Object minutesFromUTC;
+	Py::Object datetime;
+	Py::Object timedelta;
+	Py::Object uint8;
+	Py::Object sint8;
+	Py::Object uint16;
+	Py::Object sint16;
+	Py::Object uint32;
+	Py::Object sint32;
+	Py::Object uint64;
+	Py::Object sint64;
+	Py::Object real32;
+	Py::Object real64;
+};
+
+// Cache of converted CIMClass objects. Entries are keyed by
+// namespace:classname and are only valid while the generation they were
+// created with matches the current schema generation of their namespace,
+// and for g_classCacheTTL seconds. The class upcalls of providers bump the
+// generation. The CIMOM doesn't tell providers about classes changed by a
+// client, those are seen once the entry expires.
+// All access is serialized by the GIL.
+struct CachedClass
+{
+	CachedClass() : generation(0), loadTime(0) {}
+	Py::Object pycls;
+	UInt32 generation;
+	time_t loadTime;
+};
+typedef Map<String, CachedClass> ClassCacheMap;
+typedef Map<String, UInt32> SchemaGenMap;
+SchemaGenMap g_schemaGen;
+UInt32 g_classCacheTTL = 300;
+
+// Everything the converters keep that refers to python objects. Each
+// python interpreter has its own pywbem module, so there is one of these
+// per interpreter. All access is serialized by the GIL.
+struct PyConvState
+{
+	Py::Module mod;
+	PyWbemTypes types;
+	ClassCacheMap classCache;
+};
+typedef std::map<PyInterpreterState*, PyConvState> ConvStateMap;
+ConvStateMap g_convStates;
+PyInterpreterState* g_lastInterp = 0;
+PyConvState* g_lastState = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+// Returns the converter state of the interpreter the calling thread is
+// running in. Must be called with the GIL held.
+inline PyConvState&
+convState()
+{
+	PyInterpreterState* interp = PyThreadState_GET()->interp;
+	if (interp != g_lastInterp)
+	{
+		g_lastState = &g_convStates[interp];
+		g_lastInterp = interp;
+	}
+	return *g_lastState;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+inline String
+classCacheKey(
+	const String& ns,
+	const String& className)
+{
+	String key = ns;
+	key.toLowerCase();
+	String cn = className;
+	cn.toLowerCase();
+	return key + ":" + cn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+inline String
+nsCacheKey(const String& ns)
+{
+	String key = ns;
+	key.toLowerCase();
+	return key;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 void
 py2ConversionException(
@@ -89,8 +193,7 @@ convertPyDateTime(
 	Py::Object arg)
 {
     CIMDateTime cdt; 
-	Py::Object dtclass = g_modpywbem.getAttr("CIMDateTime");
-	if (!arg.isInstanceOf(dtclass))
+	if (!arg.isInstanceOf(convState().types.cimDateTime))
 	{
 		OW_THROW(PyConversionException,
 			"Unknown python type converting to OW CIMDateTime");
@@ -145,44 +248,187 @@ convertPyDateTime(
     return cdt; 
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Create a plain python number for an OW numeric value. Returns a new
+// reference.
+inline PyObject* num2Py(UInt8 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* num2Py(Int8 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* num2Py(UInt16 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* num2Py(Int16 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* num2Py(UInt32 v) { return PyLong_FromUnsignedLong(v); }
+inline PyObject* num2Py(Int32 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* num2Py(UInt64 v) { return PyLong_FromUnsignedLongLong(v); }
+inline PyObject* num2Py(Int64 v) { return PyLong_FromLongLong(v); }
+inline PyObject* num2Py(Real32 v) { return PyFloat_FromDouble(double(v)); }
+inline PyObject* num2Py(Real64 v) { return PyFloat_FromDouble(v); }
+
+//////////////////////////////////////////////////////////////////////////////
+// Makes pywbem numbers from plain python numbers. pywbem numeric types are
+// python subclasses of int, long or float without __new__ or __init__ of
+// their own. Objects of the float and int ones are allocated and filled in
+// here, the way the interpreter does it for subclasses. The long ones go
+// straight to the type's tp_new. Any other callable is called, with an
+// argument tuple that is reused from call to call as long as nobody else
+// holds on to it.
+class NumericCtor
+{
+public:
+	NumericCtor(const Py::Object& pyfunc, const char* func)
+		: m_func(pyfunc.ptr())
+		, m_name(func)
+		, m_args(0)
+		, m_type(0)
+		, m_kind(E_CALL)
+	{
+		if (!PyType_Check(m_func))
+		{
+			return;
+		}
+		PyTypeObject* tp = reinterpret_cast<PyTypeObject*>(m_func);
+		if (!(tp->tp_flags & Py_TPFLAGS_HEAPTYPE)
+			|| tp->tp_init != PyBaseObject_Type.tp_init)
+		{
+			// Only subclasses defined in python are made here
+			return;
+		}
+		m_type = tp;
+		if (tp->tp_new == PyFloat_Type.tp_new)
+		{
+			m_kind = E_FLOAT;
+		}
+		else if (tp->tp_new == PyInt_Type.tp_new)
+		{
+			m_kind = E_INT;
+		}
+		else if (tp->tp_new == PyLong_Type.tp_new)
+		{
+			m_kind = E_NEW;
+		}
+		else
+		{
+			m_type = 0;
+		}
+	}
+
+	~NumericCtor()
+	{
+		Py_XDECREF(m_args);
+	}
+
+	// Steals the reference to rawval. Returns a new reference.
+	PyObject* operator()(PyObject* rawval)
+	{
+		if (!rawval)
+		{
+			throw Py::Exception(Format("Converting value for %1",
+				m_name).c_str());
+		}
+		if ((m_kind == E_FLOAT && PyFloat_CheckExact(rawval))
+			|| (m_kind == E_INT && PyInt_CheckExact(rawval)))
+		{
+			return alloc(rawval);
+		}
+		if (!m_args)
+		{
+			m_args = PyTuple_New(1);
+			if (!m_args)
+			{
+				Py_DECREF(rawval);
+				throw Py::Exception(Format("Calling function %1",
+					m_name).c_str());
+			}
+		}
+		PyTuple_SET_ITEM(m_args, 0, rawval);
+		PyObject* pVal = (m_kind == E_NEW)
+			? m_type->tp_new(m_type, m_args, NULL)
+			: PyObject_Call(m_func, m_args, NULL);
+		if (m_args->ob_refcnt == 1)
+		{
+			PyTuple_SET_ITEM(m_args, 0, NULL);
+			Py_DECREF(rawval);
+		}
+		else
+		{
+			// The callee kept the tuple. Let it go and make a new one
+			// next time around.
+			Py_DECREF(m_args);
+			m_args = 0;
+		}
+		if (!pVal)
+		{
+			throw Py::Exception(Format("Calling function %1", m_name).c_str());
+		}
+		return pVal;
+	}
+
+private:
+	NumericCtor(const NumericCtor&);
+	NumericCtor& operator=(const NumericCtor&);
+
+	enum Kind { E_CALL, E_FLOAT, E_INT, E_NEW };
+
+	// Same as float_subtype_new and int_subtype_new. Steals rawval.
+	PyObject* alloc(PyObject* rawval)
+	{
+		PyObject* pVal = m_type->tp_alloc(m_type, 0);
+		if (pVal)
+		{
+			if (m_kind == E_FLOAT)
+			{
+				reinterpret_cast<PyFloatObject*>(pVal)->ob_fval =
+					PyFloat_AS_DOUBLE(rawval);
+			}
+			else
+			{
+				reinterpret_cast<PyIntObject*>(pVal)->ob_ival =
+					PyInt_AS_LONG(rawval);
+			}
+		}
+		Py_DECREF(rawval);
+		if (!pVal)
+		{
+			throw Py::Exception(Format("Calling function %1", m_name).c_str());
+		}
+		return pVal;
+	}
+
+	PyObject* m_func;
+	const char* m_name;
+	PyObject* m_args;
+	PyTypeObject* m_type;	// Set unless the function is called
+	Kind m_kind;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 template <typename T>
 Py::Object
 numericOW2Py(
-	const char* format,
+	const Py::Object& pyfunc,
 	const char* func, 
 	const CIMValue& owval)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr(func);
+	NumericCtor ctor(pyfunc, func);
     if (owval.isArray())
     {
 		Array<T> val;
 		owval.get(val); 
-		Py::List vlist;
-
-		for (size_t i = 0; i < val.size(); ++i)
+		size_t sz = val.size();
+		PyObject* plist = PyList_New(sz);
+		if (!plist)
 		{
-			PyObject* pVal = PyObject_CallFunction(pyfunc.ptr(),
-				const_cast<char*>(format), val[i]);
-			if (!pVal)
-			{
-				throw Py::Exception(Format("Calling function %1", func).c_str());
-			}
-			vlist.append(Py::Object(pVal, true));
+			throw Py::Exception(Format("Calling function %1", func).c_str());
+		}
+		Py::List vlist(plist, true);
+		for (size_t i = 0; i < sz; ++i)
+		{
+			PyList_SET_ITEM(plist, i, ctor(num2Py(val[i])));
 		}
-
 		return vlist; 
     }
 
 	T val;
 	owval.get(val); 
-	PyObject* pVal = PyObject_CallFunction(pyfunc.ptr(),
-		const_cast<char*>(format), val);
-	if (!pVal)
-	{
-		throw Py::Exception(Format("Calling function %1", func).c_str());
-	}
-	return Py::Object(pVal, true);
+	return Py::Object(ctor(num2Py(val)), true);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -193,7 +439,7 @@ convertOWDateTime(const CIMDateTime& dt)
 	{
 		try
 		{
-			Py::Callable pyfunc = g_modpywbem.getAttr("timedelta");
+			Py::Callable pyfunc = convState().types.timedelta;
 			Py::Tuple pyarg = Py::Tuple(7);
 			pyarg[0] = Py::Int(int(dt.getDays()));
 			pyarg[1] = Py::Int(int(dt.getSeconds()));
@@ -203,7 +449,7 @@ convertOWDateTime(const CIMDateTime& dt)
 			pyarg[5] = Py::Int(int(dt.getHours()));
 			pyarg[6] = Py::Int(0);
                         Py::Object td(pyfunc.apply(pyarg)); 
-                        pyfunc = g_modpywbem.getAttr("CIMDateTime"); 
+                        pyfunc = convState().types.cimDateTime;
                         Py::Tuple dtarg = Py::Tuple(1);
                         dtarg[0] = td; 
 			return pyfunc.apply(dtarg);
@@ -216,12 +462,11 @@ convertOWDateTime(const CIMDateTime& dt)
 
 	try
 	{
-		//Py::Callable pyfunc = g_modpywbem.getAttr("CIMDateTime");
-                Py::Callable func = g_modpywbem.getAttr("MinutesFromUTC"); 
+                Py::Callable func = convState().types.minutesFromUTC;
                 Py::Tuple utc_pyarg(1);
                 utc_pyarg[0] = Py::Int(int(dt.getUtc())); 
                 Py::Object utc(func.apply(utc_pyarg)); 
-		func = g_modpywbem.getAttr("datetime");
+		func = convState().types.datetime;
 		Py::Tuple pyarg(8);
 		pyarg[0] = Py::Int(int(dt.getYear()));
 		pyarg[1] = Py::Int(int(dt.getMonth()));
@@ -232,7 +477,7 @@ convertOWDateTime(const CIMDateTime& dt)
 		pyarg[6] = Py::Int(int(dt.getMicroSeconds()));
 		pyarg[7] = utc; 
                 Py::Object dt(func.apply(pyarg));
-		func = g_modpywbem.getAttr("CIMDateTime");
+		func = convState().types.cimDateTime;
                 Py::Tuple cdtarg(1);
                 cdtarg[0] = dt; 
                 return func.apply(cdtarg); 
@@ -245,6 +490,255 @@ convertOWDateTime(const CIMDateTime& dt)
 	return Py::None();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Element converters used by PyVal2OW. Exact int and float objects are
+// converted directly; anything else goes through the python number protocol.
+template <typename T>
+T
+pyToUnsigned(PyObject* pyob)
+{
+	unsigned long val;
+	if (PyInt_CheckExact(pyob))
+	{
+		long sval = PyInt_AS_LONG(pyob);
+		if (sval < 0)
+		{
+			OW_THROW(PyConversionException, Format("Negative value %1 "
+				"given for an unsigned %2 bit CIM type", Int64(sval),
+				int(sizeof(T) * 8)).c_str());
+		}
+		val = (unsigned long)sval;
+	}
+	else
+	{
+		// Raises for negative values
+		val = Py::Int(Py::Object(pyob)).asUnsignedLong();
+	}
+	if (val > (unsigned long)std::numeric_limits<T>::max())
+	{
+		OW_THROW(PyConversionException, Format("Value %1 is out of range "
+			"for an unsigned %2 bit CIM type", UInt64(val),
+			int(sizeof(T) * 8)).c_str());
+	}
+	return T(val);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+T
+pyToSigned(PyObject* pyob)
+{
+	long val;
+	if (PyInt_CheckExact(pyob))
+	{
+		val = PyInt_AS_LONG(pyob);
+	}
+	else
+	{
+		val = Py::Int(Py::Object(pyob)).asLong();
+	}
+	if (val < (long)std::numeric_limits<T>::min()
+		|| val > (long)std::numeric_limits<T>::max())
+	{
+		OW_THROW(PyConversionException, Format("Value %1 is out of range "
+			"for a signed %2 bit CIM type", Int64(val),
+			int(sizeof(T) * 8)).c_str());
+	}
+	return T(val);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+UInt64
+pyToUInt64(PyObject* pyob)
+{
+	return UInt64(Py::LongLong(Py::Object(pyob)).asUnsignedLongLong());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Int64
+pyToInt64(PyObject* pyob)
+{
+	return Int64(Py::LongLong(Py::Object(pyob)).asLongLong());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+T
+pyToReal(PyObject* pyob)
+{
+	if (PyFloat_CheckExact(pyob))
+	{
+		return T(PyFloat_AS_DOUBLE(pyob));
+	}
+	return T(Py::Float(Py::Object(pyob)).as_double());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Bool
+pyToBool(PyObject* pyob)
+{
+	int rc = PyObject_IsTrue(pyob);
+	if (rc < 0)
+	{
+		throw Py::Exception();
+	}
+	return Bool(rc != 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+String
+pyToString(PyObject* pyob)
+{
+	return Py::String(pyob).as_ow_string();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMDateTime
+pyToDateTime(PyObject* pyob)
+{
+	return convertPyDateTime(Py::Object(pyob));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMObjectPath
+pyToRef(PyObject* pyob)
+{
+	return OWPyConv::PyRef2OW(Py::Object(pyob));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMInstance
+pyToInst(PyObject* pyob)
+{
+	return OWPyConv::PyInst2OW(Py::Object(pyob));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMClass
+pyToClass(PyObject* pyob)
+{
+	return OWPyConv::PyClass2OW(Py::Object(pyob));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+inline bool
+isPySequence(const Py::Object& pyval)
+{
+	return PyList_Check(pyval.ptr()) || PyTuple_Check(pyval.ptr());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Convert a python list or tuple into a preallocated OW Array without
+// creating a wrapper object for every element.
+template <typename T, T (*conv)(PyObject*)>
+CIMValue
+pySeq2OW(const Py::Object& pyval)
+{
+	PyObject* seq = pyval.ptr();
+	size_t sz = size_t(PySequence_Fast_GET_SIZE(seq));
+	PyObject** items = PySequence_Fast_ITEMS(seq);
+	Array<T> ra(sz);
+	for (size_t i = 0; i < sz; i++)
+	{
+		ra[i] = conv(items[i]);
+	}
+	return CIMValue(ra);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Convert a scalar or, if pyval is a list or tuple, an array value
+template <typename T, T (*conv)(PyObject*)>
+inline CIMValue
+py2OW(const Py::Object& pyval)
+{
+	if (isPySequence(pyval))
+	{
+		return pySeq2OW<T, conv>(pyval);
+	}
+	return CIMValue(conv(pyval.ptr()));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+typedef CIMValue (*Py2OWFunc)(const Py::Object&);
+
+//////////////////////////////////////////////////////////////////////////////
+// Convert the value of an EmbeddedObject property, which can hold either
+// classes or instances. The first element decides for arrays.
+CIMValue
+py2OWEmbeddedObject(const Py::Object& pyval)
+{
+	Py::Object first = pyval;
+	if (isPySequence(pyval))
+	{
+		if (PySequence_Fast_GET_SIZE(pyval.ptr()) == 0)
+		{
+			return py2OW<CIMInstance, pyToInst>(pyval);
+		}
+		first = Py::Object(PySequence_Fast_GET_ITEM(pyval.ptr(), 0));
+	}
+	if (first.isInstanceOf(convState().types.cimClass))
+	{
+		return py2OW<CIMClass, pyToClass>(pyval);
+	}
+	return py2OW<CIMInstance, pyToInst>(pyval);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the converter for python values of the given CIM type
+Py2OWFunc
+getPy2OWFunc(CIMDataType::Type type)
+{
+	switch (type)
+	{
+		case CIMDataType::BOOLEAN:
+			return &py2OW<Bool, pyToBool>;
+		case CIMDataType::STRING:
+			return &py2OW<String, pyToString>;
+		case CIMDataType::UINT8:
+			return &py2OW<UInt8, pyToUnsigned<UInt8> >;
+		case CIMDataType::SINT8:
+			return &py2OW<Int8, pyToSigned<Int8> >;
+		case CIMDataType::UINT16:
+			return &py2OW<UInt16, pyToUnsigned<UInt16> >;
+		case CIMDataType::SINT16:
+			return &py2OW<Int16, pyToSigned<Int16> >;
+		case CIMDataType::UINT32:
+			return &py2OW<UInt32, pyToUnsigned<UInt32> >;
+		case CIMDataType::SINT32:
+			return &py2OW<Int32, pyToSigned<Int32> >;
+		case CIMDataType::UINT64:
+			return &py2OW<UInt64, pyToUInt64>;
+		case CIMDataType::SINT64:
+			return &py2OW<Int64, pyToInt64>;
+		case CIMDataType::REAL32:
+			return &py2OW<Real32, pyToReal<Real32> >;
+		case CIMDataType::REAL64:
+			return &py2OW<Real64, pyToReal<Real64> >;
+		case CIMDataType::CHAR16:
+			OW_THROW(PyConversionException,
+				"Unable to convert to OW from python char16");
+		case CIMDataType::DATETIME:
+			return &py2OW<CIMDateTime, pyToDateTime>;
+		case CIMDataType::REFERENCE:
+			return &py2OW<CIMObjectPath, pyToRef>;
+		case CIMDataType::EMBEDDEDINSTANCE:
+			return &py2OW<CIMInstance, pyToInst>;
+		case CIMDataType::EMBEDDEDCLASS:
+			return &py2OW<CIMClass, pyToClass>;
+		default:
+			break;
+	}
+
+	String typeName = OWPyConv::OWDataType2Py(type);
+	if (typeName.empty())
+	{
+		typeName = CIMDataType(type).toString();
+	}
+	OW_THROW(PyConversionException,
+		Format("Unknown python data type for conversion: %1", typeName).c_str());
+	return 0;	// Shouldn't hit here
+}
+
 //////////////////////////////////////////////////////////////////////////////
 Py::Dict
 makeQualDict(const CIMQualifierArray& quals)
@@ -318,7 +812,72 @@ void
 OWPyConv::setPyWbemMod(
 	const Py::Module& mod)
 {
-	g_modpywbem = mod;
+	PyConvState& state = convState();
+	state.mod = mod;
+	state.types.cimInstance = mod.getAttr("CIMInstance");
+	state.types.cimInstanceName = mod.getAttr("CIMInstanceName");
+	state.types.cimClassName = mod.getAttr("CIMClassName");
+	state.types.cimClass = mod.getAttr("CIMClass");
+	state.types.cimProperty = mod.getAttr("CIMProperty");
+	state.types.cimQualifier = mod.getAttr("CIMQualifier");
+	state.types.cimQualifierDecl = mod.getAttr("CIMQualifierDeclaration");
+	state.types.cimParameter = mod.getAttr("CIMParameter");
+	state.types.cimMethod = mod.getAttr("CIMMethod");
+	state.types.cimDateTime = mod.getAttr("CIMDateTime");
+	state.types.minutesFromUTC = mod.getAttr("MinutesFromUTC");
+	state.types.datetime = mod.getAttr("datetime");
+	state.types.timedelta = mod.getAttr("timedelta");
+	state.types.uint8 = mod.getAttr("Uint8");
+	state.types.sint8 = mod.getAttr("Sint8");
+	state.types.uint16 = mod.getAttr("Uint16");
+	state.types.sint16 = mod.getAttr("Sint16");
+	state.types.uint32 = mod.getAttr("Uint32");
+	state.types.sint32 = mod.getAttr("Sint32");
+	state.types.uint64 = mod.getAttr("Uint64");
+	state.types.sint64 = mod.getAttr("Sint64");
+	state.types.real32 = mod.getAttr("Real32");
+	state.types.real64 = mod.getAttr("Real64");
+	// Cached objects were created from the previous module
+	state.classCache.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+OWPyConv::checkPyWbemMod()
+{
+	PyConvState& state = convState();
+	if (state.mod.isNone())
+	{
+		return;
+	}
+	// If pywbem has been reloaded, its classes are new objects and the
+	// pinned ones are stale.
+	if (state.mod.getAttr("CIMInstance").ptr()
+		!= state.types.cimInstance.ptr())
+	{
+		Py::Module mod(state.mod);
+		setPyWbemMod(mod);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+Py::Module
+OWPyConv::getPyWbemMod()
+{
+	return convState().mod;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+OWPyConv::dropInterpreterState()
+{
+	PyInterpreterState* interp = PyThreadState_GET()->interp;
+	g_convStates.erase(interp);
+	g_lastInterp = 0;
+	g_lastState = 0;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -394,45 +953,66 @@ CIMDataType::Type
 OWPyConv::PyDataType2OW(
 	const String& strt)
 {
-	CIMDataType::Type dtype;
-	if (strt == "char16")
-		dtype = CIMDataType::CHAR16;
-	else if (strt == "reference")
-		dtype =  CIMDataType::REFERENCE;
-	else if (strt == "datetime")
-		dtype =  CIMDataType::DATETIME;
-	else if (strt == "boolean")
-		dtype =  CIMDataType::BOOLEAN;
-	else if (strt == "real32")
-		dtype =  CIMDataType::REAL32;
-	else if (strt == "real64")
-		dtype =  CIMDataType::REAL64;
-	else if (strt == "sint8")
-		dtype =  CIMDataType::SINT8;
-	else if (strt == "sint16")
-		dtype =  CIMDataType::SINT16;
-	else if (strt == "sint32")
-		dtype =  CIMDataType::SINT32;
-	else if (strt == "sint64")
-		dtype =  CIMDataType::SINT64;
-	else if (strt == "uint8")
-		dtype =  CIMDataType::UINT8;
-	else if (strt == "uint16")
-		dtype =  CIMDataType::UINT16;
-	else if (strt == "uint32")
-		dtype =  CIMDataType::UINT32;
-	else if (strt == "uint64")
-		dtype =  CIMDataType::UINT64;
-	else if (strt == "string")
-		dtype =  CIMDataType::STRING;
-	else if (strt == "class")
-		dtype =  CIMDataType::EMBEDDEDCLASS;
-	else if (strt == "instance")
-		dtype =  CIMDataType::EMBEDDEDINSTANCE;
-	else
-		OW_THROW(PyConversionException,
-			Format("Unknown python type encountered in PyDataType2OW: %1",strt).c_str());
-	return dtype;
+	// Dispatch on the first character so a type name costs at most a
+	// couple of comparisons instead of walking the whole list.
+	const char* p = strt.c_str();
+	switch (p[0])
+	{
+		case 'b':
+			if (strt == "boolean")
+				return CIMDataType::BOOLEAN;
+			break;
+		case 'c':
+			if (strt == "char16")
+				return CIMDataType::CHAR16;
+			if (strt == "class")
+				return CIMDataType::EMBEDDEDCLASS;
+			break;
+		case 'd':
+			if (strt == "datetime")
+				return CIMDataType::DATETIME;
+			break;
+		case 'i':
+			if (strt == "instance")
+				return CIMDataType::EMBEDDEDINSTANCE;
+			break;
+		case 'r':
+			if (strt == "reference")
+				return CIMDataType::REFERENCE;
+			if (strt == "real32")
+				return CIMDataType::REAL32;
+			if (strt == "real64")
+				return CIMDataType::REAL64;
+			break;
+		case 's':
+			if (strt == "string")
+				return CIMDataType::STRING;
+			if (strt == "sint8")
+				return CIMDataType::SINT8;
+			if (strt == "sint16")
+				return CIMDataType::SINT16;
+			if (strt == "sint32")
+				return CIMDataType::SINT32;
+			if (strt == "sint64")
+				return CIMDataType::SINT64;
+			break;
+		case 'u':
+			if (strt == "uint8")
+				return CIMDataType::UINT8;
+			if (strt == "uint16")
+				return CIMDataType::UINT16;
+			if (strt == "uint32")
+				return CIMDataType::UINT32;
+			if (strt == "uint64")
+				return CIMDataType::UINT64;
+			break;
+		default:
+			break;
+	}
+	OW_THROW(PyConversionException,
+		Format("Unknown python type encountered in PyDataType2OW: %1",strt).c_str());
+	// Shouldn't hit here
+	return CIMDataType::INVALID;
 }
 
 
@@ -512,25 +1092,25 @@ OWPyConv::OWVal2Py(const CIMValue& owval)
 		}
 
 		case CIMDataType::REAL32:
-			return numericOW2Py<Real32>("(d)", "Real32", owval);
+			return numericOW2Py<Real32>(convState().types.real32, "Real32", owval);
 		case CIMDataType::REAL64:
-			return numericOW2Py<Real64>("(d)", "Real64", owval);
+			return numericOW2Py<Real64>(convState().types.real64, "Real64", owval);
 		case CIMDataType::SINT8:
-			return numericOW2Py<Int8>("(b)", "Sint8", owval);
+			return numericOW2Py<Int8>(convState().types.sint8, "Sint8", owval);
 		case CIMDataType::SINT16:
-			return numericOW2Py<Int16>("(h)", "Sint16", owval);
+			return numericOW2Py<Int16>(convState().types.sint16, "Sint16", owval);
 		case CIMDataType::SINT32:
-			return numericOW2Py<Int32>("(i)", "Sint32", owval);
+			return numericOW2Py<Int32>(convState().types.sint32, "Sint32", owval);
 		case CIMDataType::SINT64:
-			return numericOW2Py<Int64>("(L)", "Sint64", owval);
+			return numericOW2Py<Int64>(convState().types.sint64, "Sint64", owval);
 		case CIMDataType::UINT8:
-			return numericOW2Py<UInt8>("(k)", "Uint8", owval);
+			return numericOW2Py<UInt8>(convState().types.uint8, "Uint8", owval);
 		case CIMDataType::UINT16:
-			return numericOW2Py<UInt16>("(k)", "Uint16", owval);
+			return numericOW2Py<UInt16>(convState().types.uint16, "Uint16", owval);
 		case CIMDataType::UINT32:
-			return numericOW2Py<UInt32>("(k)", "Uint32", owval);
+			return numericOW2Py<UInt32>(convState().types.uint32, "Uint32", owval);
 		case CIMDataType::UINT64:
-			return numericOW2Py<UInt64>("(K)", "Uint64", owval);
+			return numericOW2Py<UInt64>(convState().types.uint64, "Uint64", owval);
 		case CIMDataType::STRING:
 		{
 			if (owval.isArray())
@@ -567,7 +1147,7 @@ OWPyConv::OWRef2Py(const CIMObjectPath& cop)
 {
 	if (cop.isClassPath())
 	{
-		Py::Callable pyfunc = g_modpywbem.getAttr("CIMClassName");
+		Py::Callable pyfunc = convState().types.cimClassName;
 		Py::Tuple args(3);
 		args[0] = Py::String(cop.getClassName());
 		args[1] = Py::String(cop.getHost());
@@ -575,7 +1155,7 @@ OWPyConv::OWRef2Py(const CIMObjectPath& cop)
 		return pyfunc.apply(args);
 	}
 
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMInstanceName");
+	Py::Callable pyfunc = convState().types.cimInstanceName;
 	Py::Dict dict;
 
     CIMPropertyArray cpa = cop.getKeys();
@@ -605,7 +1185,7 @@ OWPyConv::OWRef2Py(const CIMObjectPath& cop)
 Py::Object
 OWPyConv::OWInst2Py(const CIMInstance& ci, const String& nsArg)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMInstance");
+	Py::Callable pyfunc = convState().types.cimInstance;
 	Py::Tuple pyarg(4);
 	pyarg[0] = Py::String(ci.getClassName());
 	pyarg[1] = makePropDict(ci.getProperties());
@@ -637,7 +1217,7 @@ OWPyConv::OWInst2Py(const CIMInstance& ci, const String& nsArg)
 Py::Object
 OWPyConv::OWQual2Py(const CIMQualifier& qual)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMQualifier");
+	Py::Callable pyfunc = convState().types.cimQualifier;
 	Py::Tuple pyarg(8);
 	pyarg[0] = Py::String(qual.getName());
 	Py::Object qval;
@@ -666,7 +1246,7 @@ OWPyConv::OWQual2Py(const CIMQualifier& qual)
 Py::Object
 OWPyConv::OWQualType2Py(const CIMQualifierType& qualt)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMQualifierDeclaration");
+	Py::Callable pyfunc = convState().types.cimQualifierDecl;
 	Py::Tuple pyarg(7);
 	pyarg[0] = Py::String(qualt.getName());		// name
 	Py::Object pqvalt;
@@ -773,7 +1353,7 @@ OWPyConv::OWQualType2Py(const CIMQualifierType& qualt)
 Py::Object
 OWPyConv::OWCIMParam2Py(const CIMParameter& param)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMParameter");
+	Py::Callable pyfunc = convState().types.cimParameter;
 	Py::Tuple pyarg(6);
 	pyarg[0] = Py::String(param.getName());	// name
 	CIMDataType dt = param.getType();
@@ -793,7 +1373,7 @@ OWPyConv::OWCIMParam2Py(const CIMParameter& param)
 Py::Object
 OWPyConv::OWMeth2Py(const CIMMethod& meth)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMMethod");
+	Py::Callable pyfunc = convState().types.cimMethod;
 	Py::Tuple pyarg(6);
 	pyarg[0] = Py::String(meth.getName());
 	pyarg[1] = Py::String(OWDataType2Py(meth.getReturnType().getType()));
@@ -815,7 +1395,7 @@ OWPyConv::OWMeth2Py(const CIMMethod& meth)
 Py::Object
 OWPyConv::OWProperty2Py(const CIMProperty& prop)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMProperty");
+	Py::Callable pyfunc = convState().types.cimProperty;
 	Py::Tuple pyarg(10);
 	pyarg[0] = Py::String(prop.getName());	// name
 
@@ -875,7 +1455,7 @@ OWPyConv::OWProperty2Py(const CIMProperty& prop)
 Py::Object
 OWPyConv::OWClass2Py(const CIMClass& cls)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMClass");
+	Py::Callable pyfunc = convState().types.cimClass;
 	Py::Tuple pyarg(5);
 	pyarg[0] = Py::String(cls.getName());
 	pyarg[1] = makePropDict(cls.getProperties());
@@ -896,11 +1476,81 @@ OWPyConv::OWClass2Py(const CIMClass& cls)
 	return pyfunc.apply(pyarg);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+Py::Object
+OWPyConv::OWCachedClass2Py(
+	const CIMClass& cls,
+	const String& ns)
+{
+	if (!cls || ns.empty() || g_classCacheTTL == 0)
+	{
+		return OWClass2Py(cls);
+	}
+
+	UInt32 gen = g_schemaGen[nsCacheKey(ns)];
+	time_t now = ::time(NULL);
+	CachedClass& entry = convState().classCache[classCacheKey(ns, cls.getName())];
+	if (entry.pycls.isNone() || entry.generation != gen
+		|| now - entry.loadTime >= time_t(g_classCacheTTL)
+		|| now < entry.loadTime)
+	{
+		entry.pycls = OWClass2Py(cls);
+		entry.generation = gen;
+		entry.loadTime = now;
+	}
+	// The caller gets its own dictionaries, so adding or removing
+	// properties, methods or qualifiers doesn't show in other requests
+	return Py::Callable(entry.pycls.getAttr("copy")).apply(Py::Tuple());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+OWPyConv::setClassCacheTTL(
+	UInt32 secs)
+{
+	g_classCacheTTL = secs;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+OWPyConv::invalidateClassCache(
+	const String& ns)
+{
+	// A change to any class can affect its subclasses, so the whole
+	// namespace is invalidated by bumping its schema generation.
+	String nskey = nsCacheKey(ns);
+	++g_schemaGen[nskey];
+	String prefix = nskey + ":";
+	ClassCacheMap& classCache = convState().classCache;
+	ClassCacheMap::iterator it = classCache.begin();
+	while (it != classCache.end())
+	{
+		if (it->first.startsWith(prefix))
+		{
+			classCache.erase(it++);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // STATIC
 CIMInstance
 OWPyConv::PyInst2OW(const Py::Object& pyci, const String& nsArg)
 {
+	if (PyLazyInstance::check(pyci))
+	{
+		// Instance we gave the provider. No need to convert it back
+		// unless the provider forced it into a pywbem.CIMInstance
+		return static_cast<PyLazyInstance*>(pyci.ptr())->toOW(nsArg);
+	}
+
 	String ns;
     CIMInstance inst(stringAttr(pyci, "classname"));
 
@@ -944,9 +1594,9 @@ OWPyConv::PyRef2OW(
 	CIMObjectPath cop(className, ns);
 	Py::Mapping kb = pycop.getAttr("keybindings");
 	Py::List items = kb.items();
-	Py::Object pciName = g_modpywbem.getAttr("CIMInstanceName");
-	Py::Object pciClassName = g_modpywbem.getAttr("CIMClassName");
-	Py::Object pciDateTime = g_modpywbem.getAttr("CIMDateTime");
+	const Py::Object& pciName = convState().types.cimInstanceName;
+	const Py::Object& pciClassName = convState().types.cimClassName;
+	const Py::Object& pciDateTime = convState().types.cimDateTime;
 	
 	for (int i = 0; i < int(items.length()); i++)
 	{
@@ -963,11 +1613,11 @@ OWPyConv::PyRef2OW(
 
 		if (pkval.isBool())
 		{
-			cv = PyVal2OW("boolean", pkval);
+			cv = PyVal2OW(CIMDataType::BOOLEAN, pkval);
 		}
 		else if (pkval.isString())
 		{
-			cv = PyVal2OW("string", pkval);
+			cv = PyVal2OW(CIMDataType::STRING, pkval);
 		}
 		else if (pkval.isInt())
 		{
@@ -997,16 +1647,16 @@ OWPyConv::PyRef2OW(
 		}
 		else if (pkval.isFloat())
 		{
-			cv = PyVal2OW("real64", pkval); 
+			cv = PyVal2OW(CIMDataType::REAL64, pkval); 
 		}
 		else if (pkval.isInstanceOf(pciClassName)
 			|| pkval.isInstanceOf(pciName))
 		{
-			cv = PyVal2OW("reference", pkval); 
+			cv = PyVal2OW(CIMDataType::REFERENCE, pkval); 
 		}
 		else if (pkval.isInstanceOf(pciDateTime))
 		{
-			cv = PyVal2OW("datetime", pkval);
+			cv = PyVal2OW(CIMDataType::DATETIME, pkval);
 		}
 		else
 		{
@@ -1020,263 +1670,204 @@ OWPyConv::PyRef2OW(
 }
 
 //////////////////////////////////////////////////////////////////////////////
-// STATIC
-CIMValue
-OWPyConv::PyVal2OW(
-	const String& type,
-	const Py::Object& pyval)
+OWPyKeyTupleConv::OWPyKeyTupleConv(
+	const CIMClass& cls,
+	const String& ns)
+	: m_className(cls.getName())
+	, m_ns(ns)
+	, m_keyNames()
+	, m_keyTypes()
 {
-	if (type == "boolean")
+	CIMPropertyArray keys = cls.getKeys();
+	for (CIMPropertyArray::size_type i = 0; i < keys.size(); i++)
 	{
-		if (pyval.isList())
-		{
-			Py::List bl(pyval);
-			size_t sz = bl.length();
-			Array<Bool> bra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-					bra[i] = bl[i].isTrue();
-			}
-			return CIMValue(bra);
-		}
-		return CIMValue(Bool(pyval.isTrue()));
+		m_keyNames.append(keys[i].getName());
+		m_keyTypes.append(keys[i].getDataType().getType());
 	}
-	else if (type == "string")
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMObjectPath
+OWPyKeyTupleConv::PyKeyTuple2OW(
+	const Py::Object& pykeys) const
+{
+	PyObject* tup = pykeys.ptr();
+	size_t sz = size_t(PyTuple_GET_SIZE(tup));
+	if (sz != m_keyNames.size())
 	{
-		if (pyval.isList())
-		{
-			Py::List sl(pyval);
-			size_t sz = sl.length();
-			StringArray sra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				sra[i] = Py::String(sl[i]).as_ow_string();
-			}
-			return CIMValue(sra);
-		}
-		return CIMValue(Py::String(pyval).as_ow_string());
+		OW_THROW(PyConversionException, Format("Key tuple for class %1 has "
+			"%2 values. Expected %3", m_className, UInt32(sz),
+			UInt32(m_keyNames.size())).c_str());
 	}
-	else if (type == "uint8")
+
+	CIMObjectPath cop(m_className, m_ns);
+	for (size_t i = 0; i < sz; i++)
 	{
-		if (pyval.isList())
+		PyObject* pkval = PyTuple_GET_ITEM(tup, i);
+		if (pkval == Py_None)
 		{
-			Py::List il(pyval);
-			size_t sz = il.length();
-			UInt8Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = UInt8(Py::Int(il[i]).asUnsignedLong());
-			}
-			return CIMValue(nra);
+			OW_THROW(PyConversionException, Format("Key tuple for class %1 "
+				"has no value for key %2", m_className,
+				m_keyNames[i]).c_str());
 		}
-		return CIMValue(UInt8(Py::Int(pyval).asUnsignedLong()));
+		cop.setKeyValue(CIMName(m_keyNames[i]),
+			OWPyConv::PyVal2OW(m_keyTypes[i], Py::Object(pkval)));
 	}
-	else if (type == "sint8")
-    {
-		if (pyval.isList())
-		{
-			Py::List il(pyval);
-			size_t sz = il.length();
-			Int8Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = Int8(Py::Int(il[i]).asLong());
-			}
-			return CIMValue(nra);
-		}
-		return CIMValue(Int8(Py::Int(pyval).asLong()));
+	return cop;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+CIMValue
+OWPyConv::PyVal2OW(
+	const String& type,
+	const Py::Object& pyval)
+{
+	return PyVal2OW(PyDataType2OW(type), pyval);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+CIMValue
+OWPyConv::PyVal2OW(
+	CIMDataType::Type type,
+	const Py::Object& pyval)
+{
+	return getPy2OWFunc(type)(pyval);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+bool
+OWPyConv::isPyInstBatch(
+	const Py::Object& pyobj)
+{
+	// (classname, [propname, ...], [column, ...])
+	PyObject* pyob = pyobj.ptr();
+	if (!PyTuple_Check(pyob) || PyTuple_GET_SIZE(pyob) != 3)
+	{
+		return false;
 	}
-	else if (type == "uint16")
-    {
-		if (pyval.isList())
+	PyObject* pycn = PyTuple_GET_ITEM(pyob, 0);
+	return (PyString_Check(pycn) || PyUnicode_Check(pycn))
+		&& isPySequence(Py::Object(PyTuple_GET_ITEM(pyob, 1)))
+		&& isPySequence(Py::Object(PyTuple_GET_ITEM(pyob, 2)));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+String
+OWPyConv::getPyInstBatchClassName(
+	const Py::Object& pybatch)
+{
+	Py::Tuple batch(pybatch);
+	return Py::String(batch[0]).as_ow_string();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+CIMInstanceArray
+OWPyConv::PyInstBatch2OW(
+	const Py::Object& pybatch,
+	const CIMClass& cls,
+	const String& ns)
+{
+	Py::Tuple batch(pybatch);
+	String className = Py::String(batch[0]).as_ow_string();
+	Py::Sequence pynames(batch[1]);
+	Py::Sequence pycols(batch[2]);
+	size_t ncols = size_t(pynames.length());
+	if (size_t(pycols.length()) != ncols)
+	{
+		OW_THROW(PyConversionException, Format("Instance batch for class %1 "
+			"has %2 property names but %3 columns", className, UInt32(ncols),
+			pycols.length()).c_str());
+	}
+
+	// Resolve the type and converter of every column once, using the
+	// property definitions from the class
+	CIMPropertyArray props(ncols);
+	Array<Py2OWFunc> convs(ncols);
+	Array<bool> isKey(ncols);
+	std::vector<Py::Object> cols(ncols);
+	size_t nrows = 0;
+	for (size_t c = 0; c < ncols; c++)
+	{
+		String name = Py::String(pynames[c]).as_ow_string();
+		CIMProperty cp = cls.getProperty(name);
+		if (!cp)
 		{
-			Py::List il(pyval);
-			size_t sz = il.length();
-			UInt16Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = UInt16(Py::Int(il[i]).asUnsignedLong());
-			}
-			return CIMValue(nra);
+			OW_THROW(PyConversionException, Format("Instance batch property "
+				"%1 is not defined in class %2", name, cls.getName()).c_str());
 		}
-		return CIMValue(UInt16(Py::Int(pyval).asUnsignedLong()));
-	}
-	else if (type == "sint16")
-    {
-		if (pyval.isList())
+		CIMDataType dt = cp.getDataType();
+		CIMDataType::Type valType = dt.getType();
+		if (valType == CIMDataType::STRING
+			&& cp.getQualifier("EmbeddedInstance"))
 		{
-			Py::List il(pyval);
-			size_t sz = il.length();
-			Int16Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = Int16(Py::Int(il[i]).asLong());
-			}
-			return CIMValue(nra);
+			convs[c] = getPy2OWFunc(CIMDataType::EMBEDDEDINSTANCE);
 		}
-		return CIMValue(Int16(Py::Int(pyval).asLong()));
-	}
-	else if (type == "uint32")
-    {
-		if (pyval.isList())
+		else if (valType == CIMDataType::STRING
+			&& cp.getQualifier("EmbeddedObject"))
 		{
-			Py::List il(pyval);
-			size_t sz = il.length();
-			UInt32Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = UInt32(Py::Int(il[i]).asUnsignedLong());
-			}
-			return CIMValue(nra);
+			convs[c] = &py2OWEmbeddedObject;
 		}
-		return CIMValue(UInt32(Py::Int(pyval).asUnsignedLong()));
-	}
-	else if (type == "sint32")
-    {
-		if (pyval.isList())
+		else
 		{
-			Py::List il(pyval);
-			size_t sz = il.length();
-			Int32Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = Int32(Py::Int(il[i]).asLong());
-			}
-			return CIMValue(nra);
+			convs[c] = getPy2OWFunc(valType);
 		}
-		return CIMValue(Int32(Py::Int(pyval).asLong()));
-	}
-	else if (type == "uint64")
-    {
-		if (pyval.isList())
+		isKey[c] = cp.isKey();
+		props[c] = CIMProperty(cp.getName());
+		props[c].setDataType(dt);
+
+		PyObject* col = PySequence_Fast(Py::Object(pycols[c]).ptr(),
+			"Instance batch columns must be sequences");
+		if (!col)
 		{
-			Py::List il(pyval);
-			size_t sz = il.length();
-			UInt64Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = UInt64(Py::LongLong(il[i]).asUnsignedLongLong());
-			}
-			return CIMValue(nra);
+			throw Py::Exception();
 		}
-		return CIMValue(UInt64(Py::LongLong(pyval).asUnsignedLongLong()));
-	}
-	else if (type == "sint64")
-    {
-		if (pyval.isList())
+		cols[c] = Py::Object(col, true);
+		size_t len = size_t(PySequence_Fast_GET_SIZE(col));
+		if (c == 0)
 		{
-			Py::List il(pyval);
-			size_t sz = il.length();
-			Int64Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = Int64(Py::LongLong(il[i]).asLongLong());
-			}
-			return CIMValue(nra);
+			nrows = len;
 		}
-		return CIMValue(Int64(Py::LongLong(pyval).asLongLong()));
-	}
-	else if (type == "real32")
-	{
-		if (pyval.isList())
+		else if (len != nrows)
 		{
-			Py::List fl(pyval);
-			size_t sz = fl.length();
-			Real32Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = Real32(Py::Float(fl[i]).as_double());
-			}
-			return CIMValue(nra);
+			OW_THROW(PyConversionException, Format("Instance batch column %1 "
+				"has %2 values. Expected %3", name, UInt32(len),
+				UInt32(nrows)).c_str());
 		}
-		return CIMValue(Real32(Py::Float(pyval).as_double()));
 	}
-	else if (type == "real64")
+
+	CIMInstanceArray rv;
+	rv.reserve(nrows);
+	for (size_t r = 0; r < nrows; r++)
 	{
-		if (pyval.isList())
-		{
-			Py::List fl(pyval);
-			size_t sz = fl.length();
-			Real64Array nra(sz);
-			for(size_t i = 0; i < sz; i++)
-			{
-				nra[i] = Real64(Py::Float(fl[i]).as_double());
-			}
-			return CIMValue(nra);
-		}
-		return CIMValue(Real64(Py::Float(pyval).as_double()));
-	}
-	else if (type == "char16")
-    {
-		OW_THROW(PyConversionException,
-			"Unable to convert to OW from python char16");
-    }
-	else if (type == "datetime")
-    {
-		if (pyval.isList())
+		CIMInstance inst(className);
+		inst.setNameSpace(ns);
+		CIMPropertyArray pra(props);
+		CIMPropertyArray keys;
+		for (size_t c = 0; c < ncols; c++)
 		{
-			Py::List dl(pyval);
-			size_t sz = dl.length();
-			Array<CIMDateTime> ra(sz); 
-			for (size_t i = 0; i < sz; ++i)
+			PyObject* cell = PySequence_Fast_GET_ITEM(cols[c].ptr(), r);
+			if (cell != Py_None)
 			{
-				ra[i] = convertPyDateTime(dl[i]);
+				pra[c].setValue(convs[c](Py::Object(cell)));
 			}
-			return CIMValue(ra);
-		}
-		return CIMValue(convertPyDateTime(pyval)); 
-    }
-	else if (type == "reference")
-    {
-		if (pyval.isList())
-		{
-			Py::List dl(pyval);
-			size_t sz = dl.length();
-			Array<CIMObjectPath> ra(sz); 
-			for (size_t i = 0; i < sz; ++i)
+			if (isKey[c])
 			{
-				ra[i] = PyRef2OW(dl[i]);
+				keys.append(pra[c]);
 			}
-			return CIMValue(ra);
 		}
-		return CIMValue(PyRef2OW(pyval)); 
-    }
-	else if (type == "instance")
-	{
-		if (pyval.isList())
+		inst.setProperties(pra);
+		if (keys.size())
 		{
-			Py::List dl(pyval);
-			size_t sz = dl.length();
-			Array<CIMInstance> ra(sz); 
-			for (size_t i = 0; i < sz; ++i)
-			{
-				ra[i] = PyInst2OW(dl[i]);
-			}
-			return CIMValue(ra);
+			inst.setKeys(keys);
 		}
-		return CIMValue(PyInst2OW(pyval));
+		rv.append(inst);
 	}
-	else if (type == "class")
-	{
-		if (pyval.isList())
-		{
-			Py::List dl(pyval);
-			size_t sz = dl.length();
-			Array<CIMClass> ra(sz); 
-			for (size_t i = 0; i < sz; ++i)
-			{
-				ra[i] = PyClass2OW(dl[i]);
-			}
-			return CIMValue(ra);
-		}
-		return CIMValue(PyClass2OW(pyval));
-	}
-
-	OW_THROW(PyConversionException,
-		Format("Unknown python data type for conversion: %1", type).c_str());
-
-	// Shouldn't hit here
-    return CIMValue(CIMNULL); 
+	return rv;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1340,7 +1931,8 @@ OWPyConv::PyProperty2OW(const Py::Object& pyprop)
 
 	// Convert data type
 	String strtype = Py::String(pyprop.getAttr("type")).as_ow_string();
-	CIMDataType theDataType(PyDataType2OW(strtype));
+	CIMDataType::Type valType = PyDataType2OW(strtype);
+	CIMDataType theDataType(valType);
 	Py::Object wko = pyprop.getAttr("is_array");
 	if (wko.isTrue())
 	{
@@ -1355,14 +1947,14 @@ OWPyConv::PyProperty2OW(const Py::Object& pyprop)
 	{
 		String stremb = Py::String(wko).as_ow_string();
 		if (stremb.equalsIgnoreCase("instance"))
-			strtype = "instance";
+			valType = CIMDataType::EMBEDDEDINSTANCE;
 		else
-			strtype = "class";
+			valType = CIMDataType::EMBEDDEDCLASS;
 	}
 	wko = pyprop.getAttr("value");
 	if (!wko.isNone())
 	{
-		theProp.setValue(PyVal2OW(strtype, wko));
+		theProp.setValue(PyVal2OW(valType, wko));
 	}
 
 	if (pyprop.getAttr("propagated").isTrue())
@@ -1423,7 +2015,7 @@ OWPyConv::PyQual2OW(const Py::Object& pyqual)
 	Py::Object qv = pyqual.getAttr("value");
 	if (!qv.isNone())
 	{
-		theValue = PyVal2OW(strtype, qv);
+		theValue = PyVal2OW(theDataType, qv);
 	}
 	CIMQualifierType cqt(theName);
 	cqt.setDataType(theDataType);
@@ -1471,7 +2063,7 @@ OWPyConv::PyQualType2OW(const Py::Object& pyqualt)
 	if (!wko.isNone())
 	{
 		// I'm assuming data is the value...not sure
-		CIMValue theValue = PyVal2OW(strtype, wko);
+		CIMValue theValue = PyVal2OW(theDataType.getType(), wko);
 		cqt.setDefaultValue(theValue);
 	}
 	wko = pyqualt.getAttr("scopes");
@@ -45,6 +45,19 @@ public:
 	static Py::Object OWVal2Py(const CIMValue& val);	
 
 	static Py::Object OWClass2Py(const CIMClass& cls);
+	// Same as OWClass2Py, but copies the class from a per namespace cache.
+	// Entries are made again after the class upcalls of a provider change
+	// the namespace, and once they are older than the cache TTL. The copy
+	// has its own properties, methods and qualifiers dictionaries, but
+	// shares the objects in them with the cache; those must be treated as
+	// read-only.
+	// Must be called with the GIL held.
+	static Py::Object OWCachedClass2Py(const CIMClass& cls, const String& ns);
+	// Seconds a cached class is used for. 0 turns the cache off.
+	static void setClassCacheTTL(UInt32 secs);
+	// Drop all cached classes for the given namespace. Must be called with
+	// the GIL held.
+	static void invalidateClassCache(const String& ns);
 	static Py::Object OWProperty2Py(const CIMProperty& prop);
 	static Py::Object OWQual2Py(const CIMQualifier& qual);
 	static Py::Object OWQualType2Py(const CIMQualifierType& qualt);
@@ -56,8 +69,19 @@ public:
 	static CIMInstance PyInst2OW(const Py::Object& pyci, const String& ns=String());
 	static CIMObjectPath PyRef2OW(const Py::Object& pycop, const String& ns=String());
 	static CIMValue PyVal2OW(const String& type, const Py::Object& pyval);
+	static CIMValue PyVal2OW(CIMDataType::Type type, const Py::Object& pyval);
 	static CIMValue PyVal2OW(const Py::Tuple& tuple);
 
+	// Columnar instance batches returned by providers:
+	// (classname, [propname, ...], [column, ...]) where every column holds
+	// the values of one property for all instances. Property types are
+	// taken from the given class. Only tuples of a string and two lists
+	// or tuples are taken for batches.
+	static bool isPyInstBatch(const Py::Object& pyobj);
+	static String getPyInstBatchClassName(const Py::Object& pybatch);
+	static CIMInstanceArray PyInstBatch2OW(const Py::Object& pybatch,
+		const CIMClass& cls, const String& ns=String());
+
 	static CIMClass PyClass2OW(const Py::Object& pycls);
 	static CIMProperty PyProperty2OW(const Py::Object& pyprop);
 	static CIMQualifier PyQual2OW(const Py::Object& pyqual);
@@ -66,13 +90,45 @@ public:
 	static CIMMethod PyMeth2OW(const Py::Object& pymeth);
 	static CIMDataType::Type PyDataType2OW(const String& strt);
 
+	// Resolves and pins the pywbem types used by the converters. The
+	// converters keep separate pywbem types for every python interpreter,
+	// so this must be called in each interpreter that converts objects.
 	static void setPyWbemMod(const Py::Module& mod);
+	// Re-pins the pywbem types if the pywbem module has been reloaded.
+	// Must be called with the GIL held.
+	static void checkPyWbemMod();
+	// Returns the pywbem module of the current interpreter
+	static Py::Module getPyWbemMod();
+	// Releases the objects kept for the current interpreter. Called
+	// before a subinterpreter is ended.
+	static void dropInterpreterState();
 
 private:
 	static Py::Object RefValOW2Py(const CIMValue& owval);
 	static Py::Object DateTimeValOW2Py(const CIMValue& owval);
 };
 
+// Converts plain tuples of key values, given in the order of the key
+// properties of a class, into object paths of that class. The key
+// properties and their types are looked up once at construction.
+class OWPyKeyTupleConv
+{
+public:
+	OWPyKeyTupleConv(const CIMClass& cls, const String& ns);
+
+	static bool isPyKeyTuple(const Py::Object& pyobj)
+	{
+		return PyTuple_Check(pyobj.ptr());
+	}
+	CIMObjectPath PyKeyTuple2OW(const Py::Object& pykeys) const;
+
+private:
+	String m_className;
+	String m_ns;
+	StringArray m_keyNames;
+	Array<CIMDataType::Type> m_keyTypes;
+};
+
 }	// End of namespace PythonProvIFC
 
 #endif	// OW_PYCONVERTER_HPP_GUARD
@@ -0,0 +1,410 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc. 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*   
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*   
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#include "OW_PyInstanceIterator.hpp"
+#include "OW_PyProviderModule.hpp"
+#include "OW_PyConverter.hpp"
+#include <openwbem/OW_NonRecursiveMutexLock.hpp>
+#include <openwbem/OW_Format.hpp>
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////////
+class PyInstanceQueueResultHandler : public CIMInstanceResultHandlerIFC
+{
+public:
+	PyInstanceQueueResultHandler(const PyInstanceQueueRef& queue)
+		: CIMInstanceResultHandlerIFC()
+		, m_queue(queue)
+	{
+	}
+
+	virtual void doHandle(const CIMInstance& ci)
+	{
+		if (!m_queue->push(ci))
+		{
+			// The iterator went away. Abort the enumeration.
+			OW_THROWCIMMSG(CIMException::FAILED,
+				"Result iterator was discarded");
+		}
+	}
+
+private:
+	PyInstanceQueueRef m_queue;
+};
+
+// Innermost iterator scope of the thread
+__thread PyIteratorScope* t_iteratorScope = 0;
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+PyInstanceQueue::PyInstanceQueue(
+	UInt32 maxSize)
+	: IntrusiveCountableBase()
+	, m_guard()
+	, m_cond()
+	, m_items()
+	, m_maxSize(maxSize ? maxSize : 1)
+	, m_finished(false)
+	, m_closed(false)
+	, m_expired(false)
+	, m_failed(false)
+	, m_errNo(CIMException::FAILED)
+	, m_errMsg()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyInstanceQueue::push(
+	const CIMInstance& ci)
+{
+	NonRecursiveMutexLock l(m_guard);
+	while (!m_closed && m_items.size() >= m_maxSize)
+	{
+		m_cond.wait(l);
+	}
+	if (m_closed)
+	{
+		return false;
+	}
+	m_items.push_back(ci);
+	m_cond.notifyAll();
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyInstanceQueue::finish()
+{
+	NonRecursiveMutexLock l(m_guard);
+	m_finished = true;
+	m_cond.notifyAll();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyInstanceQueue::fail(
+	CIMException::ErrNoType errNo,
+	const String& msg)
+{
+	NonRecursiveMutexLock l(m_guard);
+	m_failed = true;
+	m_errNo = errNo;
+	m_errMsg = msg;
+	m_finished = true;
+	m_cond.notifyAll();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyInstanceQueue::pop(
+	CIMInstance& ci)
+{
+	NonRecursiveMutexLock l(m_guard);
+	while (m_items.empty() && !m_finished && !m_closed)
+	{
+		m_cond.wait(l);
+	}
+	if (m_items.empty())
+	{
+		return false;
+	}
+	ci = m_items.front();
+	m_items.pop_front();
+	m_cond.notifyAll();
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyInstanceQueue::close()
+{
+	NonRecursiveMutexLock l(m_guard);
+	m_closed = true;
+	m_items.clear();
+	m_cond.notifyAll();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyInstanceQueue::expire()
+{
+	NonRecursiveMutexLock l(m_guard);
+	m_expired = true;
+	m_closed = true;
+	m_items.clear();
+	m_cond.notifyAll();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyInstanceQueue::expired()
+{
+	NonRecursiveMutexLock l(m_guard);
+	return m_expired;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyInstanceQueue::failed(
+	CIMException::ErrNoType& errNo,
+	String& msg)
+{
+	NonRecursiveMutexLock l(m_guard);
+	if (m_failed)
+	{
+		errNo = m_errNo;
+		msg = m_errMsg;
+	}
+	return m_failed;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyInstanceProducer::PyInstanceProducer(
+	const PyInstanceQueueRef& queue)
+	: Thread()
+	, m_queue(queue)
+	, m_stopGuard()
+	, m_joined(false)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyInstanceProducer::stop()
+{
+	m_queue->close();
+	NonRecursiveMutexLock l(m_stopGuard);
+	if (!m_joined)
+	{
+		m_joined = true;
+		try
+		{
+			join();
+		}
+		catch(...)
+		{
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyIteratorScope::PyIteratorScope()
+	: m_prev(t_iteratorScope)
+	, m_producers()
+{
+	t_iteratorScope = this;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyIteratorScope::~PyIteratorScope()
+{
+	t_iteratorScope = m_prev;
+	if (m_producers.empty())
+	{
+		return;
+	}
+	for (size_t i = 0; i < m_producers.size(); i++)
+	{
+		m_producers[i]->getQueue()->expire();
+	}
+	PYCXX_ALLOW_THREADS
+	for (size_t i = 0; i < m_producers.size(); i++)
+	{
+		m_producers[i]->stop();
+	}
+	PYCXX_END_ALLOW_THREADS
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyIteratorScope::add(
+	const PyInstanceProducerRef& producer)
+{
+	m_producers.push_back(producer);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+PyIteratorScope*
+PyIteratorScope::current()
+{
+	return t_iteratorScope;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Int32
+PyInstanceProducer::run()
+{
+	PyInstanceQueueResultHandler result(m_queue);
+	try
+	{
+		produce(result);
+		m_queue->finish();
+	}
+	catch(const CIMException& e)
+	{
+		String msg = e.getDescription();
+		if (msg.empty())
+		{
+			msg = e.getMessage();
+		}
+		m_queue->fail(e.getErrNo(), msg);
+	}
+	catch(const Exception& e)
+	{
+		m_queue->fail(CIMException::FAILED, e.getMessage());
+	}
+	catch(...)
+	{
+		m_queue->fail(CIMException::FAILED, "Unknown exception");
+	}
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyInstanceIterator::PyInstanceIterator(
+	const PyInstanceQueueRef& queue,
+	const PyInstanceProducerRef& producer,
+	const String& ns)
+	: Py::PythonExtension<PyInstanceIterator>()
+	, m_queue(queue)
+	, m_producer(producer)
+	, m_ns(ns)
+	, m_started(false)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyInstanceIterator::~PyInstanceIterator()
+{
+	// Unblock the producer if the provider did not exhaust the iterator,
+	// then wait for the enumeration to wind down.
+	m_queue->close();
+	if (m_started)
+	{
+		PYCXX_ALLOW_THREADS
+		m_producer->stop();
+		PYCXX_END_ALLOW_THREADS
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyInstanceIterator::repr()
+{
+	return Py::String(Format("<CIMInstance iterator for namespace '%1'>",
+		m_ns));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyInstanceIterator::getattr(
+	const char *name)
+{
+	return getattr_methods(name);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyInstanceIterator::iter()
+{
+	return Py::Object(this);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyObject*
+PyInstanceIterator::iternext()
+{
+	CIMInstance ci(CIMNULL);
+	bool haveOne = false;
+	PYCXX_ALLOW_THREADS
+	haveOne = m_queue->pop(ci);
+	PYCXX_END_ALLOW_THREADS
+	if (haveOne)
+	{
+		return Py::new_reference_to(OWPyConv::OWInst2Py(ci, m_ns));
+	}
+
+	CIMException::ErrNoType errNo;
+	String msg;
+	if (m_queue->expired())
+	{
+		// pop() returns nothing once the queue has expired
+		errNo = CIMException::FAILED;
+		msg = "The provider call that created this iterator has ended";
+	}
+	else if (!m_queue->failed(errNo, msg))
+	{
+		// End of the results. Returning NULL without an exception set
+		// stops the iteration.
+		return NULL;
+	}
+
+	Py::Callable excctor = PyProviderModule::getWBEMMod().getAttr(
+		"CIMError");
+	Py::Tuple args(2);
+	args[0] = Py::Int(int(errNo));
+	args[1] = Py::String(msg);
+	throw Py::Exception(excctor, args);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+PyInstanceIterator::doInit()
+{
+	behaviors().name("CIMInstanceIterator");
+	behaviors().doc("Iterator over the instances of a CIMOM handle "
+		"enumeration called with Iterator=True. The enumeration runs on its "
+		"own thread and is throttled by a bounded queue");
+	behaviors().supportRepr();
+	behaviors().supportGetattr();
+	behaviors().supportIter();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+Py::Object
+PyInstanceIterator::newObject(
+	const PyInstanceQueueRef& queue,
+	const PyInstanceProducerRef& producer,
+	const String& ns)
+{
+	PyIteratorScope* scope = PyIteratorScope::current();
+	if (!scope)
+	{
+		OW_THROWCIMMSG(CIMException::NOT_SUPPORTED, "Iterator=True can only "
+			"be used on the thread running the provider call");
+	}
+	PyInstanceIterator* pit = new PyInstanceIterator(queue, producer, ns);
+	Py::Object rv = Py::asObject(pit);
+	producer->start();
+	pit->m_started = true;
+	scope->add(producer);
+	return rv;
+}
+
+}	// End of namespace PythonProvIFC
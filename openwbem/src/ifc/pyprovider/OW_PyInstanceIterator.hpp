@@ -0,0 +1,164 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc. 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*   
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*   
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifndef OW_PYINSTANCEITERATOR_HPP_GUARD
+#define OW_PYINSTANCEITERATOR_HPP_GUARD
+
+#include "PyCxxObjects.hpp"
+#include "PyCxxExtensions.hpp"
+#include <openwbem/OW_CIMInstance.hpp>
+#include <openwbem/OW_CIMException.hpp>
+#include <openwbem/OW_ResultHandlerIFC.hpp>
+#include <openwbem/OW_Thread.hpp>
+#include <openwbem/OW_NonRecursiveMutex.hpp>
+#include <openwbem/OW_Condition.hpp>
+#include <openwbem/OW_IntrusiveCountableBase.hpp>
+#include <openwbem/OW_IntrusiveReference.hpp>
+
+#include <deque>
+#include <vector>
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+//////////////////////////////////////////////////////////////////////////////
+// Bounded queue between the thread running a CIMOM enumeration and the
+// python iterator that consumes its results.
+class PyInstanceQueue : public IntrusiveCountableBase
+{
+public:
+	PyInstanceQueue(UInt32 maxSize);
+
+	// Producer side. push() blocks while the queue is full and returns
+	// false once the consumer has closed the queue.
+	bool push(const CIMInstance& ci);
+	void finish();
+	void fail(CIMException::ErrNoType errNo, const String& msg);
+
+	// Consumer side. pop() blocks while the queue is empty and returns
+	// false after the last result has been taken.
+	bool pop(CIMInstance& ci);
+	void close();
+	bool failed(CIMException::ErrNoType& errNo, String& msg);
+
+	// Closes the queue for good because the provider call that started
+	// the enumeration has ended
+	void expire();
+	bool expired();
+
+private:
+	NonRecursiveMutex m_guard;
+	Condition m_cond;
+	std::deque<CIMInstance> m_items;
+	UInt32 m_maxSize;
+	bool m_finished;
+	bool m_closed;
+	bool m_expired;
+	bool m_failed;
+	CIMException::ErrNoType m_errNo;
+	String m_errMsg;
+};
+typedef IntrusiveReference<PyInstanceQueue> PyInstanceQueueRef;
+
+//////////////////////////////////////////////////////////////////////////////
+// Thread that runs one CIMOM enumeration and puts its results on a
+// PyInstanceQueue. Subclasses supply the actual CIMOM call.
+class PyInstanceProducer : public Thread
+{
+public:
+	PyInstanceProducer(const PyInstanceQueueRef& queue);
+
+	// Closes the queue and waits for the thread to end. Safe to call
+	// more than once. Must be called without the GIL.
+	void stop();
+	PyInstanceQueueRef getQueue() const { return m_queue; }
+
+protected:
+	virtual Int32 run();
+	virtual void produce(CIMInstanceResultHandlerIFC& result) = 0;
+
+private:
+	PyInstanceQueueRef m_queue;
+	NonRecursiveMutex m_stopGuard;
+	bool m_joined;
+};
+typedef IntrusiveReference<PyInstanceProducer> PyInstanceProducerRef;
+
+//////////////////////////////////////////////////////////////////////////////
+// Ties the enumerations started on the current thread to the provider call
+// that runs there. The CIMOM handle and operation context they use are only
+// valid while the call lasts, so when the scope ends every producer started
+// within it is stopped and its iterator raises from then on. Iterators can
+// only be created while a scope is active. Must be constructed with the GIL
+// held and destroyed before it is given up.
+class PyIteratorScope
+{
+public:
+	PyIteratorScope();
+	~PyIteratorScope();
+
+	void add(const PyInstanceProducerRef& producer);
+
+	// Returns the innermost scope of the calling thread or 0
+	static PyIteratorScope* current();
+
+private:
+	PyIteratorScope(const PyIteratorScope&);
+	PyIteratorScope& operator=(const PyIteratorScope&);
+
+	PyIteratorScope* m_prev;
+	std::vector<PyInstanceProducerRef> m_producers;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Python iterator returned by the CIMOM handle upcalls when they are called
+// with Iterator=True. Results are converted to pywbem.CIMInstance objects
+// one at a time as the provider asks for them. Dropping the iterator before
+// it is exhausted aborts the enumeration, and so does the end of the
+// provider call that created it.
+class PyInstanceIterator
+	: public Py::PythonExtension<PyInstanceIterator>
+{
+public:
+	PyInstanceIterator(const PyInstanceQueueRef& queue,
+		const PyInstanceProducerRef& producer, const String& ns);
+	~PyInstanceIterator();
+
+	virtual Py::Object repr();
+	virtual Py::Object getattr(const char *name);
+	virtual Py::Object iter();
+	virtual PyObject* iternext();
+
+	static void doInit();
+
+	// Starts the producer thread and returns the iterator for its results.
+	// Throws if no PyIteratorScope is active on the calling thread.
+	static Py::Object newObject(const PyInstanceQueueRef& queue,
+		const PyInstanceProducerRef& producer, const String& ns);
+
+private:
+	PyInstanceQueueRef m_queue;
+	PyInstanceProducerRef m_producer;
+	String m_ns;
+	bool m_started;
+};
+
+}	// End of namespace PythonProvIFC
+
+#endif	// OW_PYINSTANCEITERATOR_HPP_GUARD
@@ -0,0 +1,645 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc. 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*   
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*   
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#include "OW_PyLazyInstance.hpp"
+#include "OW_PyConverter.hpp"
+#include <openwbem/OW_CIMProperty.hpp>
+#include <openwbem/OW_CIMObjectPath.hpp>
+#include <openwbem/OW_Format.hpp>
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////////
+// The check pywbem.CIMInstance.__setitem__ makes before it stores a value.
+// Numbers must come as pywbem CIM types, so their CIM type is known.
+void
+checkPropertyValue(
+	const Py::Object& value)
+{
+	PyObject* pyval = value.ptr();
+	if (PyInt_CheckExact(pyval) || PyLong_CheckExact(pyval)
+		|| PyFloat_CheckExact(pyval))
+	{
+		throw Py::TypeError("Must use a CIM type assigning numeric values.");
+	}
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+PyLazyInstance::PyLazyInstance(
+	const CIMInstance& ci,
+	const String& ns)
+	: Py::PythonExtension<PyLazyInstance>()
+	, m_ci(ci)
+	, m_ns(ns)
+	, m_pyinst()
+	, m_path()
+	, m_props()
+	, m_propsView(0)
+{
+	String cins = m_ci.getNameSpace();
+	if (!cins.empty())
+	{
+		m_ns = cins;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyLazyInstance::~PyLazyInstance()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::getProperty(
+	const String& name)
+{
+	String key(name);
+	key.toLowerCase();
+	if (m_props.hasKey(key))
+	{
+		return m_props.getItem(key);
+	}
+
+	CIMProperty prop = m_ci.getProperty(name);
+	if (!prop)
+	{
+		throw Py::KeyError(name);
+	}
+
+	Py::Object pyprop = OWPyConv::OWProperty2Py(prop);
+	m_props.setItem(key, pyprop);
+	return pyprop;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::getValue(
+	const String& name)
+{
+	return getProperty(name).getAttr("value");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::getPath()
+{
+	if (m_path.isNone())
+	{
+		// Same rules as OWPyConv::OWInst2Py: a class path means the
+		// keys can't be determined from the given instance.
+		CIMObjectPath icop(m_ns, m_ci);
+		if (!icop.isClassPath())
+		{
+			m_path = OWPyConv::OWRef2Py(icop);
+		}
+	}
+	return m_path;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::getPropertiesView()
+{
+	if (m_propsView)
+	{
+		return Py::Object(m_propsView);
+	}
+	m_propsView = new PyLazyProperties(Py::Object(this));
+	return Py::asObject(m_propsView);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::materialize()
+{
+	if (isMaterialized())
+	{
+		return m_pyinst;
+	}
+
+	Py::Object pyinst = OWPyConv::OWInst2Py(m_ci, m_ns);
+
+	// Properties already handed out to the provider must be the ones
+	// held by the instance, in case the provider modified them in place
+	Py::Mapping props = pyinst.getAttr("properties");
+	Py::List pkeys = m_props.keys();
+	for (int i = 0; i < pkeys.length(); i++)
+	{
+		Py::Object pyprop = m_props.getItem(pkeys[i]);
+		props.setItem(pyprop.getAttr("name"), pyprop);
+	}
+	if (!m_path.isNone())
+	{
+		pyinst.setAttr("path", m_path);
+	}
+
+	m_pyinst = pyinst;
+	m_props.clear();
+	return m_pyinst;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMInstance
+PyLazyInstance::toOW(
+	const String& ns) const
+{
+	if (isMaterialized())
+	{
+		return OWPyConv::PyInst2OW(m_pyinst, ns);
+	}
+	if (m_props.length() == 0)
+	{
+		return m_ci;
+	}
+
+	// Only the properties handed out can have been changed
+	CIMInstance ci(m_ci);
+	Py::List pkeys = m_props.keys();
+	for (int i = 0; i < pkeys.length(); i++)
+	{
+		ci.setProperty(OWPyConv::PyProperty2OW(m_props.getItem(pkeys[i])));
+	}
+	return ci;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::keys(const Py::Tuple& args)
+{
+	if (isMaterialized())
+	{
+		return Py::Callable(m_pyinst.getAttr("keys")).apply(args);
+	}
+
+	CIMPropertyArray props = m_ci.getProperties();
+	Py::List rv(props.size());
+	for (size_t i = 0; i < props.size(); i++)
+	{
+		rv[i] = Py::String(props[i].getName());
+	}
+	return rv;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::values(const Py::Tuple& args)
+{
+	if (isMaterialized())
+	{
+		return Py::Callable(m_pyinst.getAttr("values")).apply(args);
+	}
+
+	CIMPropertyArray props = m_ci.getProperties();
+	Py::List rv(props.size());
+	for (size_t i = 0; i < props.size(); i++)
+	{
+		rv[i] = getValue(props[i].getName());
+	}
+	return rv;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::items(const Py::Tuple& args)
+{
+	if (isMaterialized())
+	{
+		return Py::Callable(m_pyinst.getAttr("items")).apply(args);
+	}
+
+	CIMPropertyArray props = m_ci.getProperties();
+	Py::List rv(props.size());
+	for (size_t i = 0; i < props.size(); i++)
+	{
+		String name = props[i].getName();
+		Py::Tuple item(2);
+		item[0] = Py::String(name);
+		item[1] = getValue(name);
+		rv[i] = item;
+	}
+	return rv;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::hasKey(const Py::Tuple& args)
+{
+	if (isMaterialized())
+	{
+		return Py::Callable(m_pyinst.getAttr("has_key")).apply(args);
+	}
+
+	args.verify_length(1);
+	String name = Py::String(args[0]);
+	return Py::Object(m_ci.getProperty(name) ? Py_True : Py_False);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::get(const Py::Tuple& args)
+{
+	if (isMaterialized())
+	{
+		return Py::Callable(m_pyinst.getAttr("get")).apply(args);
+	}
+
+	args.verify_length(1, 2);
+	String name = Py::String(args[0]);
+	if (!m_ci.getProperty(name))
+	{
+		return (args.length() > 1) ? args[1] : Py::None();
+	}
+	return getValue(name);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyLazyInstance::accepts(
+	PyObject *pyob) const
+{
+	return pyob && PyLazyInstance::check(pyob);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::repr()
+{
+	if (isMaterialized())
+	{
+		return m_pyinst.repr();
+	}
+	return Py::String(Format("CIMInstance(classname='%1', ...)",
+		m_ci.getClassName()));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::getattr(
+	const char *name)
+{
+	if (isMaterialized())
+	{
+		return m_pyinst.getAttr(name);
+	}
+
+	String sname(name);
+	if (sname == "classname")
+	{
+		return Py::String(m_ci.getClassName());
+	}
+	if (sname == "path")
+	{
+		return getPath();
+	}
+	if (sname == "properties")
+	{
+		return getPropertiesView();
+	}
+	if (methods().find(sname) != methods().end())
+	{
+		return getattr_methods(name);
+	}
+
+	// Everything else ('qualifiers', 'copy', ...) needs
+	// a real pywbem.CIMInstance
+	return materialize().getAttr(name);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int
+PyLazyInstance::setattr(
+	const char *name,
+	const Py::Object& value)
+{
+	materialize().setAttr(name, value);
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::iter()
+{
+	Py::Object pykeys = keys(Py::Tuple());
+	return Py::Object(PyObject_GetIter(pykeys.ptr()), true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int
+PyLazyInstance::mapping_length()
+{
+	if (isMaterialized())
+	{
+		return Py::Mapping(m_pyinst.getAttr("properties")).length();
+	}
+	return int(m_ci.getProperties().size());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyInstance::mapping_subscript(
+	const Py::Object& key)
+{
+	if (isMaterialized())
+	{
+		return Py::Object(PyObject_GetItem(m_pyinst.ptr(), key.ptr()), true);
+	}
+	return getValue(Py::String(key));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int
+PyLazyInstance::mapping_ass_subscript(
+	const Py::Object& key,
+	const Py::Object& value)
+{
+	if (value.ptr() == 0)
+	{
+		return PyObject_DelItem(materialize().ptr(), key.ptr());
+	}
+	if (isMaterialized())
+	{
+		return PyObject_SetItem(m_pyinst.ptr(), key.ptr(), value.ptr());
+	}
+
+	checkPropertyValue(value);
+	// Existing properties only get a new value
+	String name = Py::String(key);
+	if (m_ci.getProperty(name))
+	{
+		getProperty(name).setAttr("value", value);
+		return 0;
+	}
+	return PyObject_SetItem(materialize().ptr(), key.ptr(), value.ptr());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyLazyInstance::doInit()
+{
+	behaviors().name("LazyCIMInstance");
+	behaviors().doc("Read optimized stand-in for pywbem.CIMInstance given "
+		"to providers registered with LazyInstances=true. Properties "
+		"are converted when they are accessed");
+	behaviors().supportRepr();
+	behaviors().supportGetattr();
+	behaviors().supportSetattr();
+	behaviors().supportIter();
+	behaviors().supportMappingType();
+	add_varargs_method("keys", &PyLazyInstance::keys,
+		"Return a list of the property names");
+	add_varargs_method("values", &PyLazyInstance::values,
+		"Return a list of the property values");
+	add_varargs_method("items", &PyLazyInstance::items,
+		"Return a list of (name, value) tuples for all properties");
+	add_varargs_method("has_key", &PyLazyInstance::hasKey,
+		"Return True if the instance has the given property");
+	add_varargs_method("get", &PyLazyInstance::get,
+		"Return the value of the given property or the given default");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+Py::Object
+PyLazyInstance::newObject(
+	const CIMInstance& ci,
+	const String& ns,
+	PyLazyInstance **plinst)
+{
+	PyLazyInstance* pli = new PyLazyInstance(ci, ns);
+	if (plinst)
+	{
+		*plinst = pli;
+	}
+
+	return Py::asObject(pli);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyLazyProperties::PyLazyProperties(
+	const Py::Object& owner)
+	: Py::PythonExtension<PyLazyProperties>()
+	, m_owner(owner)
+	, m_inst(static_cast<PyLazyInstance*>(owner.ptr()))
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyLazyProperties::~PyLazyProperties()
+{
+	if (m_inst->m_propsView == this)
+	{
+		m_inst->m_propsView = 0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::realProps()
+{
+	return m_inst->materialize().getAttr("properties");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::delegate(
+	const char* meth,
+	const Py::Tuple& args)
+{
+	return Py::Callable(realProps().getAttr(meth)).apply(args);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::keys(const Py::Tuple& args)
+{
+	if (m_inst->isMaterialized())
+	{
+		return delegate("keys", args);
+	}
+	return m_inst->keys(args);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::values(const Py::Tuple& args)
+{
+	if (m_inst->isMaterialized())
+	{
+		return delegate("values", args);
+	}
+
+	CIMPropertyArray props = m_inst->m_ci.getProperties();
+	Py::List rv(props.size());
+	for (size_t i = 0; i < props.size(); i++)
+	{
+		rv[i] = m_inst->getProperty(props[i].getName());
+	}
+	return rv;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::items(const Py::Tuple& args)
+{
+	if (m_inst->isMaterialized())
+	{
+		return delegate("items", args);
+	}
+
+	CIMPropertyArray props = m_inst->m_ci.getProperties();
+	Py::List rv(props.size());
+	for (size_t i = 0; i < props.size(); i++)
+	{
+		String name = props[i].getName();
+		Py::Tuple item(2);
+		item[0] = Py::String(name);
+		item[1] = m_inst->getProperty(name);
+		rv[i] = item;
+	}
+	return rv;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::hasKey(const Py::Tuple& args)
+{
+	if (m_inst->isMaterialized())
+	{
+		return delegate("has_key", args);
+	}
+	return m_inst->hasKey(args);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::get(const Py::Tuple& args)
+{
+	if (m_inst->isMaterialized())
+	{
+		return delegate("get", args);
+	}
+
+	args.verify_length(1, 2);
+	String name = Py::String(args[0]);
+	if (!m_inst->m_ci.getProperty(name))
+	{
+		return (args.length() > 1) ? args[1] : Py::None();
+	}
+	return m_inst->getProperty(name);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::repr()
+{
+	if (m_inst->isMaterialized())
+	{
+		return realProps().repr();
+	}
+	return Py::String(Format("<lazy properties of %1>",
+		m_inst->m_ci.getClassName()));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::getattr(
+	const char *name)
+{
+	if (!m_inst->isMaterialized()
+		&& methods().find(String(name)) != methods().end())
+	{
+		return getattr_methods(name);
+	}
+
+	// Everything else ('copy', 'update', ...) needs the real properties
+	return realProps().getAttr(name);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::iter()
+{
+	Py::Object pykeys = keys(Py::Tuple());
+	return Py::Object(PyObject_GetIter(pykeys.ptr()), true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int
+PyLazyProperties::mapping_length()
+{
+	return m_inst->mapping_length();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyLazyProperties::mapping_subscript(
+	const Py::Object& key)
+{
+	if (m_inst->isMaterialized())
+	{
+		Py::Object props = realProps();
+		return Py::Object(PyObject_GetItem(props.ptr(), key.ptr()), true);
+	}
+	return m_inst->getProperty(Py::String(key));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int
+PyLazyProperties::mapping_ass_subscript(
+	const Py::Object& key,
+	const Py::Object& value)
+{
+	Py::Object props = realProps();
+	if (value.ptr() == 0)
+	{
+		return PyObject_DelItem(props.ptr(), key.ptr());
+	}
+	return PyObject_SetItem(props.ptr(), key.ptr(), value.ptr());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyLazyProperties::doInit()
+{
+	behaviors().name("LazyCIMProperties");
+	behaviors().doc("Properties of a LazyCIMInstance. Each property is "
+		"converted when it is accessed");
+	behaviors().supportRepr();
+	behaviors().supportGetattr();
+	behaviors().supportIter();
+	behaviors().supportMappingType();
+	add_varargs_method("keys", &PyLazyProperties::keys,
+		"Return a list of the property names");
+	add_varargs_method("values", &PyLazyProperties::values,
+		"Return a list of the properties");
+	add_varargs_method("items", &PyLazyProperties::items,
+		"Return a list of (name, property) tuples");
+	add_varargs_method("has_key", &PyLazyProperties::hasKey,
+		"Return True if the given property exists");
+	add_varargs_method("get", &PyLazyProperties::get,
+		"Return the given property or the given default");
+}
+
+}	// End of namespace PythonProvIFC
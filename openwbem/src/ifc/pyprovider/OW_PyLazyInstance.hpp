@@ -0,0 +1,134 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc. 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*   
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*   
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifndef OW_PYLAZYINSTANCE_HPP_GUARD
+#define OW_PYLAZYINSTANCE_HPP_GUARD
+
+#include "PyCxxObjects.hpp"
+#include "PyCxxExtensions.hpp"
+#include <openwbem/OW_CIMInstance.hpp>
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+class PyLazyProperties;
+
+//////////////////////////////////////////////////////////////////////////////
+// Stand-in for a pywbem.CIMInstance that is handed to providers registered
+// with LazyInstances=true. Properties are only converted to python when
+// they are accessed through item access, get(), values(), items() or the
+// 'properties' mapping. Values and properties that were handed out are
+// converted back when the instance is returned, so changes made to them in
+// place are kept. Any other access (e.g. the 'qualifiers' attribute, adding
+// or removing properties) converts the whole instance once and from then
+// on delegates everything to the resulting pywbem.CIMInstance.
+class PyLazyInstance
+	: public Py::PythonExtension<PyLazyInstance>
+{
+public:
+	PyLazyInstance(const CIMInstance& ci, const String& ns);
+	~PyLazyInstance();
+
+	Py::Object keys(const Py::Tuple& args);
+	Py::Object values(const Py::Tuple& args);
+	Py::Object items(const Py::Tuple& args);
+	Py::Object hasKey(const Py::Tuple& args);
+	Py::Object get(const Py::Tuple& args);
+
+	virtual bool accepts(PyObject *pyob) const;
+	virtual Py::Object repr();
+	virtual Py::Object getattr(const char *name);
+	virtual int setattr(const char *name, const Py::Object& value);
+	virtual Py::Object iter();
+	virtual int mapping_length();
+	virtual Py::Object mapping_subscript(const Py::Object& key);
+	virtual int mapping_ass_subscript(const Py::Object& key,
+		const Py::Object& value);
+
+	// Returns the OpenWBEM instance this object represents. If the
+	// instance was never materialized, this is the original instance with
+	// the properties that were handed out to the provider converted back.
+	CIMInstance toOW(const String& ns) const;
+
+	static void doInit();
+	static Py::Object newObject(const CIMInstance& ci, const String& ns,
+		PyLazyInstance **plinst=0);
+
+private:
+	Py::Object getProperty(const String& name);
+	Py::Object getValue(const String& name);
+	Py::Object getPath();
+	Py::Object getPropertiesView();
+	Py::Object materialize();
+	bool isMaterialized() const { return !m_pyinst.isNone(); }
+
+	CIMInstance m_ci;
+	String m_ns;
+	Py::Object m_pyinst;
+	Py::Object m_path;
+	// pywbem.CIMProperty objects handed out so far, keyed by the lower
+	// case property name
+	Py::Dict m_props;
+	// The 'properties' view while anything holds it. Not a reference, the
+	// view holds the instance and clears this when it goes away.
+	PyLazyProperties* m_propsView;
+
+	friend class PyLazyProperties;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// The 'properties' attribute of a PyLazyInstance. Reads convert single
+// properties on first access. Adding or removing properties materializes
+// the owning instance, after which everything is delegated to the
+// 'properties' of the resulting pywbem.CIMInstance. An instance hands out
+// the same view for as long as anything holds on to it.
+class PyLazyProperties
+	: public Py::PythonExtension<PyLazyProperties>
+{
+public:
+	PyLazyProperties(const Py::Object& owner);
+	~PyLazyProperties();
+
+	Py::Object keys(const Py::Tuple& args);
+	Py::Object values(const Py::Tuple& args);
+	Py::Object items(const Py::Tuple& args);
+	Py::Object hasKey(const Py::Tuple& args);
+	Py::Object get(const Py::Tuple& args);
+
+	virtual Py::Object repr();
+	virtual Py::Object getattr(const char *name);
+	virtual Py::Object iter();
+	virtual int mapping_length();
+	virtual Py::Object mapping_subscript(const Py::Object& key);
+	virtual int mapping_ass_subscript(const Py::Object& key,
+		const Py::Object& value);
+
+	static void doInit();
+
+private:
+	Py::Object realProps();
+	Py::Object delegate(const char* meth, const Py::Tuple& args);
+
+	Py::Object m_owner;
+	PyLazyInstance* m_inst;
+};
+
+}	// End of namespace PythonProvIFC
+
+#endif	// OW_PYLAZYINSTANCE_HPP_GUARD
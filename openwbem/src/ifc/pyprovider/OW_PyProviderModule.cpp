@@ -16,6 +16,7 @@
 * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *****************************************************************************/
 #include "OW_PyProviderModule.hpp"
+#include "OW_PyConverter.hpp"
 
 namespace PythonProvIFC
 {
@@ -27,6 +28,10 @@ PyProviderModule::PyProviderModule()
 	PyCIMOMHandle::doInit();
 	PyLogger::doInit();
 	PyProviderEnvironment::doInit();
+	PyLazyInstance::doInit();
+	PyLazyProperties::doInit();
+	PyInstanceIterator::doInit();
+	PyAsyncLoop::doInit();
 
 	initialize("Supporting Classes/Objects for the Python Provider Interface");
 }
@@ -37,14 +42,12 @@ PyProviderModule::~PyProviderModule()
 }
 
 static PyProviderModule* g_pymod = 0;
-static Py::Module g_pywbemmod;
 //////////////////////////////////////////////////////////////////////////////
 // STATIC
 void
 PyProviderModule::doInit(
 	const Py::Module& pywbemMod)
 {
-	g_pywbemmod = pywbemMod;
 	g_pymod = new PyProviderModule;
 }
 
@@ -61,7 +64,9 @@ PyProviderModule::getModulePtr()
 Py::Module
 PyProviderModule::getWBEMMod()
 {
-	return g_pywbemmod;
+	// Subinterpreters have their own pywbem module. The converters keep
+	// track of the one for the interpreter we are running in.
+	return OWPyConv::getPyWbemMod();
 }
 
 }	// End of namespace PythonProvIFC
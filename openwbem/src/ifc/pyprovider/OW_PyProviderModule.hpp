@@ -23,6 +23,9 @@
 #include "OW_PyCIMOMHandle.hpp"
 #include "OW_PyProviderEnvironment.hpp"
 #include "OW_PyLogger.hpp"
+#include "OW_PyLazyInstance.hpp"
+#include "OW_PyInstanceIterator.hpp"
+#include "OW_PyAsyncLoop.hpp"
 #include <openwbem/OW_IfcsFwd.hpp>
 
 using namespace OW_NAMESPACE;
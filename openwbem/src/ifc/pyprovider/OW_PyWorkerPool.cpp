@@ -0,0 +1,1848 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#include "OW_PyWorkerPool.hpp"
+#include "OW_PyConverter.hpp"
+#include "OW_PyProvIFCCommon.hpp"
+#include "OW_PyProviderModule.hpp"
+#include <openwbem/OW_CIMException.hpp>
+#include <openwbem/OW_NonRecursiveMutexLock.hpp>
+#include <openwbem/OW_Format.hpp>
+
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+extern "C"
+{
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+}
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+//////////////////////////////////////////////////////////////////////////////
+// Lives in memory shared by the CIMOM and a worker process and is followed
+// by the record data. The worker appends records at head, the CIMOM
+// consumes them at tail. A record is a UInt32 length, a type byte and the
+// type specific data in the binary encoding the CIM objects use for
+// readObject/writeObject.
+struct PyWorkerRing
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t dataCond;
+	pthread_cond_t spaceCond;
+	UInt64 head;
+	UInt64 tail;
+	UInt32 size;
+	UInt32 abandoned;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Consumes the result records of a worker request in the CIMOM
+class PyWorkerRecordHandler
+{
+public:
+	virtual ~PyWorkerRecordHandler() {}
+	virtual void handle(UInt8 type, std::istream& istrm) = 0;
+};
+
+namespace
+{
+
+// Worker requests
+enum
+{
+	E_WORKER_ENUM_INSTANCE_NAMES = 1,
+	E_WORKER_ENUM_INSTANCES,
+	E_WORKER_GET_INSTANCE
+};
+
+// Result record types
+const UInt8 WORKER_REC_PATH = 'P';
+const UInt8 WORKER_REC_INSTANCE = 'I';
+const UInt8 WORKER_REC_ERROR = 'E';
+const UInt8 WORKER_REC_DONE = 'D';
+
+// How often a thread waiting for results checks that the worker is alive
+const int WORKER_POLL_SECS = 1;
+// How long the worker program may take to initialize python
+const int WORKER_START_MSECS = 30000;
+// How long a worker or the template process may take to exit once told
+// to before it is killed
+const int WORKER_STOP_MSECS = 5000;
+
+// Thrown in a worker when the CIMOM abandoned the current request
+struct WorkerAbandoned
+{
+};
+
+//////////////////////////////////////////////////////////////////////////////
+inline char*
+ringData(
+	PyWorkerRing* ring)
+{
+	return reinterpret_cast<char*>(ring + 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+ringCopyIn(
+	PyWorkerRing* ring,
+	UInt64 pos,
+	const char* src,
+	size_t len)
+{
+	size_t off = size_t(pos % ring->size);
+	size_t first = len < ring->size - off ? len : ring->size - off;
+	::memcpy(ringData(ring) + off, src, first);
+	::memcpy(ringData(ring), src + first, len - first);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+ringCopyOut(
+	PyWorkerRing* ring,
+	UInt64 pos,
+	char* dst,
+	size_t len)
+{
+	size_t off = size_t(pos % ring->size);
+	size_t first = len < ring->size - off ? len : ring->size - off;
+	::memcpy(dst, ringData(ring) + off, first);
+	::memcpy(dst + first, ringData(ring), len - first);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+initRing(
+	PyWorkerRing* ring,
+	UInt32 size)
+{
+	::memset(ring, 0, sizeof(*ring));
+	pthread_mutexattr_t mattr;
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+	// A worker that dies holding the lock must not hang the CIMOM
+	pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&ring->mutex, &mattr);
+	pthread_mutexattr_destroy(&mattr);
+
+	pthread_condattr_t cattr;
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+	pthread_cond_init(&ring->dataCond, &cattr);
+	pthread_cond_init(&ring->spaceCond, &cattr);
+	pthread_condattr_destroy(&cattr);
+
+	ring->size = size;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Returns false if the previous owner of the lock died holding it.
+// The lock is held in either case.
+bool
+lockRing(
+	PyWorkerRing* ring)
+{
+	if (pthread_mutex_lock(&ring->mutex) == EOWNERDEAD)
+	{
+		pthread_mutex_consistent(&ring->mutex);
+		return false;
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Appends a record. Waits for the CIMOM to make room if the ring is full.
+// Returns false if the CIMOM abandoned the request. Error and done records
+// are written regardless.
+bool
+ringPut(
+	PyWorkerRing* ring,
+	UInt8 type,
+	const std::string& data)
+{
+	UInt32 len = UInt32(data.size()) + 1;
+	UInt64 need = UInt64(len) + sizeof(len);
+	bool always = (type == WORKER_REC_DONE || type == WORKER_REC_ERROR);
+	lockRing(ring);
+	while ((always || !ring->abandoned)
+		&& ring->size - (ring->head - ring->tail) < need)
+	{
+		pthread_cond_wait(&ring->spaceCond, &ring->mutex);
+	}
+	if (!always && ring->abandoned)
+	{
+		pthread_mutex_unlock(&ring->mutex);
+		return false;
+	}
+	ringCopyIn(ring, ring->head, reinterpret_cast<char*>(&len), sizeof(len));
+	ringCopyIn(ring, ring->head + sizeof(len),
+		reinterpret_cast<char*>(&type), 1);
+	ringCopyIn(ring, ring->head + sizeof(len) + 1, data.data(), data.size());
+	ring->head += need;
+	pthread_cond_signal(&ring->dataCond);
+	pthread_mutex_unlock(&ring->mutex);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void
+writeRaw(
+	std::ostream& ostrm,
+	T val)
+{
+	ostrm.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+T
+readRaw(
+	std::istream& istrm)
+{
+	T val = T();
+	istrm.read(reinterpret_cast<char*>(&val), sizeof(val));
+	if (!istrm)
+	{
+		OW_THROWCIMMSG(CIMException::FAILED,
+			"Truncated python worker message");
+	}
+	return val;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+T
+readObj(
+	std::istream& istrm)
+{
+	T obj;
+	obj.readObject(istrm);
+	return obj;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+writeRequestHeader(
+	std::ostream& ostrm,
+	UInt8 op,
+	const String& provPath,
+	time_t provModTime,
+	const String& userName,
+	const String& ns)
+{
+	writeRaw<UInt8>(ostrm, op);
+	provPath.writeObject(ostrm);
+	writeRaw<Int64>(ostrm, Int64(provModTime));
+	userName.writeObject(ostrm);
+	ns.writeObject(ostrm);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+writePropertyList(
+	std::ostream& ostrm,
+	const StringArray* propertyList)
+{
+	// 0 means no property list, otherwise the number of names plus one
+	writeRaw<UInt32>(ostrm, propertyList ? propertyList->size() + 1 : 0);
+	if (propertyList)
+	{
+		for (size_t i = 0; i < propertyList->size(); i++)
+		{
+			(*propertyList)[i].writeObject(ostrm);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+readPyPropertyList(
+	std::istream& istrm)
+{
+	UInt32 count = readRaw<UInt32>(istrm);
+	if (count <= 1)
+	{
+		// Empty property lists are passed as None like in the CIMOM
+		return Py::None();
+	}
+	Py::List plst;
+	for (UInt32 i = 1; i < count; i++)
+	{
+		plst.append(Py::String(readObj<String>(istrm)));
+	}
+	return plst;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+writeFull(
+	int fd,
+	const char* buf,
+	size_t len)
+{
+	while (len)
+	{
+		ssize_t cc = ::send(fd, buf, len, MSG_NOSIGNAL);
+		if (cc < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		buf += cc;
+		len -= cc;
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+readFull(
+	int fd,
+	char* buf,
+	size_t len)
+{
+	while (len)
+	{
+		ssize_t cc = ::read(fd, buf, len);
+		if (cc < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		if (cc == 0)
+		{
+			return false;
+		}
+		buf += cc;
+		len -= cc;
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Waits at most msecs for fd to become readable or hang up
+bool
+waitReadable(
+	int fd,
+	int msecs)
+{
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	int rc;
+	while ((rc = ::poll(&pfd, 1, msecs)) < 0 && errno == EINTR)
+	{
+	}
+	return rc > 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Waits at most msecs for child pid to exit and reaps it. A child the
+// CIMOM's SIGCHLD handling reaped already counts as exited.
+bool
+waitExited(
+	pid_t pid,
+	int msecs)
+{
+	for (int waited = 0; ; waited += 10)
+	{
+		int status;
+		pid_t rc = ::waitpid(pid, &status, WNOHANG);
+		if (rc == pid || (rc < 0 && errno != EINTR))
+		{
+			return true;
+		}
+		if (waited >= msecs)
+		{
+			return false;
+		}
+		::usleep(10000);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+UInt32
+hashPath(
+	const String& path)
+{
+	UInt32 hash = 0;
+	for (size_t i = 0; i < path.length(); i++)
+	{
+		hash = hash * 31 + UInt32(UInt8(path[i]));
+	}
+	return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Worker side
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+class WorkerResultWriter
+{
+public:
+	WorkerResultWriter(PyWorkerRing* ring)
+		: m_ring(ring)
+	{
+	}
+
+	template <typename T>
+	void put(UInt8 type, const T& obj)
+	{
+		std::ostringstream ostrm;
+		obj.writeObject(ostrm);
+		std::string data = ostrm.str();
+		if (data.size() + 1 + sizeof(UInt32) > m_ring->size)
+		{
+			OW_THROWCIMMSG(CIMException::FAILED, Format("Python worker "
+				"result of %1 bytes does not fit the ring buffer of %2 "
+				"bytes", UInt32(data.size()), m_ring->size).c_str());
+		}
+		if (!ringPut(m_ring, type, data))
+		{
+			throw WorkerAbandoned();
+		}
+	}
+
+	void error(CIMException::ErrNoType errNo, const String& msg)
+	{
+		// Long tracebacks are cut to fit the ring
+		String smsg = msg;
+		if (smsg.length() > m_ring->size / 2)
+		{
+			smsg = smsg.substring(0, m_ring->size / 2);
+		}
+		std::ostringstream ostrm;
+		writeRaw<UInt32>(ostrm, UInt32(errNo));
+		smsg.writeObject(ostrm);
+		ringPut(m_ring, WORKER_REC_ERROR, ostrm.str());
+	}
+
+	void done()
+	{
+		ringPut(m_ring, WORKER_REC_DONE, std::string());
+	}
+
+private:
+	PyWorkerRing* m_ring;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Must be called with the python error still set
+void
+getPyErrorInfo(
+	CIMException::ErrNoType& errNo,
+	String& msg)
+{
+	Py::Object cimexObj = OWPyConv::getPyWbemMod().getAttr("CIMError");
+	bool isCIMExc = PyErr_ExceptionMatches(cimexObj.ptr());
+	Py::Object etype, evalue;
+	String tb = Py::getCurrentErrorInfo(etype, evalue);
+
+	errNo = CIMException::FAILED;
+	if (!isCIMExc)
+	{
+		msg = Format("From python code. Trace: %1", tb);
+		return;
+	}
+
+	msg = "Thrown from Python provider in worker process";
+	try
+	{
+		bool haveInt = false;
+		bool haveMsg = false;
+		Py::Tuple exargs = evalue.getAttr("args");
+		for (int i = 0; i < int(exargs.length()); i++)
+		{
+			Py::Object wko = exargs[i];
+			if (wko.isInt() && !haveInt)
+			{
+				errNo = CIMException::ErrNoType(int(Py::Int(wko)));
+				haveInt = true;
+			}
+			if (wko.isString() && !haveMsg)
+			{
+				msg = Py::String(wko).as_ow_string();
+				haveMsg = true;
+			}
+		}
+	}
+	catch(Py::Exception& e)
+	{
+		e.clear();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Returns the provider proxy for the given module, loading it the first
+// time or when the CIMOM saw the module change.
+Py::Object
+getWorkerProvider(
+	Py::Dict& provs,
+	const Py::Object& env,
+	const String& provPath,
+	Int64 provModTime)
+{
+	if (provs.hasKey(provPath))
+	{
+		Py::Tuple entry(provs.getItem(provPath));
+		if (Int64(Py::LongLong(entry[0]).asLongLong()) == provModTime)
+		{
+			return entry[1];
+		}
+	}
+
+	Py::Object cim_provider = OWPyConv::getPyWbemMod().getAttr(
+		"cim_provider");
+	Py::Callable ctor = cim_provider.getAttr("ProviderProxy");
+	Py::Tuple args(2);
+	args[0] = env;
+	args[1] = Py::String(provPath);
+	Py::Object pyprov = ctor.apply(args);
+	// Loading the provider may have reloaded pywbem
+	OWPyConv::checkPyWbemMod();
+
+	Py::Tuple entry(2);
+	entry[0] = Py::LongLong(static_cast<long long>(provModTime));
+	entry[1] = pyprov;
+	provs.setItem(provPath, entry);
+	return pyprov;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyObject*
+getWorkerIter(
+	const Py::Object& wko,
+	const char* fname)
+{
+	PyObject* ito = PyObject_GetIter(wko.ptr());
+	if (!ito)
+	{
+		PyErr_Clear();
+		OW_THROWCIMMSG(CIMException::FAILED, Format("%1 for python "
+			"provider in worker process is NOT an iterable object",
+			fname).c_str());
+	}
+	return ito;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+workerEnumInstanceNames(
+	std::istream& istrm,
+	const Py::Object& env,
+	Py::Object& pyprov,
+	const String& ns,
+	WorkerResultWriter& writer)
+{
+	CIMClass cimClass = readObj<CIMClass>(istrm);
+
+	Py::Callable pyfunc = pyprov.getAttr(PYFUNC_PREFIX "enumInstanceNames");
+	Py::Tuple args(3);
+	args[0] = env;
+	args[1] = Py::String(ns);
+	// Classes are not cached here. The worker doesn't see schema changes.
+	args[2] = OWPyConv::OWClass2Py(cimClass);
+	Py::Object wko = pyfunc.apply(args);
+	PyObject* ito = getWorkerIter(wko, "enumInstanceNames");
+	Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+	OWPyKeyTupleConv keyConv(cimClass, ns);
+	PyObject* item;
+	while((item = PyIter_Next(ito)))
+	{
+		wko = Py::Object(item, true);
+		if (OWPyKeyTupleConv::isPyKeyTuple(wko))
+		{
+			writer.put(WORKER_REC_PATH, keyConv.PyKeyTuple2OW(wko));
+		}
+		else
+		{
+			writer.put(WORKER_REC_PATH, OWPyConv::PyRef2OW(wko, ns));
+		}
+	}
+	if (PyErr_Occurred())
+	{
+		throw Py::Exception();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+workerEnumInstances(
+	std::istream& istrm,
+	const Py::Object& env,
+	Py::Object& pyprov,
+	const String& ns,
+	WorkerResultWriter& writer)
+{
+	Py::Object plist = readPyPropertyList(istrm);
+	CIMClass requestedClass = readObj<CIMClass>(istrm);
+	CIMClass cimClass = requestedClass;
+	if (!readRaw<UInt8>(istrm))
+	{
+		cimClass = readObj<CIMClass>(istrm);
+	}
+
+	Py::Callable pyfunc = pyprov.getAttr(PYFUNC_PREFIX "enumInstances");
+	Py::Tuple args(5);
+	args[0] = env;
+	args[1] = Py::String(ns);
+	args[2] = plist;
+	args[3] = OWPyConv::OWClass2Py(requestedClass);
+	if (requestedClass.getName().equalsIgnoreCase(cimClass.getName()))
+	{
+		args[4] = args[3];
+	}
+	else
+	{
+		args[4] = OWPyConv::OWClass2Py(cimClass);
+	}
+	Py::Object wko = pyfunc.apply(args);
+	PyObject* ito = getWorkerIter(wko, "enumInstances");
+	Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+	PyObject* item;
+	while((item = PyIter_Next(ito)))
+	{
+		wko = Py::Object(item, true);
+		if (!OWPyConv::isPyInstBatch(wko))
+		{
+			writer.put(WORKER_REC_INSTANCE, OWPyConv::PyInst2OW(wko, ns));
+			continue;
+		}
+
+		String className = OWPyConv::getPyInstBatchClassName(wko);
+		CIMClass cls(CIMNULL);
+		if (className.equalsIgnoreCase(cimClass.getName()))
+		{
+			cls = cimClass;
+		}
+		else if (className.equalsIgnoreCase(requestedClass.getName()))
+		{
+			cls = requestedClass;
+		}
+		else
+		{
+			// The CIMOM would get the class with an upcall
+			OW_THROWCIMMSG(CIMException::NOT_SUPPORTED, Format("Instance "
+				"batches of subclass %1 are not supported in python worker "
+				"processes", className).c_str());
+		}
+		CIMInstanceArray insts = OWPyConv::PyInstBatch2OW(wko, cls, ns);
+		for (CIMInstanceArray::size_type i = 0; i < insts.size(); i++)
+		{
+			writer.put(WORKER_REC_INSTANCE, insts[i]);
+		}
+	}
+	if (PyErr_Occurred())
+	{
+		throw Py::Exception();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+workerGetInstance(
+	std::istream& istrm,
+	const Py::Object& env,
+	Py::Object& pyprov,
+	const String& ns,
+	WorkerResultWriter& writer)
+{
+	CIMObjectPath cop = readObj<CIMObjectPath>(istrm);
+	if (cop.getNameSpace().empty())	// Ensure namespace set
+	{
+		cop.setNameSpace(ns);
+	}
+	Py::Object plist = readPyPropertyList(istrm);
+	CIMClass cimClass = readObj<CIMClass>(istrm);
+
+	Py::Callable pyfunc = pyprov.getAttr(PYFUNC_PREFIX "getInstance");
+	Py::Tuple args(4);
+	args[0] = env;
+	args[1] = OWPyConv::OWRef2Py(cop);
+	args[2] = plist;
+	args[3] = OWPyConv::OWClass2Py(cimClass);
+	Py::Object pyci = pyfunc.apply(args);
+	if (pyci.isNone())
+	{
+		OW_THROWCIMMSG(CIMException::FAILED, "Error: Python provider "
+			"returned NONE on getInstance");
+	}
+	writer.put(WORKER_REC_INSTANCE, OWPyConv::PyInst2OW(pyci, ns));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+serveRequest(
+	const std::string& request,
+	PyWorkerRing* ring,
+	Py::Dict& provs)
+{
+	WorkerResultWriter writer(ring);
+	try
+	{
+		std::istringstream istrm(request);
+		UInt8 op = readRaw<UInt8>(istrm);
+		String provPath = readObj<String>(istrm);
+		Int64 provModTime = readRaw<Int64>(istrm);
+		String userName = readObj<String>(istrm);
+		String ns = readObj<String>(istrm);
+
+		Py::Object env = PyWorkerPool::newWorkerEnvironment(userName);
+		Py::Object pyprov = getWorkerProvider(provs, env, provPath,
+			provModTime);
+		switch (op)
+		{
+			case E_WORKER_ENUM_INSTANCE_NAMES:
+				workerEnumInstanceNames(istrm, env, pyprov, ns, writer);
+				break;
+			case E_WORKER_ENUM_INSTANCES:
+				workerEnumInstances(istrm, env, pyprov, ns, writer);
+				break;
+			case E_WORKER_GET_INSTANCE:
+				workerGetInstance(istrm, env, pyprov, ns, writer);
+				break;
+			default:
+				OW_THROWCIMMSG(CIMException::FAILED, Format("Unknown python "
+					"worker request %1", int(op)).c_str());
+		}
+	}
+	catch(const WorkerAbandoned&)
+	{
+		// The CIMOM doesn't want any more results
+	}
+	catch(Py::Exception& e)
+	{
+		CIMException::ErrNoType errNo;
+		String msg;
+		getPyErrorInfo(errNo, msg);
+		e.clear();
+		writer.error(errNo, msg);
+	}
+	catch(const PyConversionException& e)
+	{
+		writer.error(CIMException::FAILED, Format("Caught python conversion "
+			"exception in worker process. Exception Message: %1",
+			e.getMessage()));
+	}
+	catch(const CIMException& e)
+	{
+		String msg = e.getDescription();
+		if (msg.empty())
+		{
+			msg = e.getMessage();
+		}
+		writer.error(e.getErrNo(), msg);
+	}
+	catch(const Exception& e)
+	{
+		writer.error(CIMException::FAILED, e.getMessage());
+	}
+	writer.done();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Closes all descriptors inherited from the CIMOM except the request
+// socket. The request sockets of the other workers in particular must be
+// closed so those workers see EOF when the CIMOM closes its end.
+void
+closeInheritedFds(
+	int keepFd)
+{
+	std::vector<int> fds;
+	DIR* dir = ::opendir("/proc/self/fd");
+	if (dir)
+	{
+		struct dirent* ent;
+		while ((ent = ::readdir(dir)))
+		{
+			if (ent->d_name[0] != '.')
+			{
+				fds.push_back(::atoi(ent->d_name));
+			}
+		}
+		::closedir(dir);
+	}
+	else
+	{
+		int maxfd = int(::sysconf(_SC_OPEN_MAX));
+		for (int fd = 3; fd < maxfd; fd++)
+		{
+			fds.push_back(fd);
+		}
+	}
+	for (size_t i = 0; i < fds.size(); i++)
+	{
+		if (fds[i] > 2 && fds[i] != keepFd)
+		{
+			::close(fds[i]);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Undo the signal setup of the CIMOM
+void
+resetSignals()
+{
+	sigset_t sigs;
+	sigemptyset(&sigs);
+	sigprocmask(SIG_SETMASK, &sigs, 0);
+	::signal(SIGPIPE, SIG_IGN);
+	::signal(SIGHUP, SIG_DFL);
+	::signal(SIGINT, SIG_DFL);
+	::signal(SIGTERM, SIG_DFL);
+	::signal(SIGCHLD, SIG_DFL);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Main of a forked worker. Runs with the GIL the template process held.
+void
+runWorker(
+	int fd,
+	PyWorkerRing* ring)
+{
+	PyOS_AfterFork();
+	closeInheritedFds(fd);
+	resetSignals();
+
+	int rc = 0;
+	try
+	{
+		Py::Dict provs;
+		std::string request;
+		UInt32 len;
+		while (readFull(fd, reinterpret_cast<char*>(&len), sizeof(len)))
+		{
+			request.resize(len);
+			if (len && !readFull(fd, &request[0], len))
+			{
+				break;
+			}
+			serveRequest(request, ring, provs);
+		}
+	}
+	catch(Py::Exception& e)
+	{
+		PyErr_Print();
+		e.clear();
+		rc = 1;
+	}
+	catch(...)
+	{
+		rc = 1;
+	}
+	// Don't run the CIMOM's atexit handlers and static destructors
+	::_exit(rc);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Answers a spawn request of the CIMOM. If the worker was forked, its
+// request socket goes along with the reply.
+bool
+sendSpawnReply(
+	int ctlFd,
+	Int32 pid,
+	Int32 err,
+	int fd)
+{
+	Int32 reply[2] = { pid, err };
+	struct iovec iov;
+	iov.iov_base = reply;
+	iov.iov_len = sizeof(reply);
+	struct msghdr msg;
+	::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	if (fd >= 0)
+	{
+		::memset(cbuf, 0, sizeof(cbuf));
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+		struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+	ssize_t cc;
+	while ((cc = ::sendmsg(ctlFd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+	{
+	}
+	return cc == ssize_t(sizeof(reply));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+recvSpawnReply(
+	int ctlFd,
+	Int32& pid,
+	Int32& err,
+	int& fd)
+{
+	Int32 reply[2];
+	struct iovec iov;
+	iov.iov_base = reply;
+	iov.iov_len = sizeof(reply);
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	struct msghdr msg;
+	::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	ssize_t cc;
+	while ((cc = ::recvmsg(ctlFd, &msg, MSG_CMSG_CLOEXEC)) < 0
+		&& errno == EINTR)
+	{
+	}
+	if (cc != ssize_t(sizeof(reply)))
+	{
+		return false;
+	}
+	fd = -1;
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && cmsg->cmsg_level == SOL_SOCKET
+		&& cmsg->cmsg_type == SCM_RIGHTS)
+	{
+		::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	pid = reply[0];
+	err = reply[1];
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Loop of the template process. Forks a worker for every worker id the
+// CIMOM sends and exits when the CIMOM closes the control socket. Runs
+// with the GIL held and never starts a thread.
+void
+runTemplate(
+	int ctlFd,
+	const std::vector<PyWorkerRing*>& rings)
+{
+	// The workers are reaped automatically
+	::signal(SIGCHLD, SIG_IGN);
+
+	UInt32 id;
+	while (readFull(ctlFd, reinterpret_cast<char*>(&id), sizeof(id)))
+	{
+		Int32 pid = -1;
+		Int32 err = 0;
+		int fds[2] = { -1, -1 };
+		if (id >= rings.size())
+		{
+			err = EINVAL;
+		}
+		else if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+		{
+			err = errno;
+		}
+		else
+		{
+			pid = ::fork();
+			if (pid == 0)
+			{
+				::close(fds[0]);
+				runWorker(fds[1], rings[id]);	// Doesn't return
+			}
+			if (pid < 0)
+			{
+				err = errno;
+			}
+			// Only the worker may hold its end, so the CIMOM sees the
+			// socket close when the worker exits
+			::close(fds[1]);
+		}
+		bool sent = sendSpawnReply(ctlFd, pid, err, (pid > 0) ? fds[0] : -1);
+		if (fds[0] >= 0)
+		{
+			::close(fds[0]);
+		}
+		if (!sent)
+		{
+			break;
+		}
+	}
+	// Don't run the CIMOM's atexit handlers and static destructors
+	::_exit(0);
+}
+
+const char* const WORKER_ENV_SRC =
+	"import syslog\n"
+	"import pywbem\n"
+	"class WorkerLogger(object):\n"
+	"    def __init__(self, component):\n"
+	"        self.component = component\n"
+	"    def _log(self, prio, msg):\n"
+	"        syslog.syslog(prio, '%s: %s' % (self.component, msg))\n"
+	"    def log_fatal_error(self, msg):\n"
+	"        self._log(syslog.LOG_CRIT, msg)\n"
+	"    def log_error(self, msg):\n"
+	"        self._log(syslog.LOG_ERR, msg)\n"
+	"    def log_info(self, msg):\n"
+	"        self._log(syslog.LOG_INFO, msg)\n"
+	"    def log_debug(self, msg):\n"
+	"        self._log(syslog.LOG_DEBUG, msg)\n"
+	"class WorkerEnvironment(object):\n"
+	"    def __init__(self, user_name):\n"
+	"        self.user_name = user_name\n"
+	"        self.context = {}\n"
+	"    def get_cimom_handle(self):\n"
+	"        raise pywbem.CIMError(pywbem.CIM_ERR_NOT_SUPPORTED,\n"
+	"            'CIMOM upcalls are not available to python providers '\n"
+	"            'running in a worker process')\n"
+	"    def get_logger(self, component=None):\n"
+	"        return WorkerLogger(component or '" COMPONENT_NAME "')\n"
+	"    def get_user_name(self):\n"
+	"        return self.user_name\n"
+	"    def get_context_value(self, key):\n"
+	"        return self.context.get(key)\n"
+	"    def set_context_value(self, key, value):\n"
+	"        self.context[key] = value\n";
+
+PyObject* g_workerEnvClass = 0;	// Protected by the GIL
+
+//////////////////////////////////////////////////////////////////////////////
+// Parent side
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+class PathRecordHandler : public PyWorkerRecordHandler
+{
+public:
+	PathRecordHandler(CIMObjectPathResultHandlerIFC& result)
+		: PyWorkerRecordHandler()
+		, m_result(result)
+	{
+	}
+
+	virtual void handle(UInt8 type, std::istream& istrm)
+	{
+		if (type != WORKER_REC_PATH)
+		{
+			OW_THROWCIMMSG(CIMException::FAILED,
+				"Unexpected result from python worker process");
+		}
+		m_result.handle(readObj<CIMObjectPath>(istrm));
+	}
+
+private:
+	CIMObjectPathResultHandlerIFC& m_result;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+class InstanceRecordHandler : public PyWorkerRecordHandler
+{
+public:
+	InstanceRecordHandler(CIMInstanceResultHandlerIFC& result)
+		: PyWorkerRecordHandler()
+		, m_result(result)
+	{
+	}
+
+	virtual void handle(UInt8 type, std::istream& istrm)
+	{
+		if (type != WORKER_REC_INSTANCE)
+		{
+			OW_THROWCIMMSG(CIMException::FAILED,
+				"Unexpected result from python worker process");
+		}
+		m_result.handle(readObj<CIMInstance>(istrm));
+	}
+
+private:
+	CIMInstanceResultHandlerIFC& m_result;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+class SingleInstanceRecordHandler : public PyWorkerRecordHandler
+{
+public:
+	SingleInstanceRecordHandler()
+		: PyWorkerRecordHandler()
+		, m_inst(CIMNULL)
+	{
+	}
+
+	virtual void handle(UInt8 type, std::istream& istrm)
+	{
+		if (type != WORKER_REC_INSTANCE || m_inst)
+		{
+			OW_THROWCIMMSG(CIMException::FAILED,
+				"Unexpected result from python worker process");
+		}
+		m_inst = readObj<CIMInstance>(istrm);
+	}
+
+	CIMInstance getInstance() const { return m_inst; }
+
+private:
+	CIMInstance m_inst;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Reads the remaining records of an abandoned request
+void
+drainRequest(
+	PyWorker& worker)
+{
+	UInt8 type;
+	std::string data;
+	do
+	{
+		worker.readRecord(type, data);
+	} while (type != WORKER_REC_DONE);
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+PyWorkerTemplate::PyWorkerTemplate()
+	: m_guard()
+	, m_pid(0)
+	, m_fd(-1)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyWorkerTemplate::~PyWorkerTemplate()
+{
+	stop();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorkerTemplate::start(
+	const String& program,
+	const std::vector<int>& ringFds,
+	UInt32 ringSize)
+{
+	int fds[2];
+	if (::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0)
+	{
+		OW_THROWCIMMSG(CIMException::FAILED, Format("Failed to create "
+			"socket for python worker template: %1",
+			::strerror(errno)).c_str());
+	}
+	// Other threads of the CIMOM may fork meanwhile
+	::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+	// Everything the child needs is prepared before the fork. Between
+	// the fork and the exec it may only make async signal safe calls.
+	std::vector<std::string> args;
+	args.push_back(program.c_str());
+	args.push_back(Format("%1", fds[1]).c_str());
+	args.push_back(Format("%1", ringSize).c_str());
+	for (size_t i = 0; i < ringFds.size(); i++)
+	{
+		args.push_back(Format("%1", ringFds[i]).c_str());
+	}
+	std::vector<char*> argv;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		argv.push_back(const_cast<char*>(args[i].c_str()));
+	}
+	argv.push_back(0);
+
+	pid_t pid = ::fork();
+	if (pid == 0)
+	{
+		::fcntl(fds[1], F_SETFD, 0);
+		for (size_t i = 0; i < ringFds.size(); i++)
+		{
+			::fcntl(ringFds[i], F_SETFD, 0);
+		}
+		::execv(argv[0], &argv[0]);
+		::_exit(127);
+	}
+	int forkErrno = errno;
+	::close(fds[1]);
+	if (pid < 0)
+	{
+		::close(fds[0]);
+		OW_THROWCIMMSG(CIMException::FAILED, Format("Failed to fork "
+			"python worker template: %1", ::strerror(forkErrno)).c_str());
+	}
+	m_fd = fds[0];
+	m_pid = pid;
+
+	// The program says it is ready once python is initialized. It exits
+	// if it can't be run or python fails to initialize.
+	Int32 rpid = -1;
+	Int32 err = 0;
+	int fd = -1;
+	if (!waitReadable(m_fd, WORKER_START_MSECS)
+		|| !recvSpawnReply(m_fd, rpid, err, fd) || rpid != Int32(pid))
+	{
+		if (fd >= 0)
+		{
+			::close(fd);
+		}
+		stop();
+		OW_THROWCIMMSG(CIMException::FAILED, Format("Python worker program "
+			"%1 failed to start", program).c_str());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorkerTemplate::spawnWorker(
+	UInt32 id,
+	pid_t& pid,
+	int& fd)
+{
+	NonRecursiveMutexLock l(m_guard);
+	Int32 rpid = -1;
+	Int32 err = 0;
+	if (m_fd < 0
+		|| !writeFull(m_fd, reinterpret_cast<char*>(&id), sizeof(id))
+		|| !recvSpawnReply(m_fd, rpid, err, fd))
+	{
+		OW_THROWCIMMSG(CIMException::FAILED, Format("Python worker template "
+			"process is gone. Can't start python worker %1", id).c_str());
+	}
+	if (rpid <= 0 || fd < 0)
+	{
+		OW_THROWCIMMSG(CIMException::FAILED, Format("Failed to fork "
+			"python worker %1: %2", id, ::strerror(err)).c_str());
+	}
+	pid = pid_t(rpid);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorkerTemplate::stop()
+{
+	NonRecursiveMutexLock l(m_guard);
+	if (m_fd >= 0)
+	{
+		::close(m_fd);
+		m_fd = -1;
+	}
+	if (m_pid > 0)
+	{
+		// The template exits when it reads EOF from the control socket
+		if (!waitExited(m_pid, WORKER_STOP_MSECS))
+		{
+			::kill(m_pid, SIGKILL);
+			int status;
+			while (::waitpid(m_pid, &status, 0) < 0 && errno == EINTR)
+			{
+			}
+		}
+		m_pid = 0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+int
+PyWorkerTemplate::main(
+	int argc,
+	char* argv[])
+{
+	if (argc < 4)
+	{
+		// Only meant to be run by the provider interface
+		return 2;
+	}
+	int ctlFd = ::atoi(argv[1]);
+	UInt32 ringSize = UInt32(::strtoul(argv[2], 0, 10));
+	std::vector<PyWorkerRing*> rings;
+	for (int i = 3; i < argc; i++)
+	{
+		int fd = ::atoi(argv[i]);
+		void* p = ::mmap(0, sizeof(PyWorkerRing) + ringSize,
+			PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED)
+		{
+			return 1;
+		}
+		rings.push_back(static_cast<PyWorkerRing*>(p));
+	}
+	closeInheritedFds(ctlFd);
+	resetSignals();
+
+	// Python is set up like the provider interface sets it up in the
+	// CIMOM. The workers always run in the main interpreter.
+	Py_Initialize();
+	PyEval_InitThreads();
+	try
+	{
+		Py::Module pywbem("pywbem", true);
+		OWPyConv::setPyWbemMod(pywbem);
+		PyProviderModule::doInit(pywbem);
+	}
+	catch(Py::Exception& e)
+	{
+		PyErr_Print();
+		e.clear();
+		return 1;
+	}
+	if (!sendSpawnReply(ctlFd, Int32(::getpid()), 0, -1))
+	{
+		return 1;
+	}
+	runTemplate(ctlFd, rings);	// Doesn't return
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyWorker::PyWorker(
+	UInt32 id,
+	UInt32 ringSize)
+	: IntrusiveCountableBase()
+	, m_id(id)
+	, m_ringSize(ringSize)
+	, m_ring(0)
+	, m_ringFd(-1)
+	, m_pid(0)
+	, m_fd(-1)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyWorker::~PyWorker()
+{
+	stop();
+	if (m_ring)
+	{
+		::munmap(m_ring, sizeof(PyWorkerRing) + m_ringSize);
+	}
+	if (m_ringFd >= 0)
+	{
+		::close(m_ringFd);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int
+PyWorker::mapRing()
+{
+	if (!m_ring)
+	{
+		// The object is only needed until its descriptor is handed to
+		// the worker program, so it is unlinked right away
+		String name = Format("/owpyworker.%1.%2", ::getpid(), m_id);
+		int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL,
+			S_IRUSR | S_IWUSR);
+		if (fd < 0)
+		{
+			OW_THROWCIMMSG(CIMException::FAILED, Format("Failed to create "
+				"ring buffer for python worker %1: %2", m_id,
+				::strerror(errno)).c_str());
+		}
+		::shm_unlink(name.c_str());
+		size_t len = sizeof(PyWorkerRing) + m_ringSize;
+		void* p = MAP_FAILED;
+		if (::ftruncate(fd, off_t(len)) == 0)
+		{
+			p = ::mmap(0, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		if (p == MAP_FAILED)
+		{
+			int err = errno;
+			::close(fd);
+			OW_THROWCIMMSG(CIMException::FAILED, Format("Failed to map "
+				"ring buffer for python worker %1: %2", m_id,
+				::strerror(err)).c_str());
+		}
+		m_ring = static_cast<PyWorkerRing*>(p);
+		m_ringFd = fd;
+	}
+	return m_ringFd;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorker::spawn(
+	PyWorkerTemplate& tmpl)
+{
+	// The previous worker may have died at any point
+	initRing(m_ring, m_ringSize);
+
+	pid_t pid;
+	int fd;
+	tmpl.spawnWorker(m_id, pid, fd);
+	m_fd = fd;
+	m_pid = pid;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorker::stop()
+{
+	if (m_fd >= 0)
+	{
+		// The worker exits when it reads EOF from the request socket.
+		// It isn't our child, so wait for it to close its end instead.
+		// The template reaps it once it is gone.
+		::shutdown(m_fd, SHUT_WR);
+		if (!waitReadable(m_fd, WORKER_STOP_MSECS) && m_pid > 0)
+		{
+			::kill(m_pid, SIGKILL);
+			waitReadable(m_fd, WORKER_STOP_MSECS);
+		}
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_pid = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyWorker::processAlive() const
+{
+	// The worker never writes to the request socket, so it only becomes
+	// readable when the worker's end is closed
+	struct pollfd pfd;
+	pfd.fd = m_fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	int rc;
+	while ((rc = ::poll(&pfd, 1, 0)) < 0 && errno == EINTR)
+	{
+	}
+	return rc == 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyWorker::checkRunning()
+{
+	if (m_fd >= 0 && !processAlive())
+	{
+		::close(m_fd);
+		m_fd = -1;
+		m_pid = 0;
+	}
+	return m_fd >= 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorker::died(
+	const char* what)
+{
+	pid_t pid = m_pid;
+	if (m_pid > 0)
+	{
+		// Make sure a hung worker doesn't stay around
+		::kill(m_pid, SIGKILL);
+	}
+	stop();
+	OW_THROWCIMMSG(CIMException::FAILED, Format("Python worker %1 "
+		"(pid %2) %3", m_id, int(pid), what).c_str());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorker::sendRequest(
+	const std::string& request)
+{
+	if (!lockRing(m_ring))
+	{
+		pthread_mutex_unlock(&m_ring->mutex);
+		died("exited unexpectedly");
+	}
+	m_ring->abandoned = 0;
+	pthread_mutex_unlock(&m_ring->mutex);
+
+	UInt32 len = UInt32(request.size());
+	if (!writeFull(m_fd, reinterpret_cast<char*>(&len), sizeof(len))
+		|| !writeFull(m_fd, request.data(), request.size()))
+	{
+		died("could not be sent a request");
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorker::readRecord(
+	UInt8& type,
+	std::string& data)
+{
+	bool consistent = lockRing(m_ring);
+	while (consistent && m_ring->head == m_ring->tail)
+	{
+		struct timespec ts;
+		::clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += WORKER_POLL_SECS;
+		int rc = pthread_cond_timedwait(&m_ring->dataCond, &m_ring->mutex,
+			&ts);
+		if (rc == EOWNERDEAD)
+		{
+			pthread_mutex_consistent(&m_ring->mutex);
+			consistent = false;
+		}
+		else if (rc == ETIMEDOUT && !processAlive())
+		{
+			pthread_mutex_unlock(&m_ring->mutex);
+			died("exited unexpectedly");
+		}
+	}
+	if (!consistent)
+	{
+		// The worker died in the middle of writing a record
+		pthread_mutex_unlock(&m_ring->mutex);
+		died("exited unexpectedly");
+	}
+
+	UInt32 len;
+	ringCopyOut(m_ring, m_ring->tail, reinterpret_cast<char*>(&len),
+		sizeof(len));
+	ringCopyOut(m_ring, m_ring->tail + sizeof(len),
+		reinterpret_cast<char*>(&type), 1);
+	data.resize(len - 1);
+	if (len > 1)
+	{
+		ringCopyOut(m_ring, m_ring->tail + sizeof(len) + 1, &data[0],
+			len - 1);
+	}
+	m_ring->tail += sizeof(len) + len;
+	pthread_cond_signal(&m_ring->spaceCond);
+	pthread_mutex_unlock(&m_ring->mutex);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorker::abandon()
+{
+	lockRing(m_ring);
+	m_ring->abandoned = 1;
+	pthread_cond_signal(&m_ring->spaceCond);
+	pthread_mutex_unlock(&m_ring->mutex);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyWorkerPool::PyWorkerPool(
+	UInt32 workerCount,
+	UInt32 ringSize,
+	const String& workerProgram)
+	: IntrusiveCountableBase()
+	, m_template()
+	, m_workerProgram(workerProgram)
+	, m_ringSize(ringSize)
+	, m_workers()
+	, m_busy()
+	, m_guard()
+	, m_idleCond()
+	, m_shutdown(false)
+{
+	for (UInt32 i = 0; i < workerCount; i++)
+	{
+		m_workers.append(PyWorkerRef(new PyWorker(i, ringSize)));
+		m_busy.append(false);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyWorkerPool::~PyWorkerPool()
+{
+	try
+	{
+		shutdown();
+	}
+	catch(...)
+	{
+		// Ignore?
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorkerPool::start()
+{
+	std::vector<int> ringFds;
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		ringFds.push_back(m_workers[i]->mapRing());
+	}
+	m_template.start(m_workerProgram, ringFds, m_ringSize);
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i]->spawn(m_template);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorkerPool::shutdown()
+{
+	NonRecursiveMutexLock l(m_guard);
+	m_shutdown = true;
+	for (size_t i = 0; i < m_busy.size(); i++)
+	{
+		while (m_busy[i])
+		{
+			m_idleCond.wait(l);
+		}
+	}
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i]->stop();
+	}
+	m_template.stop();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyWorkerRef
+PyWorkerPool::acquireWorker(
+	const String& provPath)
+{
+	PyWorkerRef worker;
+	{
+		NonRecursiveMutexLock l(m_guard);
+		UInt32 count = m_workers.size();
+		UInt32 home = hashPath(provPath) % count;
+		while (!worker)
+		{
+			if (m_shutdown)
+			{
+				OW_THROWCIMMSG(CIMException::FAILED,
+					"Python worker pool is shut down");
+			}
+			// The home worker of the module has it loaded already, but
+			// any idle worker is better than waiting for it.
+			for (UInt32 i = 0; i < count; i++)
+			{
+				UInt32 idx = (home + i) % count;
+				if (!m_busy[idx])
+				{
+					m_busy[idx] = true;
+					worker = m_workers[idx];
+					break;
+				}
+			}
+			if (!worker)
+			{
+				m_idleCond.wait(l);
+			}
+		}
+	}
+
+	if (!worker->checkRunning())
+	{
+		try
+		{
+			worker->spawn(m_template);
+		}
+		catch(...)
+		{
+			releaseWorker(worker);
+			throw;
+		}
+	}
+	return worker;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorkerPool::releaseWorker(
+	const PyWorkerRef& worker)
+{
+	NonRecursiveMutexLock l(m_guard);
+	m_busy[worker->getId()] = false;
+	m_idleCond.notifyAll();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorkerPool::runRequest(
+	const String& provPath,
+	const std::string& request,
+	PyWorkerRecordHandler& handler)
+{
+	PyWorkerRef worker = acquireWorker(provPath);
+	bool failed = false;
+	CIMException::ErrNoType errNo = CIMException::FAILED;
+	String errMsg;
+	try
+	{
+		worker->sendRequest(request);
+		UInt8 type;
+		std::string data;
+		for (;;)
+		{
+			worker->readRecord(type, data);
+			if (type == WORKER_REC_DONE)
+			{
+				break;
+			}
+			std::istringstream istrm(data);
+			if (type == WORKER_REC_ERROR)
+			{
+				failed = true;
+				errNo = CIMException::ErrNoType(readRaw<UInt32>(istrm));
+				errMsg = readObj<String>(istrm);
+				continue;
+			}
+			try
+			{
+				handler.handle(type, istrm);
+			}
+			catch(...)
+			{
+				// Stop the worker and get it ready for the next request
+				worker->abandon();
+				drainRequest(*worker);
+				throw;
+			}
+		}
+	}
+	catch(...)
+	{
+		releaseWorker(worker);
+		throw;
+	}
+	releaseWorker(worker);
+
+	if (failed)
+	{
+		throw CIMException(__FILE__, __LINE__, errNo, errMsg.c_str());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorkerPool::enumInstanceNames(
+	const String& provPath,
+	time_t provModTime,
+	const String& userName,
+	const String& ns,
+	const CIMClass& cimClass,
+	CIMObjectPathResultHandlerIFC& result)
+{
+	std::ostringstream ostrm;
+	writeRequestHeader(ostrm, E_WORKER_ENUM_INSTANCE_NAMES, provPath,
+		provModTime, userName, ns);
+	cimClass.writeObject(ostrm);
+	PathRecordHandler handler(result);
+	runRequest(provPath, ostrm.str(), handler);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyWorkerPool::enumInstances(
+	const String& provPath,
+	time_t provModTime,
+	const String& userName,
+	const String& ns,
+	const StringArray* propertyList,
+	const CIMClass& requestedClass,
+	const CIMClass& cimClass,
+	CIMInstanceResultHandlerIFC& result)
+{
+	std::ostringstream ostrm;
+	writeRequestHeader(ostrm, E_WORKER_ENUM_INSTANCES, provPath,
+		provModTime, userName, ns);
+	writePropertyList(ostrm, propertyList);
+	requestedClass.writeObject(ostrm);
+	// Don't send the same class twice
+	bool sameClass = requestedClass.getName().equalsIgnoreCase(
+		cimClass.getName());
+	writeRaw<UInt8>(ostrm, sameClass ? 1 : 0);
+	if (!sameClass)
+	{
+		cimClass.writeObject(ostrm);
+	}
+	InstanceRecordHandler handler(result);
+	runRequest(provPath, ostrm.str(), handler);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMInstance
+PyWorkerPool::getInstance(
+	const String& provPath,
+	time_t provModTime,
+	const String& userName,
+	const String& ns,
+	const CIMObjectPath& instanceName,
+	const StringArray* propertyList,
+	const CIMClass& cimClass)
+{
+	std::ostringstream ostrm;
+	writeRequestHeader(ostrm, E_WORKER_GET_INSTANCE, provPath,
+		provModTime, userName, ns);
+	instanceName.writeObject(ostrm);
+	writePropertyList(ostrm, propertyList);
+	cimClass.writeObject(ostrm);
+	SingleInstanceRecordHandler handler;
+	runRequest(provPath, ostrm.str(), handler);
+	if (!handler.getInstance())
+	{
+		OW_THROWCIMMSG(CIMException::FAILED, Format("Python worker returned "
+			"no instance on getInstance for provider %1", provPath).c_str());
+	}
+	return handler.getInstance();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+Py::Object
+PyWorkerPool::newWorkerEnvironment(
+	const String& userName)
+{
+	if (!g_workerEnvClass)
+	{
+		Py::Dict globals;
+		globals.setItem("__builtins__", Py::Object(PyEval_GetBuiltins()));
+		PyObject* rv = PyRun_String(WORKER_ENV_SRC, Py_file_input,
+			globals.ptr(), globals.ptr());
+		if (!rv)
+		{
+			throw Py::Exception();
+		}
+		Py_DECREF(rv);
+		g_workerEnvClass = Py::new_reference_to(
+			PyDict_GetItemString(globals.ptr(), "WorkerEnvironment"));
+	}
+	Py::Callable ctor(g_workerEnvClass);
+	Py::Tuple args(1);
+	args[0] = Py::String(userName);
+	return ctor.apply(args);
+}
+
+}	// End of namespace PythonProvIFC
@@ -0,0 +1,217 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifndef OW_PYWORKERPOOL_HPP_GUARD
+#define OW_PYWORKERPOOL_HPP_GUARD
+
+#include "PyCxxObjects.hpp"
+#include <openwbem/OW_CIMInstance.hpp>
+#include <openwbem/OW_CIMObjectPath.hpp>
+#include <openwbem/OW_CIMClass.hpp>
+#include <openwbem/OW_ResultHandlerIFC.hpp>
+#include <openwbem/OW_NonRecursiveMutex.hpp>
+#include <openwbem/OW_Condition.hpp>
+#include <openwbem/OW_IntrusiveCountableBase.hpp>
+#include <openwbem/OW_IntrusiveReference.hpp>
+#include <openwbem/OW_Array.hpp>
+
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <sys/types.h>
+#include <time.h>
+}
+
+using namespace OW_NAMESPACE;
+
+namespace PythonProvIFC
+{
+
+struct PyWorkerRing;
+class PyWorkerRecordHandler;
+
+//////////////////////////////////////////////////////////////////////////////
+// Single threaded process running the worker program, which initializes
+// python and pywbem itself. It forks all worker processes, so a worker
+// never starts as a copy of the multithreaded CIMOM, where another thread
+// may have held a lock at the time of the fork. The CIMOM only forks to
+// exec the program right away.
+class PyWorkerTemplate
+{
+public:
+	PyWorkerTemplate();
+	~PyWorkerTemplate();
+
+	// Starts the worker program and waits until it is ready. The shared
+	// memory of the ring buffers of all workers must exist already; the
+	// program maps it by the given descriptors.
+	void start(const String& program, const std::vector<int>& ringFds,
+		UInt32 ringSize);
+	// Has the template fork worker id. Returns the pid of the worker and
+	// the CIMOM's end of its request socket.
+	void spawnWorker(UInt32 id, pid_t& pid, int& fd);
+	// Ends the template process and waits for it to exit. Kills it if it
+	// doesn't exit in time.
+	void stop();
+
+	// Main of the worker program. The arguments are the control socket
+	// descriptor, the ring size and a ring descriptor per worker.
+	static int main(int argc, char* argv[]);
+
+private:
+	PyWorkerTemplate(const PyWorkerTemplate&);
+	PyWorkerTemplate& operator=(const PyWorkerTemplate&);
+
+	NonRecursiveMutex m_guard;
+	pid_t m_pid;
+	int m_fd;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// A worker process forked by the PyWorkerTemplate with python and pywbem
+// already initialized. Requests are written to a socket, results come back
+// through a ring buffer in memory shared with the worker. A worker serves
+// one request at a time.
+class PyWorker : public IntrusiveCountableBase
+{
+public:
+	PyWorker(UInt32 id, UInt32 ringSize);
+	~PyWorker();
+
+	// Creates the shared memory of the ring buffer and maps it. Returns its
+	// descriptor, which is handed to the worker program when it starts, so
+	// the workers it forks share the buffer with the CIMOM.
+	int mapRing();
+	// Has the template process fork the worker process
+	void spawn(PyWorkerTemplate& tmpl);
+	// Closes the request socket and waits for the worker to exit. Kills it
+	// if it doesn't exit in time.
+	void stop();
+	// Returns false if the worker process is gone
+	bool checkRunning();
+
+	UInt32 getId() const { return m_id; }
+	pid_t getPid() const { return m_pid; }
+
+	void sendRequest(const std::string& request);
+	// Returns the next result record. Throws a CIMException if the
+	// worker process died.
+	void readRecord(UInt8& type, std::string& data);
+	// Tells the worker to stop producing results for the current request.
+	// The records up to the end of the request still have to be read.
+	void abandon();
+
+private:
+	PyWorker(const PyWorker&);
+	PyWorker& operator=(const PyWorker&);
+
+	// The worker is not a child of the CIMOM. It is gone once its end of
+	// the request socket is closed.
+	bool processAlive() const;
+	// Cleans up after the worker process went away and throws
+	void died(const char* what);
+
+	UInt32 m_id;
+	UInt32 m_ringSize;
+	PyWorkerRing* m_ring;
+	int m_ringFd;
+	pid_t m_pid;
+	int m_fd;
+};
+typedef IntrusiveReference<PyWorker> PyWorkerRef;
+
+//////////////////////////////////////////////////////////////////////////////
+// Runs the instance read operations of python providers registered with
+// OutOfProcess=true in a pool of worker processes, so they don't compete
+// for the GIL of the CIMOM. Requests for a provider module go to the same
+// worker while it is idle, so the module stays loaded there. Workers that
+// die are forked again by the template process on their next request.
+// workerProgram is the path of the owpyworker program the template runs.
+// Providers running in a worker get a ProviderEnvironment without a
+// CIMOM handle; upcalls fail with CIM_ERR_NOT_SUPPORTED.
+// provModTime is the modification time of the provider module the CIMOM
+// loaded. Workers reload the module when it changes.
+class PyWorkerPool : public IntrusiveCountableBase
+{
+public:
+	PyWorkerPool(UInt32 workerCount, UInt32 ringSize,
+		const String& workerProgram);
+	~PyWorkerPool();
+
+	// Starts the worker program and has it fork the workers
+	void start();
+	// Ends the workers and waits for them to exit
+	void shutdown();
+
+	UInt32 getWorkerCount() const { return m_workers.size(); }
+
+	void enumInstanceNames(
+		const String& provPath,
+		time_t provModTime,
+		const String& userName,
+		const String& ns,
+		const CIMClass& cimClass,
+		CIMObjectPathResultHandlerIFC& result);
+
+	void enumInstances(
+		const String& provPath,
+		time_t provModTime,
+		const String& userName,
+		const String& ns,
+		const StringArray* propertyList,
+		const CIMClass& requestedClass,
+		const CIMClass& cimClass,
+		CIMInstanceResultHandlerIFC& result);
+
+	CIMInstance getInstance(
+		const String& provPath,
+		time_t provModTime,
+		const String& userName,
+		const String& ns,
+		const CIMObjectPath& instanceName,
+		const StringArray* propertyList,
+		const CIMClass& cimClass);
+
+	// The ProviderEnvironment given to providers inside a worker.
+	// Must be called with the GIL held.
+	static Py::Object newWorkerEnvironment(const String& userName);
+
+private:
+	PyWorkerPool(const PyWorkerPool&);
+	PyWorkerPool& operator=(const PyWorkerPool&);
+
+	PyWorkerRef acquireWorker(const String& provPath);
+	void releaseWorker(const PyWorkerRef& worker);
+	void runRequest(const String& provPath, const std::string& request,
+		PyWorkerRecordHandler& handler);
+
+	PyWorkerTemplate m_template;
+	String m_workerProgram;
+	UInt32 m_ringSize;
+	Array<PyWorkerRef> m_workers;
+	Array<bool> m_busy;
+	NonRecursiveMutex m_guard;
+	Condition m_idleCond;
+	bool m_shutdown;
+};
+typedef IntrusiveReference<PyWorkerPool> PyWorkerPoolRef;
+
+}	// End of namespace PythonProvIFC
+
+#endif	// OW_PYWORKERPOOL_HPP_GUARD
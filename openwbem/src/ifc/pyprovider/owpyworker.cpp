@@ -0,0 +1,29 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#include "OW_PyWorkerPool.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+// The program the python provider interface runs the template process of
+// its worker pool in, see PyWorkerTemplate
+int
+main(
+	int argc,
+	char* argv[])
+{
+	return PythonProvIFC::PyWorkerTemplate::main(argc, argv);
+}
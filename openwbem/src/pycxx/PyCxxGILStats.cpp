@@ -0,0 +1,423 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#include "PyCxxGILStats.hpp"
+
+#include <map>
+#include <set>
+#include <utility>
+#include <fstream>
+
+extern "C"
+{
+#include <pthread.h>
+#include <time.h>
+}
+
+using namespace OpenWBEM;
+
+namespace Py
+{
+
+namespace
+{
+
+typedef std::pair<String, String> GILTagKey;
+
+struct GILTagStats
+{
+	GILHistogram wait;
+	GILHistogram hold;
+};
+
+typedef std::map<GILTagKey, GILTagStats> GILTagMap;
+
+//////////////////////////////////////////////////////////////////////////////
+void
+mergeTags(
+	GILTagMap& to,
+	const GILTagMap& from)
+{
+	for (GILTagMap::const_iterator it = from.begin(); it != from.end(); ++it)
+	{
+		GILTagStats& stats = to[it->first];
+		stats.wait.merge(it->second.wait);
+		stats.hold.merge(it->second.hold);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// The histograms of one thread. Only the owning thread adds samples and
+// tags. Adding a tag takes m_guard so getStats can walk the map. Samples
+// are added without it, so a reader may see one half recorded.
+class GILThreadStats
+{
+public:
+	GILThreadStats()
+		: m_tags()
+		, m_untagged(0)
+	{
+		pthread_mutex_init(&m_guard, 0);
+	}
+
+	~GILThreadStats()
+	{
+		pthread_mutex_destroy(&m_guard);
+	}
+
+	GILTagStats* getTag(const GILTagKey& key)
+	{
+		GILTagMap::iterator it = m_tags.find(key);
+		if (it != m_tags.end())
+		{
+			return &it->second;
+		}
+		pthread_mutex_lock(&m_guard);
+		GILTagStats* stats = &m_tags[key];
+		pthread_mutex_unlock(&m_guard);
+		return stats;
+	}
+
+	GILTagStats* getUntagged()
+	{
+		if (!m_untagged)
+		{
+			m_untagged = getTag(GILTagKey(String(), String()));
+		}
+		return m_untagged;
+	}
+
+	void mergeInto(GILTagMap& to)
+	{
+		pthread_mutex_lock(&m_guard);
+		mergeTags(to, m_tags);
+		pthread_mutex_unlock(&m_guard);
+	}
+
+private:
+	pthread_mutex_t m_guard;
+	GILTagMap m_tags;
+	GILTagStats* m_untagged;
+};
+
+volatile bool g_enabled = false;
+
+// Live threads and the merged histograms of the threads that exited
+pthread_mutex_t g_guard = PTHREAD_MUTEX_INITIALIZER;
+std::set<GILThreadStats*> g_threads;
+GILTagMap g_retired;
+pthread_key_t g_threadKey;
+pthread_once_t g_threadKeyOnce = PTHREAD_ONCE_INIT;
+
+__thread GILThreadStats* t_stats = 0;
+__thread GILTagStats* t_tag = 0;	// Set by GILStatsScope
+__thread int t_depth = 0;			// GILGuards holding the lock
+__thread UInt64 t_holdStart = 0;	// 0 if the hold isn't timed
+
+//////////////////////////////////////////////////////////////////////////////
+inline UInt64
+nowUsecs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return UInt64(ts.tv_sec) * 1000000 + UInt64(ts.tv_nsec) / 1000;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+threadStatsExit(
+	void* arg)
+{
+	GILThreadStats* stats = static_cast<GILThreadStats*>(arg);
+	pthread_mutex_lock(&g_guard);
+	g_threads.erase(stats);
+	stats->mergeInto(g_retired);
+	pthread_mutex_unlock(&g_guard);
+	delete stats;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+createThreadKey()
+{
+	pthread_key_create(&g_threadKey, threadStatsExit);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+GILThreadStats*
+threadStats()
+{
+	if (!t_stats)
+	{
+		pthread_once(&g_threadKeyOnce, createThreadKey);
+		t_stats = new GILThreadStats;
+		pthread_setspecific(g_threadKey, t_stats);
+		pthread_mutex_lock(&g_guard);
+		g_threads.insert(t_stats);
+		pthread_mutex_unlock(&g_guard);
+	}
+	return t_stats;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+inline GILTagStats*
+currentTag()
+{
+	return t_tag ? t_tag : threadStats()->getUntagged();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+writeHistogram(
+	std::ostream& ostrm,
+	const GILStatsEntry& entry,
+	const char* kind,
+	const GILHistogram& hist)
+{
+	ostrm << (entry.provider.empty() ? "-" : entry.provider.c_str())
+		<< '\t' << (entry.operation.empty() ? "-" : entry.operation.c_str())
+		<< '\t' << kind
+		<< '\t' << hist.count
+		<< '\t' << hist.totalUsecs
+		<< '\t' << hist.maxUsecs
+		<< '\t';
+	for (int i = 0; i < GILHistogram::BUCKETS; i++)
+	{
+		ostrm << (i ? " " : "") << hist.buckets[i];
+	}
+	ostrm << '\n';
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+GILHistogram::GILHistogram()
+	: count(0)
+	, totalUsecs(0)
+	, maxUsecs(0)
+{
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		buckets[i] = 0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+GILHistogram::add(
+	UInt64 usecs)
+{
+	int bucket = 0;
+	while (bucket < BUCKETS - 1 && (UInt64(1) << bucket) <= usecs)
+	{
+		bucket++;
+	}
+	buckets[bucket]++;
+	count++;
+	totalUsecs += usecs;
+	if (usecs > maxUsecs)
+	{
+		maxUsecs = usecs;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+GILHistogram::merge(
+	const GILHistogram& other)
+{
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		buckets[i] += other.buckets[i];
+	}
+	count += other.count;
+	totalUsecs += other.totalUsecs;
+	if (other.maxUsecs > maxUsecs)
+	{
+		maxUsecs = other.maxUsecs;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+GILStatsScope::GILStatsScope(
+	const String& provider,
+	const char* operation)
+	: m_prevTag(t_tag)
+{
+	t_tag = g_enabled
+		? threadStats()->getTag(GILTagKey(provider, String(operation)))
+		: 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+GILStatsScope::~GILStatsScope()
+{
+	t_tag = static_cast<GILTagStats*>(m_prevTag);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+GILStats::setEnabled(
+	bool enabled)
+{
+	g_enabled = enabled;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+bool
+GILStats::isEnabled()
+{
+	return g_enabled;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+std::vector<GILStatsEntry>
+GILStats::getStats()
+{
+	GILTagMap tags;
+	pthread_mutex_lock(&g_guard);
+	mergeTags(tags, g_retired);
+	for (std::set<GILThreadStats*>::iterator it = g_threads.begin();
+		it != g_threads.end(); ++it)
+	{
+		(*it)->mergeInto(tags);
+	}
+	pthread_mutex_unlock(&g_guard);
+
+	std::vector<GILStatsEntry> rv;
+	for (GILTagMap::const_iterator it = tags.begin(); it != tags.end(); ++it)
+	{
+		GILStatsEntry entry;
+		entry.provider = it->first.first;
+		entry.operation = it->first.second;
+		entry.wait = it->second.wait;
+		entry.hold = it->second.hold;
+		rv.push_back(entry);
+	}
+	return rv;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+bool
+GILStats::dump(
+	const String& fileName)
+{
+	std::ofstream ostrm(fileName.c_str());
+	if (!ostrm)
+	{
+		return false;
+	}
+	ostrm << "# GIL wait and hold times in microseconds\n"
+		<< "# provider\toperation\tkind\tcount\ttotal\tmax\tbuckets "
+		"(< 1, < 2, < 4 ... < 2^" << (GILHistogram::BUCKETS - 2)
+		<< ", longer)\n";
+	std::vector<GILStatsEntry> stats = getStats();
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		writeHistogram(ostrm, stats[i], "wait", stats[i].wait);
+		writeHistogram(ostrm, stats[i], "hold", stats[i].hold);
+	}
+	ostrm.close();
+	return !ostrm.fail();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+UInt64
+GILStats::lockRequested()
+{
+	return (g_enabled && t_depth == 0) ? nowUsecs() : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+GILStats::lockAcquired(
+	UInt64 requested)
+{
+	if (++t_depth > 1)
+	{
+		return;
+	}
+	if (requested)
+	{
+		UInt64 now = nowUsecs();
+		currentTag()->wait.add(now - requested);
+		t_holdStart = now;
+	}
+	else
+	{
+		t_holdStart = 0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+GILStats::lockReleasing()
+{
+	if (--t_depth > 0)
+	{
+		return;
+	}
+	if (t_holdStart && g_enabled)
+	{
+		currentTag()->hold.add(nowUsecs() - t_holdStart);
+	}
+	t_holdStart = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+int
+GILStats::suspend()
+{
+	int depth = t_depth;
+	if (depth > 0 && t_holdStart && g_enabled)
+	{
+		currentTag()->hold.add(nowUsecs() - t_holdStart);
+	}
+	t_depth = 0;
+	t_holdStart = 0;
+	return depth;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+GILStats::resume(
+	int depth,
+	UInt64 requested)
+{
+	t_depth = depth;
+	t_holdStart = 0;
+	if (requested)
+	{
+		UInt64 now = nowUsecs();
+		currentTag()->wait.add(now - requested);
+		if (depth > 0)
+		{
+			t_holdStart = now;
+		}
+	}
+}
+
+}	// End of namespace Py
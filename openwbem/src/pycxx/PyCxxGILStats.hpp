@@ -0,0 +1,103 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifndef __PYCXXGILSTATS_HPP_GUARD
+#define __PYCXXGILSTATS_HPP_GUARD
+
+#include <openwbem/OW_config.h>
+#include <openwbem/OW_Types.hpp>
+#include <openwbem/OW_String.hpp>
+
+#include <vector>
+
+namespace Py
+{
+
+// Histogram of GIL wait or hold times. Bucket i counts the samples of less
+// than 2^i microseconds, the last bucket all longer ones.
+struct GILHistogram
+{
+	enum { BUCKETS = 24 };
+
+	GILHistogram();
+	void add(OpenWBEM::UInt64 usecs);
+	void merge(const GILHistogram& other);
+
+	OpenWBEM::UInt64 count;
+	OpenWBEM::UInt64 totalUsecs;
+	OpenWBEM::UInt64 maxUsecs;
+	OpenWBEM::UInt64 buckets[BUCKETS];
+};
+
+// Time spent waiting for the GIL and holding it on behalf of one provider
+// operation. Samples taken outside of any GILStatsScope have an empty
+// provider and operation.
+struct GILStatsEntry
+{
+	OpenWBEM::String provider;
+	OpenWBEM::String operation;
+	GILHistogram wait;
+	GILHistogram hold;
+};
+
+// Tags the GIL samples the current thread takes with a provider and an
+// operation for as long as it is in scope. Scopes nest, so an upcall that
+// ends up in another provider is accounted to that provider.
+class GILStatsScope
+{
+public:
+	GILStatsScope(const OpenWBEM::String& provider, const char* operation);
+	~GILStatsScope();
+private:
+	GILStatsScope(const GILStatsScope&);
+	GILStatsScope& operator=(const GILStatsScope&);
+
+	void* m_prevTag;
+};
+
+// Optional recording of GIL wait and hold times by GILGuard and
+// PYCXX_ALLOW_THREADS. Only the outermost GILGuard of a thread takes
+// samples. Time spent inside PYCXX_ALLOW_THREADS is not hold time, taking
+// the lock back afterwards is wait time.
+// Every thread records into histograms of its own without taking a lock.
+// getStats merges them. The histograms of threads that exit are merged
+// into a shared set.
+class GILStats
+{
+public:
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	// Merged statistics of all threads, one entry per provider operation
+	static std::vector<GILStatsEntry> getStats();
+	// Writes getStats() to the given file as tab separated text.
+	// Returns false if the file can't be written.
+	static bool dump(const OpenWBEM::String& fileName);
+
+	// Used by GILGuard and ThreadSaver. lockRequested returns the time the
+	// wait started or 0 if it isn't timed. suspend returns the nesting
+	// depth that resume must be given back.
+	static OpenWBEM::UInt64 lockRequested();
+	static void lockAcquired(OpenWBEM::UInt64 requested);
+	static void lockReleasing();
+	static int suspend();
+	static void resume(int depth, OpenWBEM::UInt64 requested);
+};
+
+}	// End of namespace Py
+
+#endif	// __PYCXXGILSTATS_HPP_GUARD
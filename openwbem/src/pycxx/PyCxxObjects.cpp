@@ -17,15 +17,300 @@
 *****************************************************************************/
 #include "PyCxxObjects.hpp"
 
+#include <set>
+#include <vector>
+
+extern "C"
+{
+#include <pthread.h>
+}
+
 namespace Py
 {
 
+namespace
+{
+
+// Per thread state of the InterpreterScope/GILGuard pair. t_tstate is the
+// thread state this thread uses in t_interp and t_depth the number of
+// GILGuards currently holding it. t_cached is false if t_tstate is to be
+// deleted once t_depth drops to 0.
+__thread PyInterpreterState* t_interp = 0;
+__thread PyThreadState* t_tstate = 0;
+__thread int t_depth = 0;
+__thread bool t_cached = false;
+
+// The thread states a thread keeps between GILGuards. For the main
+// interpreter that is the PyGILState one, kept alive by an extra
+// PyGILState_Ensure. Subinterpreters get one PyThreadState each.
+struct ThreadStates
+{
+	ThreadStates()
+		: pinned(false)
+		, subStates()
+	{
+	}
+
+	bool pinned;
+	std::vector<PyThreadState*> subStates;
+};
+
+// g_cacheGuard only protects the cache data and is never held while the
+// GIL is taken. Uses of the cache that take the GIL or create thread
+// states are counted in g_cacheUsers instead, and shutdown waits for them
+// on g_cacheIdle.
+pthread_mutex_t g_cacheGuard = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t g_cacheIdle = PTHREAD_COND_INITIALIZER;
+bool g_cacheEnabled = true;
+int g_cacheUsers = 0;
+std::set<ThreadStates*> g_cachedThreads;
+pthread_key_t g_cacheKey;
+pthread_once_t g_cacheKeyOnce = PTHREAD_ONCE_INIT;
+
+__thread ThreadStates* t_cache = 0;
+__thread bool t_pinChecked = false;
+
+//////////////////////////////////////////////////////////////////////////////
+// Counts a use of the cache unless it is shut down. Returns false if it is.
+bool
+beginCacheUse()
+{
+	pthread_mutex_lock(&g_cacheGuard);
+	bool enabled = g_cacheEnabled;
+	if (enabled)
+	{
+		g_cacheUsers++;
+	}
+	pthread_mutex_unlock(&g_cacheGuard);
+	return enabled;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+endCacheUse()
+{
+	pthread_mutex_lock(&g_cacheGuard);
+	if (--g_cacheUsers == 0)
+	{
+		pthread_cond_broadcast(&g_cacheIdle);
+	}
+	pthread_mutex_unlock(&g_cacheGuard);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Runs when a thread that used python exits and deletes its thread states
+void
+releaseThreadStates(
+	void* arg)
+{
+	ThreadStates* cache = static_cast<ThreadStates*>(arg);
+	pthread_mutex_lock(&g_cacheGuard);
+	// Once it is out of the set, shutdown leaves its states to us
+	g_cachedThreads.erase(cache);
+	bool release = g_cacheEnabled && Py_IsInitialized();
+	if (release)
+	{
+		g_cacheUsers++;
+	}
+	pthread_mutex_unlock(&g_cacheGuard);
+
+	if (release)
+	{
+		for (size_t i = 0; i < cache->subStates.size(); i++)
+		{
+			PyEval_RestoreThread(cache->subStates[i]);
+			PyThreadState_Clear(cache->subStates[i]);
+			PyThreadState_DeleteCurrent();	// Also releases the lock
+		}
+		if (cache->pinned)
+		{
+			// Drop the extra reference last, the PyGILState count
+			// reaching 0 deletes the thread state.
+			PyGILState_Ensure();
+			PyGILState_Release(PyGILState_LOCKED);
+			PyGILState_Release(PyGILState_UNLOCKED);
+		}
+		endCacheUse();
+	}
+	delete cache;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+createCacheKey()
+{
+	pthread_key_create(&g_cacheKey, releaseThreadStates);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+ThreadStates*
+threadCache()
+{
+	if (!t_cache)
+	{
+		pthread_once(&g_cacheKeyOnce, createCacheKey);
+		t_cache = new ThreadStates;
+		pthread_setspecific(g_cacheKey, t_cache);
+		pthread_mutex_lock(&g_cacheGuard);
+		g_cachedThreads.insert(t_cache);
+		pthread_mutex_unlock(&g_cacheGuard);
+	}
+	return t_cache;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Keeps the PyGILState thread state of a thread that has none alive until
+// the thread exits. Threads python knows about already are left alone.
+// Must be called without the GIL.
+void
+pinMainThreadState()
+{
+	if (t_pinChecked)
+	{
+		return;
+	}
+	t_pinChecked = true;
+	if (PyGILState_GetThisThreadState())
+	{
+		return;
+	}
+	ThreadStates* cache = threadCache();
+	if (beginCacheUse())
+	{
+		PyGILState_Ensure();
+		PyEval_SaveThread();
+		pthread_mutex_lock(&g_cacheGuard);
+		cache->pinned = true;
+		pthread_mutex_unlock(&g_cacheGuard);
+		endCacheUse();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Returns this thread's cached thread state for interp, creating it if
+// needed, or 0 if the cache is shut down. Must be called without the GIL.
+PyThreadState*
+cachedSubState(
+	PyInterpreterState* interp)
+{
+	ThreadStates* cache = threadCache();
+	for (size_t i = 0; i < cache->subStates.size(); i++)
+	{
+		if (cache->subStates[i]->interp == interp)
+		{
+			return cache->subStates[i];
+		}
+	}
+	// A new thread state registers itself with PyGILState if the thread
+	// doesn't have one yet. Give it a main interpreter one first.
+	pinMainThreadState();
+	PyThreadState* tstate = 0;
+	if (beginCacheUse())
+	{
+		tstate = PyThreadState_New(interp);
+		pthread_mutex_lock(&g_cacheGuard);
+		cache->subStates.push_back(tstate);
+		pthread_mutex_unlock(&g_cacheGuard);
+		endCacheUse();
+	}
+	return tstate;
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+ThreadStateCache::shutdown()
+{
+	std::vector<PyThreadState*> subStates;
+	pthread_mutex_lock(&g_cacheGuard);
+	g_cacheEnabled = false;
+	// Let the threads that got past the check above finish first
+	while (g_cacheUsers)
+	{
+		pthread_cond_wait(&g_cacheIdle, &g_cacheGuard);
+	}
+	for (std::set<ThreadStates*>::iterator it = g_cachedThreads.begin();
+		it != g_cachedThreads.end(); ++it)
+	{
+		subStates.insert(subStates.end(), (*it)->subStates.begin(),
+			(*it)->subStates.end());
+		(*it)->subStates.clear();
+		(*it)->pinned = false;
+	}
+	pthread_mutex_unlock(&g_cacheGuard);
+
+	if (subStates.empty())
+	{
+		return;
+	}
+	PyEval_AcquireLock();
+	for (size_t i = 0; i < subStates.size(); i++)
+	{
+		PyThreadState_Swap(subStates[i]);
+		PyThreadState_Clear(subStates[i]);
+		PyThreadState_Swap(0);
+		PyThreadState_Delete(subStates[i]);
+	}
+	PyEval_ReleaseLock();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+ThreadSaver::ThreadSaver()
+	: m_tstate(0)
+	, m_statsDepth(GILStats::suspend())
+{
+	m_tstate = PyEval_SaveThread();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+ThreadSaver::~ThreadSaver()
+{
+	OpenWBEM::UInt64 requested = GILStats::lockRequested();
+	PyEval_RestoreThread(m_tstate);
+	GILStats::resume(m_statsDepth, requested);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+InterpreterScope::InterpreterScope(
+	PyInterpreterState* interp)
+	: m_prevInterp(t_interp)
+	, m_prevTState(t_tstate)
+	, m_prevDepth(t_depth)
+	, m_prevCached(t_cached)
+{
+	t_interp = interp;
+	t_tstate = 0;
+	t_depth = 0;
+	t_cached = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+InterpreterScope::~InterpreterScope()
+{
+	t_interp = m_prevInterp;
+	t_tstate = m_prevTState;
+	t_depth = m_prevDepth;
+	t_cached = m_prevCached;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+PyInterpreterState*
+InterpreterScope::current()
+{
+	return t_interp;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 GILGuard::GILGuard()
 	: m_gstate()
-	, m_acquired(true)
+	, m_acquired(false)
+	, m_subInterp(false)
+	, m_tookLock(false)
 {
-	m_gstate = PyGILState_Ensure();
+	acquire();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -38,10 +323,34 @@ GILGuard::~GILGuard()
 void
 GILGuard::release()
 {
-	if (m_acquired)
+	if (!m_acquired)
+	{
+		return;
+	}
+	m_acquired = false;
+	GILStats::lockReleasing();
+	if (!m_subInterp)
 	{
 		PyGILState_Release(m_gstate);
-		m_acquired = false;
+		return;
+	}
+	if (--t_depth == 0)
+	{
+		if (t_cached)
+		{
+			// Keep the thread state for the next guard on this thread
+			PyEval_SaveThread();
+			return;
+		}
+		// The thread state cache is shut down. Drop the thread state so
+		// the interpreter can be ended once no thread is using it.
+		PyThreadState_Clear(t_tstate);
+		PyThreadState_DeleteCurrent();	// Also releases the lock
+		t_tstate = 0;
+	}
+	else if (m_tookLock)
+	{
+		PyEval_SaveThread();
 	}
 }
 
@@ -49,11 +358,40 @@ GILGuard::release()
 void
 GILGuard::acquire()
 {
-	if (!m_acquired)
+	if (m_acquired)
 	{
+		return;
+	}
+	m_acquired = true;
+	OpenWBEM::UInt64 requested = GILStats::lockRequested();
+	m_subInterp = (t_interp != 0);
+	if (!m_subInterp)
+	{
+		pinMainThreadState();
 		m_gstate = PyGILState_Ensure();
-		m_acquired = true;
+		GILStats::lockAcquired(requested);
+		return;
+	}
+	m_tookLock = false;
+	if (!t_tstate)
+	{
+		t_tstate = cachedSubState(t_interp);
+		t_cached = (t_tstate != 0);
+		if (!t_cached)
+		{
+			t_tstate = PyThreadState_New(t_interp);
+		}
+	}
+	if (t_depth == 0 || PyThreadState_GET() != t_tstate)
+	{
+		// Either no guard holds the lock or it was given up by an
+		// enclosing guard (e.g. around an upcall to the CIMOM). Take it
+		// with this thread's state.
+		PyEval_RestoreThread(t_tstate);
+		m_tookLock = true;
 	}
+	++t_depth;
+	GILStats::lockAcquired(requested);
 }
 
 //////////////////////////////////////////////////////////////////////////////
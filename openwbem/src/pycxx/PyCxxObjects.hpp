@@ -57,6 +57,7 @@
 #include <Python.h>
 #include "PyCxxConfig.hpp"
 #include "PyCxxException.hpp"
+#include "PyCxxGILStats.hpp"
 
 #include <openwbem/OW_String.hpp>
 #include <openwbem/OW_StringStream.hpp>
@@ -74,25 +75,55 @@ namespace Py
 class ThreadSaver
 {
 public:
-	ThreadSaver()
-	{
-		m_tstate = PyEval_SaveThread();
-	}
-	~ThreadSaver()
-	{
-		PyEval_RestoreThread(m_tstate);
-	}
+	ThreadSaver();
+	~ThreadSaver();
 private:
 	PyThreadState* m_tstate;
+	int m_statsDepth;
 };
 #define PYCXX_ALLOW_THREADS { Py::ThreadSaver ts;
 #define PYCXX_END_ALLOW_THREADS }
 
+// The InterpreterScope class selects the interpreter that GILGuard
+// instances created by the current thread run in, for as long as the
+// InterpreterScope is in scope. A null interpreter selects the main
+// interpreter. Scopes nest, so a provider in one interpreter can make an
+// upcall that ends up in a provider running in another.
+class InterpreterScope
+{
+public:
+	InterpreterScope(PyInterpreterState* interp);
+	~InterpreterScope();
+	static PyInterpreterState* current();
+private:
+	PyInterpreterState* m_prevInterp;
+	PyThreadState* m_prevTState;
+	int m_prevDepth;
+	bool m_prevCached;
+};
+
+// Threads keep the python thread states GILGuard gives them until they
+// exit, so entering python again only costs taking the lock. For the main
+// interpreter that is the PyGILState thread state of threads python didn't
+// create, for subinterpreters one thread state per interpreter.
+// shutdown must be called before subinterpreters are ended or python is
+// finalized, without the GIL held. It deletes the subinterpreter thread
+// states of all threads and stops caching, the main interpreter ones go
+// away with Py_Finalize.
+class ThreadStateCache
+{
+public:
+	static void shutdown();
+};
+
 // The GILGuard class is used to acquire python global interpreter lock.
 // It acquires the lock within its constructor and releases it in its
 // destructor. Do use it just declare an instance of the GILGuard when
 // you want to acquire the lock. When the instance goes out of scope,
 // the lock will be released.
+// Within an InterpreterScope for a subinterpreter, the lock is taken with
+// a thread state of that interpreter instead of the one PyGILState keeps
+// for the main interpreter. Both come from the ThreadStateCache.
 class GILGuard
 {
 public:
@@ -103,6 +134,8 @@ public:
 private:
 	PyGILState_STATE m_gstate;
 	bool m_acquired;
+	bool m_subInterp;
+	bool m_tookLock;
 };
 
 
@@ -0,0 +1,61 @@
+"""Python Provider for Py_AsyncTest
+
+Instruments the CIM class Py_AsyncTest with provider methods that return
+coroutines and generators, to test what the provider interface awaits on
+its event loop. Needs pyprovifc.async_module = trollius.
+"""
+
+import pywbem
+import pycimmb
+import trollius
+from trollius import From, Return
+from pycim import CIMProvider
+
+_values = {'one': 1, 'two': 2, 'three': 3}
+
+def _inst(name, ns):
+    path = pywbem.CIMInstanceName('Py_AsyncTest', namespace=ns,
+        keybindings={'Name': name})
+    inst = pywbem.CIMInstance('Py_AsyncTest', path=path)
+    inst['Name'] = name
+    inst['Value'] = pywbem.Uint32(_values[name])
+    return inst
+
+class Py_AsyncTestProvider(CIMProvider):
+    """Instrument the CIM class Py_AsyncTest"""
+
+    #########################################################################
+    def __init__ (self):
+        pass
+
+    #########################################################################
+    def MI_enumInstances(self, env, ns, propertyList, requestedCimClass,
+            cimClass):
+        # A plain generator of results. It must be iterated, not awaited.
+        for name in sorted(_values.keys()):
+            yield _inst(name, ns)
+
+    #########################################################################
+    @pycimmb.coroutine
+    def MI_enumInstanceNames(self, env, ns, cimClass):
+        # A coroutine returning the names once the loop ran it
+        yield From(trollius.sleep(0.01))
+        raise Return([_inst(name, ns).path
+            for name in sorted(_values.keys())])
+
+    #########################################################################
+    @pycimmb.coroutine
+    def MI_getInstance(self, env, instanceName, propertyList, cimClass):
+        # A coroutine raising for unknown names, so errors of awaited
+        # results reach the client
+        yield From(trollius.sleep(0.01))
+        name = instanceName['Name']
+        if name not in _values:
+            raise pywbem.CIMError(pywbem.CIM_ERR_NOT_FOUND, name)
+        raise Return(_inst(name, instanceName.namespace))
+
+## end of class Py_AsyncTestProvider
+
+def get_providers(env):
+    _py_asynctest_prov = Py_AsyncTestProvider()
+    return {'Py_AsyncTest': _py_asynctest_prov}
@@ -0,0 +1,78 @@
+"""Python Provider for Py_BatchTest
+
+Instruments Py_BatchTest and the Py_Batch*Test error classes. Their
+instances are returned as columnar batches,
+    (classname, [propname, ...], [column, ...])
+The batch of Py_BatchTest is valid and mixed with single instances. The
+batches of the other classes are invalid in one way each, and enumerating
+them must fail.
+"""
+
+import pywbem
+from pycim import CIMProvider
+
+def _batch_test(ns):
+    # Plain python values are converted with the types of the class. The
+    # None cell leaves Note of 'b' unset. Name is a key in the class, so it
+    # is the key of every instance.
+    yield ('Py_BatchTest', ['Name', 'Value', 'Note'],
+        [['a', 'b'], [1, 2], ['first', None]])
+    inst = pywbem.CIMInstance('Py_BatchTest')
+    inst['Name'] = 'single'
+    inst['Value'] = pywbem.Uint32(3)
+    inst['Note'] = 'single'
+    inst.path = pywbem.CIMInstanceName('Py_BatchTest', namespace=ns,
+        keybindings={'Name': 'single'})
+    yield inst
+    # Any column order, tuples as columns and a batch of one
+    yield ('Py_BatchTest', ('Value', 'Name'), ((4,), ('tuple',)))
+    # An empty batch adds nothing
+    yield ('Py_BatchTest', ['Name', 'Value'], [[], []])
+
+def _length_test(ns):
+    yield ('Py_BatchLengthTest', ['Name', 'Value'], [['a', 'b'], [1]])
+
+def _count_test(ns):
+    yield ('Py_BatchCountTest', ['Name', 'Value'], [['a', 'b']])
+
+def _property_test(ns):
+    yield ('Py_BatchPropertyTest', ['Name', 'Nope'], [['a'], [1]])
+
+def _column_test(ns):
+    yield ('Py_BatchColumnTest', ['Name', 'Value'], [['a'], 1])
+
+def _value_test(ns):
+    yield ('Py_BatchValueTest', ['Name', 'Value'], [['a', 'b'], [1, -1]])
+
+_batches = {
+    'py_batchtest': _batch_test,
+    'py_batchlengthtest': _length_test,
+    'py_batchcounttest': _count_test,
+    'py_batchpropertytest': _property_test,
+    'py_batchcolumntest': _column_test,
+    'py_batchvaluetest': _value_test,
+}
+
+class Py_BatchTestProvider(CIMProvider):
+    """Instrument the CIM class Py_BatchTest and the Py_Batch*Test error
+    classes"""
+
+    #########################################################################
+    def __init__ (self):
+        pass
+
+    #########################################################################
+    def MI_enumInstances(self, env, ns, propertyList, requestedCimClass,
+            cimClass):
+        return _batches[cimClass.classname.lower()](ns)
+
+## end of class Py_BatchTestProvider
+
+def get_providers(env):
+    _py_batchtest_prov = Py_BatchTestProvider()
+    return {'Py_BatchTest': _py_batchtest_prov,
+            'Py_BatchLengthTest': _py_batchtest_prov,
+            'Py_BatchCountTest': _py_batchtest_prov,
+            'Py_BatchPropertyTest': _py_batchtest_prov,
+            'Py_BatchColumnTest': _py_batchtest_prov,
+            'Py_BatchValueTest': _py_batchtest_prov}
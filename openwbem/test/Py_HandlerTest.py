@@ -0,0 +1,146 @@
+"""Python Provider for Py_HandlerTest
+
+Instruments Py_HandlerTest and Py_HandlerSource. Enumerating Py_HandlerTest
+makes CIMOM handle upcalls enumerating Py_HandlerSource with a Handler and
+checks how the results are handed to it with HandlerBatchSize and
+HandlerBatchTime. An instance is returned for every check that passed. A
+failed check is raised as CIM_ERR_FAILED with a description of the check.
+"""
+
+import pywbem
+from pycim import CIMProvider
+
+_source_names = ['s%d' % i for i in range(7)]
+
+def _check(cond, what):
+    if not cond:
+        raise pywbem.CIMError(pywbem.CIM_ERR_FAILED, 'Check failed: ' + what)
+
+def _check_error(func, code, what):
+    try:
+        func()
+    except pywbem.CIMError, arg:
+        _check(arg[0] == code, what + ' raises %s: %s' % (code, arg))
+        return
+    _check(False, what + ' raises')
+
+def _names(objs):
+    if isinstance(objs, pywbem.CIMInstanceName):
+        return [objs['Name']]
+    if isinstance(objs, pywbem.CIMInstance):
+        return [objs['Name']]
+    return [obj['Name'] for obj in objs]
+
+def _enum(ns, func, **kwargs):
+    calls = []
+    rv = func('Py_HandlerSource', ns, Handler=calls.append, **kwargs)
+    _check(rv is None, 'the upcall with a Handler returns None')
+    return calls
+
+def _check_batches(calls, sizes, what):
+    _check([isinstance(call, list) and len(call) for call in calls] == sizes,
+        what + ' batch sizes: %s' % [type(call) for call in calls])
+    got = []
+    for call in calls:
+        got.extend(_names(call))
+    _check(got == _source_names, what + ' results: %s' % got)
+
+def _run_checks(ch, ns):
+    # Full batches and the remainder, handed over before the call returns
+    calls = _enum(ns, ch.EnumerateInstances, HandlerBatchSize=3)
+    _check_batches(calls, [3, 3, 1], 'EnumerateInstances')
+    for call in calls:
+        for inst in call:
+            _check(isinstance(inst, pywbem.CIMInstance),
+                'EnumerateInstances batches hold instances')
+    yield 'instances'
+
+    calls = _enum(ns, ch.EnumerateInstanceNames, HandlerBatchSize=4)
+    _check_batches(calls, [4, 3], 'EnumerateInstanceNames')
+    for call in calls:
+        for path in call:
+            _check(isinstance(path, pywbem.CIMInstanceName),
+                'EnumerateInstanceNames batches hold instance names')
+    yield 'names'
+
+    # A batch larger than the enumeration is handed over as the remainder
+    calls = _enum(ns, ch.EnumerateInstances, HandlerBatchSize=100)
+    _check_batches(calls, [7], 'HandlerBatchSize larger than the results')
+    yield 'remainder'
+
+    # A batch time longer than the call does not cut batches
+    calls = _enum(ns, ch.EnumerateInstances, HandlerBatchSize=3,
+        HandlerBatchTime=600000)
+    _check_batches(calls, [3, 3, 1], 'HandlerBatchTime')
+    yield 'time'
+
+    # Without a batch size the Handler is called once per result
+    for kwargs in [{}, {'HandlerBatchSize': 0}]:
+        calls = _enum(ns, ch.EnumerateInstances, **kwargs)
+        _check(len(calls) == 7 and not [call for call in calls
+            if not isinstance(call, pywbem.CIMInstance)],
+            'no batching with %s: %s' % (kwargs, calls))
+        _check([call['Name'] for call in calls] == _source_names,
+            'no batching with %s results' % kwargs)
+    yield 'unbatched'
+
+    # Without a Handler the batch size is ignored
+    insts = ch.EnumerateInstances('Py_HandlerSource', ns,
+        HandlerBatchSize=3)
+    _check(_names(insts) == _source_names, 'batch size without a Handler')
+    yield 'nohandler'
+
+    # Errors
+    for kwargs in [{'HandlerBatchSize': -1},
+            {'HandlerBatchSize': 3, 'HandlerBatchTime': -1}]:
+        _check_error(lambda: _enum(ns, ch.EnumerateInstances, **kwargs),
+            pywbem.CIM_ERR_INVALID_PARAMETER, 'the negative %s' % kwargs)
+    def fail_handler(batch):
+        raise ValueError('fail_handler')
+    _check_error(lambda: ch.EnumerateInstances('Py_HandlerSource', ns,
+            Handler=fail_handler, HandlerBatchSize=3),
+        pywbem.CIM_ERR_FAILED, 'an exception in the Handler of a full batch')
+    _check_error(lambda: ch.EnumerateInstances('Py_HandlerSource', ns,
+            Handler=fail_handler, HandlerBatchSize=100),
+        pywbem.CIM_ERR_FAILED, 'an exception in the Handler of the remainder')
+    yield 'errors'
+
+class Py_HandlerTestProvider(CIMProvider):
+    """Instrument the CIM classes Py_HandlerTest and Py_HandlerSource"""
+
+    #########################################################################
+    def __init__ (self):
+        pass
+
+    #########################################################################
+    def MI_enumInstances(self, env, ns, propertyList, requestedCimClass,
+            cimClass):
+        if cimClass.classname.lower() == 'py_handlersource':
+            for name in _source_names:
+                inst = pywbem.CIMInstance('Py_HandlerSource')
+                inst['Name'] = name
+                inst.path = pywbem.CIMInstanceName('Py_HandlerSource',
+                    namespace=ns, keybindings={'Name': name})
+                yield inst
+            return
+
+        ch = env.get_cimom_handle()
+        for name in _run_checks(ch, ns):
+            inst = pywbem.CIMInstance('Py_HandlerTest')
+            inst['Name'] = name
+            inst.path = pywbem.CIMInstanceName('Py_HandlerTest',
+                namespace=ns, keybindings={'Name': name})
+            yield inst
+
+    #########################################################################
+    def MI_enumInstanceNames(self, env, ns, cimClass):
+        for name in _source_names:
+            yield pywbem.CIMInstanceName('Py_HandlerSource', namespace=ns,
+                keybindings={'Name': name})
+
+## end of class Py_HandlerTestProvider
+
+def get_providers(env):
+    _py_handlertest_prov = Py_HandlerTestProvider()
+    return {'Py_HandlerTest': _py_handlertest_prov,
+            'Py_HandlerSource': _py_handlertest_prov}
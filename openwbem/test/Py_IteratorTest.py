@@ -0,0 +1,217 @@
+"""Python Provider for Py_IteratorTest
+
+Instruments Py_IteratorTest, Py_IteratorExpiryTest and the classes their
+checks enumerate. Enumerating Py_IteratorTest makes CIMOM handle upcalls
+with Iterator=True and checks the iterators they return. One iterator is
+kept past the end of the call, and enumerating Py_IteratorExpiryTest
+afterwards checks that it has ended with that call. An instance is
+returned for every check that passed. A failed check is raised as
+CIM_ERR_FAILED with a description of the check.
+"""
+
+import threading
+import pywbem
+from pycim import CIMProvider
+
+_source_names = ['s%d' % i for i in range(7)]
+_fail_names = ['f0', 'f1', 'f2']
+
+# The iterator kept from the last Py_IteratorTest call
+_kept = None
+
+def _check(cond, what):
+    if not cond:
+        raise pywbem.CIMError(pywbem.CIM_ERR_FAILED, 'Check failed: ' + what)
+
+def _check_error(func, code, what):
+    try:
+        func()
+    except pywbem.CIMError, arg:
+        _check(arg[0] == code, what + ' raises %s: %s' % (code, arg))
+        return arg
+    _check(False, what + ' raises')
+
+def _source_path(ns, name):
+    return pywbem.CIMInstanceName('Py_IteratorSource', namespace=ns,
+        keybindings={'Name': name})
+
+def _instance(ns, classname, name):
+    inst = pywbem.CIMInstance(classname)
+    inst['Name'] = name
+    inst.path = pywbem.CIMInstanceName(classname, namespace=ns,
+        keybindings={'Name': name})
+    return inst
+
+def _link(ns, name):
+    inst = pywbem.CIMInstance('Py_IteratorLink')
+    inst['Antecedent'] = _source_path(ns, _source_names[0])
+    inst['Dependent'] = _source_path(ns, name)
+    inst.path = pywbem.CIMInstanceName('Py_IteratorLink', namespace=ns,
+        keybindings={'Antecedent': inst['Antecedent'],
+                     'Dependent': inst['Dependent']})
+    return inst
+
+def _check_iterator(it, what):
+    _check(not isinstance(it, list), what + ' returns an iterator')
+    _check(iter(it) is it, what + ' iter() returns the iterator')
+    got = []
+    for inst in it:
+        _check(isinstance(inst, pywbem.CIMInstance),
+            what + ' iterates over instances')
+        got.append(inst)
+    # An exhausted iterator stays exhausted
+    _check(list(it) == [], what + ' is exhausted')
+    return got
+
+def _run_checks(ch, ns):
+    global _kept
+
+    it = ch.EnumerateInstances('Py_IteratorSource', ns, Iterator=True)
+    got = _check_iterator(it, 'EnumerateInstances')
+    _check([inst['Name'] for inst in got] == _source_names,
+        'EnumerateInstances results: %s' % got)
+    yield 'instances'
+
+    # A queue of one makes the enumeration wait for the provider after
+    # every result
+    it = ch.EnumerateInstances('Py_IteratorSource', ns, Iterator=True,
+        IteratorQueueSize=1)
+    got = _check_iterator(it, 'IteratorQueueSize=1')
+    _check([inst['Name'] for inst in got] == _source_names,
+        'IteratorQueueSize=1 results: %s' % got)
+    yield 'queuesize'
+
+    it = ch.Associators(_source_path(ns, _source_names[0]),
+        AssocClass='Py_IteratorLink', Iterator=True)
+    got = _check_iterator(it, 'Associators')
+    _check(sorted([inst['Name'] for inst in got]) == _source_names[1:],
+        'Associators results: %s' % got)
+    yield 'associators'
+
+    it = ch.References(_source_path(ns, _source_names[0]),
+        ResultClass='Py_IteratorLink', Iterator=True)
+    got = _check_iterator(it, 'References')
+    _check(sorted([inst['Dependent']['Name'] for inst in got])
+            == _source_names[1:], 'References results: %s' % got)
+    yield 'references'
+
+    # A failed enumeration raises its error after the results received
+    # before it
+    it = ch.EnumerateInstances('Py_IteratorFailSource', ns, Iterator=True)
+    got = []
+    def drain():
+        for inst in it:
+            got.append(inst['Name'])
+    _check_error(drain, pywbem.CIM_ERR_ACCESS_DENIED,
+        'A failed enumeration')
+    _check(got == _fail_names[:len(got)],
+        'Results before the failure: %s' % got)
+    _check_error(drain, pywbem.CIM_ERR_ACCESS_DENIED,
+        'A failed enumeration advanced again')
+    yield 'failure'
+
+    # Dropping an iterator early aborts its enumeration, and the next one
+    # runs as usual
+    it = ch.EnumerateInstances('Py_IteratorSource', ns, Iterator=True,
+        IteratorQueueSize=1)
+    _check(it.next()['Name'] == _source_names[0], 'First result')
+    del it
+    got = ch.EnumerateInstances('Py_IteratorSource', ns)
+    _check([inst['Name'] for inst in got] == _source_names,
+        'Enumeration after a dropped iterator: %s' % got)
+    yield 'dropped'
+
+    # Errors
+    _check_error(lambda: ch.EnumerateInstances('Py_IteratorSource', ns,
+            Iterator=True, Handler=lambda inst: None),
+        pywbem.CIM_ERR_INVALID_PARAMETER, 'Iterator with a Handler')
+    _check_error(lambda: ch.EnumerateInstances('Py_IteratorSource', ns,
+            Iterator=True, IteratorQueueSize=0),
+        pywbem.CIM_ERR_INVALID_PARAMETER, 'IteratorQueueSize=0')
+    errors = []
+    def other_thread():
+        try:
+            ch.EnumerateInstances('Py_IteratorSource', ns, Iterator=True)
+            errors.append(None)
+        except pywbem.CIMError, arg:
+            errors.append(arg[0])
+    thread = threading.Thread(target=other_thread)
+    thread.start()
+    thread.join()
+    _check(errors == [pywbem.CIM_ERR_NOT_SUPPORTED],
+        'Iterator on another thread raises NOT_SUPPORTED: %s' % errors)
+    yield 'errors'
+
+    # Kept for Py_IteratorExpiryTest with results left to take
+    _kept = ch.EnumerateInstances('Py_IteratorSource', ns, Iterator=True,
+        IteratorQueueSize=1)
+    _check(_kept.next()['Name'] == _source_names[0], 'Kept first result')
+    yield 'kept'
+
+def _run_expiry_checks():
+    global _kept
+
+    _check(_kept is not None, 'Py_IteratorTest was enumerated first')
+    arg = _check_error(_kept.next, pywbem.CIM_ERR_FAILED,
+        'The kept iterator')
+    _check('has ended' in arg[1], 'The kept iterator message: %s' % arg)
+    _check_error(_kept.next, pywbem.CIM_ERR_FAILED,
+        'The kept iterator advanced again')
+    _kept = None
+    yield 'expired'
+
+class Py_IteratorTestProvider(CIMProvider):
+    """Instrument the CIM classes Py_IteratorTest and Py_IteratorExpiryTest,
+    and the classes their checks enumerate"""
+
+    #########################################################################
+    def __init__ (self):
+        pass
+
+    #########################################################################
+    def MI_enumInstances(self, env, ns, propertyList, requestedCimClass,
+            cimClass):
+        cn = cimClass.classname.lower()
+        if cn == 'py_iteratorsource':
+            for name in _source_names:
+                yield _instance(ns, 'Py_IteratorSource', name)
+        elif cn == 'py_iteratorfailsource':
+            for name in _fail_names:
+                yield _instance(ns, 'Py_IteratorFailSource', name)
+            raise pywbem.CIMError(pywbem.CIM_ERR_ACCESS_DENIED,
+                'Py_IteratorFailSource failed')
+        elif cn == 'py_iteratorlink':
+            for name in _source_names[1:]:
+                yield _link(ns, name)
+        elif cn == 'py_iteratortest':
+            for name in _run_checks(env.get_cimom_handle(), ns):
+                yield _instance(ns, 'Py_IteratorTest', name)
+        else:
+            for name in _run_expiry_checks():
+                yield _instance(ns, 'Py_IteratorExpiryTest', name)
+
+    #########################################################################
+    def MI_associators(self, env, objectName, assocClassName,
+            resultClassName, role, resultRole, propertyList):
+        if objectName['Name'] != _source_names[0]:
+            return
+        for name in _source_names[1:]:
+            yield _instance(objectName.namespace, 'Py_IteratorSource', name)
+
+    #########################################################################
+    def MI_references(self, env, objectName, resultClassName, role,
+            propertyList):
+        if objectName['Name'] != _source_names[0]:
+            return
+        for name in _source_names[1:]:
+            yield _link(objectName.namespace, name)
+
+## end of class Py_IteratorTestProvider
+
+def get_providers(env):
+    _py_iteratortest_prov = Py_IteratorTestProvider()
+    return {'Py_IteratorTest': _py_iteratortest_prov,
+            'Py_IteratorExpiryTest': _py_iteratortest_prov,
+            'Py_IteratorSource': _py_iteratortest_prov,
+            'Py_IteratorFailSource': _py_iteratortest_prov,
+            'Py_IteratorLink': _py_iteratortest_prov}
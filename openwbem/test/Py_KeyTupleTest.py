@@ -0,0 +1,56 @@
+"""Python Provider for Py_KeyTupleTest
+
+Instruments Py_KeyTupleTest and the Py_KeyTuple*Test error classes. Their
+instance names are returned as plain tuples of key values, in the order
+of the key properties of the class. The tuples of Py_KeyTupleTest are
+valid and mixed with a CIMInstanceName. The tuples of the other classes
+are invalid in one way each, and enumerating their names must fail.
+"""
+
+import pywbem
+from pycim import CIMProvider
+
+def _names_test(ns):
+    # Plain python values are converted with the types of the keys
+    yield ('a', 1)
+    yield pywbem.CIMInstanceName('Py_KeyTupleTest', namespace=ns,
+        keybindings={'Name': 'name', 'Id': pywbem.Uint16(2)})
+    yield (u'b', pywbem.Uint16(3))
+
+def _length_test(ns):
+    yield ('a', 1)
+    yield ('b',)
+
+def _none_test(ns):
+    yield ('a', None)
+
+def _value_test(ns):
+    yield ('a', 70000)
+
+_names = {
+    'py_keytupletest': _names_test,
+    'py_keytuplelengthtest': _length_test,
+    'py_keytuplenonetest': _none_test,
+    'py_keytuplevaluetest': _value_test,
+}
+
+class Py_KeyTupleTestProvider(CIMProvider):
+    """Instrument the CIM class Py_KeyTupleTest and the Py_KeyTuple*Test
+    error classes"""
+
+    #########################################################################
+    def __init__ (self):
+        pass
+
+    #########################################################################
+    def MI_enumInstanceNames(self, env, ns, cimClass):
+        return _names[cimClass.classname.lower()](ns)
+
+## end of class Py_KeyTupleTestProvider
+
+def get_providers(env):
+    _py_keytupletest_prov = Py_KeyTupleTestProvider()
+    return {'Py_KeyTupleTest': _py_keytupletest_prov,
+            'Py_KeyTupleLengthTest': _py_keytupletest_prov,
+            'Py_KeyTupleNoneTest': _py_keytupletest_prov,
+            'Py_KeyTupleValueTest': _py_keytupletest_prov}
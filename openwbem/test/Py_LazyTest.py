@@ -0,0 +1,122 @@
+"""Python Provider for Py_LazyTest
+
+Instruments the CIM class Py_LazyTest. The provider is registered with
+LazyInstances=true and checks that the instances it is given behave like
+pywbem.CIMInstance, including the errors they raise. A failed check is
+raised as CIM_ERR_FAILED with a description of the check.
+"""
+
+import pywbem
+from pycim import CIMProvider
+
+_insts = {}
+
+def _check(cond, what):
+    if not cond:
+        raise pywbem.CIMError(pywbem.CIM_ERR_FAILED, 'Check failed: ' + what)
+
+def _check_lazy(inst, what):
+    _check(not isinstance(inst, pywbem.CIMInstance),
+        what + ' is a lazy instance')
+    _check(inst.classname.lower() == 'py_lazytest', what + ' classname')
+    names = sorted([name.lower() for name in inst.keys()])
+    _check(names == ['name', 'note', 'value'], what + ' keys(): %s' % names)
+    _check(sorted([name.lower() for name in inst]) == names,
+        what + ' iteration')
+    _check(len(inst) == 3, what + ' len()')
+    _check(inst.has_key('Value') and not inst.has_key('Nope'),
+        what + ' has_key()')
+
+    # Errors are the ones pywbem.CIMInstance raises
+    try:
+        inst['Nope']
+        _check(False, what + ' reading a missing property raises KeyError')
+    except KeyError:
+        pass
+    try:
+        inst['Value'] = 5
+        _check(False, what + ' assigning a plain int raises TypeError')
+    except TypeError:
+        pass
+    _check(inst.get('Nope') is None, what + ' get() of a missing property')
+    _check(inst.get('Nope', 'x') == 'x', what + ' get() default')
+
+    # The properties view is the same object while it is held, and reads
+    # through it see the values read through the instance
+    props = inst.properties
+    _check(props is inst.properties, what + ' properties view is kept')
+    _check(props['Value'].value == inst['Value'],
+        what + ' properties view value')
+
+def _update(inst):
+    # A value changed through a handed out property and one assigned
+    # through the instance are both kept
+    prop = inst.properties['Value']
+    prop.value = pywbem.Uint32(prop.value + 1)
+    inst['Note'] = 'changed'
+
+class Py_LazyTestProvider(CIMProvider):
+    """Instrument the CIM class Py_LazyTest"""
+
+    #########################################################################
+    def __init__ (self):
+        pass
+
+    #########################################################################
+    def MI_enumInstances(self, env, ns, propertyList, requestedCimClass,
+            cimClass):
+        # Lazy instances kept from createInstance and modifyInstance are
+        # returned as they are
+        for name in sorted(_insts.keys()):
+            yield _insts[name]
+
+    #########################################################################
+    def MI_enumInstanceNames(self, env, ns, cimClass):
+        for name in sorted(_insts.keys()):
+            yield pywbem.CIMInstanceName('Py_LazyTest', namespace=ns,
+                keybindings={'Name': name})
+
+    #########################################################################
+    def MI_getInstance(self, env, instanceName, propertyList, cimClass):
+        name = instanceName['Name']
+        if name not in _insts:
+            raise pywbem.CIMError(pywbem.CIM_ERR_NOT_FOUND, name)
+        return _insts[name]
+
+    #########################################################################
+    def MI_createInstance(self, env, instance):
+        _check_lazy(instance, 'createInstance instance')
+        name = instance['Name']
+        if name in _insts:
+            raise pywbem.CIMError(pywbem.CIM_ERR_ALREADY_EXISTS, name)
+        if name.startswith('full'):
+            # Converts the whole instance. Values read before are kept.
+            instance.qualifiers
+        _update(instance)
+        _insts[name] = instance
+        return pywbem.CIMInstanceName('Py_LazyTest',
+            keybindings={'Name': name})
+
+    #########################################################################
+    def MI_modifyInstance(self, env, modifiedInstance, previousInstance,
+            propertyList, cimClass):
+        _check_lazy(modifiedInstance, 'modifyInstance instance')
+        _check_lazy(previousInstance, 'modifyInstance previous instance')
+        name = modifiedInstance['Name']
+        if name not in _insts:
+            raise pywbem.CIMError(pywbem.CIM_ERR_NOT_FOUND, name)
+        _update(modifiedInstance)
+        _insts[name] = modifiedInstance
+
+    #########################################################################
+    def MI_deleteInstance(self, env, instanceName):
+        name = instanceName['Name']
+        if name not in _insts:
+            raise pywbem.CIMError(pywbem.CIM_ERR_NOT_FOUND, name)
+        del _insts[name]
+
+## end of class Py_LazyTestProvider
+
+def get_providers(env):
+    _py_lazytest_prov = Py_LazyTestProvider()
+    return {'Py_LazyTest': _py_lazytest_prov}
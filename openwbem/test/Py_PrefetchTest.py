@@ -0,0 +1,82 @@
+"""Python Provider for Py_PrefetchTest
+
+Instruments Py_PrefetchTest and the Py_Prefetch*ErrorTest classes. With
+pyprovifc.prefetch_depth set above 0 their enumerations run on a producer
+thread. Py_PrefetchTest returns more results than the prefetch queue and
+a result batch hold, as single instances and columnar batches. The error
+classes return the same results and then fail, each in its own way.
+"""
+
+import pywbem
+from pycim import CIMProvider
+
+# More than the default result batch size of 100 and any sensible
+# prefetch depth, so the failures happen after results were handed over
+_count = 1000
+
+def _results(ns, classname):
+    # Alternates between runs of single instances and batches
+    i = 0
+    while i < _count:
+        if (i / 50) % 2:
+            names = ['p%04d' % n for n in range(i, i + 50)]
+            yield (classname, ['Name', 'Value'], [names, range(i, i + 50)])
+            i += 50
+            continue
+        inst = pywbem.CIMInstance(classname)
+        inst['Name'] = 'p%04d' % i
+        inst['Value'] = pywbem.Uint32(i)
+        inst.path = pywbem.CIMInstanceName(classname, namespace=ns,
+            keybindings={'Name': inst['Name']})
+        yield inst
+        i += 1
+
+def _prefetch_test(ns):
+    for result in _results(ns, 'Py_PrefetchTest'):
+        yield result
+
+def _cim_error_test(ns):
+    for result in _results(ns, 'Py_PrefetchCIMErrorTest'):
+        yield result
+    raise pywbem.CIMError(pywbem.CIM_ERR_ACCESS_DENIED,
+        'Py_PrefetchCIMErrorTest failed')
+
+def _python_error_test(ns):
+    for result in _results(ns, 'Py_PrefetchPythonErrorTest'):
+        yield result
+    raise ValueError('Py_PrefetchPythonErrorTest failed')
+
+def _conversion_error_test(ns):
+    for result in _results(ns, 'Py_PrefetchConversionErrorTest'):
+        yield result
+    yield ('Py_PrefetchConversionErrorTest', ['Name', 'Value'],
+        [['bad'], [-1]])
+
+_tests = {
+    'py_prefetchtest': _prefetch_test,
+    'py_prefetchcimerrortest': _cim_error_test,
+    'py_prefetchpythonerrortest': _python_error_test,
+    'py_prefetchconversionerrortest': _conversion_error_test,
+}
+
+class Py_PrefetchTestProvider(CIMProvider):
+    """Instrument the CIM class Py_PrefetchTest and the
+    Py_Prefetch*ErrorTest classes"""
+
+    #########################################################################
+    def __init__ (self):
+        pass
+
+    #########################################################################
+    def MI_enumInstances(self, env, ns, propertyList, requestedCimClass,
+            cimClass):
+        return _tests[cimClass.classname.lower()](ns)
+
+## end of class Py_PrefetchTestProvider
+
+def get_providers(env):
+    _py_prefetchtest_prov = Py_PrefetchTestProvider()
+    return {'Py_PrefetchTest': _py_prefetchtest_prov,
+            'Py_PrefetchCIMErrorTest': _py_prefetchtest_prov,
+            'Py_PrefetchPythonErrorTest': _py_prefetchtest_prov,
+            'Py_PrefetchConversionErrorTest': _py_prefetchtest_prov}
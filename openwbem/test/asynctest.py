@@ -0,0 +1,45 @@
+#!/usr/bin/python
+#
+# Tests the provider methods of Py_AsyncTest.py. The CIMOM must run the
+# python provider interface with pyprovifc.async_module = trollius and
+# have Py_AsyncTest.mof and Py_AsyncTest.reg imported.
+
+import pywbem
+
+conn = pywbem.WBEMConnection('https://localhost:30927', ('test1', 'pass1'))
+failed = False
+
+# A generator of results is iterated, not awaited as a coroutine
+insts = conn.EnumerateInstances('Py_AsyncTest')
+names = sorted([inst['Name'] for inst in insts])
+if names != ['one', 'three', 'two']:
+    print 'Failed! EnumerateInstances:', names
+    failed = True
+
+# A marked coroutine is awaited and its result enumerated
+paths = conn.EnumerateInstanceNames('Py_AsyncTest')
+names = sorted([path['Name'] for path in paths])
+if names != ['one', 'three', 'two']:
+    print 'Failed! EnumerateInstanceNames:', names
+    failed = True
+
+iname = pywbem.CIMInstanceName('Py_AsyncTest', namespace='root/cimv2',
+                               keybindings={'Name': 'two'})
+inst = conn.GetInstance(iname)
+if inst['Value'] != 2:
+    print 'Failed! GetInstance:', inst
+    failed = True
+
+# An error raised by an awaited coroutine reaches the client
+iname['Name'] = 'four'
+try:
+    conn.GetInstance(iname)
+    print 'Failed! GetInstance of a missing instance succeeded'
+    failed = True
+except pywbem.CIMError, arg:
+    if arg[0] != pywbem.CIM_ERR_NOT_FOUND:
+        print 'Failed! GetInstance of a missing instance:', arg
+        failed = True
+
+if not failed:
+    print 'Passed'
@@ -0,0 +1,50 @@
+#!/usr/bin/python
+#
+# Tests the columnar instance batches returned by Py_BatchTest.py. The CIMOM
+# must have Py_BatchTest.mof and Py_BatchTest.reg imported.
+
+import pywbem
+
+conn = pywbem.WBEMConnection('https://localhost:30927', ('test1', 'pass1'))
+failed = False
+
+def fail(*args):
+    global failed
+    print 'Failed!', ' '.join([str(arg) for arg in args])
+    failed = True
+
+# Batches mixed with single instances, in the order they are returned
+expected = [('a', 1, 'first'), ('b', 2, None), ('single', 3, 'single'),
+            ('tuple', 4, None)]
+try:
+    insts = conn.EnumerateInstances('Py_BatchTest')
+    got = [(inst['Name'], inst['Value'], inst.get('Note')) for inst in insts]
+    if sorted(got) != expected:
+        fail('EnumerateInstances', got)
+    for inst in insts:
+        # Values have the types of the class, and the key is set from the
+        # Name column
+        if not isinstance(inst['Value'], pywbem.Uint32):
+            fail('Value type of', inst['Name'], type(inst['Value']))
+        if inst.path is None or inst.path.keybindings.keys() != ['Name'] \
+                or inst.path['Name'] != inst['Name']:
+            fail('Key of', inst['Name'], inst.path)
+except pywbem.CIMError, arg:
+    fail('EnumerateInstances', arg)
+
+# Invalid batches fail the enumeration with a message saying why
+for cn, msg in [
+        ('Py_BatchLengthTest', 'column Value has 1 values. Expected 2'),
+        ('Py_BatchCountTest', 'has 2 property names but 1 columns'),
+        ('Py_BatchPropertyTest', 'Nope is not defined in class'),
+        ('Py_BatchColumnTest', 'columns must be sequences'),
+        ('Py_BatchValueTest', 'Negative value -1')]:
+    try:
+        conn.EnumerateInstances(cn)
+        fail('EnumerateInstances of', cn, 'succeeded')
+    except pywbem.CIMError, arg:
+        if arg[0] != pywbem.CIM_ERR_FAILED or msg not in arg[1]:
+            fail('EnumerateInstances of', cn, arg)
+
+if not failed:
+    print 'Passed'
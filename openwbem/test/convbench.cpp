@@ -0,0 +1,239 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+
+// Times conversion of numeric array values between OpenWBEM and pywbem.
+//
+// Usage: convbench [iterations]
+//
+// For uint8, uint32, uint64 and real64 arrays of 1000 and 100000 elements
+// this reports the average time of OWPyConv::OWVal2Py and of the reverse
+// conversion through OWPyConv::PyVal2OW. The old* rows time the per
+// element conversion the converter used before, as the baseline: a
+// PyObject_CallFunction with a format string per element one way, and a
+// Py::Int/Py::LongLong/Py::Float wrapper per element the other way.
+
+#include "OW_PyConverter.hpp"
+#include <openwbem/OW_CIMValue.hpp>
+#include <openwbem/OW_Array.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+extern "C"
+{
+#include <sys/time.h>
+}
+
+using namespace std;
+using namespace OpenWBEM;
+using namespace PythonProvIFC;
+
+namespace
+{
+
+Py::Object g_pywbem;
+
+//////////////////////////////////////////////////////////////////////////////
+double
+nowUsecs()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return double(tv.tv_sec) * 1000000.0 + double(tv.tv_usec);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+CIMValue
+makeArrayValue(size_t count)
+{
+	Array<T> ra(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		ra[i] = T(i % 250);
+	}
+	return CIMValue(ra);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// The old OWVal2Py path for numeric arrays
+template <typename T>
+Py::Object
+oldOW2Py(
+	const char* format,
+	const char* func,
+	const CIMValue& owval)
+{
+	Py::Callable pyfunc = g_pywbem.getAttr(func);
+	Array<T> val;
+	owval.get(val);
+	Py::List vlist;
+	for (size_t i = 0; i < val.size(); ++i)
+	{
+		PyObject* pVal = PyObject_CallFunction(pyfunc.ptr(),
+			const_cast<char*>(format), val[i]);
+		if (!pVal)
+		{
+			throw Py::Exception();
+		}
+		vlist.append(Py::Object(pVal, true));
+	}
+	return vlist;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Element conversions of the old PyVal2OW path
+UInt8 oldToUInt8(const Py::Object& ob)
+{
+	return UInt8(Py::Int(ob).asUnsignedLong());
+}
+
+UInt32 oldToUInt32(const Py::Object& ob)
+{
+	return UInt32(Py::Int(ob).asUnsignedLong());
+}
+
+UInt64 oldToUInt64(const Py::Object& ob)
+{
+	return UInt64(Py::LongLong(ob).asUnsignedLongLong());
+}
+
+Real64 oldToReal64(const Py::Object& ob)
+{
+	return Real64(Py::Float(ob).as_double());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// The old PyVal2OW path for numeric arrays
+template <typename T, T (*conv)(const Py::Object&)>
+CIMValue
+oldPy2OW(const Py::Object& pyval)
+{
+	Py::List il(pyval);
+	size_t sz = il.length();
+	Array<T> nra(sz);
+	for (size_t i = 0; i < sz; i++)
+	{
+		nra[i] = conv(il[i]);
+	}
+	return CIMValue(nra);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+report(const char* what, const char* type, size_t count, int iterations,
+	double usecs)
+{
+	double per = usecs / iterations;
+	cout << setw(10) << what << setw(8) << type << setw(8) << count
+		<< setw(14) << fixed << setprecision(1) << per << " us/array"
+		<< setw(10) << setprecision(3) << per / count << " us/elem" << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <typename T, T (*conv)(const Py::Object&)>
+void
+runBench(const char* type, const char* format, const char* func,
+	const CIMValue& cv, size_t count, int iterations)
+{
+	double start = nowUsecs();
+	Py::Object oldval;
+	for (int i = 0; i < iterations; i++)
+	{
+		oldval = oldOW2Py<T>(format, func, cv);
+	}
+	report("oldow2py", type, count, iterations, nowUsecs() - start);
+
+	start = nowUsecs();
+	for (int i = 0; i < iterations; i++)
+	{
+		CIMValue rcv = oldPy2OW<T, conv>(oldval);
+	}
+	report("oldpy2ow", type, count, iterations, nowUsecs() - start);
+
+	start = nowUsecs();
+	Py::Object pyval;
+	for (int i = 0; i < iterations; i++)
+	{
+		pyval = OWPyConv::OWVal2Py(cv);
+	}
+	report("ow2py", type, count, iterations, nowUsecs() - start);
+
+	start = nowUsecs();
+	for (int i = 0; i < iterations; i++)
+	{
+		CIMValue rcv = OWPyConv::PyVal2OW(cv.getType(), pyval);
+	}
+	report("py2ow", type, count, iterations, nowUsecs() - start);
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+int
+main(int argc, char* argv[])
+{
+	int iterations = 20;
+	if (argc > 1)
+	{
+		iterations = atoi(argv[1]);
+		if (iterations <= 0)
+		{
+			cerr << "Usage: " << argv[0] << " [iterations]" << endl;
+			return 1;
+		}
+	}
+
+	Py_Initialize();
+	int rc = 0;
+	try
+	{
+		Py::Module pywbem("pywbem", true);
+		OWPyConv::setPyWbemMod(pywbem);
+		g_pywbem = pywbem;
+
+		static const size_t counts[] = { 1000, 100000 };
+		for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+		{
+			size_t count = counts[i];
+			runBench<UInt8, oldToUInt8>("uint8", "(k)", "Uint8",
+				makeArrayValue<UInt8>(count), count, iterations);
+			runBench<UInt32, oldToUInt32>("uint32", "(k)", "Uint32",
+				makeArrayValue<UInt32>(count), count, iterations);
+			runBench<UInt64, oldToUInt64>("uint64", "(K)", "Uint64",
+				makeArrayValue<UInt64>(count), count, iterations);
+			runBench<Real64, oldToReal64>("real64", "(d)", "Real64",
+				makeArrayValue<Real64>(count), count, iterations);
+		}
+	}
+	catch (Py::Exception& e)
+	{
+		PyErr_Print();
+		e.clear();
+		rc = 1;
+	}
+	catch (Exception& e)
+	{
+		cerr << "Caught exception: " << e << endl;
+		rc = 1;
+	}
+	g_pywbem = Py::Object();
+	Py_Finalize();
+	return rc;
+}
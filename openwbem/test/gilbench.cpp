@@ -0,0 +1,200 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+
+// Times entering and leaving python from threads python didn't create.
+//
+// Usage: gilbench [iterations]
+//
+// "fresh" creates and deletes a thread state for every entry, the way
+// PyGILState_Ensure does on such threads and GILGuard did before it cached
+// thread states. "cached" uses GILGuard. Both are run for the main
+// interpreter and a subinterpreter with 1 and 4 threads, each entering
+// python 'iterations' times (default 100000).
+
+#include "PyCxxObjects.hpp"
+#include <openwbem/OW_Thread.hpp>
+#include <openwbem/OW_Array.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+extern "C"
+{
+#include <sys/time.h>
+}
+
+using namespace std;
+using namespace OpenWBEM;
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////////
+double
+nowUsecs()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return double(tv.tv_sec) * 1000000.0 + double(tv.tv_usec);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+class EntryThread : public Thread
+{
+public:
+	EntryThread(PyInterpreterState* interp, bool cached, int iterations)
+		: Thread()
+		, m_interp(interp)
+		, m_cached(cached)
+		, m_iterations(iterations)
+	{
+	}
+
+protected:
+	virtual Int32 run()
+	{
+		if (m_cached)
+		{
+			Py::InterpreterScope is(m_interp);
+			for (int i = 0; i < m_iterations; i++)
+			{
+				Py::GILGuard gg;
+			}
+		}
+		else if (!m_interp)
+		{
+			for (int i = 0; i < m_iterations; i++)
+			{
+				PyGILState_STATE gstate = PyGILState_Ensure();
+				PyGILState_Release(gstate);
+			}
+		}
+		else
+		{
+			for (int i = 0; i < m_iterations; i++)
+			{
+				PyThreadState* tstate = PyThreadState_New(m_interp);
+				PyEval_RestoreThread(tstate);
+				PyThreadState_Clear(tstate);
+				PyThreadState_DeleteCurrent();
+			}
+		}
+		return 0;
+	}
+
+private:
+	PyInterpreterState* m_interp;
+	bool m_cached;
+	int m_iterations;
+};
+typedef IntrusiveReference<EntryThread> EntryThreadRef;
+
+//////////////////////////////////////////////////////////////////////////////
+void
+runThreads(
+	const char* interpName,
+	PyInterpreterState* interp,
+	bool cached,
+	int threadCount,
+	int iterations)
+{
+	Array<EntryThreadRef> threads;
+	for (int i = 0; i < threadCount; i++)
+	{
+		threads.append(EntryThreadRef(
+			new EntryThread(interp, cached, iterations)));
+	}
+
+	double start = nowUsecs();
+	for (int i = 0; i < threadCount; i++)
+	{
+		threads[i]->start();
+	}
+	for (int i = 0; i < threadCount; i++)
+	{
+		threads[i]->join();
+	}
+	double usecs = nowUsecs() - start;
+
+	cout << setw(6) << interpName << setw(8) << (cached ? "cached" : "fresh")
+		<< setw(8) << threadCount
+		<< setw(12) << fixed << setprecision(3)
+		<< usecs / (double(threadCount) * iterations) << " us/entry" << endl;
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+int
+main(int argc, char* argv[])
+{
+	int iterations = 100000;
+	if (argc > 1)
+	{
+		iterations = atoi(argv[1]);
+	}
+	if (iterations <= 0)
+	{
+		cerr << "Usage: " << argv[0] << " [iterations]" << endl;
+		return 1;
+	}
+
+	Py_Initialize();
+	PyEval_InitThreads();
+	PyThreadState* mainTState = PyThreadState_Get();
+	PyThreadState* subTState = Py_NewInterpreter();
+	PyThreadState_Swap(mainTState);
+	if (!subTState)
+	{
+		cerr << "Can't create a subinterpreter" << endl;
+		Py_Finalize();
+		return 1;
+	}
+	PyEval_ReleaseLock();
+
+	static const int threadCounts[] = { 1, 4 };
+	const int runs = sizeof(threadCounts) / sizeof(threadCounts[0]);
+	try
+	{
+		for (int i = 0; i < runs; i++)
+		{
+			runThreads("main", 0, false, threadCounts[i], iterations);
+			runThreads("main", 0, true, threadCounts[i], iterations);
+		}
+		for (int i = 0; i < runs; i++)
+		{
+			runThreads("sub", subTState->interp, false, threadCounts[i],
+				iterations);
+			runThreads("sub", subTState->interp, true, threadCounts[i],
+				iterations);
+		}
+	}
+	catch (Exception& e)
+	{
+		cerr << "Caught exception: " << e << endl;
+	}
+
+	Py::ThreadStateCache::shutdown();
+	PyEval_AcquireLock();
+	PyThreadState_Swap(subTState);
+	Py_EndInterpreter(subTState);
+	PyThreadState_Swap(mainTState);
+	Py_Finalize();
+	return 0;
+}
@@ -0,0 +1,28 @@
+#!/usr/bin/python
+#
+# Runs the Handler batching checks of Py_HandlerTest.py. The CIMOM must have
+# Py_HandlerTest.mof and Py_HandlerTest.reg imported.
+
+import pywbem
+
+conn = pywbem.WBEMConnection('https://localhost:30927', ('test1', 'pass1'))
+failed = False
+
+def fail(*args):
+    global failed
+    print 'Failed!', ' '.join([str(arg) for arg in args])
+    failed = True
+
+# Every check returns an instance once it passed. A failed check fails the
+# enumeration.
+try:
+    names = [inst['Name'] for inst in conn.EnumerateInstances('Py_HandlerTest')]
+    expected = ['instances', 'names', 'remainder', 'time', 'unbatched',
+                'nohandler', 'errors']
+    if sorted(names) != sorted(expected):
+        fail('Checks passed:', names)
+except pywbem.CIMError, arg:
+    fail(arg)
+
+if not failed:
+    print 'Passed'
@@ -0,0 +1,32 @@
+#!/usr/bin/python
+#
+# Runs the Iterator=True checks of Py_IteratorTest.py. The CIMOM must have
+# Py_IteratorTest.mof and Py_IteratorTest.reg imported.
+
+import pywbem
+
+conn = pywbem.WBEMConnection('https://localhost:30927', ('test1', 'pass1'))
+failed = False
+
+def fail(*args):
+    global failed
+    print 'Failed!', ' '.join([str(arg) for arg in args])
+    failed = True
+
+# Every check returns an instance once it passed. A failed check fails the
+# enumeration. Py_IteratorExpiryTest checks the iterator kept from the
+# Py_IteratorTest call, so it has to come second.
+for cn, expected in [
+        ('Py_IteratorTest', ['instances', 'queuesize', 'associators',
+                             'references', 'failure', 'dropped', 'errors',
+                             'kept']),
+        ('Py_IteratorExpiryTest', ['expired'])]:
+    try:
+        names = [inst['Name'] for inst in conn.EnumerateInstances(cn)]
+        if sorted(names) != sorted(expected):
+            fail(cn, 'checks passed:', names)
+    except pywbem.CIMError, arg:
+        fail(cn, arg)
+
+if not failed:
+    print 'Passed'
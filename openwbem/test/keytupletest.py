@@ -0,0 +1,43 @@
+#!/usr/bin/python
+#
+# Tests the key tuples returned by Py_KeyTupleTest.py. The CIMOM must have
+# Py_KeyTupleTest.mof and Py_KeyTupleTest.reg imported.
+
+import pywbem
+
+conn = pywbem.WBEMConnection('https://localhost:30927', ('test1', 'pass1'))
+failed = False
+
+def fail(*args):
+    global failed
+    print 'Failed!', ' '.join([str(arg) for arg in args])
+    failed = True
+
+# Key tuples mixed with an instance name. Every tuple value is set on the
+# key in the same position.
+try:
+    paths = conn.EnumerateInstanceNames('Py_KeyTupleTest')
+    got = sorted([(path['Name'], path['Id']) for path in paths])
+    if got != [('a', 1), ('b', 3), ('name', 2)]:
+        fail('EnumerateInstanceNames', got)
+    for path in paths:
+        if path.classname.lower() != 'py_keytupletest' \
+                or len(path.keybindings) != 2:
+            fail('Instance name', path)
+except pywbem.CIMError, arg:
+    fail('EnumerateInstanceNames', arg)
+
+# Invalid tuples fail the enumeration with a message saying why
+for cn, msg in [
+        ('Py_KeyTupleLengthTest', 'has 1 values. Expected 2'),
+        ('Py_KeyTupleNoneTest', 'has no value for key Id'),
+        ('Py_KeyTupleValueTest', 'Value 70000 is out of range')]:
+    try:
+        conn.EnumerateInstanceNames(cn)
+        fail('EnumerateInstanceNames of', cn, 'succeeded')
+    except pywbem.CIMError, arg:
+        if arg[0] != pywbem.CIM_ERR_FAILED or msg not in arg[1]:
+            fail('EnumerateInstanceNames of', cn, arg)
+
+if not failed:
+    print 'Passed'
@@ -0,0 +1,69 @@
+#!/usr/bin/python
+#
+# Tests the lazy instances given to Py_LazyTest.py. The CIMOM must have
+# Py_LazyTest.mof and Py_LazyTest.reg imported.
+
+import pywbem
+
+conn = pywbem.WBEMConnection('https://localhost:30927', ('test1', 'pass1'))
+failed = False
+
+def fail(*args):
+    global failed
+    print 'Failed!', ' '.join([str(arg) for arg in args])
+    failed = True
+
+def new_inst(name, value):
+    inst = pywbem.CIMInstance('Py_LazyTest')
+    inst['Name'] = name
+    inst['Value'] = pywbem.Uint32(value)
+    inst['Note'] = 'new'
+    return inst
+
+def inst_name(name):
+    return pywbem.CIMInstanceName('Py_LazyTest', namespace='root/cimv2',
+                                  keybindings={'Name': name})
+
+# 'lazy' stays lazy, 'full' is converted by the provider. Both keep the
+# values the provider changed.
+for name in ['lazy', 'full']:
+    try:
+        conn.CreateInstance(new_inst(name, 1))
+    except pywbem.CIMError, arg:
+        fail('CreateInstance', name, arg)
+        continue
+    inst = conn.GetInstance(inst_name(name))
+    if inst['Value'] != 2 or inst['Note'] != 'changed':
+        fail('GetInstance', name, inst.items())
+
+names = sorted([inst['Name'] for inst in conn.EnumerateInstances('Py_LazyTest')])
+if names != ['full', 'lazy']:
+    fail('EnumerateInstances', names)
+
+# The previous instance is lazy too
+inst = new_inst('lazy', 10)
+inst.path = inst_name('lazy')
+try:
+    conn.ModifyInstance(inst)
+    inst = conn.GetInstance(inst_name('lazy'))
+    if inst['Value'] != 11 or inst['Note'] != 'changed':
+        fail('ModifyInstance', inst.items())
+except pywbem.CIMError, arg:
+    fail('ModifyInstance', arg)
+
+# Errors raised by the provider reach the client
+try:
+    conn.CreateInstance(new_inst('lazy', 1))
+    fail('CreateInstance of an existing instance succeeded')
+except pywbem.CIMError, arg:
+    if arg[0] != pywbem.CIM_ERR_ALREADY_EXISTS:
+        fail('CreateInstance of an existing instance:', arg)
+
+for name in ['lazy', 'full']:
+    try:
+        conn.DeleteInstance(inst_name(name))
+    except pywbem.CIMError, arg:
+        fail('DeleteInstance', name, arg)
+
+if not failed:
+    print 'Passed'
@@ -0,0 +1,57 @@
+#!/usr/bin/python
+#
+# Tests the enumerations of Py_PrefetchTest.py. The CIMOM must have
+# Py_PrefetchTest.mof and Py_PrefetchTest.reg imported, and must run with
+# pyprovifc.prefetch_depth set above 0, e.g. 10, for the enumerations to
+# run on a producer thread. Without it the same results are expected.
+
+import pywbem
+
+conn = pywbem.WBEMConnection('https://localhost:30927', ('test1', 'pass1'))
+failed = False
+
+def fail(*args):
+    global failed
+    print 'Failed!', ' '.join([str(arg) for arg in args])
+    failed = True
+
+# Every result arrives once and in order, whether it was returned alone or
+# in a batch
+try:
+    insts = conn.EnumerateInstances('Py_PrefetchTest')
+    got = [(inst['Name'], inst['Value']) for inst in insts]
+    expected = [('p%04d' % i, i) for i in range(1000)]
+    if got != expected:
+        fail('EnumerateInstances', len(got), 'results', got[:5])
+    for inst in insts:
+        if inst.path is None or inst.path['Name'] != inst['Name']:
+            fail('Key of', inst['Name'], inst.path)
+            break
+except pywbem.CIMError, arg:
+    fail('EnumerateInstances', arg)
+
+# Errors raised on the producer thread reach the client as if the request
+# thread had raised them
+for cn, code, msg in [
+        ('Py_PrefetchCIMErrorTest', pywbem.CIM_ERR_ACCESS_DENIED,
+         'Py_PrefetchCIMErrorTest failed'),
+        ('Py_PrefetchPythonErrorTest', pywbem.CIM_ERR_FAILED,
+         'Py_PrefetchPythonErrorTest failed'),
+        ('Py_PrefetchConversionErrorTest', pywbem.CIM_ERR_FAILED,
+         'Negative value -1')]:
+    try:
+        conn.EnumerateInstances(cn)
+        fail('EnumerateInstances of', cn, 'succeeded')
+    except pywbem.CIMError, arg:
+        if arg[0] != code or msg not in arg[1]:
+            fail('EnumerateInstances of', cn, arg)
+
+# The provider is still usable after the failures
+try:
+    if len(conn.EnumerateInstances('Py_PrefetchTest')) != 1000:
+        fail('EnumerateInstances after the failures')
+except pywbem.CIMError, arg:
+    fail('EnumerateInstances after the failures', arg)
+
+if not failed:
+    print 'Passed'
@@ -0,0 +1,364 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+
+// Compares enumInstances throughput of a python provider called in
+// process, with every client thread contending for the GIL, against the
+// same provider served by a PyWorkerPool.
+//
+// Usage: workerbench [instances [requests [workers]]]
+//
+// With 1, 4 and 16 concurrent clients, each client runs 'requests'
+// enumerations of 'instances' instances (defaults 1000, 20 and 4 worker
+// processes). Reports requests and instances per second for both modes.
+
+#include "OW_PyConverter.hpp"
+#include "OW_PyWorkerPool.hpp"
+#include <openwbem/OW_CIMClass.hpp>
+#include <openwbem/OW_CIMProperty.hpp>
+#include <openwbem/OW_CIMQualifier.hpp>
+#include <openwbem/OW_CIMValue.hpp>
+#include <openwbem/OW_CIMDataType.hpp>
+#include <openwbem/OW_ResultHandlerIFC.hpp>
+#include <openwbem/OW_Thread.hpp>
+#include <openwbem/OW_Array.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdlib>
+
+extern "C"
+{
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+using namespace std;
+using namespace OpenWBEM;
+using namespace PythonProvIFC;
+
+namespace
+{
+
+const char* const BENCH_NS = "root/cimv2";
+
+//////////////////////////////////////////////////////////////////////////////
+double
+nowUsecs()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return double(tv.tv_sec) * 1000000.0 + double(tv.tv_usec);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+String
+providerSource(int instances)
+{
+	return String(
+		"import pywbem\n"
+		"from pywbem.cim_provider import CIMProvider\n"
+		"COUNT = ") + String(instances) + String("\n"
+		"class BenchProvider(CIMProvider):\n"
+		"    def enum_instances(self, env, model, cim_class, keys_only):\n"
+		"        for i in xrange(COUNT):\n"
+		"            model['Name'] = 'item' + str(i)\n"
+		"            if not keys_only:\n"
+		"                model['Value'] = pywbem.Uint32(i)\n"
+		"                model['Text'] = 'x' * 64\n"
+		"            yield model\n"
+		"def get_providers(env):\n"
+		"    return {'Bench_Item': BenchProvider()}\n");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMClass
+benchClass()
+{
+	CIMClass cls("Bench_Item");
+	CIMProperty name("Name", CIMDataType(CIMDataType::STRING));
+	CIMQualifier key(CIMQualifier::CIM_QUAL_KEY);
+	key.setValue(CIMValue(true));
+	name.addQualifier(key);
+	cls.addProperty(name);
+	cls.addProperty(CIMProperty("Value", CIMDataType(CIMDataType::UINT32)));
+	cls.addProperty(CIMProperty("Text", CIMDataType(CIMDataType::STRING)));
+	return cls;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+class CountingHandler : public CIMInstanceResultHandlerIFC
+{
+public:
+	CountingHandler()
+		: CIMInstanceResultHandlerIFC()
+		, m_count(0)
+	{
+	}
+
+	UInt64 getCount() const { return m_count; }
+
+protected:
+	virtual void doHandle(const CIMInstance& ci)
+	{
+		m_count++;
+	}
+
+private:
+	UInt64 m_count;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+struct BenchSetup
+{
+	String provPath;
+	time_t provModTime;
+	CIMClass cls;
+	Py::Object pyprov;		// In process provider proxy
+	PyWorkerPoolRef pool;	// Null for the in process run
+	int requests;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Does what PyProvider::enumInstances does for a provider in the CIMOM
+void
+enumInProcess(
+	const BenchSetup& setup,
+	CIMInstanceResultHandlerIFC& result)
+{
+	Py::GILGuard gg;	// Acquire python's GIL
+	Py::Callable pyfunc = setup.pyprov.getAttr("MI_enumInstances");
+	Py::Tuple args(5);
+	args[0] = PyWorkerPool::newWorkerEnvironment("bench");
+	args[1] = Py::String(BENCH_NS);
+	args[2] = Py::None();
+	args[3] = OWPyConv::OWCachedClass2Py(setup.cls, BENCH_NS);
+	args[4] = args[3];
+	Py::Object wko = pyfunc.apply(args);
+	Py::Object iterable(PyObject_GetIter(wko.ptr()), true);
+	PyObject* item;
+	while((item = PyIter_Next(iterable.ptr())))
+	{
+		wko = Py::Object(item, true);
+		CIMInstance ci = OWPyConv::PyInst2OW(wko, BENCH_NS);
+		PYCXX_ALLOW_THREADS
+		result.handle(ci);
+		PYCXX_END_ALLOW_THREADS
+	}
+	if (PyErr_Occurred())
+	{
+		throw Py::Exception();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+class BenchClient : public Thread
+{
+public:
+	BenchClient(const BenchSetup& setup)
+		: Thread()
+		, m_setup(setup)
+		, m_result()
+		, m_failed(false)
+	{
+	}
+
+	UInt64 getCount() const { return m_result.getCount(); }
+	bool failed() const { return m_failed; }
+
+protected:
+	virtual Int32 run()
+	{
+		try
+		{
+			for (int i = 0; i < m_setup.requests; i++)
+			{
+				if (m_setup.pool)
+				{
+					m_setup.pool->enumInstances(m_setup.provPath,
+						m_setup.provModTime, "bench", BENCH_NS, 0,
+						m_setup.cls, m_setup.cls, m_result);
+				}
+				else
+				{
+					enumInProcess(m_setup, m_result);
+				}
+			}
+		}
+		catch (Py::Exception& e)
+		{
+			Py::GILGuard gg;
+			PyErr_Print();
+			e.clear();
+			m_failed = true;
+		}
+		catch (Exception& e)
+		{
+			cerr << "Caught exception: " << e << endl;
+			m_failed = true;
+		}
+		return 0;
+	}
+
+private:
+	const BenchSetup& m_setup;
+	CountingHandler m_result;
+	bool m_failed;
+};
+typedef IntrusiveReference<BenchClient> BenchClientRef;
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+runClients(
+	const char* mode,
+	const BenchSetup& setup,
+	int clients)
+{
+	Array<BenchClientRef> threads;
+	for (int i = 0; i < clients; i++)
+	{
+		threads.append(BenchClientRef(new BenchClient(setup)));
+	}
+
+	double start = nowUsecs();
+	for (int i = 0; i < clients; i++)
+	{
+		threads[i]->start();
+	}
+	UInt64 instances = 0;
+	bool ok = true;
+	for (int i = 0; i < clients; i++)
+	{
+		threads[i]->join();
+		instances += threads[i]->getCount();
+		ok = ok && !threads[i]->failed();
+	}
+	double secs = (nowUsecs() - start) / 1000000.0;
+
+	cout << setw(10) << mode << setw(8) << clients
+		<< setw(12) << fixed << setprecision(1)
+		<< (clients * setup.requests) / secs << " req/s"
+		<< setw(12) << setprecision(0) << instances / secs << " inst/s"
+		<< endl;
+	return ok;
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+int
+main(int argc, char* argv[])
+{
+	int instances = 1000;
+	int requests = 20;
+	int workers = 4;
+	if (argc > 1)
+	{
+		instances = atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		requests = atoi(argv[2]);
+	}
+	if (argc > 3)
+	{
+		workers = atoi(argv[3]);
+	}
+	if (instances <= 0 || requests <= 0 || workers <= 0)
+	{
+		cerr << "Usage: " << argv[0] << " [instances [requests [workers]]]"
+			<< endl;
+		return 1;
+	}
+
+	char dirTemplate[] = "/tmp/workerbenchXXXXXX";
+	if (!mkdtemp(dirTemplate))
+	{
+		cerr << "Can't create temporary directory" << endl;
+		return 1;
+	}
+	BenchSetup setup;
+	setup.provPath = String(dirTemplate) + "/bench_provider.py";
+	{
+		ofstream src(setup.provPath.c_str());
+		src << providerSource(instances);
+	}
+	struct stat st;
+	::stat(setup.provPath.c_str(), &st);
+	setup.provModTime = st.st_mtime;
+	setup.cls = benchClass();
+	setup.requests = requests;
+
+	Py_Initialize();
+	PyEval_InitThreads();
+	int rc = 0;
+	try
+	{
+		Py::Module pywbem("pywbem", true);
+		OWPyConv::setPyWbemMod(pywbem);
+		Py::Callable ctor = pywbem.getAttr("cim_provider").getAttr(
+			"ProviderProxy");
+		Py::Tuple args(2);
+		args[0] = PyWorkerPool::newWorkerEnvironment("bench");
+		args[1] = Py::String(setup.provPath);
+		setup.pyprov = ctor.apply(args);
+	}
+	catch (Py::Exception& e)
+	{
+		PyErr_Print();
+		e.clear();
+		rc = 1;
+	}
+
+	if (rc == 0)
+	{
+		// The clients and the pool take the GIL as they need it
+		PyThreadState* mainTState = PyEval_SaveThread();
+		try
+		{
+			static const int clientCounts[] = { 1, 4, 16 };
+			const int runs = sizeof(clientCounts) / sizeof(clientCounts[0]);
+			for (int i = 0; i < runs && rc == 0; i++)
+			{
+				rc = runClients("inproc", setup, clientCounts[i]) ? 0 : 1;
+			}
+
+			setup.pool = new PyWorkerPool(workers, 1024 * 1024, OWPYWORKER);
+			setup.pool->start();
+			for (int i = 0; i < runs && rc == 0; i++)
+			{
+				rc = runClients("workers", setup, clientCounts[i]) ? 0 : 1;
+			}
+			setup.pool->shutdown();
+		}
+		catch (Exception& e)
+		{
+			cerr << "Caught exception: " << e << endl;
+			rc = 1;
+		}
+		PyEval_RestoreThread(mainTState);
+	}
+
+	setup.pyprov = Py::Object();
+	Py_Finalize();
+	::unlink(setup.provPath.c_str());
+	::unlink((setup.provPath + "c").c_str());
+	::rmdir(dirTemplate);
+	return rc;
+}
@@ -168,11 +168,98 @@ public:
 };
 #define PY_THROW_CIMMSG(code, msg) throw PyCIMOMHandleException(__FILE__, __LINE__, code, msg)
 
+//////////////////////////////////////////////////////////////////////////////
+Uint32
+_getBatchSize(
+	const Py::Dict& kws)
+{
+	// The CIMOM handle returns complete result arrays, so the
+	// HandlerBatchTime parameter has nothing to wait on and is ignored here.
+	Py::Object wko = _getParam(kws, "HandlerBatchSize");
+	if (wko.isNone())
+	{
+		return 0;
+	}
+	long v = long(Py::Int(wko));
+	if (v < 0)
+	{
+		PY_THROW_CIMMSG(CIM_ERR_INVALID_PARAMETER,
+			"'HandlerBatchSize' parameter must not be negative");
+	}
+	return Uint32(v);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+_wantIterator(
+	const Py::Dict& kws,
+	const Py::Callable& cb)
+{
+	Py::Object wko = _getParam(kws, "Iterator");
+	if (wko.isNone() || !wko.isTrue())
+	{
+		return false;
+	}
+	if (!cb.isNone())
+	{
+		PY_THROW_CIMMSG(CIM_ERR_INVALID_PARAMETER,
+			"The 'Handler' and 'Iterator' parameters are mutually exclusive");
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Passes results to a python Handler, either one at a time or as lists of
+// up to batchSize results.
+class _PyHandlerCaller
+{
+public:
+	_PyHandlerCaller(Py::Callable& cb, Uint32 batchSize)
+		: m_cb(cb)
+		, m_batchSize(batchSize)
+		, m_args(1)
+		, m_batch()
+	{
+	}
+
+	void add(const Py::Object& pyobj)
+	{
+		if (!m_batchSize)
+		{
+			m_args[0] = pyobj;
+			m_cb.apply(m_args);
+			return;
+		}
+		m_batch.append(pyobj);
+		if (m_batch.length() >= m_batchSize)
+		{
+			flush();
+		}
+	}
+
+	void flush()
+	{
+		if (m_batch.length())
+		{
+			m_args[0] = m_batch;
+			m_batch = Py::List();
+			m_cb.apply(m_args);
+		}
+	}
+
+private:
+	Py::Callable& m_cb;
+	Uint32 m_batchSize;
+	Py::Tuple m_args;
+	Py::List m_batch;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 Py::Object
 _processCIMNameResults(
 	const Array<CIMName>& cnames,
-	Py::Callable& cb)
+	Py::Callable& cb,
+	Uint32 batchSize)
 {
 	if (cb.isNone())
 	{
@@ -188,12 +275,12 @@ _processCIMNameResults(
 	{
 		try
 		{
-			Py::Tuple args(1);
+			_PyHandlerCaller caller(cb, batchSize);
 			for (Uint32 i = 0; i < cnames.size(); i++)
 			{
-				args[0] = Py::String(cnames[i].getString());
-				cb.apply(args);
+				caller.add(Py::String(cnames[i].getString()));
 			}
+			caller.flush();
 		}
 		catch(Py::Exception& e)
 		{
@@ -210,7 +297,8 @@ _processCIMNameResults(
 Py::Object
 _processCIMClassResults(
 	const Array<CIMClass>& classes,
-	Py::Callable& cb)
+	Py::Callable& cb,
+	Uint32 batchSize)
 {
 	if (cb.isNone())
 	{
@@ -226,12 +314,12 @@ _processCIMClassResults(
 	{
 		try
 		{
-			Py::Tuple args(1);
+			_PyHandlerCaller caller(cb, batchSize);
 			for (Uint32 i = 0; i < classes.size(); i++)
 			{
-				args[0] = PGPyConv::PGClass2Py(classes[i]);
-				cb.apply(args);
+				caller.add(PGPyConv::PGClass2Py(classes[i]));
 			}
+			caller.flush();
 		}
 		catch(Py::Exception& e)
 		{
@@ -249,7 +337,8 @@ Py::Object
 _processCIMInstanceResults(
 	const Array<CIMInstance>& instances,
 	const String& ns,
-	Py::Callable& cb)
+	Py::Callable& cb,
+	Uint32 batchSize)
 {
 	if (cb.isNone())
 	{
@@ -265,12 +354,12 @@ _processCIMInstanceResults(
 	{
 		try
 		{
-			Py::Tuple args(1);
+			_PyHandlerCaller caller(cb, batchSize);
 			for (Uint32 i = 0; i < instances.size(); i++)
 			{
-				args[0] = PGPyConv::PGInst2Py(instances[i], ns);
-				cb.apply(args);
+				caller.add(PGPyConv::PGInst2Py(instances[i], ns));
 			}
+			caller.flush();
 		}
 		catch(Py::Exception& e)
 		{
@@ -288,7 +377,8 @@ Py::Object
 _processCIMObjectResults(
 	const Array<CIMObject>& objects,
 	const String& ns,
-	Py::Callable& cb)
+	Py::Callable& cb,
+	Uint32 batchSize)
 {
 	if (cb.isNone())
 	{
@@ -312,20 +402,20 @@ _processCIMObjectResults(
 	{
 		try
 		{
-			Py::Tuple args(1);
+			_PyHandlerCaller caller(cb, batchSize);
 			for (Uint32 i = 0; i < objects.size(); i++)
 			{
 				if (objects[i].isClass())
 				{
-					args[0] = PGPyConv::PGClass2Py(CIMConstClass(objects[i]));
+					caller.add(PGPyConv::PGClass2Py(CIMConstClass(objects[i])));
 				}
 				else
 				{
-					args[0] = PGPyConv::PGInst2Py(CIMConstInstance(objects[i]),
-						ns);
+					caller.add(PGPyConv::PGInst2Py(CIMConstInstance(objects[i]),
+						ns));
 				}
-				cb.apply(args);
 			}
+			caller.flush();
 		}
 		catch(Py::Exception& e)
 		{
@@ -342,7 +432,8 @@ _processCIMObjectResults(
 Py::Object
 _processCIMQualResults(
 	const Array<CIMQualifierDecl>& quals,
-	Py::Callable& cb)
+	Py::Callable& cb,
+	Uint32 batchSize)
 {
 	if (cb.isNone())
 	{
@@ -358,12 +449,12 @@ _processCIMQualResults(
 	{
 		try
 		{
-			Py::Tuple args(1);
+			_PyHandlerCaller caller(cb, batchSize);
 			for (Uint32 i = 0; i < quals.size(); i++)
 			{
-				args[0] = PGPyConv::PGQualType2Py(quals[i]);
-				cb.apply(args);
+				caller.add(PGPyConv::PGQualType2Py(quals[i]));
 			}
+			caller.flush();
 		}
 		catch(Py::Exception& e)
 		{
@@ -381,7 +472,8 @@ Py::Object
 _processCIMObjectPathResults(
 	Array<CIMObjectPath>& cops,
 	Py::Callable& cb,
-    const String& ns)
+    const String& ns,
+	Uint32 batchSize)
 {
 	if (cb.isNone())
 	{
@@ -398,13 +490,13 @@ _processCIMObjectPathResults(
 	{
 		try
 		{
-			Py::Tuple args(1);
+			_PyHandlerCaller caller(cb, batchSize);
 			for (Uint32 i = 0; i < cops.size(); i++)
 			{
                 cops[i].setNameSpace(ns);
-				args[0] = PGPyConv::PGRef2Py(cops[i]);
-				cb.apply(args);
+				caller.add(PGPyConv::PGRef2Py(cops[i]));
 			}
+			caller.flush();
 		}
 		catch(Py::Exception& e)
 		{
@@ -578,8 +670,7 @@ PyCIMOMHandle::invokeMethod(
 			if (!pgparam.isUninitialized())
 			{
 				CIMType dt = pgparam.getType();
-				String pydt = PGPyConv::PGDataType2Py(dt);
-				CIMValue cv = PGPyConv::PyVal2PG(pydt, values[i]);
+				CIMValue cv = PGPyConv::PyVal2PG(dt, values[i]);
 				inParams.append(CIMParamValue(pname, dt, true));
 			}
 		}
@@ -692,7 +783,8 @@ PyCIMOMHandle::enumClassNames(
 		PYCXX_ALLOW_THREADS
 		cnames = m_chdl.enumerateClassNames(m_context, ns, className, deepflg);
 		PYCXX_END_ALLOW_THREADS
-		return _processCIMNameResults(cnames, cb);
+		return _processCIMNameResults(cnames, cb,
+			_getBatchSize(kws));
 	}
 	catch(const CIMException& e)
 	{
@@ -796,7 +888,8 @@ PyCIMOMHandle::enumClass(
 		classes = m_chdl.enumerateClasses(m_context, ns, className,
 			deepFlg, localOnlyFlag, incQualsFlag, classOriginFlag);
 		PYCXX_END_ALLOW_THREADS
-		return _processCIMClassResults(classes, cb);
+		return _processCIMClassResults(classes, cb,
+			_getBatchSize(kws));
 	}
 	catch(const CIMException& e)
 	{
@@ -952,6 +1045,8 @@ PyCIMOMHandle::createClass(
 		PYCXX_ALLOW_THREADS
 		m_chdl.createClass(m_context, ns, cc);
 		PYCXX_END_ALLOW_THREADS
+		PGPyConv::invalidateClassCache(ns);
+		m_pmgr->invalidateClassCache(ns);
 	}
 	catch(const CIMException& e)
 	{
@@ -1007,6 +1102,8 @@ PyCIMOMHandle::deleteClass(
 		PYCXX_ALLOW_THREADS
 		m_chdl.deleteClass(m_context, ns, className);
 		PYCXX_END_ALLOW_THREADS
+		PGPyConv::invalidateClassCache(ns);
+		m_pmgr->invalidateClassCache(ns);
 	}
 	catch(const CIMException& e)
 	{
@@ -1062,6 +1159,8 @@ PyCIMOMHandle::modifyClass(
 		PYCXX_ALLOW_THREADS
 		m_chdl.modifyClass(m_context, ns, cc);
 		PYCXX_END_ALLOW_THREADS
+		PGPyConv::invalidateClassCache(ns);
+		m_pmgr->invalidateClassCache(ns);
 	}
 	catch(const CIMException& e)
 	{
@@ -1121,7 +1220,8 @@ PyCIMOMHandle::enumQualifiers(
 		quals = client.enumerateQualifiers(ns);
 		PYCXX_END_ALLOW_THREADS
 		client.disconnect();
-		return _processCIMQualResults(quals, cb);
+		return _processCIMQualResults(quals, cb,
+			_getBatchSize(kws));
 	}
 	catch(const CIMException& e)
 	{
@@ -1367,7 +1467,8 @@ cerr << "!!!!! User Name on context: " << userName << endl;
 
 		cops = m_chdl.enumerateInstanceNames(m_context, ns, className);
 		PYCXX_END_ALLOW_THREADS
-		return _processCIMObjectPathResults(cops, cb, ns);
+		return _processCIMObjectPathResults(cops, cb, ns,
+			_getBatchSize(kws));
 	}
 	catch(const CIMException& e)
 	{
@@ -1471,12 +1572,25 @@ PyCIMOMHandle::enumInstances(
 			cb = wko;
 		}
 
+		bool iterate = _wantIterator(kws, cb);
 		Array<CIMInstance> instances;
 		PYCXX_ALLOW_THREADS
 		instances = m_chdl.enumerateInstances(m_context, ns, className, deepFlg, localOnlyFlag,
 			incQualsFlag, classOriginFlag, propList);
 		PYCXX_END_ALLOW_THREADS
-		return _processCIMInstanceResults(instances, ns, cb);
+		if (iterate)
+		{
+			Array<CIMObject> cimobjs;
+			cimobjs.reserveCapacity(instances.size());
+			for (Uint32 i = 0; i < instances.size(); i++)
+			{
+				cimobjs.append(CIMObject(instances[i]));
+			}
+			instances.clear();
+			return PyCIMObjectIterator::newObject(cimobjs, ns);
+		}
+		return _processCIMInstanceResults(instances, ns, cb,
+			_getBatchSize(kws));
 	}
 	catch(const CIMException& e)
 	{
@@ -1846,13 +1960,19 @@ PyCIMOMHandle::associators(
 			cb = wko;
 		}
 
+		bool iterate = _wantIterator(kws, cb);
 		Array<CIMObject> cimobjs;
 		PYCXX_ALLOW_THREADS
 		cimobjs = m_chdl.associators(m_context, ns, objectName, 
 			assocClass, resultClass, role, resultRole, incQualsFlag,
 			classOriginFlag, propList);
 		PYCXX_END_ALLOW_THREADS
-		return _processCIMObjectResults(cimobjs, ns, cb);
+		if (iterate)
+		{
+			return PyCIMObjectIterator::newObject(cimobjs, ns);
+		}
+		return _processCIMObjectResults(cimobjs, ns, cb,
+			_getBatchSize(kws));
 	}
 	catch(const CIMException& e)
 	{
@@ -1940,7 +2060,8 @@ PyCIMOMHandle::associatorNames(
 		names = m_chdl.associatorNames(m_context, ns, objectName,
 			assocClass, resultClass, role, resultRole);
 		PYCXX_END_ALLOW_THREADS
-		return _processCIMObjectPathResults(names, cb, ns);
+		return _processCIMObjectPathResults(names, cb, ns,
+			_getBatchSize(kws));
 	}
 	catch(const CIMException& e)
 	{
@@ -2038,12 +2159,18 @@ PyCIMOMHandle::references(
 			}
 			cb = wko;
 		}
+		bool iterate = _wantIterator(kws, cb);
 		Array<CIMObject> cimobjs;
 		PYCXX_ALLOW_THREADS
 		cimobjs = m_chdl.references(m_context, ns, objectName, resultClass, role, 
 			incQualsFlag, classOriginFlag, propList);
 		PYCXX_END_ALLOW_THREADS
-		return _processCIMObjectResults(cimobjs, ns, cb);
+		if (iterate)
+		{
+			return PyCIMObjectIterator::newObject(cimobjs, ns);
+		}
+		return _processCIMObjectResults(cimobjs, ns, cb,
+			_getBatchSize(kws));
 	}
 	catch(const CIMException& e)
 	{
@@ -2118,7 +2245,8 @@ PyCIMOMHandle::referenceNames(
 		cops = m_chdl.referenceNames(m_context, ns, objectName,
 			resultClass, role);
 		PYCXX_END_ALLOW_THREADS
-		return _processCIMObjectPathResults(cops, cb, ns);
+		return _processCIMObjectPathResults(cops, cb, ns,
+			_getBatchSize(kws));
 	}
 	catch(const CIMException& e)
 	{
@@ -2220,4 +2348,91 @@ PyCIMOMHandle::newObject(
 	return Py::asObject(ph);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+PyCIMObjectIterator::PyCIMObjectIterator(
+	const Array<CIMObject>& objects,
+	const String& ns)
+	: Py::PythonExtension<PyCIMObjectIterator>()
+	, m_objects(objects)
+	, m_ns(ns)
+	, m_pos(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyCIMObjectIterator::~PyCIMObjectIterator()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyCIMObjectIterator::repr()
+{
+	return Py::String(Formatter::format(
+		"<CIM object iterator for namespace '$0'>", m_ns));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyCIMObjectIterator::getattr(
+	const char *name)
+{
+	return getattr_methods(name);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Py::Object
+PyCIMObjectIterator::iter()
+{
+	return Py::Object(this);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyObject*
+PyCIMObjectIterator::iternext()
+{
+	if (m_pos >= m_objects.size())
+	{
+		// Returning NULL without an exception set stops the iteration
+		return NULL;
+	}
+	Py::Object pyobj;
+	if (m_objects[m_pos].isClass())
+	{
+		pyobj = PGPyConv::PGClass2Py(CIMConstClass(m_objects[m_pos]));
+	}
+	else
+	{
+		pyobj = PGPyConv::PGInst2Py(CIMConstInstance(m_objects[m_pos]),
+			m_ns);
+	}
+	// Let go of the native object now that python has its own copy
+	m_objects[m_pos++] = CIMObject();
+	return Py::new_reference_to(pyobj);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+PyCIMObjectIterator::doInit()
+{
+	behaviors().name("CIMObjectIterator");
+	behaviors().doc("Iterator over the results of a CIMOM handle "
+		"operation called with Iterator=True. Results are converted as the "
+		"iterator is advanced");
+	behaviors().supportRepr();
+	behaviors().supportGetattr();
+	behaviors().supportIter();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+Py::Object
+PyCIMObjectIterator::newObject(
+	const Array<CIMObject>& objects,
+	const String& ns)
+{
+	return Py::asObject(new PyCIMObjectIterator(objects, ns));
+}
+
 }	// End of namespace PythonProvIFC
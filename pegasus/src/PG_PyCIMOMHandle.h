@@ -91,6 +91,33 @@ private:
     OperationContext m_context;
 };
 
+//////////////////////////////////////////////////////////////////////////////
+// Python iterator returned by the CIMOM handle upcalls when they are called
+// with Iterator=True. The Pegasus CIMOMHandle hands back complete result
+// arrays, so this iterator converts one element per step and drops the
+// native object once it has been handed out.
+class PyCIMObjectIterator
+	: public Py::PythonExtension<PyCIMObjectIterator>
+{
+public:
+	PyCIMObjectIterator(const Array<CIMObject>& objects, const String& ns);
+	~PyCIMObjectIterator();
+
+	virtual Py::Object repr();
+	virtual Py::Object getattr(const char *name);
+	virtual Py::Object iter();
+	virtual PyObject* iternext();
+
+	static void doInit();
+	static Py::Object newObject(const Array<CIMObject>& objects,
+		const String& ns);
+
+private:
+	Array<CIMObject> m_objects;
+	String m_ns;
+	Uint32 m_pos;
+};
+
 }	// End of namespace PythonProvIFC
 
 #endif	// PG_PYCIMOMHANDLE_H_GUARD
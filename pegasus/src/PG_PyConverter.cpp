@@ -24,10 +24,14 @@
 #include <Pegasus/Common/CIMFlavor.h>
 #include <Pegasus/Common/CIMScope.h>
 #include <Pegasus/Common/Array.h>
+#include <Pegasus/Common/Formatter.h>
 
 #include <iostream>
 #include <cstdio>
 #include <cstdlib>
+#include <limits>
+#include <map>
+#include <vector>
 using std::cout;
 using std::endl;
 
@@ -78,6 +82,75 @@ Py::Module g_modpywbem;
 namespace
 {
 
+// pywbem types and callables used by the converters. These are resolved
+// once by PGPyConv::setPyWbemMod so the conversion routines don't have to
+// look them up in the module on every call.
+struct _PyWbemTypes
+{
+	Py::Object cimInstance;
+	Py::Object cimInstanceName;
+	Py::Object cimClassName;
+	Py::Object cimClass;
+	Py::Object cimProperty;
+	Py::Object cimQualifier;
+	Py::Object cimQualifierDecl;
+	Py::Object cimParameter;
+	Py::Object cimMethod;
+	Py::Object cimDateTime;
+	Py::Object uint8;
+	Py::Object sint8;
+	Py::Object uint16;
+	Py::Object sint16;
+	Py::Object uint32;
+	Py::Object sint32;
+	Py::Object uint64;
+	Py::Object sint64;
+	Py::Object real32;
+	Py::Object real64;
+};
+_PyWbemTypes g_pywbem;
+
+// Cache of converted CIMClass objects. Entries are keyed by namespace:classname
+// and are only valid while the generation they were created with matches the
+// current schema generation of their namespace, and the class passed in
+// comes from the same fetch of the provider manager's class cache. Classes
+// changed through the CIMOM by a client are seen once the manager fetches
+// them again. All access is serialized by the GIL.
+struct _CachedClass
+{
+	_CachedClass() : generation(0), classGen(0) {}
+	Py::Object pycls;
+	Uint32 generation;
+	Uint32 classGen;
+};
+typedef std::map<String, _CachedClass> _ClassCacheMap;
+typedef std::map<String, Uint32> _SchemaGenMap;
+_ClassCacheMap g_classCache;
+_SchemaGenMap g_schemaGen;
+
+//////////////////////////////////////////////////////////////////////////////
+inline String
+_nsCacheKey(const String& ns)
+{
+	String key = ns;
+	key.toLower();
+	return key;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+inline String
+_classCacheKey(
+	const String& ns,
+	const String& className)
+{
+	String cn = className;
+	cn.toLower();
+	String key = _nsCacheKey(ns);
+	key.append(":");
+	key.append(cn);
+	return key;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 void
 _py2ConversionException(
@@ -152,8 +225,7 @@ _convertPyDateTime(
 	Py::Object arg)
 {
     CIMDateTime cdt; 
-	Py::Object dtclass = g_modpywbem.getAttr("CIMDateTime");
-	if (!arg.isInstanceOf(dtclass))
+	if (!arg.isInstanceOf(g_pywbem.cimDateTime))
 	{
 		THROW_CONV_EXC("Unknown python type converting to PG CIMDateTime");
 	}
@@ -195,7 +267,7 @@ _convertPGDateTime(const CIMDateTime& dt)
 {
 	try
 	{
-		Py::Callable func = g_modpywbem.getAttr("CIMDateTime");
+		Py::Callable func = g_pywbem.cimDateTime;
 		Py::Tuple cdtarg(1);
 		cdtarg[0] = Py::String(dt.toString());
 		return func.apply(cdtarg); 
@@ -207,48 +279,426 @@ _convertPGDateTime(const CIMDateTime& dt)
 	return Py::None();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Create a plain python number for a Pegasus numeric value. Returns a new
+// reference.
+inline PyObject* _num2Py(Uint8 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* _num2Py(Sint8 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* _num2Py(Uint16 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* _num2Py(Sint16 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* _num2Py(Uint32 v) { return PyLong_FromUnsignedLong(v); }
+inline PyObject* _num2Py(Sint32 v) { return PyInt_FromLong(long(v)); }
+inline PyObject* _num2Py(Uint64 v) { return PyLong_FromUnsignedLongLong(v); }
+inline PyObject* _num2Py(Sint64 v) { return PyLong_FromLongLong(v); }
+inline PyObject* _num2Py(Real32 v) { return PyFloat_FromDouble(double(v)); }
+inline PyObject* _num2Py(Real64 v) { return PyFloat_FromDouble(v); }
+
+//////////////////////////////////////////////////////////////////////////////
+// Makes pywbem numbers from plain python numbers. pywbem numeric types are
+// python subclasses of int, long or float without __new__ or __init__ of
+// their own. Objects of the float and int ones are allocated and filled in
+// here, the way the interpreter does it for subclasses. The long ones go
+// straight to the type's tp_new. Any other callable is called, with an
+// argument tuple that is reused from call to call as long as nobody else
+// holds on to it.
+class _NumericCtor
+{
+public:
+	_NumericCtor(const Py::Object& pyfunc, const char* func)
+		: m_func(pyfunc.ptr())
+		, m_name(func)
+		, m_args(0)
+		, m_type(0)
+		, m_kind(E_CALL)
+	{
+		if (!PyType_Check(m_func))
+		{
+			return;
+		}
+		PyTypeObject* tp = reinterpret_cast<PyTypeObject*>(m_func);
+		if (!(tp->tp_flags & Py_TPFLAGS_HEAPTYPE)
+			|| tp->tp_init != PyBaseObject_Type.tp_init)
+		{
+			// Only subclasses defined in python are made here
+			return;
+		}
+		m_type = tp;
+		if (tp->tp_new == PyFloat_Type.tp_new)
+		{
+			m_kind = E_FLOAT;
+		}
+		else if (tp->tp_new == PyInt_Type.tp_new)
+		{
+			m_kind = E_INT;
+		}
+		else if (tp->tp_new == PyLong_Type.tp_new)
+		{
+			m_kind = E_NEW;
+		}
+		else
+		{
+			m_type = 0;
+		}
+	}
+
+	~_NumericCtor()
+	{
+		Py_XDECREF(m_args);
+	}
+
+	// Steals the reference to rawval. Returns a new reference.
+	PyObject* operator()(PyObject* rawval)
+	{
+		if (!rawval)
+		{
+			_throwCallError();
+		}
+		if ((m_kind == E_FLOAT && PyFloat_CheckExact(rawval))
+			|| (m_kind == E_INT && PyInt_CheckExact(rawval)))
+		{
+			return _alloc(rawval);
+		}
+		if (!m_args)
+		{
+			m_args = PyTuple_New(1);
+			if (!m_args)
+			{
+				Py_DECREF(rawval);
+				_throwCallError();
+			}
+		}
+		PyTuple_SET_ITEM(m_args, 0, rawval);
+		PyObject* pVal = (m_kind == E_NEW)
+			? m_type->tp_new(m_type, m_args, NULL)
+			: PyObject_Call(m_func, m_args, NULL);
+		if (m_args->ob_refcnt == 1)
+		{
+			PyTuple_SET_ITEM(m_args, 0, NULL);
+			Py_DECREF(rawval);
+		}
+		else
+		{
+			// The callee kept the tuple. Let it go and make a new one
+			// next time around.
+			Py_DECREF(m_args);
+			m_args = 0;
+		}
+		if (!pVal)
+		{
+			_throwCallError();
+		}
+		return pVal;
+	}
+
+private:
+	_NumericCtor(const _NumericCtor&);
+	_NumericCtor& operator=(const _NumericCtor&);
+
+	enum Kind { E_CALL, E_FLOAT, E_INT, E_NEW };
+
+	void _throwCallError()
+	{
+		String msg("Calling function ");
+		msg.append(m_name);
+		throw Py::Exception(msg);
+	}
+
+	// Same as float_subtype_new and int_subtype_new. Steals rawval.
+	PyObject* _alloc(PyObject* rawval)
+	{
+		PyObject* pVal = m_type->tp_alloc(m_type, 0);
+		if (pVal)
+		{
+			if (m_kind == E_FLOAT)
+			{
+				reinterpret_cast<PyFloatObject*>(pVal)->ob_fval =
+					PyFloat_AS_DOUBLE(rawval);
+			}
+			else
+			{
+				reinterpret_cast<PyIntObject*>(pVal)->ob_ival =
+					PyInt_AS_LONG(rawval);
+			}
+		}
+		Py_DECREF(rawval);
+		if (!pVal)
+		{
+			_throwCallError();
+		}
+		return pVal;
+	}
+
+	PyObject* m_func;
+	const char* m_name;
+	PyObject* m_args;
+	PyTypeObject* m_type;	// Set unless the function is called
+	Kind m_kind;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 template <typename T>
 Py::Object
 _numericPG2Py(
-	const char* format,
+	const Py::Object& pyfunc,
 	const char* func, 
 	const CIMValue& pegval)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr(func);
+	_NumericCtor ctor(pyfunc, func);
     if (pegval.isArray())
     {
 		Array<T> val;
 		pegval.get(val); 
-		Py::List vlist;
-
-		for (Uint32 i = 0; i < val.size(); ++i)
+		Uint32 sz = val.size();
+		PyObject* plist = PyList_New(sz);
+		if (!plist)
 		{
-			PyObject* pVal = PyObject_CallFunction(pyfunc.ptr(),
-				const_cast<char*>(format), val[i]);
-			if (!pVal)
-			{
-				String msg("Calling function ");
-				msg.append(func);
-				throw Py::Exception(msg);
-			}
-			vlist.append(Py::Object(pVal, true));
+			String msg("Calling function ");
+			msg.append(func);
+			throw Py::Exception(msg);
+		}
+		Py::List vlist(plist, true);
+		for (Uint32 i = 0; i < sz; ++i)
+		{
+			PyList_SET_ITEM(plist, i, ctor(_num2Py(val[i])));
 		}
-
 		return vlist; 
     }
 
 	T val;
 	pegval.get(val); 
-	PyObject* pVal = PyObject_CallFunction(pyfunc.ptr(),
-		const_cast<char*>(format), val);
-	if (!pVal)
+	return Py::Object(ctor(_num2Py(val)), true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Element converters used by PyVal2PG. Exact int and float objects are
+// converted directly; anything else goes through the python number protocol.
+template <typename T>
+T
+_pyToUnsigned(PyObject* pyob)
+{
+	unsigned long val;
+	if (PyInt_CheckExact(pyob))
 	{
-		String msg("Calling function ");
-		msg.append(func);
-		throw Py::Exception(msg);
+		long sval = PyInt_AS_LONG(pyob);
+		if (sval < 0)
+		{
+			THROW_CONV_EXC(Formatter::format("Negative value $0 given for "
+				"an unsigned $1 bit CIM type", Sint64(sval),
+				Uint32(sizeof(T) * 8)));
+		}
+		val = (unsigned long)sval;
 	}
-	return Py::Object(pVal, true);
+	else
+	{
+		// Raises for negative values
+		val = Py::Int(Py::Object(pyob)).asUnsignedLong();
+	}
+	if (val > (unsigned long)std::numeric_limits<T>::max())
+	{
+		THROW_CONV_EXC(Formatter::format("Value $0 is out of range for an "
+			"unsigned $1 bit CIM type", Uint64(val),
+			Uint32(sizeof(T) * 8)));
+	}
+	return T(val);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+T
+_pyToSigned(PyObject* pyob)
+{
+	long val;
+	if (PyInt_CheckExact(pyob))
+	{
+		val = PyInt_AS_LONG(pyob);
+	}
+	else
+	{
+		val = Py::Int(Py::Object(pyob)).asLong();
+	}
+	if (val < (long)std::numeric_limits<T>::min()
+		|| val > (long)std::numeric_limits<T>::max())
+	{
+		THROW_CONV_EXC(Formatter::format("Value $0 is out of range for a "
+			"signed $1 bit CIM type", Sint64(val), Uint32(sizeof(T) * 8)));
+	}
+	return T(val);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Uint64
+_pyToUint64(PyObject* pyob)
+{
+	return Uint64(Py::LongLong(Py::Object(pyob)).asUnsignedLongLong());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Sint64
+_pyToSint64(PyObject* pyob)
+{
+	return Sint64(Py::LongLong(Py::Object(pyob)).asLongLong());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+T
+_pyToReal(PyObject* pyob)
+{
+	if (PyFloat_CheckExact(pyob))
+	{
+		return T(PyFloat_AS_DOUBLE(pyob));
+	}
+	return T(Py::Float(Py::Object(pyob)).as_double());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Boolean
+_pyToBoolean(PyObject* pyob)
+{
+	int rc = PyObject_IsTrue(pyob);
+	if (rc < 0)
+	{
+		throw Py::Exception();
+	}
+	return rc != 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+String
+_pyToString(PyObject* pyob)
+{
+	return Py::String(pyob).as_peg_string();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMDateTime
+_pyToDateTime(PyObject* pyob)
+{
+	return _convertPyDateTime(Py::Object(pyob));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMObjectPath
+_pyToRef(PyObject* pyob)
+{
+	return PGPyConv::PyRef2PG(Py::Object(pyob));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMInstance
+_pyToInst(PyObject* pyob)
+{
+	return PGPyConv::PyInst2PG(Py::Object(pyob));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+inline bool
+_isPySequence(const Py::Object& pyval)
+{
+	return PyList_Check(pyval.ptr()) || PyTuple_Check(pyval.ptr());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Convert a python list or tuple into a preallocated Pegasus Array without
+// creating a wrapper object for every element.
+template <typename T, T (*conv)(PyObject*)>
+CIMValue
+_pySeq2PG(const Py::Object& pyval)
+{
+	PyObject* seq = pyval.ptr();
+	Uint32 sz = Uint32(PySequence_Fast_GET_SIZE(seq));
+	PyObject** items = PySequence_Fast_ITEMS(seq);
+	Array<T> ra(sz);
+	for (Uint32 i = 0; i < sz; i++)
+	{
+		ra[i] = conv(items[i]);
+	}
+	return CIMValue(ra);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Convert a scalar or, if pyval is a list or tuple, an array value
+template <typename T, T (*conv)(PyObject*)>
+inline CIMValue
+_py2PG(const Py::Object& pyval)
+{
+	if (_isPySequence(pyval))
+	{
+		return _pySeq2PG<T, conv>(pyval);
+	}
+	return CIMValue(conv(pyval.ptr()));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+typedef CIMValue (*_Py2PGFunc)(const Py::Object&);
+
+//////////////////////////////////////////////////////////////////////////////
+// Convert the value of an EmbeddedObject property. Pegasus doesn't support
+// embedded classes, so only instances are accepted. The first element
+// decides for arrays.
+CIMValue
+_py2PGEmbeddedObject(const Py::Object& pyval)
+{
+	Py::Object first = pyval;
+	if (_isPySequence(pyval) && PySequence_Fast_GET_SIZE(pyval.ptr()) > 0)
+	{
+		first = Py::Object(PySequence_Fast_GET_ITEM(pyval.ptr(), 0));
+	}
+	if (first.isInstanceOf(g_pywbem.cimClass))
+	{
+		THROW_CONV_EXC("Embedded classes not supported");
+	}
+	return _py2PG<CIMInstance, _pyToInst>(pyval);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the converter for python values of the given CIM type
+_Py2PGFunc
+_getPy2PGFunc(CIMType type)
+{
+	switch (type)
+	{
+		case CIMTYPE_BOOLEAN:
+			return &_py2PG<Boolean, _pyToBoolean>;
+		case CIMTYPE_STRING:
+			return &_py2PG<String, _pyToString>;
+		case CIMTYPE_UINT8:
+			return &_py2PG<Uint8, _pyToUnsigned<Uint8> >;
+		case CIMTYPE_SINT8:
+			return &_py2PG<Sint8, _pyToSigned<Sint8> >;
+		case CIMTYPE_UINT16:
+			return &_py2PG<Uint16, _pyToUnsigned<Uint16> >;
+		case CIMTYPE_SINT16:
+			return &_py2PG<Sint16, _pyToSigned<Sint16> >;
+		case CIMTYPE_UINT32:
+			return &_py2PG<Uint32, _pyToUnsigned<Uint32> >;
+		case CIMTYPE_SINT32:
+			return &_py2PG<Sint32, _pyToSigned<Sint32> >;
+		case CIMTYPE_UINT64:
+			return &_py2PG<Uint64, _pyToUint64>;
+		case CIMTYPE_SINT64:
+			return &_py2PG<Sint64, _pyToSint64>;
+		case CIMTYPE_REAL32:
+			return &_py2PG<Real32, _pyToReal<Real32> >;
+		case CIMTYPE_REAL64:
+			return &_py2PG<Real64, _pyToReal<Real64> >;
+		case CIMTYPE_CHAR16:
+			THROW_CONV_EXC("Unable to convert to PG from python char16");
+		case CIMTYPE_DATETIME:
+			return &_py2PG<CIMDateTime, _pyToDateTime>;
+		case CIMTYPE_REFERENCE:
+			return &_py2PG<CIMObjectPath, _pyToRef>;
+		case CIMTYPE_INSTANCE:
+			return &_py2PG<CIMInstance, _pyToInst>;
+		// Pegasus doesn't support embedded classes
+		default:
+			break;
+	}
+
+	String msg("Unknown python data type for conversion: ");
+	msg.append(_int2Str(int(type)));
+	THROW_CONV_EXC(msg);
+	return 0;	// Never hit here
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -336,6 +786,46 @@ PGPyConv::setPyWbemMod(
 	const Py::Module& mod)
 {
 	g_modpywbem = mod;
+	g_pywbem.cimInstance = mod.getAttr("CIMInstance");
+	g_pywbem.cimInstanceName = mod.getAttr("CIMInstanceName");
+	g_pywbem.cimClassName = mod.getAttr("CIMClassName");
+	g_pywbem.cimClass = mod.getAttr("CIMClass");
+	g_pywbem.cimProperty = mod.getAttr("CIMProperty");
+	g_pywbem.cimQualifier = mod.getAttr("CIMQualifier");
+	g_pywbem.cimQualifierDecl = mod.getAttr("CIMQualifierDeclaration");
+	g_pywbem.cimParameter = mod.getAttr("CIMParameter");
+	g_pywbem.cimMethod = mod.getAttr("CIMMethod");
+	g_pywbem.cimDateTime = mod.getAttr("CIMDateTime");
+	g_pywbem.uint8 = mod.getAttr("Uint8");
+	g_pywbem.sint8 = mod.getAttr("Sint8");
+	g_pywbem.uint16 = mod.getAttr("Uint16");
+	g_pywbem.sint16 = mod.getAttr("Sint16");
+	g_pywbem.uint32 = mod.getAttr("Uint32");
+	g_pywbem.sint32 = mod.getAttr("Sint32");
+	g_pywbem.uint64 = mod.getAttr("Uint64");
+	g_pywbem.sint64 = mod.getAttr("Sint64");
+	g_pywbem.real32 = mod.getAttr("Real32");
+	g_pywbem.real64 = mod.getAttr("Real64");
+	// Cached objects were created from the previous module
+	g_classCache.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+PGPyConv::checkPyWbemMod()
+{
+	if (g_modpywbem.isNone())
+	{
+		return;
+	}
+	// If pywbem has been reloaded, its classes are new objects and the
+	// pinned ones are stale.
+	if (g_modpywbem.getAttr("CIMInstance").ptr() != g_pywbem.cimInstance.ptr())
+	{
+		Py::Module mod(g_modpywbem);
+		setPyWbemMod(mod);
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -407,46 +897,64 @@ CIMType
 PGPyConv::PyDataType2PG(
 	const String& strt)
 {
-	CIMType dtype;
-	if (strt == "char16")
-		dtype = CIMTYPE_CHAR16;
-	else if (strt == "reference")
-		dtype =  CIMTYPE_REFERENCE;
-	else if (strt == "datetime")
-		dtype =  CIMTYPE_DATETIME;
-	else if (strt == "boolean")
-		dtype =  CIMTYPE_BOOLEAN;
-	else if (strt == "real32")
-		dtype =  CIMTYPE_REAL32;
-	else if (strt == "real64")
-		dtype =  CIMTYPE_REAL64;
-	else if (strt == "sint8")
-		dtype =  CIMTYPE_SINT8;
-	else if (strt == "sint16")
-		dtype =  CIMTYPE_SINT16;
-	else if (strt == "sint32")
-		dtype =  CIMTYPE_SINT32;
-	else if (strt == "sint64")
-		dtype =  CIMTYPE_SINT64;
-	else if (strt == "uint8")
-		dtype =  CIMTYPE_UINT8;
-	else if (strt == "uint16")
-		dtype =  CIMTYPE_UINT16;
-	else if (strt == "uint32")
-		dtype =  CIMTYPE_UINT32;
-	else if (strt == "uint64")
-		dtype =  CIMTYPE_UINT64;
-	else if (strt == "string")
-		dtype =  CIMTYPE_STRING;
-	else if (strt == "instance")
-		dtype =  CIMTYPE_INSTANCE;
-	else
-	{
-		String msg("Unknown python type encountered in PyDataType2PG: ");
-		msg.append(strt);
-		THROW_CONV_EXC(msg);
+	// Dispatch on the first character so a type name costs at most a
+	// couple of comparisons instead of walking the whole list.
+	Uint16 c = strt.size() ? Uint16(strt[0]) : 0;
+	switch (c)
+	{
+		case 'b':
+			if (strt == "boolean")
+				return CIMTYPE_BOOLEAN;
+			break;
+		case 'c':
+			if (strt == "char16")
+				return CIMTYPE_CHAR16;
+			break;
+		case 'd':
+			if (strt == "datetime")
+				return CIMTYPE_DATETIME;
+			break;
+		case 'i':
+			if (strt == "instance")
+				return CIMTYPE_INSTANCE;
+			break;
+		case 'r':
+			if (strt == "reference")
+				return CIMTYPE_REFERENCE;
+			if (strt == "real32")
+				return CIMTYPE_REAL32;
+			if (strt == "real64")
+				return CIMTYPE_REAL64;
+			break;
+		case 's':
+			if (strt == "string")
+				return CIMTYPE_STRING;
+			if (strt == "sint8")
+				return CIMTYPE_SINT8;
+			if (strt == "sint16")
+				return CIMTYPE_SINT16;
+			if (strt == "sint32")
+				return CIMTYPE_SINT32;
+			if (strt == "sint64")
+				return CIMTYPE_SINT64;
+			break;
+		case 'u':
+			if (strt == "uint8")
+				return CIMTYPE_UINT8;
+			if (strt == "uint16")
+				return CIMTYPE_UINT16;
+			if (strt == "uint32")
+				return CIMTYPE_UINT32;
+			if (strt == "uint64")
+				return CIMTYPE_UINT64;
+			break;
+		default:
+			break;
 	}
-	return dtype;
+	String msg("Unknown python type encountered in PyDataType2PG: ");
+	msg.append(strt);
+	THROW_CONV_EXC(msg);
+	return CIMTYPE_STRING;	// Never hit here
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -527,34 +1035,34 @@ PGPyConv::PGVal2Py(const CIMValue& pegval)
 			break;
 		}
 		case CIMTYPE_REAL32:
-			ro = _numericPG2Py<Real32>("(d)", "Real32", pegval);
+			ro = _numericPG2Py<Real32>(g_pywbem.real32, "Real32", pegval);
 			break;
 		case CIMTYPE_REAL64:
-			ro = _numericPG2Py<Real64>("(d)", "Real64", pegval);
+			ro = _numericPG2Py<Real64>(g_pywbem.real64, "Real64", pegval);
 			break;
 		case CIMTYPE_SINT8:
-			ro = _numericPG2Py<Sint8>("(b)", "Sint8", pegval);
+			ro = _numericPG2Py<Sint8>(g_pywbem.sint8, "Sint8", pegval);
 			break;
 		case CIMTYPE_SINT16:
-			ro = _numericPG2Py<Sint16>("(h)", "Sint16", pegval);
+			ro = _numericPG2Py<Sint16>(g_pywbem.sint16, "Sint16", pegval);
 			break;
 		case CIMTYPE_SINT32:
-			ro = _numericPG2Py<Sint32>("(i)", "Sint32", pegval);
+			ro = _numericPG2Py<Sint32>(g_pywbem.sint32, "Sint32", pegval);
 			break;
 		case CIMTYPE_SINT64:
-			ro = _numericPG2Py<Sint64>("(L)", "Sint64", pegval);
+			ro = _numericPG2Py<Sint64>(g_pywbem.sint64, "Sint64", pegval);
 			break;
 		case CIMTYPE_UINT8:
-			ro = _numericPG2Py<Uint8>("(k)", "Uint8", pegval);
+			ro = _numericPG2Py<Uint8>(g_pywbem.uint8, "Uint8", pegval);
 			break;
 		case CIMTYPE_UINT16:
-			ro = _numericPG2Py<Uint16>("(k)", "Uint16", pegval);
+			ro = _numericPG2Py<Uint16>(g_pywbem.uint16, "Uint16", pegval);
 			break;
 		case CIMTYPE_UINT32:
-			ro = _numericPG2Py<Uint32>("(k)", "Uint32", pegval);
+			ro = _numericPG2Py<Uint32>(g_pywbem.uint32, "Uint32", pegval);
 			break;
 		case CIMTYPE_UINT64:
-			ro = _numericPG2Py<Uint64>("(K)", "Uint64", pegval);
+			ro = _numericPG2Py<Uint64>(g_pywbem.uint64, "Uint64", pegval);
 			break;
 		case CIMTYPE_STRING:
 		{
@@ -594,7 +1102,7 @@ PGPyConv::PGRef2Py(const CIMObjectPath& cop)
 	const Array<CIMKeyBinding>& kra = cop.getKeyBindings();
 	if (kra.size() == 0)	// No keys. Assume classpath
 	{
-		Py::Callable pyfunc = g_modpywbem.getAttr("CIMClassName");
+		Py::Callable pyfunc = g_pywbem.cimClassName;
 		Py::Tuple args(3);
 		args[0] = Py::String(cop.getClassName().getString());
 		args[1] = Py::String(cop.getHost());
@@ -602,7 +1110,7 @@ PGPyConv::PGRef2Py(const CIMObjectPath& cop)
 		return pyfunc.apply(args);
 	}
 
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMInstanceName");
+	Py::Callable pyfunc = g_pywbem.cimInstanceName;
 	Py::Dict dict;
 	for (Uint32 i = 0; i < kra.size(); i++)
 	{
@@ -644,7 +1152,7 @@ PGPyConv::PGRef2Py(const CIMObjectPath& cop)
 Py::Object
 PGPyConv::PGInst2Py(const CIMConstInstance& ci, const String& nsArg)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMInstance");
+	Py::Callable pyfunc = g_pywbem.cimInstance;
 	Py::Tuple pyarg(4);
 	pyarg[0] = Py::String(ci.getClassName().getString());
 	pyarg[1] = _makePropDict(ci);
@@ -665,7 +1173,7 @@ PGPyConv::PGInst2Py(const CIMConstInstance& ci, const String& nsArg)
 Py::Object
 PGPyConv::PGQual2Py(const CIMConstQualifier& qual)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMQualifier");
+	Py::Callable pyfunc = g_pywbem.cimQualifier;
 	Py::Tuple pyarg(8);
 	pyarg[0] = Py::String(qual.getName().getString());
 	Py::Object qval;
@@ -694,7 +1202,7 @@ PGPyConv::PGQual2Py(const CIMConstQualifier& qual)
 Py::Object
 PGPyConv::PGQualType2Py(const CIMConstQualifierDecl& qualt)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMQualifierDeclaration");
+	Py::Callable pyfunc = g_pywbem.cimQualifierDecl;
 	Py::Tuple pyarg(10);
 	pyarg[0] = Py::String(qualt.getName().getString());		// name
 	Py::Object pqvalt;
@@ -772,7 +1280,7 @@ PGPyConv::PGQualType2Py(const CIMConstQualifierDecl& qualt)
 Py::Object
 PGPyConv::PGCIMParam2Py(const CIMConstParameter& param)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMParameter");
+	Py::Callable pyfunc = g_pywbem.cimParameter;
 	Py::Tuple pyarg(6);
 	pyarg[0] = Py::String(param.getName().getString());	// name
 	pyarg[1] = Py::String(PGDataType2Py(param.getType()));
@@ -792,7 +1300,7 @@ PGPyConv::PGCIMParam2Py(const CIMConstParameter& param)
 Py::Object
 PGPyConv::PGMeth2Py(const CIMConstMethod& meth)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMMethod");
+	Py::Callable pyfunc = g_pywbem.cimMethod;
 	Py::Tuple pyarg(6);
 	pyarg[0] = Py::String(meth.getName().getString());
 	pyarg[1] = Py::String(PGDataType2Py(meth.getType()));
@@ -815,7 +1323,7 @@ PGPyConv::PGMeth2Py(const CIMConstMethod& meth)
 Py::Object
 PGPyConv::PGProperty2Py(const CIMConstProperty& prop)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMProperty");
+	Py::Callable pyfunc = g_pywbem.cimProperty;
 	Py::Tuple pyarg(10);
 	pyarg[0] = Py::String(prop.getName().getString());	// name
 	CIMValue cv = prop.getValue();
@@ -870,7 +1378,7 @@ PGPyConv::PGProperty2Py(const CIMConstProperty& prop)
 Py::Object
 PGPyConv::PGClass2Py(const CIMConstClass& cls)
 {
-	Py::Callable pyfunc = g_modpywbem.getAttr("CIMClass");
+	Py::Callable pyfunc = g_pywbem.cimClass;
 	Py::Tuple pyarg(5);
 	pyarg[0] = Py::String(cls.getClassName().getString());
 	pyarg[1] = _makePropDict(cls);
@@ -890,6 +1398,60 @@ PGPyConv::PGClass2Py(const CIMConstClass& cls)
 	return pyfunc.apply(pyarg);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+Py::Object
+PGPyConv::PGCachedClass2Py(
+	const CIMConstClass& cls,
+	const String& ns,
+	Uint32 classGen)
+{
+	if (cls.isUninitialized() || !ns.size() || !classGen)
+	{
+		return PGClass2Py(cls);
+	}
+
+	Uint32 gen = g_schemaGen[_nsCacheKey(ns)];
+	_CachedClass& entry = g_classCache[_classCacheKey(ns,
+		cls.getClassName().getString())];
+	if (entry.pycls.isNone() || entry.generation != gen
+		|| entry.classGen != classGen)
+	{
+		entry.pycls = PGClass2Py(cls);
+		entry.generation = gen;
+		entry.classGen = classGen;
+	}
+	// The caller gets its own dictionaries, so adding or removing
+	// properties, methods or qualifiers doesn't show in other requests
+	return Py::Callable(entry.pycls.getAttr("copy")).apply(Py::Tuple());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void
+PGPyConv::invalidateClassCache(
+	const String& ns)
+{
+	// A change to any class can affect its subclasses, so the whole
+	// namespace is invalidated by bumping its schema generation.
+	String nskey = _nsCacheKey(ns);
+	++g_schemaGen[nskey];
+	nskey.append(":");
+	Uint32 len = nskey.size();
+	_ClassCacheMap::iterator it = g_classCache.begin();
+	while (it != g_classCache.end())
+	{
+		if (it->first.size() > len && it->first.subString(0, len) == nskey)
+		{
+			g_classCache.erase(it++);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // STATIC
 CIMInstance
@@ -926,9 +1488,9 @@ PGPyConv::PyRef2PG(
 	}
 	Py::Mapping kb = pycop.getAttr("keybindings");
 	Py::List items = kb.items();
-	Py::Object pciName = g_modpywbem.getAttr("CIMInstanceName");
-	Py::Object pciClassName = g_modpywbem.getAttr("CIMClassName");
-	Py::Object pciDateTime = g_modpywbem.getAttr("CIMDateTime");
+	const Py::Object& pciName = g_pywbem.cimInstanceName;
+	const Py::Object& pciClassName = g_pywbem.cimClassName;
+	const Py::Object& pciDateTime = g_pywbem.cimDateTime;
 
 	Array<CIMKeyBinding> ckbs;
 	for (int i = 0; i < int(items.length()); i++)
@@ -947,12 +1509,12 @@ PGPyConv::PyRef2PG(
 
 		if (pkval.isBool())
 		{
-			cv = PyVal2PG("boolean", pkval);
+			cv = PyVal2PG(CIMTYPE_BOOLEAN, pkval);
 			ckbs.append(CIMKeyBinding(kname, cv.toString(), CIMKeyBinding::BOOLEAN));
 		}
 		else if (pkval.isString())
 		{
-			cv = PyVal2PG("string", pkval);
+			cv = PyVal2PG(CIMTYPE_STRING, pkval);
 			ckbs.append(CIMKeyBinding(kname, cv.toString(), CIMKeyBinding::STRING));
 		}
 		else if (pkval.isInt())
@@ -985,18 +1547,18 @@ PGPyConv::PyRef2PG(
 		}
 		else if (pkval.isFloat())
 		{
-			cv = PyVal2PG("real64", pkval); 
+			cv = PyVal2PG(CIMTYPE_REAL64, pkval); 
 			ckbs.append(CIMKeyBinding(kname, cv.toString(), CIMKeyBinding::NUMERIC));
 		}
 		else if (pkval.isInstanceOf(pciClassName)
 			|| pkval.isInstanceOf(pciName))
 		{
-			cv = PyVal2PG("reference", pkval); 
+			cv = PyVal2PG(CIMTYPE_REFERENCE, pkval); 
 			ckbs.append(CIMKeyBinding(kname, cv.toString(), CIMKeyBinding::REFERENCE));
 		}
 		else if (pkval.isInstanceOf(pciDateTime))
 		{
-			cv = PyVal2PG("datetime", pkval);
+			cv = PyVal2PG(CIMTYPE_DATETIME, pkval);
 			ckbs.append(CIMKeyBinding(kname, cv.toString(), CIMKeyBinding::STRING));
 		}
 		else
@@ -1013,263 +1575,222 @@ PGPyConv::PyRef2PG(
 }
 
 //////////////////////////////////////////////////////////////////////////////
-// STATIC
-CIMValue
-PGPyConv::PyVal2PG(
-	const String& type,
-	const Py::Object& pyval)
+PGPyKeyTupleConv::PGPyKeyTupleConv(
+	const CIMConstClass& cls,
+	const String& ns)
+	: m_className(cls.getClassName())
+	, m_ns(ns)
+	, m_keyNames()
+	, m_keyTypes()
 {
-	if (type == "boolean")
+	cls.getKeyNames(m_keyNames);
+	for (Uint32 i = 0; i < m_keyNames.size(); i++)
 	{
-		if (pyval.isList())
-		{
-			Py::List bl(pyval);
-			Uint32 sz = bl.length();
-			Array<Boolean> bra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-					bra[i] = bl[i].isTrue();
-			}
-			return CIMValue(bra);
-		}
-		return CIMValue(Boolean(pyval.isTrue()));
+		m_keyTypes.append(
+			cls.getProperty(cls.findProperty(m_keyNames[i])).getType());
 	}
-	else if (type == "string")
-	{
-		if (pyval.isList())
-		{
-			Py::List sl(pyval);
-			Uint32 sz = sl.length();
-			Array<String> sra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				sra[i] = Py::String(sl[i]).as_peg_string();
-			}
-			return CIMValue(sra);
-		}
-		return CIMValue(Py::String(pyval).as_peg_string());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+CIMObjectPath
+PGPyKeyTupleConv::PyKeyTuple2PG(
+	const Py::Object& pykeys) const
+{
+	PyObject* tup = pykeys.ptr();
+	Uint32 sz = Uint32(PyTuple_GET_SIZE(tup));
+	if (sz != m_keyNames.size())
+	{
+		String msg("Key tuple for class ");
+		msg.append(m_className.getString());
+		msg.append(" has ");
+		msg.append(_int2Str(sz));
+		msg.append(" values. Expected ");
+		msg.append(_int2Str(m_keyNames.size()));
+		THROW_CONV_EXC(msg);
 	}
-	else if (type == "uint8")
+
+	Array<CIMKeyBinding> ckbs;
+	ckbs.reserveCapacity(sz);
+	for (Uint32 i = 0; i < sz; i++)
 	{
-		if (pyval.isList())
-		{
-			Py::List il(pyval);
-			Uint32 sz = il.length();
-			Array<Uint8> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Uint8(Py::Int(il[i]).asUnsignedLong());
-			}
-			return CIMValue(nra);
-		}
-		return CIMValue(Uint8(Py::Int(pyval).asUnsignedLong()));
-	}
-	else if (type == "sint8")
-    {
-		if (pyval.isList())
-		{
-			Py::List il(pyval);
-			Uint32 sz = il.length();
-			Array<Sint8> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Sint8(Py::Int(il[i]).asLong());
-			}
-			return CIMValue(nra);
-		}
-		return CIMValue(Sint8(Py::Int(pyval).asLong()));
-	}
-	else if (type == "uint16")
-    {
-		if (pyval.isList())
-		{
-			Py::List il(pyval);
-			Uint32 sz = il.length();
-			Array<Uint16> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Uint16(Py::Int(il[i]).asUnsignedLong());
-			}
-			return CIMValue(nra);
-		}
-		return CIMValue(Uint16(Py::Int(pyval).asUnsignedLong()));
-	}
-	else if (type == "sint16")
-    {
-		if (pyval.isList())
+		PyObject* pkval = PyTuple_GET_ITEM(tup, i);
+		if (pkval == Py_None)
 		{
-			Py::List il(pyval);
-			Uint32 sz = il.length();
-			Array<Sint16> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Sint16(Py::Int(il[i]).asLong());
-			}
-			return CIMValue(nra);
+			String msg("Key tuple for class ");
+			msg.append(m_className.getString());
+			msg.append(" has no value for key ");
+			msg.append(m_keyNames[i].getString());
+			THROW_CONV_EXC(msg);
 		}
-		return CIMValue(Sint16(Py::Int(pyval).asLong()));
+		ckbs.append(CIMKeyBinding(m_keyNames[i],
+			PGPyConv::PyVal2PG(m_keyTypes[i], Py::Object(pkval))));
 	}
-	else if (type == "uint32")
-    {
-		if (pyval.isList())
-		{
-			Py::List il(pyval);
-			Uint32 sz = il.length();
-			Array<Uint32> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Uint32(Py::Int(il[i]).asUnsignedLong());
-			}
-			return CIMValue(nra);
-		}
-		return CIMValue(Uint32(Py::Int(pyval).asUnsignedLong()));
+	return CIMObjectPath("", m_ns, m_className, ckbs);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+CIMValue
+PGPyConv::PyVal2PG(
+	const String& type,
+	const Py::Object& pyval)
+{
+	return PyVal2PG(PyDataType2PG(type), pyval);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+CIMValue
+PGPyConv::PyVal2PG(
+	CIMType type,
+	const Py::Object& pyval)
+{
+	return _getPy2PGFunc(type)(pyval);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+bool
+PGPyConv::isPyInstBatch(
+	const Py::Object& pyobj)
+{
+	// (classname, [propname, ...], [column, ...])
+	PyObject* pyob = pyobj.ptr();
+	if (!PyTuple_Check(pyob) || PyTuple_GET_SIZE(pyob) != 3)
+	{
+		return false;
 	}
-	else if (type == "sint32")
-    {
-		if (pyval.isList())
-		{
-			Py::List il(pyval);
-			Uint32 sz = il.length();
-			Array<Sint32> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Sint32(Py::Int(il[i]).asLong());
-			}
-			return CIMValue(nra);
-		}
-		return CIMValue(Sint32(Py::Int(pyval).asLong()));
+	PyObject* pycn = PyTuple_GET_ITEM(pyob, 0);
+	return (PyString_Check(pycn) || PyUnicode_Check(pycn))
+		&& _isPySequence(Py::Object(PyTuple_GET_ITEM(pyob, 1)))
+		&& _isPySequence(Py::Object(PyTuple_GET_ITEM(pyob, 2)));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+CIMName
+PGPyConv::getPyInstBatchClassName(
+	const Py::Object& pybatch)
+{
+	Py::Tuple batch(pybatch);
+	return CIMName(Py::String(batch[0]).as_peg_string());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+Array<CIMInstance>
+PGPyConv::PyInstBatch2PG(
+	const Py::Object& pybatch,
+	const CIMConstClass& cls,
+	const String& ns)
+{
+	Py::Tuple batch(pybatch);
+	CIMName className(Py::String(batch[0]).as_peg_string());
+	Py::Sequence pynames(batch[1]);
+	Py::Sequence pycols(batch[2]);
+	Uint32 ncols = Uint32(pynames.length());
+	if (Uint32(pycols.length()) != ncols)
+	{
+		String msg("Instance batch for class ");
+		msg.append(className.getString());
+		msg.append(" has ");
+		msg.append(_int2Str(ncols));
+		msg.append(" property names but ");
+		msg.append(_int2Str(pycols.length()));
+		msg.append(" columns");
+		THROW_CONV_EXC(msg);
 	}
-	else if (type == "uint64")
-    {
-		if (pyval.isList())
+
+	// Resolve the type and converter of every column once, using the
+	// property definitions from the class
+	Array<CIMName> names;
+	Array<CIMType> types;
+	Array<Boolean> isArray;
+	Array<CIMName> refClasses;
+	Array<_Py2PGFunc> convs;
+	std::vector<Py::Object> cols(ncols);
+	Uint32 nrows = 0;
+	for (Uint32 c = 0; c < ncols; c++)
+	{
+		String name = Py::String(pynames[c]).as_peg_string();
+		Uint32 pos = cls.findProperty(name);
+		if (pos == PEG_NOT_FOUND)
 		{
-			Py::List il(pyval);
-			Uint32 sz = il.length();
-			Array<Uint64> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Uint64(Py::LongLong(il[i]).asUnsignedLongLong());
-			}
-			return CIMValue(nra);
+			String msg("Instance batch property ");
+			msg.append(name);
+			msg.append(" is not defined in class ");
+			msg.append(cls.getClassName().getString());
+			THROW_CONV_EXC(msg);
 		}
-		return CIMValue(Uint64(Py::LongLong(pyval).asUnsignedLongLong()));
-	}
-	else if (type == "sint64")
-    {
-		if (pyval.isList())
+		CIMConstProperty cp = cls.getProperty(pos);
+		CIMType valType = cp.getType();
+		_Py2PGFunc conv = 0;
+		if (valType == CIMTYPE_STRING
+			&& cp.findQualifier("EmbeddedInstance") != PEG_NOT_FOUND)
 		{
-			Py::List il(pyval);
-			Uint32 sz = il.length();
-			Array<Sint64> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Sint64(Py::LongLong(il[i]).asLongLong());
-			}
-			return CIMValue(nra);
+			valType = CIMTYPE_INSTANCE;
+			conv = _getPy2PGFunc(valType);
 		}
-		return CIMValue(Sint64(Py::LongLong(pyval).asLongLong()));
-	}
-	else if (type == "real32")
-	{
-		if (pyval.isList())
+		else if (valType == CIMTYPE_STRING
+			&& cp.findQualifier("EmbeddedObject") != PEG_NOT_FOUND)
 		{
-			Py::List fl(pyval);
-			Uint32 sz = fl.length();
-			Array<Real32> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Real32(Py::Float(fl[i]).as_double());
-			}
-			return CIMValue(nra);
+			valType = CIMTYPE_INSTANCE;
+			conv = &_py2PGEmbeddedObject;
 		}
-		return CIMValue(Real32(Py::Float(pyval).as_double()));
-	}
-	else if (type == "real64")
-	{
-		if (pyval.isList())
+		else
 		{
-			Py::List fl(pyval);
-			Uint32 sz = fl.length();
-			Array<Real64> nra(sz);
-			for(Uint32 i = 0; i < sz; i++)
-			{
-				nra[i] = Real64(Py::Float(fl[i]).as_double());
-			}
-			return CIMValue(nra);
+			conv = _getPy2PGFunc(valType);
 		}
-		return CIMValue(Real64(Py::Float(pyval).as_double()));
-	}
-	else if (type == "char16")
-    {
-		THROW_CONV_EXC("Unable to convert to PG from python char16");
-    }
-	else if (type == "datetime")
-    {
-		if (pyval.isList())
+		names.append(cp.getName());
+		types.append(valType);
+		isArray.append(cp.isArray());
+		refClasses.append(cp.getReferenceClassName());
+		convs.append(conv);
+
+		PyObject* col = PySequence_Fast(Py::Object(pycols[c]).ptr(),
+			"Instance batch columns must be sequences");
+		if (!col)
 		{
-			Py::List dl(pyval);
-			Uint32 sz = dl.length();
-			Array<CIMDateTime> ra(sz); 
-			for (Uint32 i = 0; i < sz; ++i)
-			{
-				ra[i] = _convertPyDateTime(dl[i]);
-			}
-			return CIMValue(ra);
+			throw Py::Exception();
 		}
-		return CIMValue(_convertPyDateTime(pyval)); 
-    }
-	else if (type == "reference")
-    {
-		if (pyval.isList())
+		cols[c] = Py::Object(col, true);
+		Uint32 len = Uint32(PySequence_Fast_GET_SIZE(col));
+		if (c == 0)
 		{
-			Py::List dl(pyval);
-			Uint32 sz = dl.length();
-			Array<CIMObjectPath> ra(sz); 
-			for (Uint32 i = 0; i < sz; ++i)
-			{
-				ra[i] = PyRef2PG(dl[i]);
-			}
-			return CIMValue(ra);
+			nrows = len;
 		}
-		return CIMValue(PyRef2PG(pyval)); 
-    }
-	else if (type == "instance")
-	{
-		if (pyval.isList())
+		else if (len != nrows)
 		{
-			Py::List dl(pyval);
-			Uint32 sz = dl.length();
-			Array<CIMInstance> ra(sz); 
-			for (Uint32 i = 0; i < sz; ++i)
-			{
-				ra[i] = PyInst2PG(dl[i]);
-			}
-			return CIMValue(ra);
+			String msg("Instance batch column ");
+			msg.append(name);
+			msg.append(" has ");
+			msg.append(_int2Str(len));
+			msg.append(" values. Expected ");
+			msg.append(_int2Str(nrows));
+			THROW_CONV_EXC(msg);
 		}
-		return CIMValue(PyInst2PG(pyval));
 	}
-	/* Pegasus doesn't support embedded class?
-	else if (type == "class")
+
+	Array<CIMInstance> rv;
+	rv.reserveCapacity(nrows);
+	for (Uint32 r = 0; r < nrows; r++)
 	{
-		if (pyval.isList())
+		CIMInstance inst(className);
+		for (Uint32 c = 0; c < ncols; c++)
 		{
-			Py::List dl(pyval);
-			Uint32 sz = dl.length();
-			Array<CIMClass> ra(sz); 
-			for (Uint32 i = 0; i < sz; ++i)
-			{
-				ra[i] = PyClass2PG(dl[i]);
-			}
-			return CIMValue(ra);
+			PyObject* cell = PySequence_Fast_GET_ITEM(cols[c].ptr(), r);
+			CIMValue cv = (cell != Py_None)
+				? convs[c](Py::Object(cell))
+				: CIMValue(types[c], isArray[c]);
+			inst.addProperty(CIMProperty(names[c], cv, 0,
+				(types[c] == CIMTYPE_REFERENCE) ? refClasses[c] : CIMName()));
 		}
-		return CIMValue(PyClass2PG(pyval));
+		CIMObjectPath cop = inst.buildPath(cls);
+		cop.setNameSpace(ns);
+		inst.setPath(cop);
+		rv.append(inst);
 	}
-	*/
-
-	String msg("Unknown python data type for conversion: ");
-	msg.append(type);
-	THROW_CONV_EXC(msg);
-    return CIMValue(); 	// Never hit here
+	return rv;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1356,14 +1877,14 @@ PGPyConv::PyProperty2PG(const Py::Object& pyprop)
 		arraySize = Uint32(Py::Int(wko));
 	}
 	CIMValue theValue;
+	CIMType dt = PyDataType2PG(strtype);
 	wko = pyprop.getAttr("value");
 	if (!wko.isNone())
 	{
-		theValue = PyVal2PG(strtype, wko);
+		theValue = PyVal2PG(dt, wko);
 	}
 	else
 	{
-		CIMType dt = PGPyConv::PyDataType2PG(strtype);
 		wko = pyprop.getAttr("is_array");
 		bool isArray = wko.isTrue();
 		theValue = CIMValue(dt, isArray, arraySize);
@@ -51,6 +51,18 @@ public:
 	static Py::Object PGVal2Py(const CIMValue& val);	
 
 	static Py::Object PGClass2Py(const CIMConstClass& cls);
+	// Same as PGClass2Py, but copies the class from a per namespace cache.
+	// classGen is the generation PythonProviderManager::_getClass returned
+	// with cls; the entry is made again when it changes. 0 bypasses the
+	// cache. The copy has its own properties, methods and qualifiers
+	// dictionaries, but shares the objects in them with the cache; those
+	// must be treated as read-only.
+	// Must be called with the GIL held.
+	static Py::Object PGCachedClass2Py(const CIMConstClass& cls,
+		const String& ns, Uint32 classGen);
+	// Drop all cached classes for the given namespace. Must be called with
+	// the GIL held.
+	static void invalidateClassCache(const String& ns);
 	static Py::Object PGProperty2Py(const CIMConstProperty& prop);
 	static Py::Object PGQual2Py(const CIMConstQualifier& qual);
 	static Py::Object PGQualType2Py(const CIMConstQualifierDecl& qualt);
@@ -63,8 +75,19 @@ public:
 	static CIMInstance PyInst2PG(const Py::Object& pyci, const String& ns=String());
 	static CIMObjectPath PyRef2PG(const Py::Object& pycop, const String& ns=String());
 	static CIMValue PyVal2PG(const String& type, const Py::Object& pyval);
+	static CIMValue PyVal2PG(CIMType type, const Py::Object& pyval);
 	static CIMValue PyVal2PG(const Py::Tuple& tuple);
 
+	// Columnar instance batches returned by providers:
+	// (classname, [propname, ...], [column, ...]) where every column holds
+	// the values of one property for all instances. Property types are
+	// taken from the given class. Only tuples of a string and two lists
+	// or tuples are taken for batches.
+	static bool isPyInstBatch(const Py::Object& pyobj);
+	static CIMName getPyInstBatchClassName(const Py::Object& pybatch);
+	static Array<CIMInstance> PyInstBatch2PG(const Py::Object& pybatch,
+		const CIMConstClass& cls, const String& ns=String());
+
 	static CIMClass PyClass2PG(const Py::Object& pycls);
 	static CIMProperty PyProperty2PG(const Py::Object& pyprop);
 	static CIMQualifier PyQual2PG(const Py::Object& pyqual);
@@ -73,13 +96,38 @@ public:
 	static CIMMethod PyMeth2PG(const Py::Object& pymeth);
 	static CIMType PyDataType2PG(const String& strt);
 
+	// Resolves and pins the pywbem types used by the converters
 	static void setPyWbemMod(const Py::Module& mod);
+	// Re-pins the pywbem types if the pywbem module has been reloaded.
+	// Must be called with the GIL held.
+	static void checkPyWbemMod();
 
 private:
 	static Py::Object RefValPG2Py(const CIMValue& owval);
 	static Py::Object DateTimeValPG2Py(const CIMValue& owval);
 };
 
+// Converts plain tuples of key values, given in the order of the key
+// properties of a class, into object paths of that class. The key
+// properties and their types are looked up once at construction.
+class PGPyKeyTupleConv
+{
+public:
+	PGPyKeyTupleConv(const CIMConstClass& cls, const String& ns);
+
+	static bool isPyKeyTuple(const Py::Object& pyobj)
+	{
+		return PyTuple_Check(pyobj.ptr());
+	}
+	CIMObjectPath PyKeyTuple2PG(const Py::Object& pykeys) const;
+
+private:
+	CIMName m_className;
+	CIMNamespaceName m_ns;
+	Array<CIMName> m_keyNames;
+	Array<CIMType> m_keyTypes;
+};
+
 }	// End of namespace PythonProvIFC
 
 #endif	// PG_PYCONVERTER_HPP_GUARD
@@ -25,6 +25,7 @@ PyExtensions::PyExtensions()
 	: Py::ExtensionModule<PyExtensions>("pycimmb")
 {
 	PyCIMOMHandle::doInit();
+	PyCIMObjectIterator::doInit();
 	PyLogger::doInit();
 	PyProviderEnvironment::doInit();
 
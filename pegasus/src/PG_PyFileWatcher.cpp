@@ -0,0 +1,403 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc. 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*   
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*   
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#include "PG_PyFileWatcher.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+PEGASUS_USING_PEGASUS;
+
+namespace PythonProvIFC
+{
+
+namespace
+{
+
+#ifdef HAVE_SYS_INOTIFY_H
+// Events that may leave a file in the directory with a new modification
+// time. Partial writes are left out, the file is looked at when it is
+// closed.
+const Uint32 WATCH_MASK = IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE
+	| IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF
+	| IN_MOVE_SELF;
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+void
+_splitPath(
+	const String& fileName,
+	String& dirName,
+	String& baseName)
+{
+	Uint32 idx = fileName.reverseFind('/');
+	if (idx == PEG_NOT_FOUND)
+	{
+		dirName = ".";
+		baseName = fileName;
+	}
+	else
+	{
+		dirName = (idx == 0) ? String("/") : fileName.subString(0, idx);
+		baseName = fileName.subString(idx + 1);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+_setNonBlocking(
+	int fd)
+{
+	::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+	::fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+PyFileWatch::PyFileWatch(
+	const String& fileName,
+	bool polled)
+	: m_fileName(fileName)
+	, m_polled(polled ? 1 : 0)
+	, m_dirty(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatch::setPolled()
+{
+	__sync_lock_test_and_set(&m_polled, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatch::markDirty()
+{
+	__sync_lock_test_and_set(&m_dirty, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatch::clearDirty()
+{
+	__sync_lock_release(&m_dirty);
+	__sync_synchronize();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyFileWatcher::PyFileWatcher()
+	: m_fd(-1)
+	, m_dirs()
+	, m_dirWds()
+	, m_polled()
+	, m_thread()
+	, m_started(false)
+{
+	m_wakeFds[0] = -1;
+	m_wakeFds[1] = -1;
+	pthread_mutex_init(&m_guard, 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyFileWatcher::~PyFileWatcher()
+{
+	shutdown();
+	pthread_mutex_destroy(&m_guard);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+PyFileWatcher::start()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	m_fd = ::inotify_init();
+	if (m_fd < 0)
+	{
+		return false;
+	}
+	if (::pipe(m_wakeFds) < 0)
+	{
+		::close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+	_setNonBlocking(m_fd);
+	_setNonBlocking(m_wakeFds[0]);
+	_setNonBlocking(m_wakeFds[1]);
+	m_started = (pthread_create(&m_thread, 0, threadMain, this) == 0);
+	if (!m_started)
+	{
+		shutdown();
+	}
+	return m_started;
+#else
+	return false;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatcher::shutdown()
+{
+	if (m_started)
+	{
+		char c = 0;
+		while (::write(m_wakeFds[1], &c, 1) < 0 && errno == EINTR)
+		{
+		}
+		pthread_join(m_thread, 0);
+		m_started = false;
+	}
+
+	pthread_mutex_lock(&m_guard);
+	if (m_fd >= 0)
+	{
+		::close(m_fd);
+		::close(m_wakeFds[0]);
+		::close(m_wakeFds[1]);
+		m_fd = -1;
+		m_wakeFds[0] = -1;
+		m_wakeFds[1] = -1;
+	}
+	// Watches still held fall back to polling
+	DirWatchMap::iterator dit = m_dirs.begin();
+	while (dit != m_dirs.end())
+	{
+		dropDirWatch(dit++);
+	}
+	pthread_mutex_unlock(&m_guard);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+PyFileWatchRef
+PyFileWatcher::watch(
+	const String& fileName)
+{
+	pthread_mutex_lock(&m_guard);
+	std::map<String, PyFileWatchRef>::iterator pit = m_polled.find(fileName);
+	if (pit != m_polled.end())
+	{
+		PyFileWatchRef fileWatch = pit->second;
+		pthread_mutex_unlock(&m_guard);
+		return fileWatch;
+	}
+
+	PyFileWatchRef fileWatch;
+#ifdef HAVE_SYS_INOTIFY_H
+	if (m_fd >= 0 && fileName.size())
+	{
+		String dirName, baseName;
+		_splitPath(fileName, dirName, baseName);
+		int wd = -1;
+		std::map<String, int>::iterator dit = m_dirWds.find(dirName);
+		if (dit != m_dirWds.end())
+		{
+			wd = dit->second;
+		}
+		else
+		{
+			wd = ::inotify_add_watch(m_fd,
+				(const char*)dirName.getCString(), WATCH_MASK);
+			if (wd >= 0)
+			{
+				m_dirWds[dirName] = wd;
+				m_dirs[wd].dirName = dirName;
+			}
+		}
+		if (wd >= 0)
+		{
+			DirWatch& dirWatch = m_dirs[wd];
+			std::map<String, PyFileWatchRef>::iterator fit =
+				dirWatch.files.find(baseName);
+			if (fit != dirWatch.files.end())
+			{
+				fileWatch = fit->second;
+			}
+			else
+			{
+				fileWatch = PyFileWatchRef(new PyFileWatch(fileName, false));
+				dirWatch.files[baseName] = fileWatch;
+			}
+		}
+	}
+#endif
+	if (!fileWatch)
+	{
+		// Out of watches, or no such directory
+		fileWatch = PyFileWatchRef(new PyFileWatch(fileName, true));
+		m_polled[fileName] = fileWatch;
+	}
+	pthread_mutex_unlock(&m_guard);
+	return fileWatch;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// STATIC
+void*
+PyFileWatcher::threadMain(
+	void* arg)
+{
+	static_cast<PyFileWatcher*>(arg)->run();
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatcher::run()
+{
+	for (;;)
+	{
+		struct pollfd pfds[2];
+		pfds[0].fd = m_fd;
+		pfds[0].events = POLLIN;
+		pfds[0].revents = 0;
+		pfds[1].fd = m_wakeFds[0];
+		pfds[1].events = POLLIN;
+		pfds[1].revents = 0;
+		int rc = ::poll(pfds, 2, -1);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			// Changes can't be seen any more
+			markAllDirty();
+			return;
+		}
+		if (pfds[1].revents)
+		{
+			break;
+		}
+		if (pfds[0].revents)
+		{
+			handleEvents();
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatcher::handleEvents()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	for (;;)
+	{
+		ssize_t len = ::read(m_fd, buf, sizeof(buf));
+		if (len < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (len <= 0)
+		{
+			// EAGAIN once all events are read
+			break;
+		}
+
+		bool overflow = false;
+		pthread_mutex_lock(&m_guard);
+		for (char* p = buf; p < buf + len; )
+		{
+			const struct inotify_event* ev =
+				reinterpret_cast<const struct inotify_event*>(p);
+			p += sizeof(struct inotify_event) + ev->len;
+
+			if (ev->mask & IN_Q_OVERFLOW)
+			{
+				overflow = true;
+				continue;
+			}
+			DirWatchMap::iterator dit = m_dirs.find(ev->wd);
+			if (dit == m_dirs.end())
+			{
+				continue;
+			}
+			if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+			{
+				dropDirWatch(dit);
+				continue;
+			}
+			if (ev->len == 0)
+			{
+				continue;
+			}
+			std::map<String, PyFileWatchRef>::iterator fit =
+				dit->second.files.find(String(ev->name));
+			if (fit != dit->second.files.end())
+			{
+				fit->second->markDirty();
+			}
+		}
+		pthread_mutex_unlock(&m_guard);
+		if (overflow)
+		{
+			markAllDirty();
+		}
+	}
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+PyFileWatcher::markAllDirty()
+{
+	pthread_mutex_lock(&m_guard);
+	for (DirWatchMap::iterator dit = m_dirs.begin(); dit != m_dirs.end();
+		++dit)
+	{
+		for (std::map<String, PyFileWatchRef>::iterator fit =
+			dit->second.files.begin(); fit != dit->second.files.end(); ++fit)
+		{
+			fit->second->markDirty();
+		}
+	}
+	pthread_mutex_unlock(&m_guard);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Called with m_guard held. The files of the directory become polled, and
+// dirty, since their changes can't be seen any more.
+void
+PyFileWatcher::dropDirWatch(
+	DirWatchMap::iterator dit)
+{
+	for (std::map<String, PyFileWatchRef>::iterator fit =
+		dit->second.files.begin(); fit != dit->second.files.end(); ++fit)
+	{
+		fit->second->setPolled();
+		fit->second->markDirty();
+		m_polled[fit->second->getFileName()] = fit->second;
+	}
+#ifdef HAVE_SYS_INOTIFY_H
+	if (m_fd >= 0)
+	{
+		::inotify_rm_watch(m_fd, dit->first);
+	}
+#endif
+	m_dirWds.erase(dit->second.dirName);
+	m_dirs.erase(dit);
+}
+
+}	// End of namespace PythonProvIFC
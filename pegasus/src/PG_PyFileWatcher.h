@@ -0,0 +1,111 @@
+/*****************************************************************************
+* (C) Copyright 2007 Novell, Inc. 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*   
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*   
+* You should have received a copy of the GNU Lesser General Public
+* License along with this program; if not, write to the Free Software
+* Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*****************************************************************************/
+#ifndef PG_PYFILEWATCHER_H_GUARD_
+#define PG_PYFILEWATCHER_H_GUARD_
+
+#include <Pegasus/Common/Config.h>
+#include <Pegasus/Common/String.h>
+
+#include "Reference.h"
+
+#include <pthread.h>
+#include <map>
+
+PEGASUS_USING_PEGASUS;
+
+namespace PythonProvIFC
+{
+
+//////////////////////////////////////////////////////////////////////////////
+// The change flag of a watched provider file. It is set by the watcher
+// thread and read by request threads without locking. A polled watch has
+// no watcher behind it; its owner has to stat the file itself.
+class PyFileWatch
+{
+public:
+	PyFileWatch(const String& fileName, bool polled);
+
+	const String& getFileName() const { return m_fileName; }
+	bool isPolled() const { return m_polled != 0; }
+	void setPolled();
+
+	// True if the file may have changed since clearDirty
+	bool isDirty() const { return m_dirty != 0; }
+	void markDirty();
+	void clearDirty();
+
+private:
+	String m_fileName;
+	volatile int m_polled;
+	volatile int m_dirty;
+};
+typedef Reference<PyFileWatch> PyFileWatchRef;
+
+//////////////////////////////////////////////////////////////////////////////
+// Watches provider files with inotify on the directories they are in, so
+// requests don't have to stat them. There is one watch per file, shared
+// by all loaded versions of a provider, and it is kept until the watcher
+// is shut down. Renames and writes into a directory mark the watches of
+// the files they touch dirty. If the events overflow, all watches are
+// marked dirty.
+// Where inotify isn't available, or a directory can't be watched, watch
+// returns a polled watch. Watches of a directory that is removed or moved
+// become polled.
+class PyFileWatcher
+{
+public:
+	PyFileWatcher();
+	~PyFileWatcher();
+
+	// Returns false if inotify isn't available. Watches are polled then.
+	bool start();
+	void shutdown();
+
+	PyFileWatchRef watch(const String& fileName);
+
+private:
+	PyFileWatcher(const PyFileWatcher&);
+	PyFileWatcher& operator=(const PyFileWatcher&);
+
+	static void* threadMain(void* arg);
+	void run();
+	void handleEvents();
+	void markAllDirty();
+
+	struct DirWatch
+	{
+		String dirName;
+		std::map<String, PyFileWatchRef> files;	// Watches by base name
+	};
+	typedef std::map<int, DirWatch> DirWatchMap;
+
+	void dropDirWatch(DirWatchMap::iterator dit);
+
+	int m_fd;							// inotify descriptor, -1 if none
+	int m_wakeFds[2];					// Wakes the thread up to stop it
+	DirWatchMap m_dirs;					// By watch descriptor
+	std::map<String, int> m_dirWds;		// Watch descriptors by directory
+	std::map<String, PyFileWatchRef> m_polled;	// Unwatchable files
+	pthread_mutex_t m_guard;
+	pthread_t m_thread;
+	bool m_started;
+};
+
+}	// End of namespace PythonProvIFC
+
+#endif	// PG_PYFILEWATCHER_H_GUARD_
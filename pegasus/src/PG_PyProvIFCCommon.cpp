@@ -121,5 +121,26 @@ LogPyException(
 	return LogPyException(thrownEx, fileName, lineno, etype, evalue, true);
 }
 
+namespace
+{
+
+Uint32 g_resultBatchSize = PYPROV_DEFAULT_RESULT_BATCH_SIZE;
+
+}	// End of unnamed namespace
+
+//////////////////////////////////////////////////////////////////////////////
+void
+setResultBatchSize(
+	Uint32 batchSize)
+{
+	g_resultBatchSize = (batchSize) ? batchSize : 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+Uint32
+getResultBatchSize()
+{
+	return g_resultBatchSize;
+}
 
 }	// End of namespace PythonProvIFC
@@ -21,6 +21,7 @@
 #include "PyCxxObjects.h"
 #include <Pegasus/Common/Exception.h>
 #include <Pegasus/Common/CIMInstance.h>
+#include <Pegasus/Common/TimeValue.h>
 
 // All of the functions in a python provider that can be called by the
 // provider interface will have a prefix that matches PYFUNC_PREFIX.
@@ -29,6 +30,14 @@
 #define PYFUNC_PREFIX "MI_"
 #define PYSYSTEM_ID "PyProviderManager"
 #define PYPROV_SECS_TO_LIVE 900		// 15 Minutes
+// Pegasus does not notify provider managers of schema changes, so cached
+// classes are refetched after PYPROV_CLASS_CACHE_SECS_TO_LIVE seconds.
+#define PYPROV_CLASS_CACHE_SIZE 256
+#define PYPROV_CLASS_CACHE_SECS_TO_LIVE 300	// 5 Minutes
+// Number of provider results collected with the GIL held before they are
+// delivered to the response handler with the GIL released, unless the
+// pythonResultBatchSize config property says otherwise.
+#define PYPROV_DEFAULT_RESULT_BATCH_SIZE 100
 
 using namespace Pegasus;
 
@@ -87,6 +96,103 @@ LogPyException(
 	int lineno);
 
 
+// GIL hold time of the batched delivery of provider results. Every batch
+// accounts for the time from taking (or re-taking) the GIL until it is
+// released to hand the batch to Pegasus.
+struct PyResultBatchStats
+{
+	PyResultBatchStats()
+		: batches(0)
+		, items(0)
+		, holdUsecs(0)
+		, maxHoldUsecs(0)
+	{
+	}
+
+	Uint64 batches;
+	Uint64 items;
+	Uint64 holdUsecs;
+	Uint64 maxHoldUsecs;
+};
+
+// Set once by the provider manager before any provider runs
+void
+setResultBatchSize(
+	Uint32 batchSize);
+
+Uint32
+getResultBatchSize();
+
+// Collects the results converted while the GIL is held and delivers them
+// to the response handler in batches of getResultBatchSize() with the GIL
+// released, so the CIMOM side processing of results doesn't stall other
+// python providers. The batches are accounted in the stats of the provider
+// producing them. Must be used with the GIL held. flush() must be called
+// once the provider is done producing results.
+template <typename T, typename H>
+class PyResultBatcher
+{
+public:
+	PyResultBatcher(H& handler, PyResultBatchStats& stats)
+		: m_handler(handler)
+		, m_stats(stats)
+		, m_batchSize(getResultBatchSize())
+		, m_batch()
+		, m_holdStart(TimeValue::getCurrentTime().toMicroseconds())
+	{
+		m_batch.reserveCapacity(m_batchSize);
+	}
+
+	void add(const T& item)
+	{
+		m_batch.append(item);
+		if (m_batch.size() >= m_batchSize)
+		{
+			flush();
+		}
+	}
+
+	void add(const Array<T>& items)
+	{
+		for (Uint32 i = 0; i < items.size(); i++)
+		{
+			add(items[i]);
+		}
+	}
+
+	void flush()
+	{
+		if (!m_batch.size())
+		{
+			return;
+		}
+
+		Uint64 holdUsecs =
+			TimeValue::getCurrentTime().toMicroseconds() - m_holdStart;
+		m_stats.batches++;
+		m_stats.items += m_batch.size();
+		m_stats.holdUsecs += holdUsecs;
+		if (holdUsecs > m_stats.maxHoldUsecs)
+		{
+			m_stats.maxHoldUsecs = holdUsecs;
+		}
+
+		PYCXX_ALLOW_THREADS
+		m_handler.deliver(m_batch);
+		PYCXX_END_ALLOW_THREADS
+
+		m_batch.clear();
+		m_holdStart = TimeValue::getCurrentTime().toMicroseconds();
+	}
+
+private:
+	H& m_handler;
+	PyResultBatchStats& m_stats;
+	Uint32 m_batchSize;
+	Array<T> m_batch;
+	Uint64 m_holdStart;
+};
+
 #define HANDLECATCH(handler, provref, operation) \
 	catch(Py::Exception& e) \
 	{ \
@@ -98,16 +98,19 @@ AssociatorProviderHandler::handleAssociatorsRequest(
 					"an iterable object", provref->m_path));
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		PyResultBatcher<CIMInstance, AssociatorsResponseHandler>
+			batcher(handler, provref->m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
 			wko = Py::Object(item, true); 
-			handler.deliver(PGPyConv::PyInst2PG(wko, request->nameSpace.getString()));
+			batcher.add(PGPyConv::PyInst2PG(wko, request->nameSpace.getString()));
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 		handler.complete();
 	}
 	HANDLECATCH(handler, provref, getInstance)
@@ -169,16 +172,19 @@ AssociatorProviderHandler::handleAssociatorNamesRequest(
 					"an iterable object", provref->m_path));
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		PyResultBatcher<CIMObjectPath, AssociatorNamesResponseHandler>
+			batcher(handler, provref->m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
 			wko = Py::Object(item, true); 
-			handler.deliver(PGPyConv::PyRef2PG(wko, request->nameSpace.getString()));
+			batcher.add(PGPyConv::PyRef2PG(wko, request->nameSpace.getString()));
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 		handler.complete();
 	}
 	HANDLECATCH(handler, provref, getInstance)
@@ -239,16 +245,19 @@ AssociatorProviderHandler::handleReferencesRequest(
 					"an iterable object", provref->m_path));
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		PyResultBatcher<CIMInstance, ReferencesResponseHandler>
+			batcher(handler, provref->m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
 			wko = Py::Object(item, true); 
-			handler.deliver(PGPyConv::PyInst2PG(wko, request->nameSpace.getString()));
+			batcher.add(PGPyConv::PyInst2PG(wko, request->nameSpace.getString()));
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 		handler.complete();
 	}
 	HANDLECATCH(handler, provref, getInstance)
@@ -307,16 +316,19 @@ AssociatorProviderHandler::handleReferenceNamesRequest(
 					"an iterable object", provref->m_path));
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		PyResultBatcher<CIMObjectPath, ReferenceNamesResponseHandler>
+			batcher(handler, provref->m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
 			wko = Py::Object(item, true); 
-			handler.deliver(PGPyConv::PyRef2PG(wko, request->nameSpace.getString()));
+			batcher.add(PGPyConv::PyRef2PG(wko, request->nameSpace.getString()));
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 		handler.complete();
 	}
 	HANDLECATCH(handler, provref, getInstance)
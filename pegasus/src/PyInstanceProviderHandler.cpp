@@ -73,10 +73,9 @@ InstanceProviderHandler::handleGetInstanceRequest(
 		request->instanceName.getClassName(),
 		request->instanceName.getKeyBindings());
 
-	CIMOMHandle chdl;
-	CIMClass cc = chdl.getClass(ctx, request->nameSpace,
-		request->instanceName.getClassName(), false, true, true,
-		CIMPropertyList());
+	Uint32 classGen = 0;
+	CIMClass cc = pmgr->_getClass(ctx, request->nameSpace,
+		request->instanceName.getClassName(), &classGen);
 
 	Py::GILGuard gg;	// Acquire Python's GIL
 	try
@@ -89,7 +88,8 @@ InstanceProviderHandler::handleGetInstanceRequest(
 			pmgr, provref->m_path);
 		args[1] = PGPyConv::PGRef2Py(objectPath);
 		args[2] = getPyPropertyList(request->propertyList);
-		args[3] = PGPyConv::PGClass2Py(cc);
+		args[3] = PGPyConv::PGCachedClass2Py(cc,
+			request->nameSpace.getString(), classGen);
 		Py::Object pyci = pyfunc.apply(args);
 		if (pyci.isNone())
 		{
@@ -133,9 +133,9 @@ InstanceProviderHandler::handleEnumerateInstancesRequest(
 
 	OperationContext ctx(request->operationContext);
 
-	CIMOMHandle chdl;
-	CIMClass cc = chdl.getClass(ctx, request->nameSpace,
-		request->className, false, true, true, CIMPropertyList());
+	Uint32 classGen = 0;
+	CIMClass cc = pmgr->_getClass(ctx, request->nameSpace,
+		request->className, &classGen);
 
 	Py::GILGuard gg;	// Acquire Python's GIL
 	try
@@ -147,8 +147,10 @@ InstanceProviderHandler::handleEnumerateInstancesRequest(
 			pmgr, provref->m_path);
 		args[1] = Py::String(request->nameSpace.getString());							// Namespace
 		args[2] = getPyPropertyList(request->propertyList);
-		args[3] = PGPyConv::PGClass2Py(cc);
-		args[4] = PGPyConv::PGClass2Py(cc);
+		args[3] = PGPyConv::PGCachedClass2Py(cc,
+			request->nameSpace.getString(), classGen);
+		// Requested class and model class are the same here
+		args[4] = args[3];
 
 		StatProviderTimeMeasurement providerTime(response.get());
 
@@ -164,16 +166,39 @@ InstanceProviderHandler::handleEnumerateInstancesRequest(
 					"an iterable object", provref->m_path));
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		PyResultBatcher<CIMInstance, EnumerateInstancesResponseHandler>
+			batcher(handler, provref->m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
 			wko = Py::Object(item, true);
-			handler.deliver(PGPyConv::PyInst2PG(wko, request->nameSpace.getString()));
+			if (PGPyConv::isPyInstBatch(wko))
+			{
+				// Columnar batch of instances
+				CIMName batchClassName =
+					PGPyConv::getPyInstBatchClassName(wko);
+				CIMClass bcc = cc;
+				if (!batchClassName.equal(cc.getClassName()))
+				{
+					PYCXX_ALLOW_THREADS
+					bcc = pmgr->_getClass(ctx, request->nameSpace,
+						batchClassName);
+					PYCXX_END_ALLOW_THREADS
+				}
+				batcher.add(PGPyConv::PyInstBatch2PG(wko, bcc,
+					request->nameSpace.getString()));
+			}
+			else
+			{
+				batcher.add(PGPyConv::PyInst2PG(wko,
+					request->nameSpace.getString()));
+			}
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 		handler.complete();
 	}
 	HANDLECATCH(handler, provref, enumInstances)
@@ -207,9 +232,9 @@ InstanceProviderHandler::handleEnumerateInstanceNamesRequest(
 
 	OperationContext ctx(request->operationContext);
 
-	CIMOMHandle chdl;
-	CIMClass cc = chdl.getClass(ctx, request->nameSpace,
-		request->className, false, true, true, CIMPropertyList());
+	Uint32 classGen = 0;
+	CIMClass cc = pmgr->_getClass(ctx, request->nameSpace,
+		request->className, &classGen);
 
 	Py::GILGuard gg;	// Acquire Python's GIL
 	try
@@ -223,7 +248,8 @@ InstanceProviderHandler::handleEnumerateInstanceNamesRequest(
 		args[0] = PyProviderEnvironment::newObject(request->operationContext,
 			pmgr, provref->m_path);
 		args[1] = Py::String(request->nameSpace.getString());							// Namespace
-		args[2] = PGPyConv::PGClass2Py(cc);
+		args[2] = PGPyConv::PGCachedClass2Py(cc,
+			request->nameSpace.getString(), classGen);
 
 		Py::Object wko = pyfunc.apply(args);
 		PyObject* ito = PyObject_GetIter(wko.ptr());
@@ -235,16 +261,30 @@ InstanceProviderHandler::handleEnumerateInstanceNamesRequest(
 					"an iterable object", provref->m_path));
 		}
 		Py::Object iterable(ito, true);	// Let Py::Object manage the ref count
+		// Providers may yield plain tuples of key values in the order
+		// of the key properties of the class instead of CIMInstanceNames
+		PGPyKeyTupleConv keyConv(cc, request->nameSpace.getString());
+		PyResultBatcher<CIMObjectPath, EnumerateInstanceNamesResponseHandler>
+			batcher(handler, provref->m_resultBatchStats);
 		PyObject* item;
 		while((item = PyIter_Next(ito)))
 		{
 			wko = Py::Object(item, true);
-			handler.deliver(PGPyConv::PyRef2PG(wko, request->nameSpace.getString()));
+			if (PGPyKeyTupleConv::isPyKeyTuple(wko))
+			{
+				batcher.add(keyConv.PyKeyTuple2PG(wko));
+			}
+			else
+			{
+				batcher.add(PGPyConv::PyRef2PG(wko,
+					request->nameSpace.getString()));
+			}
 		}
 		if (PyErr_Occurred())
 		{
 			throw Py::Exception();
 		}
+		batcher.flush();
 		handler.complete();
 	}
 	HANDLECATCH(handler, provref, enumInstanceNames)
@@ -278,10 +318,8 @@ InstanceProviderHandler::handleCreateInstanceRequest(
 
 	OperationContext ctx(request->operationContext);
 
-	CIMOMHandle chdl;
-	CIMClass cc = chdl.getClass(ctx, request->nameSpace,
-		request->newInstance.getClassName(), false, true, true,
-		CIMPropertyList());
+	CIMClass cc = pmgr->_getClass(ctx, request->nameSpace,
+		request->newInstance.getClassName());
 	CIMObjectPath objectPath = request->newInstance.buildPath(cc);
 	objectPath.setNameSpace(request->nameSpace);
 	objectPath.setHost(System::getHostName());
@@ -338,16 +376,16 @@ InstanceProviderHandler::handleModifyInstanceRequest(
 		request, response.get(), pmgr->_responseChunkCallback);
 
 	OperationContext ctx(request->operationContext);
-	CIMOMHandle chdl;
-	CIMClass cc = chdl.getClass(ctx, request->nameSpace,
-		request->modifiedInstance.getClassName(), false, true, true,
-		CIMPropertyList());
+	Uint32 classGen = 0;
+	CIMClass cc = pmgr->_getClass(ctx, request->nameSpace,
+		request->modifiedInstance.getClassName(), &classGen);
 
 	CIMObjectPath objectPath = request->modifiedInstance.buildPath(cc);
 	objectPath.setNameSpace(request->nameSpace);
 	objectPath.setHost(System::getHostName());
 	request->modifiedInstance.setPath(objectPath);
 
+	CIMOMHandle chdl;
 	CIMInstance prevInstance = chdl.getInstance(ctx,
 		request->nameSpace, objectPath, false, true, true, CIMPropertyList());
 	prevInstance.setPath(objectPath);
@@ -367,7 +405,7 @@ InstanceProviderHandler::handleModifyInstanceRequest(
 		args[1] = PGPyConv::PGInst2Py(request->modifiedInstance, ns);
 		args[2] = PGPyConv::PGInst2Py(prevInstance, ns);
 		args[3] = getPyPropertyList(request->propertyList);
-		args[4] = PGPyConv::PGClass2Py(cc);
+		args[4] = PGPyConv::PGCachedClass2Py(cc, ns, classGen);
 		pyfunc.apply(args);
 		handler.complete();
 	}
@@ -454,10 +492,9 @@ InstanceProviderHandler::handleGetPropertyRequest(
         request->instanceName.getClassName(),
         request->instanceName.getKeyBindings());
 
-	CIMOMHandle chdl;
-	CIMClass cc = chdl.getClass(ctx, request->nameSpace,
-		request->instanceName.getClassName(), false, true, true,
-		CIMPropertyList());
+	Uint32 classGen = 0;
+	CIMClass cc = pmgr->_getClass(ctx, request->nameSpace,
+		request->instanceName.getClassName(), &classGen);
 
 	Py::GILGuard gg;	// Acquire Python's GIL
 	try
@@ -470,7 +507,8 @@ InstanceProviderHandler::handleGetPropertyRequest(
 			pmgr, provref->m_path);
 		args[1] = PGPyConv::PGRef2Py(objectPath);
 		args[2] = Py::None();
-		args[3] = PGPyConv::PGClass2Py(cc);
+		args[3] = PGPyConv::PGCachedClass2Py(cc,
+			request->nameSpace.getString(), classGen);
 		Py::Object pyci = pyfunc.apply(args);
 		if (pyci.isNone())
 		{
@@ -537,11 +575,11 @@ InstanceProviderHandler::handleSetPropertyRequest(
         request->propertyName, request->newValue));
     instance.setPath(objectPath);
 
-	CIMOMHandle chdl;
-	CIMClass cc = chdl.getClass(ctx, request->nameSpace,
-		request->instanceName.getClassName(), false, true, true,
-		CIMPropertyList());
+	Uint32 classGen = 0;
+	CIMClass cc = pmgr->_getClass(ctx, request->nameSpace,
+		request->instanceName.getClassName(), &classGen);
 
+	CIMOMHandle chdl;
 	CIMInstance prevInstance = chdl.getInstance(ctx,
 		request->nameSpace, objectPath, false, true, true, CIMPropertyList());
 	prevInstance.setPath(objectPath);
@@ -563,7 +601,7 @@ InstanceProviderHandler::handleSetPropertyRequest(
 		Py::List pList;
 		pList.append(Py::String(request->propertyName.getString()));
 		args[3] = pList;
-		args[4] = PGPyConv::PGClass2Py(cc);
+		args[4] = PGPyConv::PGCachedClass2Py(cc, ns, classGen);
 		pyfunc.apply(args);
 		handler.complete();
 	}
@@ -71,10 +71,8 @@ MethodProviderHandler::handleInvokeMethodRequest(
 		request->instanceName.getClassName(),
 		request->instanceName.getKeyBindings());
 
-	CIMOMHandle chdl;
-	CIMClass cc = chdl.getClass(ctx, request->nameSpace,
-		request->instanceName.getClassName(), false, true, true,
-		CIMPropertyList());
+	CIMClass cc = pmgr->_getClass(ctx, request->nameSpace,
+		request->instanceName.getClassName());
 
 	Py::GILGuard gg;	// Acquire Python's GIL
 	try
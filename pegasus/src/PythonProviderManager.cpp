@@ -35,6 +35,7 @@
 #include <Pegasus/Common/Constants.h>
 #include <Pegasus/Common/FileSystem.h>
 #include <Pegasus/Common/Mutex.h>
+#include <Pegasus/Common/Formatter.h>
 #include <Pegasus/Config/ConfigManager.h>
 #include <Pegasus/Provider/CIMOMHandleQueryContext.h>
 #include <Pegasus/ProviderManager2/CIMOMHandleContext.h>
@@ -44,6 +45,11 @@
 #include "PG_PyConverter.h"
 
 #include <unistd.h>
+#include <pthread.h>
+
+#include <cstdlib>
+#include <deque>
+#include <vector>
 
 PEGASUS_USING_STD;
 PEGASUS_USING_PEGASUS;
@@ -56,6 +62,9 @@ namespace
 
 Py::Object g_cimexobj;
 Mutex g_provGuard;
+Mutex g_classCacheGuard;
+
+volatile int g_moduleLoads = 0;
 
 void TRACE(const char* fmt, ...)
 {
@@ -65,6 +74,65 @@ void TRACE(const char* fmt, ...)
 	va_end(ap);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// ProviderProxy imports a provider module under its path. Python 2 runs a
+// module that is already in sys.modules again in the same module object,
+// so a new version of a changed provider would replace the code of the
+// version still serving. The path is cleared before a load, the module is
+// moved to a name of its own after it, and that name is dropped when the
+// version is shut down. Must be called with the GIL held.
+void
+clearProviderModule(
+	const String& provPath)
+{
+	Py::Dict modules(PyImport_GetModuleDict());
+	if (modules.hasKey(provPath))
+	{
+		// Left behind by a load that failed
+		modules.delItem(provPath);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+String
+keepProviderModule(
+	const String& provPath)
+{
+	Py::Dict modules(PyImport_GetModuleDict());
+	if (!modules.hasKey(provPath))
+	{
+		return String();
+	}
+	String name = Formatter::format("$0#$1", provPath,
+		Uint32(__sync_add_and_fetch(&g_moduleLoads, 1)));
+	modules.setItem(name, modules.getItem(provPath));
+	modules.delItem(provPath);
+	return name;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+dropProviderModule(
+	const String& moduleName)
+{
+	if (moduleName.size() == 0)
+	{
+		return;
+	}
+	try
+	{
+		Py::Dict modules(PyImport_GetModuleDict());
+		if (modules.hasKey(moduleName))
+		{
+			modules.delItem(moduleName);
+		}
+	}
+	catch(Py::Exception& e)
+	{
+		e.clear();
+	}
+}
+
 }	// End of unnamed namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -244,6 +312,294 @@ processPyException(
 	return tb;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Shuts down the providers unloadIdleProviders detached from the provider
+// map, once the requests still holding them are done. Python's shutdown
+// code runs on this thread, so g_provGuard isn't held meanwhile. The
+// queue is looked at again when a request drops its provider reference,
+// see referencesDropped.
+class PyProviderReaper
+{
+public:
+	PyProviderReaper(PythonProviderManager* pm)
+		: m_pm(pm)
+		, m_queue()
+		, m_reloads()
+		, m_thread()
+		, m_started(false)
+		, m_stopping(false)
+		, m_detaching(0)
+		, m_queued(0)
+		, m_recheck(false)
+		, m_stats()
+	{
+		pthread_mutex_init(&m_guard, 0);
+		pthread_cond_init(&m_cond, 0);
+	}
+
+	~PyProviderReaper()
+	{
+		stop();
+		pthread_cond_destroy(&m_cond);
+		pthread_mutex_destroy(&m_guard);
+	}
+
+	void start()
+	{
+		m_started = (pthread_create(&m_thread, 0, threadMain, this) == 0);
+	}
+
+	// Stops the thread and shuts down the providers still queued. Must be
+	// called without the GIL held.
+	void stop()
+	{
+		if (m_started)
+		{
+			pthread_mutex_lock(&m_guard);
+			m_stopping = true;
+			pthread_cond_signal(&m_cond);
+			pthread_mutex_unlock(&m_guard);
+			pthread_join(m_thread, 0);
+			m_started = false;
+		}
+		reapAll();
+	}
+
+	// Queues a detached provider. Without a thread it is shut down right
+	// away.
+	void add(const PyProviderRef& provref)
+	{
+		Entry entry;
+		entry.provref = provref;
+		entry.detachedAt = TimeValue::getCurrentTime().toMicroseconds();
+		pthread_mutex_lock(&m_guard);
+		m_queue.push_back(entry);
+		_queueChanged();
+		m_recheck = true;
+		pthread_cond_signal(&m_cond);
+		pthread_mutex_unlock(&m_guard);
+		if (!m_started)
+		{
+			reapAll();
+		}
+	}
+
+	// Shuts down all queued providers, whether requests still hold them
+	// or not. Must be called without the GIL held.
+	void reapAll()
+	{
+		std::vector<Entry> ready;
+		pthread_mutex_lock(&m_guard);
+		ready.assign(m_queue.begin(), m_queue.end());
+		m_queue.clear();
+		_queueChanged();
+		pthread_mutex_unlock(&m_guard);
+		reap(ready);
+	}
+
+	// Called after provider references were dropped. Wakes the thread if
+	// providers are waiting for their requests, without locking otherwise.
+	void referencesDropped()
+	{
+		if (m_queued.get())
+		{
+			pthread_mutex_lock(&m_guard);
+			m_recheck = true;
+			pthread_cond_signal(&m_cond);
+			pthread_mutex_unlock(&m_guard);
+		}
+	}
+
+	// Has a new version of a changed provider loaded on the thread. Returns
+	// false without a thread.
+	bool reload(const String& provPath, const OperationContext& opctx)
+	{
+		pthread_mutex_lock(&m_guard);
+		bool queued = m_started && !m_stopping;
+		if (queued)
+		{
+			m_reloads.push_back(ReloadJob(provPath, opctx));
+			pthread_cond_signal(&m_cond);
+		}
+		pthread_mutex_unlock(&m_guard);
+		return queued;
+	}
+
+	void reloadDone(Uint64 usecs, bool succeeded)
+	{
+		pthread_mutex_lock(&m_guard);
+		if (succeeded)
+		{
+			m_stats.reloads++;
+			m_stats.totalReloadUsecs += usecs;
+			if (usecs > m_stats.maxReloadUsecs)
+			{
+				m_stats.maxReloadUsecs = usecs;
+			}
+		}
+		else
+		{
+			m_stats.failedReloads++;
+		}
+		pthread_mutex_unlock(&m_guard);
+	}
+
+	// Brackets a detach pass of unloadIdleProviders
+	void detachStarted()
+	{
+		m_detaching.inc();
+	}
+
+	void detachDone(Uint64 usecs)
+	{
+		m_detaching.dec();
+		pthread_mutex_lock(&m_guard);
+		m_stats.detachPasses++;
+		m_stats.totalDetachUsecs += usecs;
+		if (usecs > m_stats.maxDetachUsecs)
+		{
+			m_stats.maxDetachUsecs = usecs;
+		}
+		pthread_mutex_unlock(&m_guard);
+	}
+
+	// Called by a request before it locks g_provGuard. Counts it if a
+	// detach pass holds the lock.
+	void requestStarting()
+	{
+		if (m_detaching.get())
+		{
+			pthread_mutex_lock(&m_guard);
+			m_stats.blockedRequests++;
+			pthread_mutex_unlock(&m_guard);
+		}
+	}
+
+	PyUnloadStats getStats()
+	{
+		pthread_mutex_lock(&m_guard);
+		PyUnloadStats stats = m_stats;
+		pthread_mutex_unlock(&m_guard);
+		return stats;
+	}
+
+private:
+	struct Entry
+	{
+		PyProviderRef provref;
+		Uint64 detachedAt;
+	};
+
+	struct ReloadJob
+	{
+		ReloadJob(const String& path, const OperationContext& ctx)
+			: provPath(path)
+			, opctx(ctx)
+		{
+		}
+
+		String provPath;
+		OperationContext opctx;
+	};
+
+	static void* threadMain(void* arg)
+	{
+		static_cast<PyProviderReaper*>(arg)->run();
+		return 0;
+	}
+
+	void run()
+	{
+		pthread_mutex_lock(&m_guard);
+		while (!m_stopping)
+		{
+			if (!m_reloads.empty())
+			{
+				ReloadJob job = m_reloads.front();
+				m_reloads.pop_front();
+				pthread_mutex_unlock(&m_guard);
+				m_pm->_reloadProvider(job.provPath, job.opctx);
+				pthread_mutex_lock(&m_guard);
+				continue;
+			}
+			if (m_queue.empty() || !m_recheck)
+			{
+				pthread_cond_wait(&m_cond, &m_guard);
+				continue;
+			}
+			// Cleared before the look, so references dropped during it
+			// are looked at again
+			m_recheck = false;
+
+			// Take the providers only the queue refers to any more
+			std::vector<Entry> ready;
+			std::deque<Entry>::iterator it = m_queue.begin();
+			while (it != m_queue.end())
+			{
+				if (it->provref.getRefCount() == 1)
+				{
+					ready.push_back(*it);
+					it = m_queue.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+			_queueChanged();
+
+			if (!ready.empty())
+			{
+				pthread_mutex_unlock(&m_guard);
+				reap(ready);
+				pthread_mutex_lock(&m_guard);
+			}
+		}
+		pthread_mutex_unlock(&m_guard);
+	}
+
+	void reap(std::vector<Entry>& ready)
+	{
+		for (size_t i = 0; i < ready.size(); i++)
+		{
+			m_pm->_shutdownProvider(ready[i].provref, OperationContext());
+			Uint64 latency = TimeValue::getCurrentTime().toMicroseconds()
+				- ready[i].detachedAt;
+			pthread_mutex_lock(&m_guard);
+			m_stats.unloads++;
+			m_stats.totalLatencyUsecs += latency;
+			if (latency > m_stats.maxLatencyUsecs)
+			{
+				m_stats.maxLatencyUsecs = latency;
+			}
+			pthread_mutex_unlock(&m_guard);
+		}
+		// The python provider objects are released with the GIL held
+		Py::GILGuard gg;
+		ready.clear();
+	}
+
+	// Called with m_guard held
+	void _queueChanged()
+	{
+		m_queued.set(m_queue.size());
+		m_stats.pending = m_queue.size();
+	}
+
+	PythonProviderManager* m_pm;
+	std::deque<Entry> m_queue;
+	std::deque<ReloadJob> m_reloads;	// Dropped when the thread stops
+	pthread_mutex_t m_guard;
+	pthread_cond_t m_cond;
+	pthread_t m_thread;
+	bool m_started;
+	bool m_stopping;
+	AtomicInt m_detaching;
+	AtomicInt m_queued;					// Size of m_queue
+	bool m_recheck;						// References were dropped. m_guard
+	PyUnloadStats m_stats;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 PythonProviderManager::PythonProviderManager()
 	: ProviderManager()
@@ -251,6 +607,12 @@ PythonProviderManager::PythonProviderManager()
 	, m_pPyExtensions(0)
 	, m_provs()
 	, m_mainPyThreadState(0)
+	, m_classCache()
+	, m_classCacheHits(0)
+	, m_classCacheMisses(0)
+	, m_classLoads(0)
+	, m_reaper(0)
+	, m_fileWatcher(0)
 {
     PEG_METHOD_ENTER(
         TRC_PROVIDERMANAGER,
@@ -262,9 +624,54 @@ PythonProviderManager::PythonProviderManager()
         "-- Python Provider Manager activated");
 
 	_initPython();
+	_getResultBatchSize();
+	m_fileWatcher = new PyFileWatcher;
+	if (!m_fileWatcher->start())
+	{
+		PEG_TRACE_CSTRING(TRC_PROVIDERMANAGER, Tracer::LEVEL2,
+			"-- Python provider files can't be watched. They are checked "
+			"for changes on every request");
+	}
+	m_reaper = new PyProviderReaper(this);
+	m_reaper->start();
     PEG_METHOD_EXIT();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void PythonProviderManager::_getResultBatchSize()
+{
+	String batchSize;
+	try
+	{
+		batchSize = ConfigManager::getInstance()->getCurrentValue(
+			"pythonResultBatchSize");
+	}
+	catch (...)
+	{
+		// Not a config property of this CIMOM build
+	}
+	Uint32 size = PYPROV_DEFAULT_RESULT_BATCH_SIZE;
+	if (batchSize.size())
+	{
+		CString cstr = batchSize.getCString();
+		char* endp = 0;
+		unsigned long val = ::strtoul((const char*)cstr, &endp, 10);
+		if (*endp || !val || val > 0xFFFFFFFFUL)
+		{
+			Logger::put(Logger::ERROR_LOG, PYSYSTEM_ID, Logger::WARNING,
+				"Invalid pythonResultBatchSize $0. Using $1", batchSize,
+				PYPROV_DEFAULT_RESULT_BATCH_SIZE);
+		}
+		else
+		{
+			size = Uint32(val);
+		}
+	}
+	setResultBatchSize(size);
+	PEG_TRACE_STRING(TRC_PROVIDERMANAGER, Tracer::LEVEL2,
+		Formatter::format("-- Python provider result batch size: $0", size));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 PythonProviderManager::~PythonProviderManager()
 {
@@ -272,6 +679,10 @@ PythonProviderManager::~PythonProviderManager()
         TRC_PROVIDERMANAGER,
         "PythonProviderManager::~PythonProviderManager()");
 	_stopAllProviders();
+	delete m_reaper;
+	m_reaper = 0;
+	delete m_fileWatcher;
+	m_fileWatcher = 0;
 	PyEval_AcquireLock();
 	PyThreadState_Swap(m_mainPyThreadState);
 	Py_Finalize();
@@ -283,7 +694,8 @@ PythonProviderManager::~PythonProviderManager()
 Py::Object
 PythonProviderManager::_loadProvider(
 	const String& provPath,
-	const OperationContext& opctx)
+	const OperationContext& opctx,
+	String& moduleName)
 {
 	PEG_METHOD_ENTER(
         TRC_PROVIDERMANAGER,
@@ -294,7 +706,11 @@ PythonProviderManager::_loadProvider(
 	args[0] = PyProviderEnvironment::newObject(opctx, this, provPath);
 	args[1] = Py::String(provPath);
 	// Construct a CIMProvider python object
+	clearProviderModule(provPath);
 	Py::Object pyprov = ctor.apply(args);
+	moduleName = keepProviderModule(provPath);
+	// Loading the provider may have reloaded pywbem
+	PGPyConv::checkPyWbemMod();
     PEG_METHOD_EXIT();
 	return pyprov;
 }
@@ -314,6 +730,16 @@ PythonProviderManager::_stopAllProviders()
 		it++;
 	}
 	m_provs.clear();
+	if (m_reaper)
+	{
+		// Providers detached by unloadIdleProviders
+		m_reaper->reapAll();
+	}
+	{
+		// Providers started again see the classes as they are now
+		AutoMutex am(g_classCacheGuard);
+		m_classCache.clear();
+	}
     PEG_METHOD_EXIT();
 }
 
@@ -331,13 +757,13 @@ PythonProviderManager::_shutdownProvider(
 	try
 	{
 		Py::Callable pyfunc = getFunction(provref->m_pyprov, "shutdown", false);
-		if (!pyfunc.isCallable())
+		if (pyfunc.isCallable())
 		{
-			return;
+			Py::Tuple args(1);
+			args[0] = PyProviderEnvironment::newObject(opctx, this,
+				provref->m_path);
+			pyfunc.apply(args);
 		}
-		Py::Tuple args(1);
-		args[0] = PyProviderEnvironment::newObject(opctx, this, provref->m_path);
-	    pyfunc.apply(args);
 	}
 	catch(Py::Exception& e)
 	{
@@ -354,6 +780,7 @@ PythonProviderManager::_shutdownProvider(
 			"Caught unknown exception invoking 'shutdown' provider $0.",
 			provref->m_path);
 	}
+	dropProviderModule(provref->m_moduleName);
     PEG_METHOD_EXIT();
 }
 
@@ -367,34 +794,60 @@ PythonProviderManager::_path2PyProviderRef(
         TRC_PROVIDERMANAGER,
         "PythonProviderManager::_path2PyProviderRef()");
  
+	m_reaper->requestStarting();
 	AutoMutex am(g_provGuard);
 	ProviderMap::iterator it = m_provs.find(provPath);
 	if (it != m_provs.end())
 	{
 		it->second->m_lastAccessTime = ::time(NULL);
+		if (it->second->m_canUnload == false)
+		{
+			// can't reload... return it
+			return it->second;
+		}
+		// The file is only looked at when the watcher saw something
+		// happen to it, or can't watch it
+		PyFileWatchRef& fileWatch = it->second->m_fileWatch;
+		if (fileWatch && !fileWatch->isPolled() && !fileWatch->isDirty())
+		{
+			return it->second;
+		}
+		if (fileWatch)
+		{
+			fileWatch->clearDirty();
+		}
         time_t curModTime = getModTime(provPath);
-        if ((curModTime <= it->second->m_fileModTime)
-            || (it->second->m_canUnload == false) )
+        if (curModTime <= it->second->m_fileModTime)
         {
-            // not modified, or can't reload... return it
+            // not modified... return it
             return it->second;
         }
-        else
-        {
-            //cleanup for reload on fall-thru
-			_shutdownProvider(it->second, opctx);
-            m_provs.erase(it);
-        }
+		// The loaded version keeps serving while the new one is loaded
+		if (it->second->m_reloading || m_reaper->reload(provPath, opctx))
+		{
+			it->second->m_reloading = true;
+			return it->second;
+		}
+		// No reaper thread. Cleanup for reload on fall-thru
+		_shutdownProvider(it->second, opctx);
+		m_provs.erase(it);
 	}
 
 	Py::GILGuard gg;	// Acquire python's GIL
 
 	try
 	{
+		// Watched, then stat'ed before the load, so a change made
+		// during the load is seen later
+		PyFileWatchRef fileWatch = m_fileWatcher->watch(provPath);
+		time_t modTime = getModTime(provPath);
 		// Get the Python proxy provider
-		Py::Object pyprov = _loadProvider(provPath, opctx);
+		String moduleName;
+		Py::Object pyprov = _loadProvider(provPath, opctx, moduleName);
 		PyProviderRef entry(new PyProviderRep(provPath, pyprov));
-		entry->m_fileModTime = getModTime(provPath);
+		entry->m_moduleName = moduleName;
+		entry->m_fileModTime = modTime;
+		entry->m_fileWatch = fileWatch;
 		entry->m_lastAccessTime = ::time(NULL);
 		m_provs[provPath] = entry;
 		return entry;
@@ -415,6 +868,104 @@ PythonProviderManager::_path2PyProviderRef(
 	return PyProviderRef(0);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Runs on the reaper thread. Loads a new version of a changed provider
+// while requests keep getting the loaded one, then switches the provider
+// map to it and hands the old version to the reaper, which shuts it down
+// once the requests using it are done. If the load fails the old version
+// keeps serving until the file changes again. A provider unloaded before
+// the job runs isn't loaded again. One unloaded during the load leaves
+// the new version to the reaper, which shuts it down without it having
+// served a request.
+void
+PythonProviderManager::_reloadProvider(
+	const String& provPath,
+	const OperationContext& opctx)
+{
+    PEG_METHOD_ENTER(
+        TRC_PROVIDERMANAGER,
+        "PythonProviderManager::_reloadProvider()");
+
+	{
+		AutoMutex am(g_provGuard);
+		if (m_provs.find(provPath) == m_provs.end())
+		{
+			PEG_TRACE_STRING(TRC_PROVIDERMANAGER, Tracer::LEVEL4,
+				Formatter::format("Provider $0 was unloaded before it was "
+					"reloaded. Not loading a new version", provPath));
+			PEG_METHOD_EXIT();
+			return;
+		}
+	}
+
+	Uint64 start = TimeValue::getCurrentTime().toMicroseconds();
+	// Taken first, so a change made during the load is seen later
+	PyFileWatchRef fileWatch = m_fileWatcher->watch(provPath);
+	time_t modTime = getModTime(provPath);
+	PyProviderRef entry;
+	{
+		Py::GILGuard gg;	// Acquire python's GIL
+		try
+		{
+			String moduleName;
+			Py::Object pyprov = _loadProvider(provPath, opctx, moduleName);
+			entry = PyProviderRef(new PyProviderRep(provPath, pyprov));
+			entry->m_moduleName = moduleName;
+			entry->m_fileModTime = modTime;
+			entry->m_fileWatch = fileWatch;
+			entry->m_lastAccessTime = ::time(NULL);
+		}
+		catch(Py::Exception& e)
+		{
+			String tb = processPyException(e, __LINE__, provPath);
+			Logger::put(Logger::ERROR_LOG, PYSYSTEM_ID, Logger::SEVERE,
+				"ProviderManager.Python.PythonProviderManager",
+				"Caught exception reloading provider $0. The loaded "
+				"version keeps serving. $1", provPath, tb);
+		}
+		catch(...)
+		{
+			Logger::put(Logger::ERROR_LOG, PYSYSTEM_ID, Logger::SEVERE,
+				"ProviderManager.Python.PythonProviderManager",
+				"Caught unknown exception reloading provider $0. The "
+				"loaded version keeps serving.", provPath);
+		}
+	}
+
+	PyProviderRef old;
+	{
+		AutoMutex am(g_provGuard);
+		ProviderMap::iterator it = m_provs.find(provPath);
+		if (it == m_provs.end())
+		{
+			// Unloaded during the load. The new version isn't needed
+			old = entry;
+		}
+		else if (!entry)
+		{
+			// Not tried again until the file changes again
+			it->second->m_fileModTime = modTime;
+			it->second->m_reloading = false;
+		}
+		else
+		{
+			old = it->second;
+			it->second = entry;
+		}
+	}
+	if (old)
+	{
+		m_reaper->add(old);
+	}
+
+	Uint64 usecs = TimeValue::getCurrentTime().toMicroseconds() - start;
+	m_reaper->reloadDone(usecs, entry);
+	PEG_TRACE_STRING(TRC_PROVIDERMANAGER, Tracer::LEVEL4,
+		Formatter::format("Reload of provider $0 $1 after $2 usecs",
+			provPath, (entry) ? "done" : "failed", usecs));
+    PEG_METHOD_EXIT();
+}
+
 #ifdef DEBUG
     void print(PEGASUS_STD(ostream)& os, CIMRequestMessage *msg)
     {
@@ -447,9 +998,9 @@ PythonProviderManager::processMessage(Message * message)
 	//     CIM_DISABLE_MODULE_REQUEST_MESSAGE
 	//     CIM_ENABLE_MODULE_REQUEST_MESSAGE
 	CIMResponseMessage* response = 0;
+	PyProviderRef provRef;
 	try
 	{
-		PyProviderRef provRef;
 		if (request->operationContext.contains(ProviderIdContainer::NAME))
 		{
 			ProviderIdContainer providerId =
@@ -600,6 +1151,12 @@ PythonProviderManager::processMessage(Message * message)
         response->cimException = PEGASUS_CIM_EXCEPTION(
             CIM_ERR_FAILED, "Unknown error.");
     }
+	if (provRef)
+	{
+		// The reaper may be waiting for this request to shut it down
+		provRef = PyProviderRef();
+		m_reaper->referencesDropped();
+	}
 
     PEG_METHOD_EXIT();
     return(response);
@@ -692,6 +1249,121 @@ PythonProviderManager::generateIndication(
 		CIMIndication(indicationInstance));
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// generation is set to a number that changes whenever the class is fetched
+// from the CIMOM again, so conversions of it can be cached until then.
+CIMClass
+PythonProviderManager::_getClass(
+	const OperationContext& opctx,
+	const CIMNamespaceName& ns,
+	const CIMName& className,
+	Uint32* generation)
+{
+	String key = ns.getString();
+	key.append(":");
+	key.append(className.getString());
+	key.toLower();
+
+	time_t currtime = ::time(NULL);
+	{
+		AutoMutex am(g_classCacheGuard);
+		PyClassCacheMap::iterator it = m_classCache.find(key);
+		if (it != m_classCache.end())
+		{
+			if ((currtime - it->second.m_loadTime)
+				< PYPROV_CLASS_CACHE_SECS_TO_LIVE)
+			{
+				m_classCacheHits++;
+				it->second.m_lastAccessTime = currtime;
+				if (generation)
+				{
+					*generation = it->second.m_generation;
+				}
+				return it->second.m_cls;
+			}
+			m_classCache.erase(it);
+		}
+		m_classCacheMisses++;
+	}
+
+	// Don't hold the cache lock while calling back into the CIMOM
+	CIMOMHandle chdl;
+	CIMClass cc = chdl.getClass(opctx, ns, className, false, true, true,
+		CIMPropertyList());
+
+	AutoMutex am(g_classCacheGuard);
+	if (m_classCache.size() >= PYPROV_CLASS_CACHE_SIZE)
+	{
+		// Evict the least recently used entry
+		PyClassCacheMap::iterator lru = m_classCache.begin();
+		PyClassCacheMap::iterator it = lru;
+		for (++it; it != m_classCache.end(); it++)
+		{
+			if (it->second.m_lastAccessTime < lru->second.m_lastAccessTime)
+			{
+				lru = it;
+			}
+		}
+		m_classCache.erase(lru);
+	}
+	PyClassCacheEntry& entry = m_classCache[key];
+	entry.m_cls = cc;
+	entry.m_loadTime = currtime;
+	entry.m_lastAccessTime = currtime;
+	if (++m_classLoads == 0)
+	{
+		// 0 is never handed out, it means unknown
+		++m_classLoads;
+	}
+	entry.m_generation = m_classLoads;
+	if (generation)
+	{
+		*generation = entry.m_generation;
+	}
+	return cc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void
+PythonProviderManager::invalidateClassCache(
+	const CIMNamespaceName& ns)
+{
+	String prefix = ns.getString();
+	prefix.append(":");
+	prefix.toLower();
+	Uint32 len = prefix.size();
+
+	AutoMutex am(g_classCacheGuard);
+	PyClassCacheMap::iterator it = m_classCache.begin();
+	while (it != m_classCache.end())
+	{
+		if (it->first.size() > len && it->first.subString(0, len) == prefix)
+		{
+			m_classCache.erase(it++);
+			continue;
+		}
+		it++;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void
+PythonProviderManager::getClassCacheStats(
+	Uint32& hits,
+	Uint32& misses) const
+{
+	AutoMutex am(g_classCacheGuard);
+	hits = m_classCacheHits;
+	misses = m_classCacheMisses;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+PyUnloadStats
+PythonProviderManager::getUnloadStats() const
+{
+	return m_reaper->getStats();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 Boolean PythonProviderManager::hasActiveProviders()
 {
@@ -730,6 +1402,11 @@ Boolean PythonProviderManager::hasActiveProviders()
 		// TODO
 		cc = true;
 	}
+	if (!cc && getUnloadStats().pending)
+	{
+		// Detached providers still wait for their shutdown
+		cc = true;
+	}
     PEG_METHOD_EXIT();
 	return cc;
 }
@@ -741,24 +1418,91 @@ void PythonProviderManager::unloadIdleProviders()
         TRC_PROVIDERMANAGER,
         "PythonProviderManager::unloadIdleProviders()");
  
-	AutoMutex am(g_provGuard);
-	time_t currtime = ::time(NULL);
-	ProviderMap::iterator it = m_provs.begin();
-	while(it != m_provs.end())
+	Uint32 hits, misses;
+	getClassCacheStats(hits, misses);
+	PEG_TRACE_STRING(TRC_PROVIDERMANAGER, Tracer::LEVEL4,
+		Formatter::format("Class cache hits: $0  misses: $1", hits, misses));
+
+	std::vector<PyProviderRef> provs;
+	{
+		AutoMutex am(g_provGuard);
+		for (ProviderMap::iterator it = m_provs.begin();
+			it != m_provs.end(); ++it)
+		{
+			provs.push_back(it->second);
+		}
+	}
+	for (size_t i = 0; i < provs.size(); i++)
 	{
-		if (!(it->second->m_isIndicationConsumer)
-			&& !(it->second->m_pIndicationResponseHandler))
+		PyResultBatchStats bstats;
 		{
-			time_t tdiff = currtime - it->second->m_lastAccessTime;
-			if (tdiff >= PYPROV_SECS_TO_LIVE)
+			Py::GILGuard gg;	// The counters are protected by the GIL
+			bstats = provs[i]->m_resultBatchStats;
+		}
+		if (!bstats.batches)
+		{
+			continue;
+		}
+		PEG_TRACE_STRING(TRC_PROVIDERMANAGER, Tracer::LEVEL4,
+			Formatter::format("Provider $0 result batches: $1  items: $2  "
+				"GIL hold usecs total: $3  avg: $4  max: $5",
+				provs[i]->m_path, bstats.batches, bstats.items,
+				bstats.holdUsecs, bstats.holdUsecs / bstats.batches,
+				bstats.maxHoldUsecs));
+	}
+	provs.clear();
+	// One of them may have been replaced by a reload meanwhile
+	m_reaper->referencesDropped();
+
+	PyUnloadStats ustats = getUnloadStats();
+	PEG_TRACE_STRING(TRC_PROVIDERMANAGER, Tracer::LEVEL4,
+		Formatter::format("Provider unloads: $0  pending: $1  latency usecs "
+			"avg: $2  max: $3  detach usecs avg: $4  max: $5  blocked "
+			"requests: $6", ustats.unloads, ustats.pending,
+			(ustats.unloads) ? ustats.totalLatencyUsecs / ustats.unloads : 0,
+			ustats.maxLatencyUsecs,
+			(ustats.detachPasses)
+				? ustats.totalDetachUsecs / ustats.detachPasses : 0,
+			ustats.maxDetachUsecs, ustats.blockedRequests));
+	PEG_TRACE_STRING(TRC_PROVIDERMANAGER, Tracer::LEVEL4,
+		Formatter::format("Provider reloads: $0  failed: $1  reload usecs "
+			"avg: $2  max: $3", ustats.reloads, ustats.failedReloads,
+			(ustats.reloads) ? ustats.totalReloadUsecs / ustats.reloads : 0,
+			ustats.maxReloadUsecs));
+
+	// Only detach the idle providers here. Their python shutdown code runs
+	// on the reaper thread once the requests using them are done.
+	std::vector<PyProviderRef> detached;
+	m_reaper->detachStarted();
+	Uint64 detachStart = TimeValue::getCurrentTime().toMicroseconds();
+	{
+		AutoMutex am(g_provGuard);
+		time_t currtime = ::time(NULL);
+		ProviderMap::iterator it = m_provs.begin();
+		while(it != m_provs.end())
+		{
+			if (!(it->second->m_isIndicationConsumer)
+				&& !(it->second->m_pIndicationResponseHandler))
 			{
-				_shutdownProvider(it->second, OperationContext());
-				m_provs.erase(it++);
-				continue;
+				time_t tdiff = currtime - it->second->m_lastAccessTime;
+				if (tdiff >= PYPROV_SECS_TO_LIVE)
+				{
+					detached.push_back(it->second);
+					m_provs.erase(it++);
+					continue;
+				}
 			}
+			it++;
 		}
-		it++;
 	}
+	m_reaper->detachDone(TimeValue::getCurrentTime().toMicroseconds()
+		- detachStart);
+	for (size_t i = 0; i < detached.size(); i++)
+	{
+		m_reaper->add(detached[i]);
+	}
+	detached.clear();
+	m_reaper->referencesDropped();
     PEG_METHOD_EXIT();
 }
 
@@ -33,6 +33,8 @@
 #include "Reference.h"
 #include "PyCxxObjects.h"
 #include "PG_PyExtensions.h"
+#include "PG_PyFileWatcher.h"
+#include "PG_PyProvIFCCommon.h"
 
 #include <ctime>
 #include <map>
@@ -52,13 +54,17 @@ public:
 	PyProviderRep()
 		: m_path()
 		, m_pyprov(Py::None())
+		, m_moduleName()
 		, m_canUnload(true)
 		, m_lastAccessTime(time_t(0))
 		, m_fileModTime(time_t(0))
+		, m_fileWatch()
 		, m_activationCount(0)
 		, m_provInstance()
 		, m_pIndicationResponseHandler(0)
 		, m_isIndicationConsumer(false)
+		, m_reloading(false)
+		, m_resultBatchStats()
 	{
 	}
 
@@ -66,13 +72,17 @@ public:
 		bool canUnload=true)
 		: m_path(path)
 		, m_pyprov(pyprov)
+		, m_moduleName()
 		, m_canUnload(canUnload)
 		, m_lastAccessTime(time_t(0))
 		, m_fileModTime(time_t(0))
+		, m_fileWatch()
 		, m_activationCount(0)
 		, m_provInstance()
 		, m_pIndicationResponseHandler(0)
 		, m_isIndicationConsumer(false)
+		, m_reloading(false)
+		, m_resultBatchStats()
 	{
 	}
 
@@ -85,13 +95,17 @@ public:
 
 	String m_path;
 	Py::Object m_pyprov;
+	String m_moduleName;	// Key of the module in sys.modules
 	bool m_canUnload;
 	time_t m_lastAccessTime;
 	time_t m_fileModTime;
+	PyFileWatchRef m_fileWatch;	// Says when m_fileModTime is worth checking
 	int m_activationCount;
 	CIMInstance m_provInstance;
 	EnableIndicationsResponseHandler *m_pIndicationResponseHandler;
 	bool m_isIndicationConsumer;
+	bool m_reloading;		// A new version is being loaded. g_provGuard
+	PyResultBatchStats m_resultBatchStats;	// Protected by the GIL
 private:
 
 	// These are unimplemented. Copy not allowed
@@ -102,6 +116,59 @@ private:
 typedef Reference<PyProviderRep> PyProviderRef;
 typedef std::map<String, PyProviderRef> ProviderMap;
 
+// Unloading of idle providers. unloadIdleProviders only detaches them
+// from the provider map; their shutdown runs later on the reaper thread.
+struct PyUnloadStats
+{
+	PyUnloadStats()
+		: unloads(0)
+		, totalLatencyUsecs(0)
+		, maxLatencyUsecs(0)
+		, pending(0)
+		, detachPasses(0)
+		, totalDetachUsecs(0)
+		, maxDetachUsecs(0)
+		, blockedRequests(0)
+		, reloads(0)
+		, failedReloads(0)
+		, totalReloadUsecs(0)
+		, maxReloadUsecs(0)
+	{
+	}
+
+	Uint64 unloads;				// Providers shut down by the reaper
+	Uint64 totalLatencyUsecs;	// From detaching to the end of shutdown
+	Uint64 maxLatencyUsecs;
+	Uint32 pending;				// Detached, waiting for requests to drain
+	Uint64 detachPasses;
+	Uint64 totalDetachUsecs;	// g_provGuard hold time of detach passes
+	Uint64 maxDetachUsecs;
+	Uint64 blockedRequests;		// Requests that waited for a detach pass
+	Uint64 reloads;				// Changed providers replaced by new versions
+	Uint64 failedReloads;		// Loads of new versions that failed
+	Uint64 totalReloadUsecs;	// Load and switch time of new versions
+	Uint64 maxReloadUsecs;
+};
+
+class PyProviderReaper;
+
+struct PyClassCacheEntry
+{
+	PyClassCacheEntry()
+		: m_cls()
+		, m_loadTime(time_t(0))
+		, m_lastAccessTime(time_t(0))
+		, m_generation(0)
+	{
+	}
+
+	CIMClass m_cls;
+	time_t m_loadTime;
+	time_t m_lastAccessTime;
+	Uint32 m_generation;	// Changes every time the class is fetched
+};
+typedef std::map<String, PyClassCacheEntry> PyClassCacheMap;
+
 class PEGASUS_PYTHONPM_LINKAGE PythonProviderManager : public ProviderManager
 {
 public:
@@ -134,6 +201,11 @@ public:
 
 	void setAsIndicationConsumer(PyProviderRef& provref);
 
+	// Drop all cached classes for the given namespace
+	void invalidateClassCache(const CIMNamespaceName& ns);
+	void getClassCacheStats(Uint32& hits, Uint32& misses) const;
+	PyUnloadStats getUnloadStats() const;
+
 protected:
 
     CIMResponseMessage* _handleUnsupportedRequest(CIMRequestMessage * message, PyProviderRef& provref);
@@ -153,30 +225,43 @@ protected:
     ProviderName _resolveProviderName(const ProviderIdContainer & providerId);
 	String _resolvePhysicalName(String physicalName);
 	void _initPython();
+	void _getResultBatchSize();
 
 private:
 
 	Py::Object _loadProvider(const String& provPath,
-		const OperationContext& opctx);
+		const OperationContext& opctx, String& moduleName);
 	void _shutdownProvider(const PyProviderRef& provref,
 		const OperationContext& opctx);
+	void _reloadProvider(const String& provPath,
+		const OperationContext& opctx);
 	PyProviderRef _path2PyProviderRef(const String& provPath,
 		const OperationContext& opctx);
 	void _incActivationCount(CIMRequestMessage* message, PyProviderRef& provref);
 	void _decActivationCount(CIMRequestMessage* message, PyProviderRef& provref);
 	void _stopAllProviders();
+	CIMClass _getClass(const OperationContext& opctx,
+		const CIMNamespaceName& ns, const CIMName& className,
+		Uint32* generation=0);
 
 	Py::Module m_pywbemMod;
 	Py::Object m_cimexobj;
 	PyExtensions* m_pPyExtensions;
 	ProviderMap m_provs;
 	PyThreadState* m_mainPyThreadState;
+	PyClassCacheMap m_classCache;
+	Uint32 m_classCacheHits;
+	Uint32 m_classCacheMisses;
+	Uint32 m_classLoads;
+	PyProviderReaper* m_reaper;
+	PyFileWatcher* m_fileWatcher;
 
 	friend class InstanceProviderHandler;
 	friend class MethodProviderHandler;
 	friend class AssociatorProviderHandler;
 	friend class IndicationConsumerProviderHandler;
 	friend class IndicationProviderHandler;
+	friend class PyProviderReaper;
 };
 
 bool strEndsWith(const String& src, const String& tok);
@@ -78,6 +78,9 @@ class Reference :
 		T* operator->() const;
 		T& operator*() const;
 		T* getPtr() const;
+		// Number of references to the object, 0 if null. Only a hint while
+		// other threads copy or drop references.
+		int getRefCount() const;
 		typedef T* volatile Reference::*safe_bool;
 		operator safe_bool () const
 			{  return (m_pObj ? &Reference::m_pObj : 0); }
@@ -179,6 +182,12 @@ inline T* Reference<T>::getPtr() const
 	return m_pObj;
 }
 //////////////////////////////////////////////////////////////////////////////
+template<class T>
+inline int Reference<T>::getRefCount() const
+{
+	return (m_pObj) ? m_pRefCount->get() : 0;
+}
+//////////////////////////////////////////////////////////////////////////////
 template <class T>
 template <class U>
 inline Reference<U>